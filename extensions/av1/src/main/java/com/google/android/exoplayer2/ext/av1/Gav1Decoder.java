@@ -18,15 +18,24 @@ package com.google.android.exoplayer2.ext.av1;
 import static androidx.annotation.VisibleForTesting.PACKAGE_PRIVATE;
 import static java.lang.Runtime.getRuntime;
 
+import android.os.ParcelFileDescriptor;
+import android.util.Log;
 import android.view.Surface;
 import androidx.annotation.Nullable;
 import androidx.annotation.VisibleForTesting;
 import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.decoder.DecodedFrameRateTracker;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.DecoderThreadBudget;
+import com.google.android.exoplayer2.decoder.SharedMemoryFrame;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
+import com.google.android.exoplayer2.decoder.TemporalUnitInfo;
 import com.google.android.exoplayer2.decoder.VideoDecoderOutputBuffer;
+import com.google.android.exoplayer2.decoder.VideoDecoderPreroll;
 import com.google.android.exoplayer2.util.Util;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.Arrays;
 
 /** Gav1 decoder. */
 @VisibleForTesting(otherwise = PACKAGE_PRIVATE)
@@ -36,10 +45,43 @@ public final class Gav1Decoder
   private static final int GAV1_ERROR = 0;
   private static final int GAV1_OK = 1;
   private static final int GAV1_DECODE_ONLY = 2;
+  private static final int GAV1_PRIVATE_FRAME = 3;
+
+  // Indices of the ints in frameMetadata.
+  private static final int FRAME_METADATA_WIDTH = 0;
+  private static final int FRAME_METADATA_HEIGHT = 1;
+  private static final int FRAME_METADATA_BUFFER_ID = 2;
+  private static final int FRAME_METADATA_SIZE = 3;
+
+  // Indices of the ints describing a frame exported by gav1ExportSharedFrame.
+  private static final int SHARED_FRAME_LAYOUT_WIDTH = 0;
+  private static final int SHARED_FRAME_LAYOUT_HEIGHT = 1;
+  private static final int SHARED_FRAME_LAYOUT_SIZE_BYTES = 2;
+  private static final int SHARED_FRAME_LAYOUT_OFFSETS = 3;
+  private static final int SHARED_FRAME_LAYOUT_STRIDES = 6;
+  private static final int SHARED_FRAME_LAYOUT_SIZE = 9;
+  // Returned by gav1ExportSharedFrame instead of a file descriptor.
+  private static final int SHARED_FRAME_NOT_SHARED = -1;
+  private static final int SHARED_FRAME_ERROR = -2;
+
+  /** Value of {@link VideoDecoderOutputBuffer#decoderPrivate} when it holds no native frame. */
+  private static final int NO_NATIVE_FRAME = -1;
 
   private final long gav1DecoderContext;
+  // Releases the native frames of output buffers, including after the decoder is released.
+  private final long gav1BufferManager;
+  private final DecoderThreadBudget.Registration threadBudgetRegistration;
+  private final VideoDecoderPreroll preroll;
+  private final DecodedFrameRateTracker trickPlayFrameRate;
+  // Receives the metadata of frames output in surface mode, saving upcalls from native code.
+  private final ByteBuffer frameMetadata;
+
+  private int decoderThreads;
+  private boolean decoderTrickPlay;
 
   private volatile @C.VideoOutputMode int outputMode;
+  private volatile boolean asyncRenderEnabled;
+  private volatile boolean trickPlayEnabled;
 
   /**
    * Creates a Gav1Decoder.
@@ -49,13 +91,18 @@ public final class Gav1Decoder
    * @param initialInputBufferSize The initial size of each input buffer, in bytes.
    * @param threads Number of threads libgav1 will use to decode. If {@link
    *     Libgav1VideoRenderer#THREAD_COUNT_AUTODETECT} is passed, then this class will auto detect
-   *     the number of threads to be used.
+   *     the number of threads to be used. The decoder may use fewer threads when other decoders
+   *     share the {@link DecoderThreadBudget}.
    * @throws Gav1DecoderException Thrown if an exception occurs when initializing the decoder.
    */
   public Gav1Decoder(
       int numInputBuffers, int numOutputBuffers, int initialInputBufferSize, int threads)
       throws Gav1DecoderException {
     super(new DecoderInputBuffer[numInputBuffers], new VideoDecoderOutputBuffer[numOutputBuffers]);
+    preroll = new VideoDecoderPreroll();
+    trickPlayFrameRate = new DecodedFrameRateTracker();
+    frameMetadata =
+        ByteBuffer.allocateDirect(FRAME_METADATA_SIZE * 4).order(ByteOrder.nativeOrder());
     if (!Gav1Library.isAvailable()) {
       throw new Gav1DecoderException("Failed to load decoder native library.");
     }
@@ -69,14 +116,134 @@ public final class Gav1Decoder
       }
     }
 
-    gav1DecoderContext = gav1Init(threads);
+    threadBudgetRegistration =
+        DecoderThreadBudget.getInstance()
+            .register(DecoderThreadBudget.PRIORITY_FOREGROUND, threads);
+    decoderThreads = threadBudgetRegistration.getThreadCount();
+    gav1DecoderContext = gav1Init(decoderThreads);
     if (gav1DecoderContext == GAV1_ERROR || gav1CheckError(gav1DecoderContext) == GAV1_ERROR) {
+      threadBudgetRegistration.unregister();
       throw new Gav1DecoderException(
           "Failed to initialize decoder. Error: " + gav1GetErrorMessage(gav1DecoderContext));
     }
+    gav1BufferManager = gav1GetBufferManager(gav1DecoderContext);
     setInitialInputBufferSize(initialInputBufferSize);
   }
 
+  /**
+   * Initializes native decoders ahead of time and keeps them idle, so that decoders created later,
+   * for example when switching channels or tracks, start without waiting for libgav1 to initialize.
+   * Closed decoders are also kept idle for reuse. At most two idle decoders are kept.
+   *
+   * <p>Idle decoders are kept with a single thread, so that they hold no threads outside the
+   * {@link DecoderThreadBudget}. A decoder that reuses one starts the threads it is given.
+   *
+   * @param count Number of decoders to initialize.
+   */
+  public static void prewarm(int count) {
+    if (Gav1Library.isAvailable()) {
+      gav1Prewarm(count);
+    }
+  }
+
+  /**
+   * Sets how many bytes of frame buffer memory released by closed decoders are kept for new
+   * decoders to reuse. A decoder created after another one is closed, for example when a track or
+   * resolution change re-creates the decoder, then reuses memory that is already mapped instead of
+   * allocating it again. The least recently released memory is freed first. The default is 64 MiB.
+   * Setting 0 frees the kept memory, for example when the app is asked to trim its memory.
+   *
+   * @param capacityBytes The maximum number of bytes kept.
+   */
+  public static void setFrameArenaCapacity(long capacityBytes) {
+    if (Gav1Library.isAvailable()) {
+      gav1SetFrameArenaCapacity(capacityBytes);
+    }
+  }
+
+  /**
+   * Sets the minimum priority of the messages logged by the native decoder. Messages below it cost
+   * next to nothing. The default is {@link Log#WARN}. Debug and verbose messages are compiled out
+   * of release builds of the native library.
+   *
+   * @param priority One of the {@link Log} priorities, such as {@link Log#VERBOSE}.
+   */
+  public static void setNativeLogLevel(int priority) {
+    if (Gav1Library.isAvailable()) {
+      gav1SetLogLevel(priority);
+    }
+  }
+
+  /**
+   * Sets whether the native decoder writes its messages to an in-memory ring of recent messages
+   * instead of logcat, so that verbose logging does not distort benchmarks. Errors are written to
+   * logcat in either case. The ring is read with {@link #getNativeLogRing()}.
+   */
+  public static void setNativeLogRingEnabled(boolean enabled) {
+    if (Gav1Library.isAvailable()) {
+      gav1SetLogRingEnabled(enabled);
+    }
+  }
+
+  /**
+   * Returns the messages held in the in-memory ring of the native decoder, oldest first and one per
+   * line, or an empty string if the native library is not available.
+   */
+  public static String getNativeLogRing() {
+    if (!Gav1Library.isAvailable()) {
+      return "";
+    }
+    @Nullable String log = gav1DumpLogRing();
+    return log != null ? log : "";
+  }
+
+  /**
+   * Classifies the temporal unit held by an input buffer by parsing its headers, without decoding
+   * it. The player can use the result to decide whether to drop or skip the buffer before queueing
+   * it.
+   *
+   * <p>Must be called on the thread that queues input buffers, before the buffer is queued. The
+   * parser keeps the sequence header and reference frame types of the stream, so buffers must be
+   * classified in decode order, starting from a buffer that holds a sequence header.
+   *
+   * @param inputBuffer The input buffer, whose {@link DecoderInputBuffer#data} must be flipped.
+   * @return The {@link TemporalUnitInfo}, or null if the temporal unit could not be parsed.
+   */
+  @Nullable
+  public TemporalUnitInfo classifyTemporalUnit(DecoderInputBuffer inputBuffer) {
+    ByteBuffer inputData = Util.castNonNull(inputBuffer.data);
+    return TemporalUnitInfo.fromPackedInfo(
+        gav1ClassifyTemporalUnit(
+            gav1DecoderContext, inputData, inputData.position(), inputData.remaining()));
+  }
+
+  /**
+   * Sets whether only key frames and other intra coded frames are decoded, for fast forward and
+   * rewind at high speeds. Other input buffers are skipped without being decoded, and output as
+   * decode-only buffers. Takes effect from the next input buffer.
+   *
+   * <p>Frames that follow a skipped frame may reference it, so after trick play is disabled, input
+   * buffers keep being skipped until the next key frame.
+   *
+   * @param enabled Whether trick play is enabled.
+   */
+  public void setTrickPlayEnabled(boolean enabled) {
+    trickPlayEnabled = enabled;
+    if (enabled) {
+      trickPlayFrameRate.start();
+    } else {
+      trickPlayFrameRate.stop();
+    }
+  }
+
+  /**
+   * Returns the number of frames per second output since trick play was enabled, or 0 if it is not
+   * enabled.
+   */
+  public float getTrickPlayFrameRate() {
+    return trickPlayFrameRate.getFrameRate();
+  }
+
   @Override
   public String getName() {
     return "libgav1";
@@ -96,31 +263,63 @@ public final class Gav1Decoder
   @Nullable
   protected Gav1DecoderException decode(
       DecoderInputBuffer inputBuffer, VideoDecoderOutputBuffer outputBuffer, boolean reset) {
+    preroll.onDecodeStarting();
+    if (reset) {
+      // Apply the decoder's current share of the thread budget, which may have changed as other
+      // decoders came and went.
+      int threads = threadBudgetRegistration.getThreadCount();
+      if (threads != decoderThreads) {
+        if (gav1SetThreads(gav1DecoderContext, threads) == GAV1_ERROR) {
+          return new Gav1DecoderException(
+              "gav1SetThreads error: " + gav1GetErrorMessage(gav1DecoderContext));
+        }
+        decoderThreads = threads;
+      }
+    }
+    boolean trickPlay = trickPlayEnabled;
+    if (trickPlay != decoderTrickPlay) {
+      gav1SetTrickPlayEnabled(gav1DecoderContext, trickPlay);
+      decoderTrickPlay = trickPlay;
+    }
     ByteBuffer inputData = Util.castNonNull(inputBuffer.data);
     int inputSize = inputData.limit();
-    if (gav1Decode(gav1DecoderContext, inputData, inputSize) == GAV1_ERROR) {
-      return new Gav1DecoderException(
-          "gav1Decode error: " + gav1GetErrorMessage(gav1DecoderContext));
-    }
-
     boolean decodeOnly = inputBuffer.isDecodeOnly();
+    @C.VideoOutputMode int outputMode = this.outputMode;
     if (!decodeOnly) {
       outputBuffer.init(inputBuffer.timeUs, outputMode, /* supplementalData= */ null);
     }
+    outputBuffer.decoderPrivate = NO_NATIVE_FRAME;
     // We need to dequeue the decoded frame from the decoder even when the input data is
     // decode-only.
-    int getFrameResult = gav1GetFrame(gav1DecoderContext, outputBuffer, decodeOnly);
-    if (getFrameResult == GAV1_ERROR) {
+    int result =
+        gav1DecodeFrame(
+            gav1DecoderContext,
+            inputData,
+            inputSize,
+            outputBuffer,
+            outputMode,
+            decodeOnly,
+            frameMetadata);
+    if (result == GAV1_ERROR) {
       return new Gav1DecoderException(
-          "gav1GetFrame error: " + gav1GetErrorMessage(gav1DecoderContext));
+          "gav1DecodeFrame error: " + gav1GetErrorMessage(gav1DecoderContext));
     }
-    if (getFrameResult == GAV1_DECODE_ONLY) {
+    if (result == GAV1_DECODE_ONLY) {
       outputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
+    } else if (result == GAV1_PRIVATE_FRAME) {
+      outputBuffer.initForPrivateFrame(
+          frameMetadata.getInt(FRAME_METADATA_WIDTH * 4),
+          frameMetadata.getInt(FRAME_METADATA_HEIGHT * 4));
+      outputBuffer.decoderPrivate = frameMetadata.getInt(FRAME_METADATA_BUFFER_ID * 4);
     }
     if (!decodeOnly) {
       outputBuffer.format = inputBuffer.format;
     }
+    if (trickPlay && !outputBuffer.isDecodeOnly()) {
+      trickPlayFrameRate.onFrameDecoded();
+    }
 
+    preroll.onFrameDecoded(outputBuffer);
     return null;
   }
 
@@ -131,20 +330,82 @@ public final class Gav1Decoder
 
   @Override
   public void release() {
+    preroll.release();
     super.release();
     gav1Close(gav1DecoderContext);
+    threadBudgetRegistration.unregister();
   }
 
   @Override
   protected void releaseOutputBuffer(VideoDecoderOutputBuffer buffer) {
+    preroll.onFrameReleased(buffer);
     // Decode only frames do not acquire a reference on the internal decoder buffer and thus do not
-    // require a call to gav1ReleaseFrame.
-    if (buffer.mode == C.VIDEO_OUTPUT_MODE_SURFACE_YUV && !buffer.isDecodeOnly()) {
-      gav1ReleaseFrame(gav1DecoderContext, buffer);
+    // require a call to gav1ReleaseFrame. Nor do frames copied out in YUV mode, but frames exposed
+    // without copying do. They may be released after the decoder, whose buffer manager outlives it
+    // until then.
+    if (!buffer.isDecodeOnly() && buffer.decoderPrivate != NO_NATIVE_FRAME) {
+      gav1ReleaseFrame(gav1BufferManager, buffer.decoderPrivate);
+      buffer.decoderPrivate = NO_NATIVE_FRAME;
     }
     super.releaseOutputBuffer(buffer);
   }
 
+  /**
+   * Starts prerolling an upcoming playlist item, decoding its first frames before it becomes
+   * current. Until {@link #endPreroll()} is called, the decode thread runs at background priority
+   * and waits once the frames it decoded and that are still queued or held hold {@code maxBytes}.
+   * The frames are handed out as soon as they are dequeued.
+   *
+   * @param maxBytes The maximum number of bytes of decoded frames to hold while prerolling.
+   */
+  public void startPreroll(long maxBytes) {
+    preroll.start(maxBytes);
+  }
+
+  /** Ends the preroll started by {@link #startPreroll(long)}, once the item becomes current. */
+  public void endPreroll() {
+    preroll.end();
+  }
+
+  /**
+   * Suspends the decoder while it is not needed, for example while the app is in the background
+   * with playback paused. The native decoder and its threads are destroyed and the frame buffers
+   * that are not held by output buffers are freed, but the configuration of the decoder is kept.
+   * Freed frame buffers are not kept for reuse, so call {@link #setFrameArenaCapacity(long)} too to
+   * release the memory of other closed decoders. May be called on any thread.
+   *
+   * <p>The native decoder is recreated by {@link #resume()}, or when it is next given input. As the
+   * frames it referenced are gone, input is then output as decode-only until the next key frame.
+   */
+  public void suspend() {
+    gav1Suspend(gav1DecoderContext);
+  }
+
+  /**
+   * Recreates the native decoder after {@link #suspend()}, so that the next input is not delayed
+   * by its initialization. Frame buffers are allocated again as frames are decoded. Does nothing if
+   * the decoder is not suspended. May be called on any thread.
+   *
+   * @throws Gav1DecoderException Thrown if the native decoder could not be recreated.
+   */
+  public void resume() throws Gav1DecoderException {
+    if (gav1Resume(gav1DecoderContext) == GAV1_ERROR) {
+      throw new Gav1DecoderException(
+          "gav1Resume error: " + gav1GetErrorMessage(gav1DecoderContext));
+    }
+  }
+
+  /**
+   * Sets the priority of this decoder when the {@link DecoderThreadBudget} is divided between the
+   * live decoders. Decoders start with {@link DecoderThreadBudget#PRIORITY_FOREGROUND}. A change in
+   * the number of threads the decoder uses takes effect when it is next flushed.
+   *
+   * @param priority The {@link DecoderThreadBudget.Priority}.
+   */
+  public void setThreadPriority(@DecoderThreadBudget.Priority int priority) {
+    threadBudgetRegistration.setPriority(priority);
+  }
+
   /**
    * Sets the output mode for frames rendered by the decoder.
    *
@@ -154,6 +415,197 @@ public final class Gav1Decoder
     this.outputMode = outputMode;
   }
 
+  /**
+   * Sets the row alignment of the planes written in {@link C#VIDEO_OUTPUT_MODE_YUV} mode. Takes
+   * effect from the next output frame.
+   *
+   * <p>By default the planes are copied with libgav1's strides, which include its border and
+   * alignment padding. If {@code alignment} is positive, the stride of each plane is instead its
+   * displayed width rounded up to a multiple of {@code alignment}, which reduces the number of
+   * bytes copied and uploaded when the decoder stride is much wider than the picture. The strides
+   * used are reported through {@link VideoDecoderOutputBuffer#yuvStrides}.
+   *
+   * @param alignment The row alignment in bytes, for example 1 for tightly packed rows or 16, or 0
+   *     to use the decoder's strides.
+   */
+  public void setYuvOutputStrideAlignment(int alignment) {
+    gav1SetYuvOutputStrideAlignment(gav1DecoderContext, alignment);
+  }
+
+  /**
+   * Sets whether frames output in {@link C#VIDEO_OUTPUT_MODE_YUV} mode expose the decoder's frame
+   * buffers instead of copying them into {@link VideoDecoderOutputBuffer#data}. Takes effect from
+   * the next output frame.
+   *
+   * <p>When enabled, 8-bit 4:2:0 frames are output with {@link VideoDecoderOutputBuffer#data} set
+   * to null and {@link VideoDecoderOutputBuffer#yuvPlanes} viewing the decoder's memory, which
+   * avoids a full frame copy. The planes keep libgav1's strides regardless of {@link
+   * #setYuvOutputStrideAlignment(int)}, and are only valid until the output buffer is released.
+   * Other frames are copied as before.
+   *
+   * @param enabled Whether zero-copy YUV output is enabled.
+   */
+  public void setZeroCopyYuvOutputEnabled(boolean enabled) {
+    gav1SetZeroCopyYuvOutputEnabled(gav1DecoderContext, enabled);
+  }
+
+  /**
+   * Sets whether the decoder's frame buffers are allocated in shared memory, backed by {@code
+   * memfd_create} or ashmem, so that the frames can be {@link #exportSharedFrame exported} to
+   * another process without copying them. Takes effect as frame buffers are handed to the decoder,
+   * so frames decoded shortly after enabling it may still be in private memory.
+   *
+   * @param enabled Whether frame buffers are allocated in shared memory.
+   */
+  public void setSharedMemoryFramesEnabled(boolean enabled) {
+    gav1SetSharedMemoryFramesEnabled(gav1DecoderContext, enabled);
+  }
+
+  /**
+   * Exports the frame held by an output buffer as a {@link SharedMemoryFrame}, which another
+   * process can map without copying the frame. Only frames output through {@link
+   * #setZeroCopyYuvOutputEnabled(boolean) zero-copy} {@link C#VIDEO_OUTPUT_MODE_YUV} buffers or in
+   * {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode, while {@link
+   * #setSharedMemoryFramesEnabled(boolean) shared memory frames} are enabled, can be exported.
+   *
+   * <p>The output buffer must not be released before the other process is done with the frame.
+   *
+   * @param outputBuffer An output buffer dequeued from this decoder and not yet released.
+   * @return The exported frame, whose file descriptor the caller must close, or null if the frame
+   *     is not in shared memory.
+   * @throws IllegalArgumentException If the output buffer does not hold a frame of this decoder.
+   */
+  @Nullable
+  public SharedMemoryFrame exportSharedFrame(VideoDecoderOutputBuffer outputBuffer) {
+    if (outputBuffer.isDecodeOnly() || outputBuffer.decoderPrivate == NO_NATIVE_FRAME) {
+      return null;
+    }
+    int[] layout = new int[SHARED_FRAME_LAYOUT_SIZE];
+    int fd = gav1ExportSharedFrame(gav1DecoderContext, outputBuffer.decoderPrivate, layout);
+    if (fd == SHARED_FRAME_ERROR) {
+      throw new IllegalArgumentException(
+          "gav1ExportSharedFrame error: " + gav1GetErrorMessage(gav1DecoderContext));
+    }
+    if (fd == SHARED_FRAME_NOT_SHARED) {
+      return null;
+    }
+    return new SharedMemoryFrame(
+        ParcelFileDescriptor.adoptFd(fd),
+        layout[SHARED_FRAME_LAYOUT_SIZE_BYTES],
+        layout[SHARED_FRAME_LAYOUT_WIDTH],
+        layout[SHARED_FRAME_LAYOUT_HEIGHT],
+        Arrays.copyOfRange(layout, SHARED_FRAME_LAYOUT_OFFSETS, SHARED_FRAME_LAYOUT_OFFSETS + 3),
+        Arrays.copyOfRange(layout, SHARED_FRAME_LAYOUT_STRIDES, SHARED_FRAME_LAYOUT_STRIDES + 3));
+  }
+
+  /**
+   * Sets the factor by which 8-bit frames are downscaled while being copied out, in {@link
+   * C#VIDEO_OUTPUT_MODE_YUV} and {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} modes. Takes effect from
+   * the next output frame.
+   *
+   * <p>Each output sample is the average of a {@code factor} x {@code factor} block of decoded
+   * samples, and the output width and height are the decoded ones divided by {@code factor},
+   * rounded up. This reduces the memory traffic and the size of the output buffers when the frames
+   * are shown in a view much smaller than the video, for example a thumbnail. Downscaled frames are
+   * never output through {@link #setZeroCopyYuvOutputEnabled(boolean) zero-copy} buffers.
+   *
+   * @param factor 1 (the default) to output frames at their decoded size, 2 or 4.
+   * @throws IllegalArgumentException If the factor is not supported.
+   */
+  public void setOutputDownscaleFactor(int factor) {
+    if (factor != 1 && factor != 2 && factor != 4) {
+      throw new IllegalArgumentException("Unsupported downscale factor: " + factor);
+    }
+    gav1SetDownscaleFactor(gav1DecoderContext, factor);
+  }
+
+  /**
+   * Sets whether frames are presented on a native render thread in {@link
+   * C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode.
+   *
+   * <p>When enabled, {@link #renderToSurface} queues the frame and returns without waiting for a
+   * window buffer, so a busy compositor does not block the caller. The render thread waits until
+   * the release time of each queued frame before presenting it, as ANativeWindow has no public API
+   * to pass a presentation time to the compositor. A frame is dropped if a later frame is already
+   * due when the render thread gets to it, or if too many frames are queued. Disabling stops the
+   * render thread and drops the frames that have not been presented yet.
+   *
+   * @param enabled Whether asynchronous rendering is enabled.
+   */
+  public void setAsyncRenderEnabled(boolean enabled) {
+    asyncRenderEnabled = enabled;
+    gav1SetAsyncRenderEnabled(gav1DecoderContext, enabled);
+  }
+
+  /**
+   * Returns the number of frames presented by the render thread since asynchronous rendering was
+   * last enabled.
+   */
+  public long getAsyncRenderedFrameCount() {
+    return gav1GetRenderedFrameCount(gav1DecoderContext);
+  }
+
+  /**
+   * Returns the number of frames dropped by the render thread since asynchronous rendering was last
+   * enabled, including frames that failed to be presented.
+   */
+  public long getAsyncDroppedFrameCount() {
+    return gav1GetDroppedFrameCount(gav1DecoderContext);
+  }
+
+  /**
+   * Sets the size of a native cache of copies of the recently output frames, keyed by presentation
+   * time. Frames read from it with {@link #readCachedFrame} serve short backward seeks and seek
+   * previews without decoding. Only 8-bit 4:2:0 frames are cached. When the cache is full, the
+   * least recently output or read frames are evicted.
+   *
+   * <p>While the cache is enabled, every output frame is copied into it, which costs about one more
+   * pass over each frame, or a quarter or a sixteenth of one when downscaling by 2 or 4.
+   *
+   * <p>Cached frames survive flushes, so the cache should be disabled, which drops its frames,
+   * before the decoder is fed a stream whose timestamps may collide with the cached ones.
+   *
+   * @param maxBytes The maximum number of bytes of frames held, or 0 (the default) to disable the
+   *     cache.
+   * @param downscaleFactor The factor by which frames are downscaled as they are cached, as for
+   *     {@link #setOutputDownscaleFactor(int)}. Changing it drops the cached frames.
+   * @throws IllegalArgumentException If the downscale factor is not supported.
+   */
+  public void setFrameCacheSize(long maxBytes, int downscaleFactor) {
+    if (downscaleFactor != 1 && downscaleFactor != 2 && downscaleFactor != 4) {
+      throw new IllegalArgumentException("Unsupported downscale factor: " + downscaleFactor);
+    }
+    gav1SetFrameCacheSize(gav1DecoderContext, maxBytes, downscaleFactor);
+  }
+
+  /**
+   * Reads the latest cached frame whose presentation time is at most {@code timeUs} and at least
+   * {@code timeUs - toleranceUs} into a {@link C#VIDEO_OUTPUT_MODE_YUV} output buffer. Can be
+   * called on any thread.
+   *
+   * @param timeUs The presentation time of the frame, in microseconds.
+   * @param toleranceUs How much earlier than {@code timeUs} the frame may be, in microseconds. 0
+   *     for a frame-accurate lookup, larger for a seek preview.
+   * @param outputBuffer A buffer that was not dequeued from this decoder, which receives the frame
+   *     and its presentation time.
+   * @return Whether a frame was read.
+   */
+  public boolean readCachedFrame(
+      long timeUs, long toleranceUs, VideoDecoderOutputBuffer outputBuffer) {
+    outputBuffer.init(timeUs, C.VIDEO_OUTPUT_MODE_YUV, /* supplementalData= */ null);
+    return gav1ReadCachedFrame(gav1DecoderContext, timeUs, toleranceUs, outputBuffer);
+  }
+
+  /** Returns the number of {@link #readCachedFrame} calls that found a frame. */
+  public long getFrameCacheHitCount() {
+    return gav1GetFrameCacheHitCount(gav1DecoderContext);
+  }
+
+  /** Returns the number of {@link #readCachedFrame} calls that found no frame. */
+  public long getFrameCacheMissCount() {
+    return gav1GetFrameCacheMissCount(gav1DecoderContext);
+  }
+
   /**
    * Renders output buffer to the given surface. Must only be called when in {@link
    * C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode.
@@ -165,17 +617,40 @@ public final class Gav1Decoder
    */
   public void renderToSurface(VideoDecoderOutputBuffer outputBuffer, Surface surface)
       throws Gav1DecoderException {
+    renderToSurface(outputBuffer, surface, System.nanoTime());
+  }
+
+  /**
+   * Renders output buffer to the given surface. Must only be called when in {@link
+   * C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode.
+   *
+   * @param outputBuffer Output buffer.
+   * @param surface Output surface.
+   * @param releaseTimeNs The time at which the frame should be displayed, in the {@link
+   *     System#nanoTime()} time base. When asynchronous rendering is enabled, the frame is
+   *     presented at this time. Otherwise it is presented immediately.
+   * @throws Gav1DecoderException Thrown if called with invalid output mode or frame rendering
+   *     fails. When asynchronous rendering is enabled, also thrown if an earlier frame failed to be
+   *     presented.
+   */
+  public void renderToSurface(
+      VideoDecoderOutputBuffer outputBuffer, Surface surface, long releaseTimeNs)
+      throws Gav1DecoderException {
     if (outputBuffer.mode != C.VIDEO_OUTPUT_MODE_SURFACE_YUV) {
       throw new Gav1DecoderException("Invalid output mode.");
     }
-    if (gav1RenderFrame(gav1DecoderContext, surface, outputBuffer) == GAV1_ERROR) {
+    int result =
+        asyncRenderEnabled
+            ? gav1QueueFrame(gav1DecoderContext, surface, outputBuffer, releaseTimeNs)
+            : gav1RenderFrame(gav1DecoderContext, surface, outputBuffer);
+    if (result == GAV1_ERROR) {
       throw new Gav1DecoderException(
           "Buffer render error: " + gav1GetErrorMessage(gav1DecoderContext));
     }
   }
 
   /**
-   * Initializes a libgav1 decoder.
+   * Initializes a libgav1 decoder, reusing an idle decoder context if there is one.
    *
    * @param threads Number of threads to be used by a libgav1 decoder.
    * @return The address of the decoder context or {@link #GAV1_ERROR} if there was an error.
@@ -183,32 +658,98 @@ public final class Gav1Decoder
   private native long gav1Init(int threads);
 
   /**
-   * Deallocates the decoder context.
+   * Initializes idle decoder contexts for {@link #gav1Init} to reuse.
+   *
+   * @param threads Number of threads to be used by each decoder.
+   * @param count Number of contexts to initialize.
+   */
+  private static native void gav1Prewarm(int count);
+
+  /**
+   * Sets the maximum number of bytes of released frame buffer memory kept for reuse.
+   *
+   * @param capacityBytes The maximum number of bytes kept.
+   */
+  private static native void gav1SetFrameArenaCapacity(long capacityBytes);
+
+  /**
+   * Deallocates the decoder context, or flushes it and keeps it idle for reuse.
    *
    * @param context Decoder context.
    */
   private native void gav1Close(long context);
 
   /**
-   * Decodes the encoded data passed.
+   * Recreates the decoder with a different number of threads. Frames queued in the decoder are
+   * dropped, so this must only be called when the decoder is flushed.
    *
    * @param context Decoder context.
-   * @param encodedData Encoded data.
-   * @param length Length of the data buffer.
+   * @param threads Number of threads to be used by the decoder.
    * @return {@link #GAV1_OK} if successful, {@link #GAV1_ERROR} if an error occurred.
    */
-  private native int gav1Decode(long context, ByteBuffer encodedData, int length);
+  private native int gav1SetThreads(long context, int threads);
+
+  /**
+   * Destroys the decoder and frees the frame buffers that are not in use, keeping the
+   * configuration.
+   *
+   * @param context Decoder context.
+   */
+  private native void gav1Suspend(long context);
+
+  /**
+   * Recreates the decoder destroyed by {@link #gav1Suspend(long)}, if any.
+   *
+   * @param context Decoder context.
+   * @return {@link #GAV1_OK} if successful, {@link #GAV1_ERROR} if an error occurred.
+   */
+  private native int gav1Resume(long context);
+
+  /**
+   * Classifies the temporal unit in the encoded data without decoding it.
+   *
+   * @param context Decoder context.
+   * @param encodedData Encoded data.
+   * @param offset Offset of the temporal unit in the data buffer.
+   * @param length Length of the temporal unit.
+   * @return The info packed for {@link TemporalUnitInfo#fromPackedInfo(int)}, or a negative value
+   *     if the temporal unit could not be parsed.
+   */
+  private native int gav1ClassifyTemporalUnit(
+      long context, ByteBuffer encodedData, int offset, int length);
 
   /**
-   * Gets the decoded frame.
+   * Sets whether only temporal units whose frames are all intra coded are decoded.
    *
    * @param context Decoder context.
+   * @param enabled Whether trick play is enabled.
+   */
+  private native void gav1SetTrickPlayEnabled(long context, boolean enabled);
+
+  /**
+   * Decodes the encoded data passed and gets the decoded frame, if any, in a single call.
+   *
+   * @param context Decoder context.
+   * @param encodedData Encoded data.
+   * @param length Length of the data buffer.
    * @param outputBuffer Output buffer for the decoded frame.
-   * @return {@link #GAV1_OK} if successful, {@link #GAV1_DECODE_ONLY} if successful but the frame
-   *     is decode-only, {@link #GAV1_ERROR} if an error occurred.
+   * @param outputMode The output mode of the output buffer.
+   * @param decodeOnly Whether the decoded frame is decode-only.
+   * @param frameMetadata Direct buffer of {@link #FRAME_METADATA_SIZE} native order ints that
+   *     receives the width, height and native buffer id of frames output in {@link
+   *     C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode.
+   * @return {@link #GAV1_OK} if successful, {@link #GAV1_PRIVATE_FRAME} if successful and the
+   *     output buffer must be initialized from {@code frameMetadata}, {@link #GAV1_DECODE_ONLY} if
+   *     successful but there is no frame to output, {@link #GAV1_ERROR} if an error occurred.
    */
-  private native int gav1GetFrame(
-      long context, VideoDecoderOutputBuffer outputBuffer, boolean decodeOnly);
+  private native int gav1DecodeFrame(
+      long context,
+      ByteBuffer encodedData,
+      int length,
+      VideoDecoderOutputBuffer outputBuffer,
+      @C.VideoOutputMode int outputMode,
+      boolean decodeOnly,
+      ByteBuffer frameMetadata);
 
   /**
    * Renders the frame to the surface. Used with {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} only.
@@ -222,12 +763,142 @@ public final class Gav1Decoder
       long context, Surface surface, VideoDecoderOutputBuffer outputBuffer);
 
   /**
-   * Releases the frame. Used with {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} only.
+   * Queues the frame for presentation on the surface by the render thread. Used with {@link
+   * C#VIDEO_OUTPUT_MODE_SURFACE_YUV} only, when asynchronous rendering is enabled.
    *
    * @param context Decoder context.
+   * @param surface Output surface.
+   * @param outputBuffer Output buffer with the decoded frame.
+   * @param releaseTimeNs The time at which the frame should be displayed, in nanoseconds.
+   * @return {@link #GAV1_OK} if successful, {@link #GAV1_ERROR} if an error occurred.
+   */
+  private native int gav1QueueFrame(
+      long context, Surface surface, VideoDecoderOutputBuffer outputBuffer, long releaseTimeNs);
+
+  /**
+   * Sets the factor by which 8-bit frames are downscaled while being copied out.
+   *
+   * @param context Decoder context.
+   * @param factor 1, 2 or 4.
+   */
+  private native void gav1SetDownscaleFactor(long context, int factor);
+
+  /**
+   * Starts or stops the render thread used to present frames asynchronously.
+   *
+   * @param context Decoder context.
+   * @param enabled Whether asynchronous rendering is enabled.
+   */
+  private native void gav1SetAsyncRenderEnabled(long context, boolean enabled);
+
+  /**
+   * Returns the number of frames presented by the render thread.
+   *
+   * @param context Decoder context.
+   * @return The number of frames presented, or 0 if asynchronous rendering is disabled.
+   */
+  private native long gav1GetRenderedFrameCount(long context);
+
+  /**
+   * Returns the number of frames dropped by the render thread.
+   *
+   * @param context Decoder context.
+   * @return The number of frames dropped, or 0 if asynchronous rendering is disabled.
+   */
+  private native long gav1GetDroppedFrameCount(long context);
+
+  /**
+   * Returns the buffer manager of the decoder, which holds the frames of output buffers. It stays
+   * valid after {@link #gav1Close(long)} until all of them are released.
+   *
+   * @param context Decoder context.
+   * @return The buffer manager.
+   */
+  private native long gav1GetBufferManager(long context);
+
+  /**
+   * Releases the frame. Used with {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} and zero-copy {@link
+   * C#VIDEO_OUTPUT_MODE_YUV} only. May be called after {@link #gav1Close(long)}, and deletes the
+   * buffer manager if it was closed and this was its last frame held by an output buffer.
+   *
+   * @param bufferManager Buffer manager returned by {@link #gav1GetBufferManager(long)}.
+   * @param bufferId Id of the frame, from {@link VideoDecoderOutputBuffer#decoderPrivate}.
+   */
+  private static native void gav1ReleaseFrame(long bufferManager, int bufferId);
+
+  /**
+   * Sets the row alignment of the planes written in {@link C#VIDEO_OUTPUT_MODE_YUV} mode.
+   *
+   * @param context Decoder context.
+   * @param alignment The row alignment in bytes, or 0 to use the decoder's strides.
+   */
+  private native void gav1SetYuvOutputStrideAlignment(long context, int alignment);
+
+  /**
+   * Sets whether frames output in {@link C#VIDEO_OUTPUT_MODE_YUV} mode expose the decoder's frame
+   * buffers instead of copying them.
+   *
+   * @param context Decoder context.
+   * @param enabled Whether zero-copy YUV output is enabled.
+   */
+  private native void gav1SetZeroCopyYuvOutputEnabled(long context, boolean enabled);
+
+  /**
+   * Sets whether frame buffers are allocated in shared memory.
+   *
+   * @param context Decoder context.
+   * @param enabled Whether frame buffers are allocated in shared memory.
+   */
+  private native void gav1SetSharedMemoryFramesEnabled(long context, boolean enabled);
+
+  /**
+   * Exports a frame held in shared memory.
+   *
+   * @param context Decoder context.
+   * @param bufferId The native buffer id of the frame.
+   * @param layout Receives the {@code SHARED_FRAME_LAYOUT} ints describing the frame.
+   * @return A new file descriptor of the shared memory, {@link #SHARED_FRAME_NOT_SHARED} if the
+   *     frame is not in shared memory or could not be exported, or {@link #SHARED_FRAME_ERROR} if
+   *     the buffer id is not that of a frame in use.
+   */
+  private native int gav1ExportSharedFrame(long context, int bufferId, int[] layout);
+
+  /**
+   * Configures the cache of output frames.
+   *
+   * @param context Decoder context.
+   * @param maxBytes The maximum number of bytes of frames held, or 0 to disable the cache.
+   * @param downscaleFactor The factor by which frames are downscaled as they are cached.
+   */
+  private native void gav1SetFrameCacheSize(long context, long maxBytes, int downscaleFactor);
+
+  /**
+   * Reads a cached frame into a {@link C#VIDEO_OUTPUT_MODE_YUV} output buffer.
+   *
+   * @param context Decoder context.
+   * @param timeUs The latest presentation time of the frame, in microseconds.
+   * @param toleranceUs How much earlier than {@code timeUs} the frame may be, in microseconds.
    * @param outputBuffer Output buffer.
+   * @return Whether a frame was read.
+   */
+  private native boolean gav1ReadCachedFrame(
+      long context, long timeUs, long toleranceUs, VideoDecoderOutputBuffer outputBuffer);
+
+  /**
+   * Returns the number of cached frame reads that found a frame.
+   *
+   * @param context Decoder context.
+   * @return The number of hits.
+   */
+  private native long gav1GetFrameCacheHitCount(long context);
+
+  /**
+   * Returns the number of cached frame reads that found no frame.
+   *
+   * @param context Decoder context.
+   * @return The number of misses.
    */
-  private native void gav1ReleaseFrame(long context, VideoDecoderOutputBuffer outputBuffer);
+  private native long gav1GetFrameCacheMissCount(long context);
 
   /**
    * Returns a human-readable string describing the last error encountered in the given context.
@@ -251,4 +922,14 @@ public final class Gav1Decoder
    * @return Optimal number of threads if there was no error, 0 if an error occurred.
    */
   private native int gav1GetThreads();
+
+  /** Sets the minimum {@link Log} priority of native messages. */
+  private static native void gav1SetLogLevel(int priority);
+
+  /** Sets whether native messages are written to the in-memory ring instead of logcat. */
+  private static native void gav1SetLogRingEnabled(boolean enabled);
+
+  /** Returns the messages held in the native in-memory ring, or null if there was an error. */
+  @Nullable
+  private static native String gav1DumpLogRing();
 }
@@ -25,19 +25,41 @@
 #ifdef CPU_FEATURES_COMPILED_ANY_ARM_NEON
 #include <arm_neon.h>
 #endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
+#ifdef CPU_FEATURES_ARCH_X86
+#include <immintrin.h>
+
+#include "cpuinfo_x86.h"  // NOLINT
+#endif                    // CPU_FEATURES_ARCH_X86
 #include <jni.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
 #include <cstdint>
 #include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>  // NOLINT
 #include <new>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "cpu_info.h"  // NOLINT
+#include "frame_arena.h"  // NOLINT
+#include "frame_cache.h"  // NOLINT
 #include "gav1/decoder.h"
+#include "jni_log.h"  // NOLINT
+#include "obu_parser.h"  // NOLINT
+#include "row_convert.h"  // NOLINT
+#include "shared_memory.h"  // NOLINT
+#include "worker_pool.h"  // NOLINT
+#include "yuv_to_rgba.h"  // NOLINT
 
 #define LOG_TAG "gav1_jni"
-#define LOGE(...) \
-  ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__))
 
 #define DECODER_FUNC(RETURN_TYPE, NAME, ...)                         \
   extern "C" {                                                       \
@@ -69,16 +91,43 @@ const int kMaxPlanes = 3;
 // https://developer.android.com/reference/android/graphics/ImageFormat.html#YV12.
 const int kImageFormatYV12 = 0x32315659;
 
+// Value of the chroma samples output for monochrome frames, which have no
+// chroma planes.
+const uint8_t kNeutralChroma = 128;
+
 // Output modes.
 const int kOutputModeYuv = 0;
 const int kOutputModeSurfaceYuv = 1;
-
-const int kColorSpaceUnknown = 0;
+const int kOutputModeRgba = 2;
 
 // Return codes for jni methods.
 const int kStatusError = 0;
 const int kStatusOk = 1;
 const int kStatusDecodeOnly = 2;
+// Returned by gav1DecodeFrame when the output buffer is to be initialized from
+// the frame metadata. See OutputFrame().
+const int kStatusPrivateFrame = 3;
+
+// Indices of the ints written to the frame metadata buffer of gav1DecodeFrame.
+// See Gav1Decoder.
+const int kFrameMetadataWidth = 0;
+const int kFrameMetadataHeight = 1;
+const int kFrameMetadataBufferId = 2;
+
+// Layout of the ints describing a frame exported by gav1ExportSharedFrame. The
+// offsets and strides of the Y, U and V planes follow one another. Monochrome
+// frames have zero U and V offsets and strides.
+const int kSharedFrameLayoutWidth = 0;
+const int kSharedFrameLayoutHeight = 1;
+const int kSharedFrameLayoutSizeBytes = 2;
+const int kSharedFrameLayoutOffsets = 3;
+const int kSharedFrameLayoutStrides = 6;
+const int kSharedFrameLayoutSize = 9;
+
+// Returned by gav1ExportSharedFrame instead of a file descriptor. The values
+// match the SHARED_FRAME_* constants of Gav1Decoder.
+const int kSharedFrameNotShared = -1;
+const int kSharedFrameError = -2;
 
 // Status codes specific to the JNI wrapper code.
 enum JniStatusCode {
@@ -90,7 +139,10 @@ enum JniStatusCode {
   kJniStatusHighBitDepthNotSupportedWithSurfaceYuv = -5,
   kJniStatusANativeWindowError = -6,
   kJniStatusBufferResizeError = -7,
-  kJniStatusNeonNotSupported = -8
+  kJniStatusNeonNotSupported = -8,
+  kJniStatusUnsupportedRgbaFrame = -9,
+  kJniStatusInvalidBufferId = -10,
+  kJniStatusAsyncRenderNotEnabled = -11
 };
 
 const char* GetJniErrorMessage(JniStatusCode error_code) {
@@ -112,6 +164,13 @@ const char* GetJniErrorMessage(JniStatusCode error_code) {
       return "Buffer resize failed.";
     case kJniStatusNeonNotSupported:
       return "Neon is not supported.";
+    case kJniStatusUnsupportedRgbaFrame:
+      return "RGBA output is only supported for 8-bit and 10-bit 4:2:0 and "
+             "monochrome frames.";
+    case kJniStatusInvalidBufferId:
+      return "Invalid frame buffer id.";
+    case kJniStatusAsyncRenderNotEnabled:
+      return "Asynchronous rendering is not enabled.";
     default:
       return "Unrecognized error code.";
   }
@@ -121,11 +180,7 @@ const char* GetJniErrorMessage(JniStatusCode error_code) {
 class JniFrameBuffer {
  public:
   explicit JniFrameBuffer(int id) : id_(id), reference_count_(0) {}
-  ~JniFrameBuffer() {
-    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
-      delete[] raw_buffer_[plane_index];
-    }
-  }
+  ~JniFrameBuffer() { FreeDataPlanes(); }
 
   // Not copyable or movable.
   JniFrameBuffer(const JniFrameBuffer&) = delete;
@@ -134,6 +189,7 @@ class JniFrameBuffer {
   JniFrameBuffer& operator=(JniFrameBuffer&&) = delete;
 
   void SetFrameData(const libgav1::DecoderBuffer& decoder_buffer) {
+    num_planes_ = decoder_buffer.NumPlanes();
     for (int plane_index = kPlaneY; plane_index < decoder_buffer.NumPlanes();
          plane_index++) {
       stride_[plane_index] = decoder_buffer.stride[plane_index];
@@ -145,6 +201,8 @@ class JniFrameBuffer {
     }
   }
 
+  // Returns the number of planes, which is 1 for monochrome frames.
+  int NumPlanes() const { return num_planes_; }
   int Stride(int plane_index) const { return stride_[plane_index]; }
   uint8_t* Plane(int plane_index) const { return plane_[plane_index]; }
   int DisplayedWidth(int plane_index) const {
@@ -161,53 +219,165 @@ class JniFrameBuffer {
   bool InUse() const { return reference_count_ != 0; }
 
   uint8_t* RawBuffer(int plane_index) const { return raw_buffer_[plane_index]; }
+  // Returns the region holding the data planes, or null if they are not in
+  // shared memory.
+  const gav1_jni::SharedMemoryRegion* SharedMemory() const {
+    return shared_memory_.get();
+  }
   void* BufferPrivateData() const { return const_cast<int*>(&id_); }
 
+  // Returns a direct ByteBuffer wrapping the raw buffer of the plane. Only
+  // valid after a successful call to MaybeCreateDirectBuffers().
+  jobject DirectBuffer(int plane_index) const {
+    return direct_buffer_[plane_index];
+  }
+
+  // Creates global references to direct ByteBuffers wrapping the raw buffers,
+  // replacing any that wrap a buffer that has since been reallocated. Must be
+  // called on a Java thread while the frame buffer is in use. Returns false if
+  // a ByteBuffer could not be created.
+  bool MaybeCreateDirectBuffers(JNIEnv* env) {
+    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
+      if (direct_buffer_[plane_index] != nullptr &&
+          direct_buffer_data_[plane_index] == raw_buffer_[plane_index] &&
+          direct_buffer_size_[plane_index] == raw_buffer_size_[plane_index]) {
+        continue;
+      }
+      if (direct_buffer_[plane_index] != nullptr) {
+        env->DeleteGlobalRef(direct_buffer_[plane_index]);
+        direct_buffer_[plane_index] = nullptr;
+      }
+      const jobject local_buffer =
+          env->NewDirectByteBuffer(raw_buffer_[plane_index],
+                                   raw_buffer_size_[plane_index]);
+      if (local_buffer == nullptr) return false;
+      direct_buffer_[plane_index] = env->NewGlobalRef(local_buffer);
+      env->DeleteLocalRef(local_buffer);
+      if (direct_buffer_[plane_index] == nullptr) return false;
+      direct_buffer_data_[plane_index] = raw_buffer_[plane_index];
+      direct_buffer_size_[plane_index] = raw_buffer_size_[plane_index];
+    }
+    return true;
+  }
+
+  // Deletes the global references created by MaybeCreateDirectBuffers().
+  void ReleaseDirectBuffers(JNIEnv* env) {
+    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
+      if (direct_buffer_[plane_index] != nullptr) {
+        env->DeleteGlobalRef(direct_buffer_[plane_index]);
+        direct_buffer_[plane_index] = nullptr;
+      }
+    }
+  }
+
   // Attempts to reallocate data planes if the existing ones don't have enough
-  // capacity. Returns true if the allocation was successful or wasn't needed,
-  // false if the allocation failed.
+  // capacity or are not backed by the requested kind of memory. With
+  // |shared_memory|, the three planes are laid out one after the other in a
+  // single SharedMemoryRegion. Returns true if the allocation was successful
+  // or wasn't needed, false if the allocation failed.
   bool MaybeReallocateGav1DataPlanes(int y_plane_min_size,
-                                     int uv_plane_min_size) {
+                                     int uv_plane_min_size,
+                                     bool shared_memory) {
+    if (shared_memory != (shared_memory_ != nullptr)) FreeDataPlanes();
+    if (shared_memory) {
+      const size_t size = static_cast<size_t>(y_plane_min_size) +
+                          2 * static_cast<size_t>(uv_plane_min_size);
+      if (shared_memory_ == nullptr || shared_memory_->size() < size) {
+        FreeDataPlanes();
+        shared_memory_ = gav1_jni::SharedMemoryRegion::Create("gav1_frame",
+                                                              size);
+        if (shared_memory_ == nullptr) return false;
+      }
+      uint8_t* plane = shared_memory_->data();
+      for (int plane_index = kPlaneY; plane_index < kMaxPlanes;
+           plane_index++) {
+        raw_buffer_[plane_index] = plane;
+        raw_buffer_size_[plane_index] =
+            (plane_index == kPlaneY) ? y_plane_min_size : uv_plane_min_size;
+        plane += raw_buffer_size_[plane_index];
+      }
+      return true;
+    }
     for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
       const int min_size =
           (plane_index == kPlaneY) ? y_plane_min_size : uv_plane_min_size;
       if (raw_buffer_size_[plane_index] >= min_size) continue;
-      delete[] raw_buffer_[plane_index];
-      raw_buffer_[plane_index] = new (std::nothrow) uint8_t[min_size];
-      if (!raw_buffer_[plane_index]) {
-        raw_buffer_size_[plane_index] = 0;
-        return false;
-      }
-      raw_buffer_size_[plane_index] = min_size;
+      exoplayer_jni::FrameArena& arena =
+          exoplayer_jni::FrameArena::GetInstance();
+      arena.Return(raw_buffer_[plane_index], raw_buffer_size_[plane_index]);
+      raw_buffer_[plane_index] =
+          arena.Lease(min_size, &raw_buffer_size_[plane_index]);
+      if (!raw_buffer_[plane_index]) return false;
     }
     return true;
   }
 
+  // Frees the data planes, which MaybeReallocateGav1DataPlanes() allocates
+  // again when the buffer is next used. Planes that are not in shared memory
+  // are returned to the FrameArena if |keep_in_arena| is true.
+  void FreeDataPlanes(bool keep_in_arena = true) {
+    if (shared_memory_ != nullptr) {
+      shared_memory_.reset();
+    } else {
+      for (int plane_index = kPlaneY; plane_index < kMaxPlanes;
+           plane_index++) {
+        if (keep_in_arena) {
+          exoplayer_jni::FrameArena::GetInstance().Return(
+              raw_buffer_[plane_index], raw_buffer_size_[plane_index]);
+        } else {
+          exoplayer_jni::FrameArena::Free(raw_buffer_[plane_index]);
+        }
+      }
+    }
+    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
+      raw_buffer_[plane_index] = nullptr;
+      raw_buffer_size_[plane_index] = 0;
+    }
+  }
+
  private:
+  int num_planes_ = kMaxPlanes;
   int stride_[kMaxPlanes];
   uint8_t* plane_[kMaxPlanes];
   int displayed_width_[kMaxPlanes];
   int displayed_height_[kMaxPlanes];
   const int id_;
   int reference_count_;
-  // Pointers to the raw buffers allocated for the data planes.
+  // Pointers to the raw buffers of the data planes, leased from the
+  // FrameArena unless they are in |shared_memory_|.
   uint8_t* raw_buffer_[kMaxPlanes] = {};
   // Sizes of the raw buffers in bytes.
   size_t raw_buffer_size_[kMaxPlanes] = {};
+  // Region holding the raw buffers if they are in shared memory.
+  std::unique_ptr<gav1_jni::SharedMemoryRegion> shared_memory_;
+  // Direct ByteBuffers wrapping the raw buffers for zero-copy YUV output, and
+  // the raw buffers they were created for.
+  jobject direct_buffer_[kMaxPlanes] = {};
+  const uint8_t* direct_buffer_data_[kMaxPlanes] = {};
+  size_t direct_buffer_size_[kMaxPlanes] = {};
 };
 
 // Manages frame buffers used by libgav1 decoder and ExoPlayer.
 // Handles synchronization between libgav1 and ExoPlayer threads.
+//
+// The manager is owned by its JniContext until the context is destroyed, and
+// then by the output buffers still holding its frame buffers, whose planes
+// they may wrap without copying. See Detach().
 class JniBufferManager {
  public:
-  ~JniBufferManager() {
-    // This lock does not do anything since libgav1 has released all the frame
-    // buffers. It exists to merely be consistent with all other usage of
-    // |all_buffers_| and |all_buffer_count_|.
-    std::lock_guard<std::mutex> lock(mutex_);
-    while (all_buffer_count_--) {
-      delete all_buffers_[all_buffer_count_];
+  JniBufferManager() = default;
+
+  // Gives up the reference of the context, whose decoder must have released
+  // its frame buffers. Deletes the manager if no output buffer holds a frame
+  // buffer. Otherwise the ReleaseBuffer() call that releases the last one does.
+  void Detach() {
+    bool in_use;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      detached_ = true;
+      in_use = free_buffer_count_ != all_buffer_count_;
     }
+    if (!in_use) delete this;
   }
 
   JniStatusCode GetBuffer(size_t y_plane_min_size, size_t uv_plane_min_size,
@@ -225,8 +395,8 @@ class JniBufferManager {
       // Maximum number of buffers is being used.
       return kJniStatusOutOfMemory;
     }
-    if (!output_buffer->MaybeReallocateGav1DataPlanes(y_plane_min_size,
-                                                      uv_plane_min_size)) {
+    if (!output_buffer->MaybeReallocateGav1DataPlanes(
+            y_plane_min_size, uv_plane_min_size, shared_memory_)) {
       return kJniStatusOutOfMemory;
     }
 
@@ -238,38 +408,694 @@ class JniBufferManager {
 
   JniFrameBuffer* GetBuffer(int id) const { return all_buffers_[id]; }
 
+  // Returns the buffer with |id| if it is one of the at most kMaxFrames
+  // buffers allocated so far and is in use, or null otherwise. For ids that
+  // come from outside the decoder.
+  const JniFrameBuffer* GetBufferInUse(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id < 0 || id >= all_buffer_count_ || !all_buffers_[id]->InUse()) {
+      return nullptr;
+    }
+    return all_buffers_[id];
+  }
+
+  // Returns whether any buffer is referenced, by the decoder or by an output
+  // buffer.
+  bool HasBuffersInUse() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_buffer_count_ != all_buffer_count_;
+  }
+
+  // Sets whether the data planes of the buffers handed out from now on are
+  // allocated in shared memory. Free buffers whose planes are in the other
+  // kind of memory are reallocated when they are handed out again.
+  void SetSharedMemoryEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shared_memory_ = enabled;
+  }
+
+  void ReleaseDirectBuffers(JNIEnv* env) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < all_buffer_count_; i++) {
+      all_buffers_[i]->ReleaseDirectBuffers(env);
+    }
+  }
+
+  // Frees the data planes and direct buffers of the buffers that are not in
+  // use, without keeping the planes in the FrameArena. Buffers held by output
+  // buffers or by the decoder are left alone.
+  void TrimFreeBuffers(JNIEnv* env) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < free_buffer_count_; i++) {
+      free_buffers_[i]->ReleaseDirectBuffers(env);
+      free_buffers_[i]->FreeDataPlanes(/*keep_in_arena=*/false);
+    }
+  }
+
   void AddBufferReference(int id) {
     std::lock_guard<std::mutex> lock(mutex_);
     all_buffers_[id]->AddReference();
   }
 
+  // Releases a reference on the buffer with |id|. Deletes the manager if it
+  // is detached and this was the last buffer in use, so the manager must not
+  // be used after releasing a buffer once its context is destroyed.
   JniStatusCode ReleaseBuffer(int id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    JniFrameBuffer* buffer = all_buffers_[id];
-    if (!buffer->InUse()) {
-      return kJniStatusBufferAlreadyReleased;
-    }
-    buffer->RemoveReference();
-    if (!buffer->InUse()) {
-      free_buffers_[free_buffer_count_++] = buffer;
+    bool delete_manager;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (id < 0 || id >= all_buffer_count_) return kJniStatusInvalidBufferId;
+      JniFrameBuffer* buffer = all_buffers_[id];
+      if (!buffer->InUse()) {
+        return kJniStatusBufferAlreadyReleased;
+      }
+      buffer->RemoveReference();
+      if (!buffer->InUse()) {
+        free_buffers_[free_buffer_count_++] = buffer;
+      }
+      delete_manager = detached_ && free_buffer_count_ == all_buffer_count_;
     }
+    if (delete_manager) delete this;
     return kJniStatusOk;
   }
 
  private:
   static const int kMaxFrames = 32;
 
+  // Only deleted by Detach() or ReleaseBuffer().
+  ~JniBufferManager() {
+    // This lock does not do anything since all the frame buffers have been
+    // released. It exists to merely be consistent with all other usage of
+    // |all_buffers_| and |all_buffer_count_|.
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (all_buffer_count_--) {
+      delete all_buffers_[all_buffer_count_];
+    }
+  }
+
   JniFrameBuffer* all_buffers_[kMaxFrames];
   int all_buffer_count_ = 0;
 
   JniFrameBuffer* free_buffers_[kMaxFrames];
   int free_buffer_count_ = 0;
 
+  bool shared_memory_ = false;
+
+  // Whether the context has given up its reference. See Detach().
+  bool detached_ = false;
+
+  std::mutex mutex_;
+};
+
+constexpr int AlignTo16(int value) { return (value + 15) & (~15); }
+
+void CopyPlane(const uint8_t* source, int source_stride, uint8_t* destination,
+               int destination_stride, int width, int height) {
+  while (height--) {
+    std::memcpy(destination, source, width);
+    source += source_stride;
+    destination += destination_stride;
+  }
+}
+
+// Frames with at least this many luma samples are copied, converted or
+// downscaled in parallel row bands on the worker pool, with non-temporal
+// stores for copies. Smaller frames are processed on the calling thread, where
+// handing work to other threads costs more than it saves.
+const int kMinParallelCopySamples = 2560 * 1440;
+// Number of rows in each band of parallel work.
+const int kCopyBandRows = 128;
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_nontemporal_store)
+#define GAV1_JNI_HAS_NONTEMPORAL_STORE
+#endif
+#endif
+
+// Copies a row, using non-temporal stores where the compiler supports them so
+// that large frames written to the window do not evict the decoder's data from
+// the caches.
+void CopyRowNonTemporal(const uint8_t* source, uint8_t* destination,
+                        int width) {
+#ifdef GAV1_JNI_HAS_NONTEMPORAL_STORE
+  typedef uint8_t Block __attribute__((vector_size(16)));
+  // Non-temporal stores need aligned destinations.
+  const int head = std::min(
+      width,
+      static_cast<int>(-reinterpret_cast<uintptr_t>(destination) & 15));
+  std::memcpy(destination, source, head);
+  int x = head;
+  for (; x + 16 <= width; x += 16) {
+    Block block;
+    std::memcpy(&block, source + x, sizeof(block));
+    __builtin_nontemporal_store(block,
+                                reinterpret_cast<Block*>(destination + x));
+  }
+  std::memcpy(destination + x, source + x, width - x);
+#else
+  std::memcpy(destination, source, width);
+#endif  // GAV1_JNI_HAS_NONTEMPORAL_STORE
+}
+
+// Returns the size of a dimension of |size| samples downscaled by |factor|.
+constexpr int DownscaledSize(int size, int factor) {
+  return (size + factor - 1) / factor;
+}
+
+// Writes |destination_width| samples, each the rounded average of a |factor| x
+// |factor| block of samples from |rows|, which holds |factor| source rows of
+// |source_width| samples. |factor| is 2 or 4. Blocks that extend past the right
+// edge repeat the last column.
+void DownscaleRow(const uint8_t* const* rows, int factor, int source_width,
+                  uint8_t* destination, int destination_width) {
+  int x = 0;
+  if (factor == 2) {
+#if defined(CPU_FEATURES_COMPILED_ANY_ARM_NEON)
+    for (; 2 * (x + 8) <= source_width; x += 8) {
+      const uint16x8_t sums = vaddq_u16(vpaddlq_u8(vld1q_u8(rows[0] + 2 * x)),
+                                        vpaddlq_u8(vld1q_u8(rows[1] + 2 * x)));
+      vst1_u8(destination + x, vrshrn_n_u16(sums, 2));
+    }
+#elif defined(CPU_FEATURES_ARCH_X86)
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    const __m128i rounding = _mm_set1_epi16(2);
+    for (; 2 * (x + 8) <= source_width; x += 8) {
+      __m128i sums = rounding;
+      for (int i = 0; i < 2; i++) {
+        const __m128i samples =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + 2 * x));
+        sums = _mm_add_epi16(sums, _mm_and_si128(samples, low_bytes));
+        sums = _mm_add_epi16(sums, _mm_srli_epi16(samples, 8));
+      }
+      _mm_storel_epi64(
+          reinterpret_cast<__m128i*>(destination + x),
+          _mm_packus_epi16(_mm_srli_epi16(sums, 2), _mm_setzero_si128()));
+    }
+#endif
+  } else if (factor == 4) {
+#if defined(CPU_FEATURES_COMPILED_ANY_ARM_NEON)
+    for (; 4 * (x + 8) <= source_width; x += 8) {
+      uint16x8_t low_sums = vdupq_n_u16(0);
+      uint16x8_t high_sums = vdupq_n_u16(0);
+      for (int i = 0; i < 4; i++) {
+        low_sums = vpadalq_u8(low_sums, vld1q_u8(rows[i] + 4 * x));
+        high_sums = vpadalq_u8(high_sums, vld1q_u8(rows[i] + 4 * x + 16));
+      }
+      const uint16x8_t averages =
+          vcombine_u16(vrshrn_n_u32(vpaddlq_u16(low_sums), 4),
+                       vrshrn_n_u32(vpaddlq_u16(high_sums), 4));
+      vst1_u8(destination + x, vmovn_u16(averages));
+    }
+#elif defined(CPU_FEATURES_ARCH_X86)
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i rounding = _mm_set1_epi32(8);
+    for (; 4 * (x + 8) <= source_width; x += 8) {
+      __m128i low_sums = _mm_setzero_si128();
+      __m128i high_sums = _mm_setzero_si128();
+      for (int i = 0; i < 4; i++) {
+        const __m128i low_samples =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + 4 * x));
+        const __m128i high_samples = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(rows[i] + 4 * x + 16));
+        low_sums =
+            _mm_add_epi16(low_sums, _mm_and_si128(low_samples, low_bytes));
+        low_sums = _mm_add_epi16(low_sums, _mm_srli_epi16(low_samples, 8));
+        high_sums =
+            _mm_add_epi16(high_sums, _mm_and_si128(high_samples, low_bytes));
+        high_sums = _mm_add_epi16(high_sums, _mm_srli_epi16(high_samples, 8));
+      }
+      const __m128i low_averages = _mm_srli_epi32(
+          _mm_add_epi32(_mm_madd_epi16(low_sums, ones), rounding), 4);
+      const __m128i high_averages = _mm_srli_epi32(
+          _mm_add_epi32(_mm_madd_epi16(high_sums, ones), rounding), 4);
+      _mm_storel_epi64(
+          reinterpret_cast<__m128i*>(destination + x),
+          _mm_packus_epi16(_mm_packs_epi32(low_averages, high_averages),
+                           _mm_setzero_si128()));
+    }
+#endif
+  }
+  const int block_size = factor * factor;
+  for (; x < destination_width; x++) {
+    int sum = block_size / 2;
+    for (int i = 0; i < factor; i++) {
+      for (int j = 0; j < factor; j++) {
+        sum += rows[i][std::min(x * factor + j, source_width - 1)];
+      }
+    }
+    destination[x] = sum / block_size;
+  }
+}
+
+// A plane copied by CopyPlanes(). |width| and |height| are the size of the
+// source region.
+struct PlaneCopy {
+  const uint8_t* source;
+  int source_stride;
+  uint8_t* destination;
+  int destination_stride;
+  int width;
+  int height;
+};
+
+// Downscales rows [|first_row|, |last_row|) of the destination of |plane| by
+// |factor|. Rows that extend past the bottom edge repeat the last row.
+void DownscalePlaneRows(const PlaneCopy& plane, int first_row, int last_row,
+                        int factor) {
+  const int destination_width = DownscaledSize(plane.width, factor);
+  const uint8_t* rows[4];
+  for (int row = first_row; row < last_row; row++) {
+    for (int i = 0; i < factor; i++) {
+      const int source_row = std::min(row * factor + i, plane.height - 1);
+      rows[i] = plane.source + source_row * plane.source_stride;
+    }
+    DownscaleRow(rows, factor, plane.width,
+                 plane.destination + row * plane.destination_stride,
+                 destination_width);
+  }
+}
+
+// Copies rows [|first_row|, |last_row|) of |plane|, downscaled by
+// |downscale_factor|. The rows are counted in the destination.
+void CopyPlaneRows(const PlaneCopy& plane, int first_row, int last_row,
+                   int downscale_factor, bool non_temporal) {
+  if (downscale_factor > 1) {
+    DownscalePlaneRows(plane, first_row, last_row, downscale_factor);
+    return;
+  }
+  const uint8_t* source = plane.source + first_row * plane.source_stride;
+  uint8_t* destination =
+      plane.destination + first_row * plane.destination_stride;
+  if (non_temporal) {
+    for (int row = first_row; row < last_row; row++) {
+      CopyRowNonTemporal(source, destination, plane.width);
+      source += plane.source_stride;
+      destination += plane.destination_stride;
+    }
+  } else {
+    CopyPlane(source, plane.source_stride, destination,
+              plane.destination_stride, plane.width, last_row - first_row);
+  }
+}
+
+// Copies |plane_count| planes, downscaled by |downscale_factor|, which is 1, 2
+// or 4. Large frames, as determined by the size of the first plane, are split
+// into bands of rows that are copied in parallel.
+void CopyPlanes(const PlaneCopy* planes, int plane_count,
+                int downscale_factor) {
+  if (planes[0].width * planes[0].height < kMinParallelCopySamples) {
+    for (int i = 0; i < plane_count; i++) {
+      CopyPlaneRows(planes[i], 0,
+                    DownscaledSize(planes[i].height, downscale_factor),
+                    downscale_factor, /*non_temporal=*/false);
+    }
+    return;
+  }
+
+  int band_count[kMaxPlanes];
+  int total_band_count = 0;
+  for (int i = 0; i < plane_count; i++) {
+    band_count[i] = (DownscaledSize(planes[i].height, downscale_factor) +
+                     kCopyBandRows - 1) /
+                    kCopyBandRows;
+    total_band_count += band_count[i];
+  }
+  exoplayer_jni::WorkerPool::GetInstance().ParallelFor(
+      total_band_count, [planes, downscale_factor, &band_count](int band) {
+        int plane_index = 0;
+        while (band >= band_count[plane_index]) {
+          band -= band_count[plane_index++];
+        }
+        const PlaneCopy& plane = planes[plane_index];
+        const int first_row = band * kCopyBandRows;
+        const int last_row =
+            std::min(first_row + kCopyBandRows,
+                     DownscaledSize(plane.height, downscale_factor));
+        CopyPlaneRows(plane, first_row, last_row, downscale_factor,
+                      /*non_temporal=*/true);
+#if defined(GAV1_JNI_HAS_NONTEMPORAL_STORE) && defined(CPU_FEATURES_ARCH_X86)
+        // Order the non-temporal stores before the window buffer is posted.
+        _mm_sfence();
+#endif
+      });
+}
+
+// A 4:2:0 frame converted by ConvertFrameToRgba(). Monochrome frames have null
+// chroma planes.
+struct RgbaConversion {
+  const uint8_t* planes[kMaxPlanes];
+  int strides[kMaxPlanes];
+  int width;
+  int height;
+  int bitdepth;
+  exoplayer_jni::YuvToRgbCoefficients coefficients;
+  uint8_t* destination;
+  int destination_stride;
+};
+
+// Converts an 8-bit or 10-bit frame to RGBA_8888 or RGBA_1010102 pixels
+// respectively. Large frames are split into bands of rows that are converted
+// in parallel.
+void ConvertFrameToRgba(const RgbaConversion& conversion) {
+  const int sample_size = (conversion.bitdepth == 8) ? 1 : 2;
+  // Monochrome frames are converted with neutral chroma samples.
+  std::vector<uint8_t> neutral_chroma;
+  const uint8_t* u_plane = conversion.planes[kPlaneU];
+  const uint8_t* v_plane = conversion.planes[kPlaneV];
+  int chroma_stride = conversion.strides[kPlaneU];
+  if (u_plane == nullptr) {
+    const int chroma_width = (conversion.width + 1) / 2;
+    neutral_chroma.resize(chroma_width * sample_size);
+    for (int x = 0; x < chroma_width; x++) {
+      if (sample_size == 1) {
+        neutral_chroma[x] = kNeutralChroma;
+      } else {
+        const uint16_t sample = conversion.coefficients.chroma_offset;
+        std::memcpy(&neutral_chroma[2 * x], &sample, sizeof(sample));
+      }
+    }
+    u_plane = v_plane = neutral_chroma.data();
+    chroma_stride = 0;
+  }
+
+  const auto convert_rows = [&](int first_row, int last_row) {
+    for (int row = first_row; row < last_row; row++) {
+      const uint8_t* const y = conversion.planes[kPlaneY] +
+                               row * conversion.strides[kPlaneY];
+      const uint8_t* const u = u_plane + (row / 2) * chroma_stride;
+      const uint8_t* const v = v_plane + (row / 2) * chroma_stride;
+      uint8_t* const rgba =
+          conversion.destination + row * conversion.destination_stride;
+      if (sample_size == 1) {
+        exoplayer_jni::ConvertRowToRgba8888(y, u, v, conversion.width,
+                                            conversion.coefficients, rgba);
+      } else {
+        exoplayer_jni::ConvertRowToRgba1010102(
+            reinterpret_cast<const uint16_t*>(y),
+            reinterpret_cast<const uint16_t*>(u),
+            reinterpret_cast<const uint16_t*>(v), conversion.width,
+            conversion.coefficients, reinterpret_cast<uint32_t*>(rgba));
+      }
+    }
+  };
+  if (conversion.width * conversion.height < kMinParallelCopySamples) {
+    convert_rows(0, conversion.height);
+    return;
+  }
+  exoplayer_jni::WorkerPool::GetInstance().ParallelFor(
+      (conversion.height + kCopyBandRows - 1) / kCopyBandRows,
+      [&conversion, &convert_rows](int band) {
+        const int first_row = band * kCopyBandRows;
+        convert_rows(first_row,
+                     std::min(first_row + kCopyBandRows, conversion.height));
+      });
+}
+
+// Geometry last set on a window.
+struct WindowGeometry {
+  int width = 0;
+  int height = 0;
+};
+
+// Copies the frame in |jni_buffer|, downscaled by |downscale_factor|, into a
+// YV12 window buffer.
+void CopyFrameToYv12Buffer(const JniFrameBuffer& jni_buffer,
+                           int downscale_factor,
+                           const ANativeWindow_Buffer& native_window_buffer) {
+  uint8_t* const window_data =
+      reinterpret_cast<uint8_t*>(native_window_buffer.bits);
+  const int y_plane_size =
+      native_window_buffer.stride * native_window_buffer.height;
+  const int32_t native_window_buffer_uv_height =
+      (native_window_buffer.height + 1) / 2;
+  const int native_window_buffer_uv_stride =
+      AlignTo16(native_window_buffer.stride / 2);
+
+  if (jni_buffer.NumPlanes() == 1) {
+    // Monochrome frames only have a Y plane. Fill the V and U planes, which
+    // follow it, with a neutral value.
+    const PlaneCopy y_plane = {
+        jni_buffer.Plane(kPlaneY), jni_buffer.Stride(kPlaneY), window_data,
+        native_window_buffer.stride, jni_buffer.DisplayedWidth(kPlaneY),
+        jni_buffer.DisplayedHeight(kPlaneY)};
+    CopyPlanes(&y_plane, 1, downscale_factor);
+    std::memset(
+        window_data + y_plane_size, kNeutralChroma,
+        2 * native_window_buffer_uv_stride * native_window_buffer_uv_height);
+    return;
+  }
+
+  // Since the format for ANativeWindow is YV12, V plane is being processed
+  // before U plane.
+  const int v_plane_height =
+      std::min(native_window_buffer_uv_height * downscale_factor,
+               jni_buffer.DisplayedHeight(kPlaneV));
+  const int v_plane_size = DownscaledSize(v_plane_height, downscale_factor) *
+                           native_window_buffer_uv_stride;
+  const PlaneCopy planes[kMaxPlanes] = {
+      // Y plane
+      {jni_buffer.Plane(kPlaneY), jni_buffer.Stride(kPlaneY), window_data,
+       native_window_buffer.stride, jni_buffer.DisplayedWidth(kPlaneY),
+       jni_buffer.DisplayedHeight(kPlaneY)},
+      // V plane
+      {jni_buffer.Plane(kPlaneV), jni_buffer.Stride(kPlaneV),
+       window_data + y_plane_size, native_window_buffer_uv_stride,
+       jni_buffer.DisplayedWidth(kPlaneV), v_plane_height},
+      // U plane
+      {jni_buffer.Plane(kPlaneU), jni_buffer.Stride(kPlaneU),
+       window_data + y_plane_size + v_plane_size,
+       native_window_buffer_uv_stride, jni_buffer.DisplayedWidth(kPlaneU),
+       std::min(native_window_buffer_uv_height * downscale_factor,
+                jni_buffer.DisplayedHeight(kPlaneU))}};
+  CopyPlanes(planes, kMaxPlanes, downscale_factor);
+}
+
+// Copies the frame in |jni_buffer|, downscaled by |downscale_factor|, into the
+// next YV12 buffer of |native_window| and posts it. |geometry| holds the
+// geometry last set on |native_window|, and is updated if the output size
+// differs.
+JniStatusCode RenderFrameToWindow(const JniFrameBuffer& jni_buffer,
+                                  int downscale_factor,
+                                  ANativeWindow* native_window,
+                                  WindowGeometry* geometry) {
+  const int width =
+      DownscaledSize(jni_buffer.DisplayedWidth(kPlaneY), downscale_factor);
+  const int height =
+      DownscaledSize(jni_buffer.DisplayedHeight(kPlaneY), downscale_factor);
+  if (geometry->width != width || geometry->height != height) {
+    if (ANativeWindow_setBuffersGeometry(native_window, width, height,
+                                         kImageFormatYV12)) {
+      return kJniStatusANativeWindowError;
+    }
+    geometry->width = width;
+    geometry->height = height;
+  }
+
+  ANativeWindow_Buffer native_window_buffer;
+  if (ANativeWindow_lock(native_window, &native_window_buffer,
+                         /*inOutDirtyBounds=*/nullptr) ||
+      native_window_buffer.bits == nullptr) {
+    return kJniStatusANativeWindowError;
+  }
+  CopyFrameToYv12Buffer(jni_buffer, downscale_factor, native_window_buffer);
+
+  if (ANativeWindow_unlockAndPost(native_window)) {
+    return kJniStatusANativeWindowError;
+  }
+
+  return kJniStatusOk;
+}
+
+// Presents frames on a dedicated thread, so that a slow ANativeWindow_lock
+// does not block the thread rendering the output buffers.
+class RenderWorker {
+ public:
+  explicit RenderWorker(JniBufferManager* buffer_manager)
+      : buffer_manager_(buffer_manager), thread_(&RenderWorker::Run, this) {}
+
+  // Stops the thread. Frames that have not been presented yet are dropped.
+  ~RenderWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+    while (pending_frame_count_ > 0) {
+      DropFrame(pending_frames_[--pending_frame_count_]);
+    }
+    if (native_window_ != nullptr) {
+      ANativeWindow_release(native_window_);
+    }
+  }
+
+  // Not copyable or movable.
+  RenderWorker(const RenderWorker&) = delete;
+  RenderWorker(RenderWorker&&) = delete;
+  RenderWorker& operator=(const RenderWorker&) = delete;
+  RenderWorker& operator=(RenderWorker&&) = delete;
+
+  // Queues the frame in buffer |buffer_id| for presentation on |native_window|,
+  // downscaled by |downscale_factor| as in RenderFrameToWindow(). The frame is
+  // posted once |release_time_ns|, which is in the CLOCK_MONOTONIC time base,
+  // is reached. ANativeWindow has no public API to set a presentation time, so
+  // the worker waits until then instead. A frame is dropped instead if a later
+  // frame is already due when the worker gets to it, or if the queue is full
+  // when a frame is queued. Takes references on the buffer and the window until
+  // the frame has been presented or dropped.
+  void QueueFrame(ANativeWindow* native_window, int downscale_factor,
+                  int buffer_id, int64_t release_time_ns) {
+    buffer_manager_->AddBufferReference(buffer_id);
+    ANativeWindow_acquire(native_window);
+    PendingFrame frame = {native_window, downscale_factor, buffer_id,
+                          release_time_ns};
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (pending_frame_count_ == kMaxPendingFrames) {
+        DropFrame(pending_frames_[0]);
+        std::memmove(&pending_frames_[0], &pending_frames_[1],
+                     --pending_frame_count_ * sizeof(PendingFrame));
+      }
+      int index = pending_frame_count_++;
+      while (index > 0 &&
+             pending_frames_[index - 1].release_time_ns > release_time_ns) {
+        pending_frames_[index] = pending_frames_[index - 1];
+        index--;
+      }
+      pending_frames_[index] = frame;
+    }
+    condition_.notify_one();
+  }
+
+  // Returns the error of the last frame that failed to be presented and
+  // clears it, or kJniStatusOk if there was none.
+  JniStatusCode TakeError() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const JniStatusCode status = status_;
+    status_ = kJniStatusOk;
+    return status;
+  }
+
+  int64_t rendered_frame_count() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rendered_frame_count_;
+  }
+
+  int64_t dropped_frame_count() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_frame_count_;
+  }
+
+ private:
+  static const int kMaxPendingFrames = 3;
+
+  struct PendingFrame {
+    ANativeWindow* native_window;
+    int downscale_factor;
+    int buffer_id;
+    int64_t release_time_ns;
+  };
+
+  static int64_t NowNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  }
+
+  // Releases the references held by |frame|. Must be called with |mutex_| held
+  // or after the thread has stopped.
+  void DropFrame(const PendingFrame& frame) {
+    ANativeWindow_release(frame.native_window);
+    buffer_manager_->ReleaseBuffer(frame.buffer_id);
+    dropped_frame_count_++;
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      condition_.wait(lock,
+                      [this] { return stopping_ || pending_frame_count_ > 0; });
+      if (stopping_) return;
+
+      // Wait until the first frame is due. Queuing an earlier frame or
+      // stopping wakes the thread.
+      const int64_t now_ns = NowNs();
+      if (pending_frames_[0].release_time_ns > now_ns) {
+        condition_.wait_for(lock, std::chrono::nanoseconds(
+                                      pending_frames_[0].release_time_ns -
+                                      now_ns));
+        continue;
+      }
+
+      // Skip frames that a later due frame supersedes.
+      int skipped_frame_count = 0;
+      while (skipped_frame_count < pending_frame_count_ - 1 &&
+             pending_frames_[skipped_frame_count + 1].release_time_ns <=
+                 now_ns) {
+        DropFrame(pending_frames_[skipped_frame_count++]);
+      }
+      const PendingFrame frame = pending_frames_[skipped_frame_count];
+      pending_frame_count_ -= skipped_frame_count + 1;
+      std::memmove(&pending_frames_[0],
+                   &pending_frames_[skipped_frame_count + 1],
+                   pending_frame_count_ * sizeof(PendingFrame));
+
+      lock.unlock();
+      if (frame.native_window != native_window_) {
+        if (native_window_ != nullptr) {
+          ANativeWindow_release(native_window_);
+        }
+        // Keep the frame's reference on the window, so that the geometry
+        // cached for it stays valid.
+        native_window_ = frame.native_window;
+        native_window_geometry_ = WindowGeometry();
+      } else {
+        ANativeWindow_release(frame.native_window);
+      }
+      const JniStatusCode status = RenderFrameToWindow(
+          *buffer_manager_->GetBuffer(frame.buffer_id), frame.downscale_factor,
+          native_window_, &native_window_geometry_);
+      buffer_manager_->ReleaseBuffer(frame.buffer_id);
+      lock.lock();
+
+      if (status == kJniStatusOk) {
+        rendered_frame_count_++;
+      } else {
+        LOGE("%s", GetJniErrorMessage(status));
+        status_ = status;
+        dropped_frame_count_++;
+      }
+    }
+  }
+
+  JniBufferManager* const buffer_manager_;
+
   std::mutex mutex_;
+  std::condition_variable condition_;
+  // Pending frames, sorted by release time.
+  PendingFrame pending_frames_[kMaxPendingFrames];
+  int pending_frame_count_ = 0;
+  bool stopping_ = false;
+  JniStatusCode status_ = kJniStatusOk;
+  int64_t rendered_frame_count_ = 0;
+  int64_t dropped_frame_count_ = 0;
+
+  // Only accessed on |thread_|.
+  ANativeWindow* native_window_ = nullptr;
+  WindowGeometry native_window_geometry_;
+
+  // Declared last, so that the members it uses are initialized first.
+  std::thread thread_;
 };
 
 struct JniContext {
   ~JniContext() {
+    // Stop the render worker and destroy the decoder first, as they hold
+    // references on frame buffers.
+    render_worker.reset();
+    decoder.reset();
+    buffer_manager->Detach();
     if (native_window) {
       ANativeWindow_release(native_window);
     }
@@ -282,8 +1108,7 @@ struct JniContext {
     if (native_window) {
       ANativeWindow_release(native_window);
     }
-    native_window_width = 0;
-    native_window_height = 0;
+    native_window_geometry = WindowGeometry();
     native_window = ANativeWindow_fromSurface(env, new_surface);
     if (native_window == nullptr) {
       jni_status_code = kJniStatusANativeWindowError;
@@ -295,23 +1120,71 @@ struct JniContext {
   }
 
   jfieldID decoder_private_field;
-  jfieldID output_mode_field;
   jfieldID data_field;
-  jmethodID init_for_private_frame_method;
+  jfieldID time_us_field;
   jmethodID init_for_yuv_frame_method;
-
-  JniBufferManager buffer_manager;
-  // The libgav1 decoder instance has to be deleted before |buffer_manager| is
-  // destructed. This will make sure that libgav1 releases all the frame
-  // buffers that it might be holding references to. So this has to be declared
-  // after |buffer_manager| since the destruction happens in reverse order of
-  // declaration.
-  libgav1::Decoder decoder;
+  jmethodID init_for_external_yuv_frame_method;
+  jmethodID init_for_rgba_frame_method;
+
+  // Detached when the context is destroyed, once the decoder has released the
+  // frame buffers it was holding references to. Output buffers that still hold
+  // frame buffers keep it alive. Passed to gav1ReleaseFrame by
+  // gav1GetBufferManager.
+  JniBufferManager* const buffer_manager = new JniBufferManager();
+  // Recreated by CreateDecoder() when the number of threads changes, and null
+  // while the context is suspended.
+  std::unique_ptr<libgav1::Decoder> decoder;
+  // Number of threads |decoder| was initialized with, or 0 if its
+  // initialization failed. Kept while the context is suspended.
+  int threads = 0;
+  // Serializes the calls that use or replace |decoder|, as gav1Suspend and
+  // gav1Resume may be called on any thread.
+  std::mutex decoder_mutex;
 
   ANativeWindow* native_window = nullptr;
   jobject surface = nullptr;
-  int native_window_width = 0;
-  int native_window_height = 0;
+  WindowGeometry native_window_geometry;
+  // Factor by which 8-bit frames are downscaled while being copied out, in YUV
+  // and surface modes. 1, 2 or 4.
+  int downscale_factor = 1;
+  // Presents the frames queued by gav1QueueFrame if asynchronous rendering is
+  // enabled.
+  std::unique_ptr<RenderWorker> render_worker;
+
+  // Whether the 10-bit to 8-bit conversion may use AVX2. Only used on x86.
+  bool use_avx2 = false;
+
+  // Row alignment of the planes written in YUV output mode. See
+  // GetYuvOutputStride().
+  int yuv_stride_alignment = 0;
+  // Whether 8-bit 4:2:0 frames are output in YUV mode by exposing the pooled
+  // frame buffers instead of copying them.
+  bool zero_copy_yuv = false;
+
+  // Classifies the temporal units passed to gav1ClassifyTemporalUnit(), on the
+  // thread that queues input buffers.
+  exoplayer_jni::ObuParser input_parser;
+
+  // Whether only temporal units whose frames are all intra coded are decoded.
+  // Set by gav1SetTrickPlayEnabled on the playback thread and read on the
+  // decode thread.
+  std::atomic<bool> trick_play{false};
+  // Whether temporal units are skipped until the next key frame, because one
+  // was skipped since the last key frame and later frames may reference it.
+  bool awaiting_key_frame = false;
+  // Whether |decoder| was destroyed by gav1Suspend and has not been given a
+  // key frame since. The new decoder has neither a sequence header nor
+  // reference frames, so every temporal unit before the next key frame is
+  // skipped.
+  bool restarting = false;
+  // Classifies the temporal units decoded while |trick_play| or
+  // |awaiting_key_frame| is set, on the decode thread. Not reset on suspend,
+  // so that it keeps the sequence header needed to find the next key frame.
+  exoplayer_jni::ObuParser trick_play_parser;
+
+  // Copies of recently output frames, read by gav1ReadCachedFrame on any
+  // thread.
+  exoplayer_jni::FrameCache frame_cache;
 
   Libgav1StatusCode libgav1_status_code = kLibgav1StatusOk;
   JniStatusCode jni_status_code = kJniStatusOk;
@@ -332,7 +1205,7 @@ Libgav1StatusCode Libgav1GetFrameBuffer(void* callback_private_data,
 
   JniContext* const context = static_cast<JniContext*>(callback_private_data);
   JniFrameBuffer* jni_buffer;
-  context->jni_status_code = context->buffer_manager.GetBuffer(
+  context->jni_status_code = context->buffer_manager->GetBuffer(
       info.y_buffer_size, info.uv_buffer_size, &jni_buffer);
   if (context->jni_status_code != kJniStatusOk) {
     LOGE("%s", GetJniErrorMessage(context->jni_status_code));
@@ -353,65 +1226,263 @@ void Libgav1ReleaseFrameBuffer(void* callback_private_data,
                                void* buffer_private_data) {
   JniContext* const context = static_cast<JniContext*>(callback_private_data);
   const int buffer_id = *static_cast<const int*>(buffer_private_data);
-  context->jni_status_code = context->buffer_manager.ReleaseBuffer(buffer_id);
+  context->jni_status_code = context->buffer_manager->ReleaseBuffer(buffer_id);
   if (context->jni_status_code != kJniStatusOk) {
     LOGE("%s", GetJniErrorMessage(context->jni_status_code));
   }
 }
 
-constexpr int AlignTo16(int value) { return (value + 15) & (~15); }
+// Creates the libgav1 decoder of |context| with |threads| threads, replacing
+// any previous one. Libgav1 fixes its thread count at initialization, so this
+// is how the count is changed. Frames queued in the previous decoder are
+// dropped, but frames held by output buffers keep their references in the
+// buffer manager and stay valid.
+Libgav1StatusCode CreateDecoder(JniContext* const context, int threads) {
+  // Destroy the previous decoder first so that it returns its frame buffers.
+  context->decoder.reset();
+  context->decoder.reset(new (std::nothrow) libgav1::Decoder());
+  if (context->decoder == nullptr) {
+    return kLibgav1StatusOutOfMemory;
+  }
+  libgav1::DecoderSettings settings;
+  settings.threads = threads;
+  settings.get_frame_buffer = Libgav1GetFrameBuffer;
+  settings.release_frame_buffer = Libgav1ReleaseFrameBuffer;
+  settings.callback_private_data = context;
+  const Libgav1StatusCode status = context->decoder->Init(&settings);
+  context->threads = (status == kLibgav1StatusOk) ? threads : 0;
+  return status;
+}
 
-void CopyPlane(const uint8_t* source, int source_stride, uint8_t* destination,
-               int destination_stride, int width, int height) {
-  while (height--) {
-    std::memcpy(destination, source, width);
-    source += source_stride;
-    destination += destination_stride;
+// Destroys the libgav1 decoder of |context|, which stops its threads and
+// returns the frame buffers it holds, and frees the frame buffers that are not
+// in use. The configuration of the context is kept. The decoder is recreated by
+// ResumeContext(), after which decoding restarts at the next key frame.
+// |context->decoder_mutex| must be held.
+void SuspendContext(JNIEnv* env, JniContext* const context) {
+  if (context->decoder == nullptr) return;
+  context->decoder.reset();
+  context->buffer_manager->TrimFreeBuffers(env);
+  context->frame_cache.Clear();
+  context->awaiting_key_frame = true;
+  context->restarting = true;
+}
+
+// Recreates the decoder of a suspended context with the number of threads it
+// had. Frame buffers are allocated again as frames are decoded. Does nothing if
+// the context is not suspended. |context->decoder_mutex| must be held.
+Libgav1StatusCode ResumeContext(JniContext* const context) {
+  if (context->decoder != nullptr) return kLibgav1StatusOk;
+  return CreateDecoder(context, context->threads);
+}
+
+// Maximum number of contexts kept by IdleContextPool. Each one keeps its
+// frame buffers, so the pool is kept small.
+constexpr int kMaxIdleContexts = 2;
+
+// Keeps the contexts of closed decoders, flushed but with their libgav1
+// decoder and frame buffers still allocated, so that gav1Init can reuse one
+// instead of initializing a new decoder. This shortens the time to the first
+// frame when switching between channels or tracks. Idle decoders are trimmed
+// to a single thread, which runs on the caller, so that the pool holds no
+// threads outside the DecoderThreadBudget of the decoders in use. gav1Init
+// restarts the threads of a reused decoder that is given more.
+class IdleContextPool {
+ public:
+  // Returns the pool of the process. It is never destroyed.
+  static IdleContextPool& GetInstance() {
+    static IdleContextPool* const instance = new IdleContextPool();
+    return *instance;
+  }
+
+  // Removes and returns an idle context, whose decoder uses a single thread,
+  // or returns nullptr if there is none.
+  JniContext* Lease() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (contexts_.empty()) return nullptr;
+    JniContext* const context = contexts_.back();
+    contexts_.pop_back();
+    return context;
+  }
+
+  // Takes ownership of |context| unless the pool is full or its decoder could
+  // not be trimmed to a single thread. Returns whether it did.
+  bool Park(JniContext* context) {
+    if (IsFull()) return false;
+    if (context->threads != 1 &&
+        CreateDecoder(context, 1) != kLibgav1StatusOk) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (static_cast<int>(contexts_.size()) >= kMaxIdleContexts) return false;
+    contexts_.push_back(context);
+    return true;
+  }
+
+ private:
+  IdleContextPool() = default;
+
+  bool IsFull() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(contexts_.size()) >= kMaxIdleContexts;
+  }
+
+  std::mutex mutex_;
+  std::vector<JniContext*> contexts_;
+};
+
+// Returns |context| to the state of a newly initialized one, keeping its
+// decoder and frame buffers. Returns false if the decoder is suspended or
+// could not be flushed, in which case the context must not be reused.
+bool ResetContextForReuse(JNIEnv* env, JniContext* const context) {
+  // Stop the render worker first, as it holds references on frame buffers.
+  context->render_worker.reset();
+  if (context->decoder == nullptr) return false;
+  // Drops the frames still queued in the decoder and returns their buffers.
+  if (context->decoder->SignalEOS() != kLibgav1StatusOk) return false;
+  context->buffer_manager->ReleaseDirectBuffers(env);
+  if (context->native_window) {
+    ANativeWindow_release(context->native_window);
+    context->native_window = nullptr;
   }
+  context->surface = nullptr;
+  context->native_window_geometry = WindowGeometry();
+  context->downscale_factor = 1;
+  context->yuv_stride_alignment = 0;
+  context->zero_copy_yuv = false;
+  context->buffer_manager->SetSharedMemoryEnabled(false);
+  context->input_parser.Reset();
+  context->trick_play = false;
+  context->awaiting_key_frame = false;
+  context->restarting = false;
+  context->trick_play_parser.Reset();
+  context->frame_cache.Reset();
+  context->libgav1_status_code = kLibgav1StatusOk;
+  context->jni_status_code = kJniStatusOk;
+  return true;
+}
+
+// Returns the stride of |plane_index| in the YUV output buffer. A non-positive
+// |stride_alignment| keeps the decoder's stride, borders and padding included.
+// Otherwise the displayed width is rounded up to a multiple of
+// |stride_alignment|.
+int GetYuvOutputStride(const libgav1::DecoderBuffer* decoder_buffer,
+                       int plane_index, int stride_alignment,
+                       int downscale_factor) {
+  // Monochrome frames are output with 4:2:0 chroma planes, which the decoder
+  // has no stride for.
+  const bool monochrome_chroma = plane_index >= decoder_buffer->NumPlanes();
+  if (!monochrome_chroma && stride_alignment <= 0 && downscale_factor == 1) {
+    return decoder_buffer->stride[plane_index];
+  }
+  const int width = DownscaledSize(
+      monochrome_chroma ? (decoder_buffer->displayed_width[kPlaneY] + 1) / 2
+                        : decoder_buffer->displayed_width[plane_index],
+      downscale_factor);
+  return (stride_alignment <= 0)
+             ? AlignTo16(width)
+             : (width + stride_alignment - 1) / stride_alignment *
+                   stride_alignment;
 }
 
 void CopyFrameToDataBuffer(const libgav1::DecoderBuffer* decoder_buffer,
-                           jbyte* data) {
+                           const int* destination_strides,
+                           int downscale_factor, jbyte* data) {
+  PlaneCopy planes[kMaxPlanes];
   for (int plane_index = kPlaneY; plane_index < decoder_buffer->NumPlanes();
        plane_index++) {
-    const uint64_t length = decoder_buffer->stride[plane_index] *
-                            decoder_buffer->displayed_height[plane_index];
-    memcpy(data, decoder_buffer->plane[plane_index], length);
-    data += length;
+    const int height = decoder_buffer->displayed_height[plane_index];
+    planes[plane_index] = {decoder_buffer->plane[plane_index],
+                           decoder_buffer->stride[plane_index],
+                           reinterpret_cast<uint8_t*>(data),
+                           destination_strides[plane_index],
+                           decoder_buffer->displayed_width[plane_index],
+                           height};
+    data += static_cast<uint64_t>(destination_strides[plane_index]) *
+            DownscaledSize(height, downscale_factor);
+  }
+  CopyPlanes(planes, decoder_buffer->NumPlanes(), downscale_factor);
+}
+
+// Returns the color space of |decoder_buffer|, as passed to
+// VideoDecoderOutputBuffer.
+int GetColorSpace(const libgav1::DecoderBuffer* decoder_buffer) {
+  switch (decoder_buffer->matrix_coefficients) {
+    case libgav1::kMatrixCoefficientsBt470BG:
+    case libgav1::kMatrixCoefficientsBt601:
+      return exoplayer_jni::kColorSpaceBT601;
+    case libgav1::kMatrixCoefficientsBt709:
+      return exoplayer_jni::kColorSpaceBT709;
+    case libgav1::kMatrixCoefficientsBt2020Ncl:
+    case libgav1::kMatrixCoefficientsBt2020Cl:
+      return exoplayer_jni::kColorSpaceBT2020;
+    default:
+      return exoplayer_jni::kColorSpaceUnknown;
   }
 }
 
+// Converts |decoder_buffer| to RGBA pixels written to |data|, |stride| bytes
+// apart.
+void CopyFrameToRgbaDataBuffer(const libgav1::DecoderBuffer* decoder_buffer,
+                               int stride, jbyte* data) {
+  RgbaConversion conversion;
+  for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
+    const bool present = plane_index < decoder_buffer->NumPlanes();
+    conversion.planes[plane_index] =
+        present ? decoder_buffer->plane[plane_index] : nullptr;
+    conversion.strides[plane_index] =
+        present ? decoder_buffer->stride[plane_index] : 0;
+  }
+  conversion.width = decoder_buffer->displayed_width[kPlaneY];
+  conversion.height = decoder_buffer->displayed_height[kPlaneY];
+  conversion.bitdepth = decoder_buffer->bitdepth;
+  conversion.coefficients = exoplayer_jni::GetYuvToRgbCoefficients(
+      GetColorSpace(decoder_buffer),
+      decoder_buffer->color_range == libgav1::kColorRangeFull,
+      decoder_buffer->bitdepth);
+  conversion.destination = reinterpret_cast<uint8_t*>(data);
+  conversion.destination_stride = stride;
+  ConvertFrameToRgba(conversion);
+}
+
+// Converts the planes of the 10-bit |decoder_buffer| to 8 bits with
+// |convert_row|. Large frames are converted in parallel bands of rows.
 void Convert10BitFrameTo8BitDataBuffer(
-    const libgav1::DecoderBuffer* decoder_buffer, jbyte* data) {
-  for (int plane_index = kPlaneY; plane_index < decoder_buffer->NumPlanes();
-       plane_index++) {
-    int sample = 0;
-    const uint8_t* source = decoder_buffer->plane[plane_index];
-    for (int i = 0; i < decoder_buffer->displayed_height[plane_index]; i++) {
-      const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
-      for (int j = 0; j < decoder_buffer->displayed_width[plane_index]; j++) {
-        // Lightweight dither. Carryover the remainder of each 10->8 bit
-        // conversion to the next pixel.
-        sample += source_16[j];
-        data[j] = sample >> 2;
-        sample &= 3;  // Remainder.
-      }
-      source += decoder_buffer->stride[plane_index];
-      data += decoder_buffer->stride[plane_index];
-    }
+    const libgav1::DecoderBuffer* decoder_buffer,
+    const int* destination_strides, jbyte* data,
+    exoplayer_jni::RowTo8BitConverter convert_row) {
+  exoplayer_jni::PlaneTo8Bit planes[kMaxPlanes];
+  const int plane_count = decoder_buffer->NumPlanes();
+  for (int plane_index = kPlaneY; plane_index < plane_count; plane_index++) {
+    planes[plane_index] = {decoder_buffer->plane[plane_index],
+                           decoder_buffer->stride[plane_index],
+                           reinterpret_cast<uint8_t*>(data),
+                           destination_strides[plane_index],
+                           decoder_buffer->displayed_width[plane_index],
+                           decoder_buffer->displayed_height[plane_index]};
+    data += static_cast<uint64_t>(destination_strides[plane_index]) *
+            decoder_buffer->displayed_height[plane_index];
   }
+  exoplayer_jni::ConvertPlanesTo8Bit(
+      planes, plane_count, convert_row,
+      /*parallel=*/decoder_buffer->displayed_width[kPlaneY] *
+                  decoder_buffer->displayed_height[kPlaneY] >=
+              kMinParallelCopySamples &&
+          exoplayer_jni::WorkerPool::GetInstance().HasThreads());
 }
 
 #ifdef CPU_FEATURES_COMPILED_ANY_ARM_NEON
 void Convert10BitFrameTo8BitDataBufferNeon(
-    const libgav1::DecoderBuffer* decoder_buffer, jbyte* data) {
+    const libgav1::DecoderBuffer* decoder_buffer,
+    const int* destination_strides, jbyte* data) {
   uint32x2_t lcg_value = vdup_n_u32(random());
   lcg_value = vset_lane_u32(random(), lcg_value, 1);
   // LCG values recommended in "Numerical Recipes".
   const uint32x2_t LCG_MULT = vdup_n_u32(1664525);
   const uint32x2_t LCG_INCR = vdup_n_u32(1013904223);
 
-  for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
+  for (int plane_index = kPlaneY; plane_index < decoder_buffer->NumPlanes();
+       plane_index++) {
     const uint8_t* source = decoder_buffer->plane[plane_index];
 
     for (int i = 0; i < decoder_buffer->displayed_height[plane_index]; i++) {
@@ -495,18 +1566,72 @@ void Convert10BitFrameTo8BitDataBufferNeon(
       }
 
       source += decoder_buffer->stride[plane_index];
-      data += decoder_buffer->stride[plane_index];
+      data += destination_strides[plane_index];
     }
   }
 }
-#endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
 
-}  // namespace
+// Converts the 10-bit |decoder_buffer| to 8 bits with
+// Convert10BitFrameTo8BitDataBufferNeon(). Large frames are split into bands
+// of rows that are converted in parallel, each passed as a monochrome buffer
+// holding rows of one plane. The NEON converter dithers with pseudo-random
+// values rather than a carried remainder, so the bands are independent.
+void Convert10BitFrameInBands(const libgav1::DecoderBuffer* decoder_buffer,
+                              const int* destination_strides, jbyte* data) {
+  if (decoder_buffer->displayed_width[kPlaneY] *
+              decoder_buffer->displayed_height[kPlaneY] <
+          kMinParallelCopySamples ||
+      !exoplayer_jni::WorkerPool::GetInstance().HasThreads()) {
+    Convert10BitFrameTo8BitDataBufferNeon(decoder_buffer, destination_strides,
+                                          data);
+    return;
+  }
+  const int plane_count = decoder_buffer->NumPlanes();
+  jbyte* plane_data[kMaxPlanes];
+  int band_count[kMaxPlanes];
+  int total_band_count = 0;
+  for (int plane_index = kPlaneY; plane_index < plane_count; plane_index++) {
+    plane_data[plane_index] = data;
+    data += static_cast<uint64_t>(destination_strides[plane_index]) *
+            decoder_buffer->displayed_height[plane_index];
+    band_count[plane_index] =
+        (decoder_buffer->displayed_height[plane_index] + kCopyBandRows - 1) /
+        kCopyBandRows;
+    total_band_count += band_count[plane_index];
+  }
+  exoplayer_jni::WorkerPool::GetInstance().ParallelFor(
+      total_band_count, [&](int band) {
+        int plane_index = 0;
+        while (band >= band_count[plane_index]) {
+          band -= band_count[plane_index++];
+        }
+        const int first_row = band * kCopyBandRows;
+        libgav1::DecoderBuffer band_buffer = *decoder_buffer;
+        band_buffer.image_format = libgav1::kImageFormatMonochrome400;
+        band_buffer.plane[kPlaneY] = decoder_buffer->plane[plane_index] +
+                                     first_row *
+                                         decoder_buffer->stride[plane_index];
+        band_buffer.stride[kPlaneY] = decoder_buffer->stride[plane_index];
+        band_buffer.displayed_width[kPlaneY] =
+            decoder_buffer->displayed_width[plane_index];
+        band_buffer.displayed_height[kPlaneY] =
+            std::min(kCopyBandRows,
+                     decoder_buffer->displayed_height[plane_index] - first_row);
+        Convert10BitFrameTo8BitDataBufferNeon(
+            &band_buffer, &destination_strides[plane_index],
+            plane_data[plane_index] + static_cast<uint64_t>(first_row) *
+                                          destination_strides[plane_index]);
+      });
+}
+#endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
 
-DECODER_FUNC(jlong, gav1Init, jint threads) {
+// Creates a context with a decoder using |threads| threads. On failure, the
+// status codes of the returned context describe the error. Returns nullptr if
+// the context could not be allocated.
+JniContext* NewContext(JNIEnv* env, int threads) {
   JniContext* context = new (std::nothrow) JniContext();
   if (context == nullptr) {
-    return kStatusError;
+    return nullptr;
   }
 
 #ifdef CPU_FEATURES_ARCH_ARM
@@ -516,23 +1641,21 @@ DECODER_FUNC(jlong, gav1Init, jint threads) {
       cpu_features::GetArmInfo().features;
   if (!arm_features.neon) {
     context->jni_status_code = kJniStatusNeonNotSupported;
-    return reinterpret_cast<jlong>(context);
+    return context;
   }
 #else
   context->jni_status_code = kJniStatusNeonNotSupported;
-  return reinterpret_cast<jlong>(context);
+  return context;
 #endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
 #endif  // CPU_FEATURES_ARCH_ARM
 
-  libgav1::DecoderSettings settings;
-  settings.threads = threads;
-  settings.get_frame_buffer = Libgav1GetFrameBuffer;
-  settings.release_frame_buffer = Libgav1ReleaseFrameBuffer;
-  settings.callback_private_data = context;
+#ifdef CPU_FEATURES_ARCH_X86
+  context->use_avx2 = cpu_features::GetX86Info().features.avx2;
+#endif  // CPU_FEATURES_ARCH_X86
 
-  context->libgav1_status_code = context->decoder.Init(&settings);
+  context->libgav1_status_code = CreateDecoder(context, threads);
   if (context->libgav1_status_code != kLibgav1StatusOk) {
-    return reinterpret_cast<jlong>(context);
+    return context;
   }
 
   // Populate JNI References.
@@ -540,62 +1663,107 @@ DECODER_FUNC(jlong, gav1Init, jint threads) {
       "com/google/android/exoplayer2/decoder/VideoDecoderOutputBuffer");
   context->decoder_private_field =
       env->GetFieldID(outputBufferClass, "decoderPrivate", "I");
-  context->output_mode_field = env->GetFieldID(outputBufferClass, "mode", "I");
   context->data_field =
       env->GetFieldID(outputBufferClass, "data", "Ljava/nio/ByteBuffer;");
-  context->init_for_private_frame_method =
-      env->GetMethodID(outputBufferClass, "initForPrivateFrame", "(II)V");
+  context->time_us_field = env->GetFieldID(outputBufferClass, "timeUs", "J");
   context->init_for_yuv_frame_method =
       env->GetMethodID(outputBufferClass, "initForYuvFrame", "(IIIII)Z");
-
-  return reinterpret_cast<jlong>(context);
-}
-
-DECODER_FUNC(void, gav1Close, jlong jContext) {
-  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
-  delete context;
+  context->init_for_external_yuv_frame_method = env->GetMethodID(
+      outputBufferClass, "initForExternalYuvFrame",
+      "(IILjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;"
+      "IIIIII)Z");
+  context->init_for_rgba_frame_method =
+      env->GetMethodID(outputBufferClass, "initForRgbaFrame", "(IIIII)Z");
+
+  return context;
 }
 
-DECODER_FUNC(jint, gav1Decode, jlong jContext, jobject encodedData,
-             jint length) {
-  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
-  const uint8_t* const buffer = reinterpret_cast<const uint8_t*>(
-      env->GetDirectBufferAddress(encodedData));
-  context->libgav1_status_code =
-      context->decoder.EnqueueFrame(buffer, length, /*user_private_data=*/0,
-                                    /*buffer_private_data=*/nullptr);
-  if (context->libgav1_status_code != kLibgav1StatusOk) {
-    return kStatusError;
+// Stores a copy of |decoder_buffer| in the frame cache of |context| if it is
+// enabled, under the presentation time of |jOutputBuffer|. Only 8-bit 4:2:0
+// frames are cached.
+void MaybeCacheFrame(JNIEnv* env, JniContext* const context,
+                     const libgav1::DecoderBuffer* decoder_buffer,
+                     jobject jOutputBuffer) {
+  if (!context->frame_cache.enabled() || decoder_buffer->bitdepth != 8 ||
+      decoder_buffer->image_format != libgav1::kImageFormatYuv420) {
+    return;
   }
-  return kStatusOk;
+  const uint8_t* const planes[kMaxPlanes] = {decoder_buffer->plane[kPlaneY],
+                                             decoder_buffer->plane[kPlaneU],
+                                             decoder_buffer->plane[kPlaneV]};
+  context->frame_cache.Put(
+      env->GetLongField(jOutputBuffer, context->time_us_field),
+      decoder_buffer->displayed_width[kPlaneY],
+      decoder_buffer->displayed_height[kPlaneY], GetColorSpace(decoder_buffer),
+      planes, decoder_buffer->stride);
 }
 
-DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
-             jboolean decodeOnly) {
-  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
-  const libgav1::DecoderBuffer* decoder_buffer;
-  context->libgav1_status_code = context->decoder.DequeueFrame(&decoder_buffer);
-  if (context->libgav1_status_code != kLibgav1StatusOk) {
-    return kStatusError;
-  }
-
-  if (decodeOnly || decoder_buffer == nullptr) {
-    // This is not an error. The input data was decode-only or no displayable
-    // frames are available.
-    return kStatusDecodeOnly;
-  }
-
-  const int output_mode =
-      env->GetIntField(jOutputBuffer, context->output_mode_field);
-  if (output_mode == kOutputModeYuv) {
-    // Resize the buffer if required. Default color conversion will be used as
-    // libgav1::DecoderBuffer doesn't expose color space info.
+// Writes |decoder_buffer| to |jOutputBuffer| according to |output_mode|. In
+// surface mode, the frame stays in its pooled buffer: its size and buffer id
+// are written to |metadata| for the caller to initialize the output buffer,
+// and kStatusPrivateFrame is returned.
+jint OutputFrame(JNIEnv* env, JniContext* const context,
+                 const libgav1::DecoderBuffer* decoder_buffer, int output_mode,
+                 jobject jOutputBuffer, jint* metadata) {
+  MaybeCacheFrame(env, context, decoder_buffer, jOutputBuffer);
+  // Only 8-bit frames are downscaled.
+  const int downscale_factor =
+      (decoder_buffer->bitdepth == 8) ? context->downscale_factor : 1;
+  if (output_mode == kOutputModeYuv && context->zero_copy_yuv &&
+      decoder_buffer->bitdepth == 8 && downscale_factor == 1 &&
+      decoder_buffer->NumPlanes() == kMaxPlanes) {
+    // Expose the pooled frame buffer directly. The output buffer holds a
+    // reference to it until gav1ReleaseFrame is called.
+    const int buffer_id =
+        *static_cast<const int*>(decoder_buffer->buffer_private_data);
+    JniFrameBuffer* const jni_buffer =
+        context->buffer_manager->GetBuffer(buffer_id);
+    if (!jni_buffer->MaybeCreateDirectBuffers(env)) {
+      context->jni_status_code = kJniStatusOutOfMemory;
+      return kStatusError;
+    }
     const jboolean init_result = env->CallBooleanMethod(
-        jOutputBuffer, context->init_for_yuv_frame_method,
+        jOutputBuffer, context->init_for_external_yuv_frame_method,
         decoder_buffer->displayed_width[kPlaneY],
         decoder_buffer->displayed_height[kPlaneY],
+        jni_buffer->DirectBuffer(kPlaneY), jni_buffer->DirectBuffer(kPlaneU),
+        jni_buffer->DirectBuffer(kPlaneV),
+        static_cast<jint>(decoder_buffer->plane[kPlaneY] -
+                          jni_buffer->RawBuffer(kPlaneY)),
+        static_cast<jint>(decoder_buffer->plane[kPlaneU] -
+                          jni_buffer->RawBuffer(kPlaneU)),
+        static_cast<jint>(decoder_buffer->plane[kPlaneV] -
+                          jni_buffer->RawBuffer(kPlaneV)),
         decoder_buffer->stride[kPlaneY], decoder_buffer->stride[kPlaneU],
-        kColorSpaceUnknown);
+        GetColorSpace(decoder_buffer));
+    if (env->ExceptionCheck()) {
+      // Exception is thrown in Java when returning from the native call.
+      return kStatusError;
+    }
+    if (!init_result) {
+      context->jni_status_code = kJniStatusBufferResizeError;
+      return kStatusError;
+    }
+    context->buffer_manager->AddBufferReference(buffer_id);
+    jni_buffer->SetFrameData(*decoder_buffer);
+    env->SetIntField(jOutputBuffer, context->decoder_private_field, buffer_id);
+  } else if (output_mode == kOutputModeYuv) {
+    int output_strides[kMaxPlanes];
+    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
+      output_strides[plane_index] =
+          GetYuvOutputStride(decoder_buffer, plane_index,
+                             context->yuv_stride_alignment, downscale_factor);
+    }
+    const int output_width = DownscaledSize(
+        decoder_buffer->displayed_width[kPlaneY], downscale_factor);
+    const int output_height = DownscaledSize(
+        decoder_buffer->displayed_height[kPlaneY], downscale_factor);
+
+    // Resize the buffer if required.
+    const jboolean init_result = env->CallBooleanMethod(
+        jOutputBuffer, context->init_for_yuv_frame_method, output_width,
+        output_height, output_strides[kPlaneY], output_strides[kPlaneU],
+        GetColorSpace(decoder_buffer));
     if (env->ExceptionCheck()) {
       // Exception is thrown in Java when returning from the native call.
       return kStatusError;
@@ -612,19 +1780,68 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
 
     switch (decoder_buffer->bitdepth) {
       case 8:
-        CopyFrameToDataBuffer(decoder_buffer, data);
+        CopyFrameToDataBuffer(decoder_buffer, output_strides, downscale_factor,
+                              data);
         break;
       case 10:
-#ifdef CPU_FEATURES_COMPILED_ANY_ARM_NEON
-        Convert10BitFrameTo8BitDataBufferNeon(decoder_buffer, data);
+#if defined(CPU_FEATURES_COMPILED_ANY_ARM_NEON)
+        Convert10BitFrameInBands(decoder_buffer, output_strides, data);
+#elif defined(CPU_FEATURES_ARCH_X86)
+        Convert10BitFrameTo8BitDataBuffer(
+            decoder_buffer, output_strides, data,
+            context->use_avx2 ? exoplayer_jni::ConvertRowTo8BitAvx2
+                              : exoplayer_jni::ConvertRowTo8BitSse2);
 #else
-        Convert10BitFrameTo8BitDataBuffer(decoder_buffer, data);
-#endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
+        Convert10BitFrameTo8BitDataBuffer(decoder_buffer, output_strides, data,
+                                          exoplayer_jni::ConvertRowTo8Bit);
+#endif
         break;
       default:
         context->jni_status_code = kJniStatusBitDepth12NotSupportedWithYuv;
         return kStatusError;
     }
+
+    if (decoder_buffer->NumPlanes() == 1) {
+      // Monochrome frames only have a Y plane. Fill the U and V planes, which
+      // follow it, with a neutral value.
+      const uint64_t y_length =
+          static_cast<uint64_t>(output_strides[kPlaneY]) * output_height;
+      const uint64_t uv_length =
+          static_cast<uint64_t>(output_strides[kPlaneU]) *
+          ((output_height + 1) / 2);
+      std::memset(data + y_length, kNeutralChroma, 2 * uv_length);
+    }
+  } else if (output_mode == kOutputModeRgba) {
+    if ((decoder_buffer->bitdepth != 8 && decoder_buffer->bitdepth != 10) ||
+        (decoder_buffer->image_format != libgav1::kImageFormatYuv420 &&
+         decoder_buffer->image_format != libgav1::kImageFormatMonochrome400)) {
+      context->jni_status_code = kJniStatusUnsupportedRgbaFrame;
+      return kStatusError;
+    }
+    // Frames are converted at their decoded size. Both RGBA formats use 4
+    // bytes per pixel.
+    const int width = decoder_buffer->displayed_width[kPlaneY];
+    const int stride = width * 4;
+    const jboolean init_result = env->CallBooleanMethod(
+        jOutputBuffer, context->init_for_rgba_frame_method, width,
+        decoder_buffer->displayed_height[kPlaneY], stride,
+        (decoder_buffer->bitdepth == 8) ? exoplayer_jni::kRgbaFormat8888
+                                        : exoplayer_jni::kRgbaFormat1010102,
+        GetColorSpace(decoder_buffer));
+    if (env->ExceptionCheck()) {
+      // Exception is thrown in Java when returning from the native call.
+      return kStatusError;
+    }
+    if (!init_result) {
+      context->jni_status_code = kJniStatusBufferResizeError;
+      return kStatusError;
+    }
+
+    const jobject data_object =
+        env->GetObjectField(jOutputBuffer, context->data_field);
+    jbyte* const data =
+        reinterpret_cast<jbyte*>(env->GetDirectBufferAddress(data_object));
+    CopyFrameToRgbaDataBuffer(decoder_buffer, stride, data);
   } else if (output_mode == kOutputModeSurfaceYuv) {
     if (decoder_buffer->bitdepth != 8) {
       context->jni_status_code =
@@ -639,108 +1856,374 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
 
     const int buffer_id =
         *static_cast<const int*>(decoder_buffer->buffer_private_data);
-    context->buffer_manager.AddBufferReference(buffer_id);
+    context->buffer_manager->AddBufferReference(buffer_id);
     JniFrameBuffer* const jni_buffer =
-        context->buffer_manager.GetBuffer(buffer_id);
+        context->buffer_manager->GetBuffer(buffer_id);
     jni_buffer->SetFrameData(*decoder_buffer);
-    env->CallVoidMethod(jOutputBuffer, context->init_for_private_frame_method,
-                        decoder_buffer->displayed_width[kPlaneY],
-                        decoder_buffer->displayed_height[kPlaneY]);
-    if (env->ExceptionCheck()) {
-      // Exception is thrown in Java when returning from the native call.
-      return kStatusError;
+    const int width = DownscaledSize(decoder_buffer->displayed_width[kPlaneY],
+                                     downscale_factor);
+    const int height = DownscaledSize(
+        decoder_buffer->displayed_height[kPlaneY], downscale_factor);
+    metadata[kFrameMetadataWidth] = width;
+    metadata[kFrameMetadataHeight] = height;
+    metadata[kFrameMetadataBufferId] = buffer_id;
+    return kStatusPrivateFrame;
+  }
+
+  return kStatusOk;
+}
+
+// Returns whether the temporal unit of |size| bytes at |data| is skipped
+// instead of decoded. In trick-play mode, only temporal units whose frames are
+// all intra coded are decoded. Once a temporal unit has been skipped, inter
+// frames are skipped until the next key frame refreshes every reference frame.
+// Temporal units that cannot be classified are decoded, unless the decoder was
+// recreated after a suspension and has not decoded a key frame yet.
+bool SkipTemporalUnit(JniContext* const context, const uint8_t* data,
+                      size_t size) {
+  if (!context->trick_play && !context->awaiting_key_frame) {
+    return false;
+  }
+  exoplayer_jni::TemporalUnitInfo info;
+  if (!context->trick_play_parser.ParseTemporalUnit(data, size, &info)) {
+    return context->restarting;
+  }
+  if (context->restarting && info.show_existing_frame) {
+    // The recreated decoder holds no frame to show.
+    return true;
+  }
+  if (info.key_frame) {
+    context->awaiting_key_frame = false;
+    context->restarting = false;
+    return false;
+  }
+  if (context->trick_play && info.intra_only && !context->restarting) {
+    return false;
+  }
+  context->awaiting_key_frame = true;
+  return true;
+}
+
+}  // namespace
+
+DECODER_FUNC(jlong, gav1Init, jint threads) {
+  // Reuse the context of a closed decoder if there is one.
+  JniContext* context = IdleContextPool::GetInstance().Lease();
+  if (context != nullptr) {
+    if (context->threads != threads) {
+      context->libgav1_status_code = CreateDecoder(context, threads);
     }
-    env->SetIntField(jOutputBuffer, context->decoder_private_field, buffer_id);
+    return reinterpret_cast<jlong>(context);
+  }
+  context = NewContext(env, threads);
+  if (context == nullptr) {
+    return kStatusError;
+  }
+  return reinterpret_cast<jlong>(context);
+}
+
+DECODER_FUNC(void, gav1Prewarm, jint count) {
+  for (int i = 0; i < count; i++) {
+    // Idle decoders use a single thread, see IdleContextPool.
+    JniContext* const context = NewContext(env, 1);
+    if (context == nullptr) {
+      return;
+    }
+    if (context->threads == 0 ||
+        !IdleContextPool::GetInstance().Park(context)) {
+      delete context;
+      return;
+    }
+  }
+}
+
+DECODER_FUNC(void, gav1Close, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  // Keep the context for the next decoder if it is healthy and there is room.
+  // Once the decoder is flushed, buffers still in use are held by output
+  // buffers the renderer has not released, which would release them into the
+  // next decoder, so the context is destroyed instead. Its buffer manager is
+  // then deleted by the last of those releases.
+  if (context->threads > 0 && context->jni_status_code == kJniStatusOk &&
+      ResetContextForReuse(env, context) &&
+      !context->buffer_manager->HasBuffersInUse() &&
+      IdleContextPool::GetInstance().Park(context)) {
+    return;
+  }
+  context->buffer_manager->ReleaseDirectBuffers(env);
+  delete context;
+}
+
+DECODER_FUNC(jint, gav1SetThreads, jlong jContext, jint threads) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  context->libgav1_status_code = CreateDecoder(context, threads);
+  if (context->libgav1_status_code != kLibgav1StatusOk) {
+    return kStatusError;
   }
+  return kStatusOk;
+}
+
+DECODER_FUNC(void, gav1Suspend, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  SuspendContext(env, context);
+}
 
+DECODER_FUNC(jint, gav1Resume, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  context->libgav1_status_code = ResumeContext(context);
+  if (context->libgav1_status_code != kLibgav1StatusOk) {
+    return kStatusError;
+  }
   return kStatusOk;
 }
 
+DECODER_FUNC(jint, gav1ClassifyTemporalUnit, jlong jContext,
+             jobject encodedData, jint offset, jint length) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  const auto* const buffer = reinterpret_cast<const uint8_t*>(
+      env->GetDirectBufferAddress(encodedData));
+  exoplayer_jni::TemporalUnitInfo info;
+  if (buffer == nullptr || !context->input_parser.ParseTemporalUnit(
+                               buffer + offset, length, &info)) {
+    return exoplayer_jni::kTemporalUnitUnknown;
+  }
+  return exoplayer_jni::PackTemporalUnitInfo(info);
+}
+
+DECODER_FUNC(void, gav1SetTrickPlayEnabled, jlong jContext, jboolean enabled) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  context->trick_play = enabled;
+}
+
+DECODER_FUNC(jint, gav1DecodeFrame, jlong jContext, jobject encodedData,
+             jint length, jobject jOutputBuffer, jint outputMode,
+             jboolean decodeOnly, jobject jMetadata) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  const uint8_t* const buffer = reinterpret_cast<const uint8_t*>(
+      env->GetDirectBufferAddress(encodedData));
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  if (SkipTemporalUnit(context, buffer, length)) {
+    return kStatusDecodeOnly;
+  }
+  context->libgav1_status_code = ResumeContext(context);
+  if (context->libgav1_status_code != kLibgav1StatusOk) {
+    return kStatusError;
+  }
+  context->libgav1_status_code =
+      context->decoder->EnqueueFrame(buffer, length, /*user_private_data=*/0,
+                                     /*buffer_private_data=*/nullptr);
+  if (context->libgav1_status_code != kLibgav1StatusOk) {
+    return kStatusError;
+  }
+  const libgav1::DecoderBuffer* decoder_buffer;
+  context->libgav1_status_code =
+      context->decoder->DequeueFrame(&decoder_buffer);
+  if (context->libgav1_status_code != kLibgav1StatusOk) {
+    return kStatusError;
+  }
+  if (decodeOnly || decoder_buffer == nullptr) {
+    // This is not an error. The input data was decode-only or no displayable
+    // frames are available.
+    return kStatusDecodeOnly;
+  }
+  // The Java decoder allocates room for all the metadata ints.
+  jint* const metadata =
+      static_cast<jint*>(env->GetDirectBufferAddress(jMetadata));
+  return OutputFrame(env, context, decoder_buffer, outputMode, jOutputBuffer,
+                     metadata);
+}
+
 DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
              jobject jOutputBuffer) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
   const int buffer_id =
       env->GetIntField(jOutputBuffer, context->decoder_private_field);
-  JniFrameBuffer* const jni_buffer =
-      context->buffer_manager.GetBuffer(buffer_id);
+  const JniFrameBuffer* const jni_buffer =
+      context->buffer_manager->GetBufferInUse(buffer_id);
+  if (jni_buffer == nullptr) {
+    context->jni_status_code = kJniStatusInvalidBufferId;
+    return kStatusError;
+  }
 
   if (!context->MaybeAcquireNativeWindow(env, jSurface)) {
     return kStatusError;
   }
 
-  if (context->native_window_width != jni_buffer->DisplayedWidth(kPlaneY) ||
-      context->native_window_height != jni_buffer->DisplayedHeight(kPlaneY)) {
-    if (ANativeWindow_setBuffersGeometry(
-            context->native_window, jni_buffer->DisplayedWidth(kPlaneY),
-            jni_buffer->DisplayedHeight(kPlaneY), kImageFormatYV12)) {
-      context->jni_status_code = kJniStatusANativeWindowError;
-      return kStatusError;
-    }
-    context->native_window_width = jni_buffer->DisplayedWidth(kPlaneY);
-    context->native_window_height = jni_buffer->DisplayedHeight(kPlaneY);
-  }
+  context->jni_status_code = RenderFrameToWindow(
+      *jni_buffer, context->downscale_factor, context->native_window,
+      &context->native_window_geometry);
+  return (context->jni_status_code == kJniStatusOk) ? kStatusOk : kStatusError;
+}
 
-  ANativeWindow_Buffer native_window_buffer;
-  if (ANativeWindow_lock(context->native_window, &native_window_buffer,
-                         /*inOutDirtyBounds=*/nullptr) ||
-      native_window_buffer.bits == nullptr) {
-    context->jni_status_code = kJniStatusANativeWindowError;
+DECODER_FUNC(jint, gav1QueueFrame, jlong jContext, jobject jSurface,
+             jobject jOutputBuffer, jlong releaseTimeNs) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  if (context->render_worker == nullptr) {
+    context->jni_status_code = kJniStatusAsyncRenderNotEnabled;
+    return kStatusError;
+  }
+  // Report failures to present earlier frames.
+  const JniStatusCode render_status = context->render_worker->TakeError();
+  if (render_status != kJniStatusOk) {
+    context->jni_status_code = render_status;
+    return kStatusError;
+  }
+  const int buffer_id =
+      env->GetIntField(jOutputBuffer, context->decoder_private_field);
+  if (context->buffer_manager->GetBufferInUse(buffer_id) == nullptr) {
+    context->jni_status_code = kJniStatusInvalidBufferId;
+    return kStatusError;
+  }
+  if (!context->MaybeAcquireNativeWindow(env, jSurface)) {
     return kStatusError;
   }
+  context->render_worker->QueueFrame(context->native_window,
+                                     context->downscale_factor, buffer_id,
+                                     releaseTimeNs);
+  return kStatusOk;
+}
 
-  // Y plane
-  CopyPlane(jni_buffer->Plane(kPlaneY), jni_buffer->Stride(kPlaneY),
-            reinterpret_cast<uint8_t*>(native_window_buffer.bits),
-            native_window_buffer.stride, jni_buffer->DisplayedWidth(kPlaneY),
-            jni_buffer->DisplayedHeight(kPlaneY));
+DECODER_FUNC(jlong, gav1GetBufferManager, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  return reinterpret_cast<jlong>(context->buffer_manager);
+}
 
-  const int y_plane_size =
-      native_window_buffer.stride * native_window_buffer.height;
-  const int32_t native_window_buffer_uv_height =
-      (native_window_buffer.height + 1) / 2;
-  const int native_window_buffer_uv_stride =
-      AlignTo16(native_window_buffer.stride / 2);
+DECODER_FUNC(void, gav1ReleaseFrame, jlong jBufferManager, jint bufferId) {
+  JniBufferManager* const buffer_manager =
+      reinterpret_cast<JniBufferManager*>(jBufferManager);
+  // The context may have been destroyed, so the error is only logged.
+  const JniStatusCode status = buffer_manager->ReleaseBuffer(bufferId);
+  if (status != kJniStatusOk) {
+    LOGE("%s", GetJniErrorMessage(status));
+  }
+}
 
-  // TODO(b/140606738): Handle monochrome videos.
+DECODER_FUNC(void, gav1SetDownscaleFactor, jlong jContext, jint factor) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  context->downscale_factor = factor;
+}
 
-  // V plane
-  // Since the format for ANativeWindow is YV12, V plane is being processed
-  // before U plane.
-  const int v_plane_height = std::min(native_window_buffer_uv_height,
-                                      jni_buffer->DisplayedHeight(kPlaneV));
-  CopyPlane(
-      jni_buffer->Plane(kPlaneV), jni_buffer->Stride(kPlaneV),
-      reinterpret_cast<uint8_t*>(native_window_buffer.bits) + y_plane_size,
-      native_window_buffer_uv_stride, jni_buffer->DisplayedWidth(kPlaneV),
-      v_plane_height);
-
-  const int v_plane_size = v_plane_height * native_window_buffer_uv_stride;
-
-  // U plane
-  CopyPlane(jni_buffer->Plane(kPlaneU), jni_buffer->Stride(kPlaneU),
-            reinterpret_cast<uint8_t*>(native_window_buffer.bits) +
-                y_plane_size + v_plane_size,
-            native_window_buffer_uv_stride, jni_buffer->DisplayedWidth(kPlaneU),
-            std::min(native_window_buffer_uv_height,
-                     jni_buffer->DisplayedHeight(kPlaneU)));
-
-  if (ANativeWindow_unlockAndPost(context->native_window)) {
-    context->jni_status_code = kJniStatusANativeWindowError;
-    return kStatusError;
+DECODER_FUNC(void, gav1SetAsyncRenderEnabled, jlong jContext,
+             jboolean enabled) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  if (!enabled) {
+    context->render_worker.reset();
+  } else if (context->render_worker == nullptr) {
+    context->render_worker.reset(
+        new (std::nothrow) RenderWorker(context->buffer_manager));
   }
+}
 
-  return kStatusOk;
+DECODER_FUNC(jlong, gav1GetRenderedFrameCount, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  return (context->render_worker == nullptr)
+             ? 0
+             : context->render_worker->rendered_frame_count();
 }
 
-DECODER_FUNC(void, gav1ReleaseFrame, jlong jContext, jobject jOutputBuffer) {
+DECODER_FUNC(jlong, gav1GetDroppedFrameCount, jlong jContext) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
-  const int buffer_id =
-      env->GetIntField(jOutputBuffer, context->decoder_private_field);
-  env->SetIntField(jOutputBuffer, context->decoder_private_field, -1);
-  context->jni_status_code = context->buffer_manager.ReleaseBuffer(buffer_id);
-  if (context->jni_status_code != kJniStatusOk) {
-    LOGE("%s", GetJniErrorMessage(context->jni_status_code));
+  return (context->render_worker == nullptr)
+             ? 0
+             : context->render_worker->dropped_frame_count();
+}
+
+DECODER_FUNC(void, gav1SetYuvOutputStrideAlignment, jlong jContext,
+             jint alignment) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  context->yuv_stride_alignment = alignment;
+}
+
+DECODER_FUNC(void, gav1SetZeroCopyYuvOutputEnabled, jlong jContext,
+             jboolean enabled) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  context->zero_copy_yuv = enabled;
+}
+
+DECODER_FUNC(void, gav1SetSharedMemoryFramesEnabled, jlong jContext,
+             jboolean enabled) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  context->buffer_manager->SetSharedMemoryEnabled(enabled);
+}
+
+DECODER_FUNC(jint, gav1ExportSharedFrame, jlong jContext, jint bufferId,
+             jintArray jLayout) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  const JniFrameBuffer* const jni_buffer =
+      context->buffer_manager->GetBufferInUse(bufferId);
+  if (jni_buffer == nullptr) {
+    context->jni_status_code = kJniStatusInvalidBufferId;
+    return kSharedFrameError;
+  }
+  const gav1_jni::SharedMemoryRegion* const shared_memory =
+      jni_buffer->SharedMemory();
+  if (shared_memory == nullptr) return kSharedFrameNotShared;
+  // The layout matches the SHARED_FRAME_LAYOUT constants of Gav1Decoder.
+  jint layout[kSharedFrameLayoutSize] = {};
+  layout[kSharedFrameLayoutWidth] = jni_buffer->DisplayedWidth(kPlaneY);
+  layout[kSharedFrameLayoutHeight] = jni_buffer->DisplayedHeight(kPlaneY);
+  layout[kSharedFrameLayoutSizeBytes] =
+      static_cast<jint>(shared_memory->size());
+  for (int plane_index = kPlaneY; plane_index < jni_buffer->NumPlanes();
+       plane_index++) {
+    layout[kSharedFrameLayoutOffsets + plane_index] = static_cast<jint>(
+        jni_buffer->Plane(plane_index) - shared_memory->data());
+    layout[kSharedFrameLayoutStrides + plane_index] =
+        jni_buffer->Stride(plane_index);
   }
+  env->SetIntArrayRegion(jLayout, 0, kSharedFrameLayoutSize, layout);
+  if (env->ExceptionCheck()) {
+    // Exception is thrown in Java when returning from the native call.
+    return kSharedFrameNotShared;
+  }
+  const int fd = shared_memory->DuplicateFd();
+  if (fd < 0) {
+    LOGE("Failed to duplicate the shared frame descriptor: %s",
+         strerror(errno));
+    return kSharedFrameNotShared;
+  }
+  return fd;
+}
+
+DECODER_FUNC(void, gav1SetFrameCacheSize, jlong jContext, jlong maxBytes,
+             jint downscaleFactor) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  context->frame_cache.Configure(
+      static_cast<size_t>(std::max<jlong>(maxBytes, 0)), downscaleFactor);
+}
+
+DECODER_FUNC(jboolean, gav1ReadCachedFrame, jlong jContext, jlong timeUs,
+             jlong toleranceUs, jobject jOutputBuffer) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  return context->frame_cache.Read(
+      timeUs, std::max<jlong>(toleranceUs, 0),
+      [=](const exoplayer_jni::CachedFrameInfo& info) -> uint8_t* {
+        const jboolean init_result = env->CallBooleanMethod(
+            jOutputBuffer, context->init_for_yuv_frame_method, info.width,
+            info.height, info.width, (info.width + 1) / 2, info.colorspace);
+        if (env->ExceptionCheck() || !init_result) {
+          // Any exception is thrown in Java when returning from the native
+          // call.
+          return nullptr;
+        }
+        env->SetLongField(jOutputBuffer, context->time_us_field, info.time_us);
+        const jobject data_object =
+            env->GetObjectField(jOutputBuffer, context->data_field);
+        return static_cast<uint8_t*>(env->GetDirectBufferAddress(data_object));
+      });
+}
+
+DECODER_FUNC(jlong, gav1GetFrameCacheHitCount, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  return context->frame_cache.hit_count();
+}
+
+DECODER_FUNC(jlong, gav1GetFrameCacheMissCount, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  return context->frame_cache.miss_count();
 }
 
 DECODER_FUNC(jstring, gav1GetErrorMessage, jlong jContext) {
@@ -770,7 +2253,30 @@ DECODER_FUNC(jint, gav1CheckError, jlong jContext) {
 }
 
 DECODER_FUNC(jint, gav1GetThreads) {
-  return gav1_jni::GetNumberOfPerformanceCoresOnline();
+  return exoplayer_jni::GetNumberOfPerformanceCoresOnline();
+}
+
+DECODER_FUNC(void, gav1SetFrameArenaCapacity, jlong capacityBytes) {
+  exoplayer_jni::FrameArena::GetInstance().SetCapacity(
+      static_cast<size_t>(std::max<jlong>(capacityBytes, 0)));
+}
+
+DECODER_FUNC(void, gav1SetLogLevel, jint level) {
+  exoplayer_jni::SetLogLevel(level);
+}
+
+DECODER_FUNC(void, gav1SetLogRingEnabled, jboolean enabled) {
+  exoplayer_jni::SetLogRingEnabled(enabled);
+}
+
+DECODER_FUNC(jstring, gav1DumpLogRing) {
+  std::unique_ptr<char[]> log(new (std::nothrow)
+                                  char[exoplayer_jni::kLogRingDumpSize]);
+  if (log == nullptr) {
+    return nullptr;
+  }
+  exoplayer_jni::DumpLogRing(log.get(), exoplayer_jni::kLogRingDumpSize);
+  return env->NewStringUTF(log.get());
 }
 
 // TODO(b/139902005): Add functions for getting libgav1 version and build
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "shared_memory.h"  // NOLINT
+
+#include <fcntl.h>
+#include <linux/memfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+#if defined(__ANDROID__)
+#include <linux/ashmem.h>
+#include <sys/ioctl.h>
+#endif  // defined(__ANDROID__)
+
+namespace gav1_jni {
+namespace {
+
+// Returns a memfd of |size| bytes, or -1 if the kernel does not support them.
+// The system call is made directly, as the libc wrapper is missing from older
+// Android API levels.
+int CreateMemfd(const char* name, size_t size) {
+#if defined(__NR_memfd_create)
+  const int fd =
+      static_cast<int>(syscall(__NR_memfd_create, name, MFD_CLOEXEC));
+  if (fd < 0) return -1;
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+#else
+  return -1;
+#endif  // defined(__NR_memfd_create)
+}
+
+// Returns an ashmem region of |size| bytes, or -1 on failure or when not
+// running on Android.
+int CreateAshmem(const char* name, size_t size) {
+#if defined(__ANDROID__)
+  const int fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+  if (fd < 0) return -1;
+  char ashmem_name[ASHMEM_NAME_LEN];
+  snprintf(ashmem_name, sizeof(ashmem_name), "%s", name);
+  if (ioctl(fd, ASHMEM_SET_NAME, ashmem_name) < 0 ||
+      ioctl(fd, ASHMEM_SET_SIZE, size) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+#else
+  (void)name;
+  (void)size;
+  return -1;
+#endif  // defined(__ANDROID__)
+}
+
+}  // namespace
+
+std::unique_ptr<SharedMemoryRegion> SharedMemoryRegion::Create(
+    const char* name, size_t size) {
+  if (size == 0) return nullptr;
+  bool memfd = true;
+  int fd = CreateMemfd(name, size);
+  if (fd < 0) {
+    memfd = false;
+    fd = CreateAshmem(name, size);
+    if (fd < 0) return nullptr;
+  }
+  void* const data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+  return std::unique_ptr<SharedMemoryRegion>(new SharedMemoryRegion(
+      fd, memfd, static_cast<uint8_t*>(data), size));
+}
+
+SharedMemoryRegion::~SharedMemoryRegion() {
+  munmap(data_, size_);
+  close(fd_);
+}
+
+int SharedMemoryRegion::DuplicateFd() const {
+  if (memfd_) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd_);
+    const int read_only_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (read_only_fd >= 0) return read_only_fd;
+  }
+  return fcntl(fd_, F_DUPFD_CLOEXEC, 0);
+}
+
+}  // namespace gav1_jni
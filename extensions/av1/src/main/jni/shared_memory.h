@@ -0,0 +1,62 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_AV1_SRC_MAIN_JNI_SHARED_MEMORY_H_
+#define EXOPLAYER_V2_EXTENSIONS_AV1_SRC_MAIN_JNI_SHARED_MEMORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace gav1_jni {
+
+// A region of memory that other processes can map through a file descriptor.
+// Backed by memfd_create(), or by ashmem on Android kernels that lack it. The
+// region is mapped read-write in this process for as long as it exists.
+class SharedMemoryRegion {
+ public:
+  // Creates a region of |size| bytes. |name| only shows up in debugging tools
+  // such as /proc/<pid>/maps. Returns null on failure.
+  static std::unique_ptr<SharedMemoryRegion> Create(const char* name,
+                                                    size_t size);
+
+  ~SharedMemoryRegion();
+
+  // Not copyable or movable.
+  SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+  SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Returns a new close-on-exec file descriptor of the region, owned by the
+  // caller, or -1 on failure. Memfd regions are reopened read-only through
+  // /proc when possible, so that the process the descriptor is sent to cannot
+  // write to them.
+  int DuplicateFd() const;
+
+ private:
+  SharedMemoryRegion(int fd, bool memfd, uint8_t* data, size_t size)
+      : fd_(fd), memfd_(memfd), data_(data), size_(size) {}
+
+  const int fd_;
+  const bool memfd_;
+  uint8_t* const data_;
+  const size_t size_;
+};
+
+}  // namespace gav1_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_AV1_SRC_MAIN_JNI_SHARED_MEMORY_H_
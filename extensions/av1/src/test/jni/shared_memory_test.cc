@@ -0,0 +1,210 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Exports a frame laid out the way gav1ExportSharedFrame describes it to a
+// child process, sending the descriptor over a Unix socket with SCM_RIGHTS as
+// Binder does for a ParcelFileDescriptor, and checks that the child maps the
+// same bytes, sees later writes, and cannot write to the frame.
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "shared_memory.h"  // NOLINT
+
+namespace {
+
+constexpr int kWidth = 70;
+constexpr int kHeight = 46;
+constexpr int kNumPlanes = 3;
+
+// Mirrors the ints of a SharedMemoryFrame.
+struct FrameLayout {
+  int size;
+  int offsets[kNumPlanes];
+  int strides[kNumPlanes];
+};
+
+int PlaneWidth(int plane) { return plane == 0 ? kWidth : (kWidth + 1) / 2; }
+int PlaneHeight(int plane) { return plane == 0 ? kHeight : (kHeight + 1) / 2; }
+
+uint8_t ExpectedSample(int plane, int x, int y) {
+  return static_cast<uint8_t>(plane * 85 + x * 3 + y * 7);
+}
+
+bool SendFd(int socket, int fd, const FrameLayout& layout) {
+  iovec iov = {const_cast<FrameLayout*>(&layout), sizeof(layout)};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr message = {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  cmsghdr* const header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(header), &fd, sizeof(int));
+  return sendmsg(socket, &message, 0) == static_cast<ssize_t>(sizeof(layout));
+}
+
+int ReceiveFd(int socket, FrameLayout* layout) {
+  iovec iov = {layout, sizeof(*layout)};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr message = {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  if (recvmsg(socket, &message, 0) != static_cast<ssize_t>(sizeof(*layout))) {
+    return -1;
+  }
+  const cmsghdr* const header = CMSG_FIRSTHDR(&message);
+  if (header == nullptr || header->cmsg_type != SCM_RIGHTS) return -1;
+  int fd;
+  memcpy(&fd, CMSG_DATA(header), sizeof(int));
+  return fd;
+}
+
+bool WriteByte(int socket) {
+  const char byte = 0;
+  return write(socket, &byte, 1) == 1;
+}
+
+bool ReadByte(int socket) {
+  char byte;
+  return read(socket, &byte, 1) == 1;
+}
+
+// Runs in the child process. Returns the exit status.
+int CheckReceivedFrame(int socket) {
+  FrameLayout layout;
+  const int fd = ReceiveFd(socket, &layout);
+  if (fd < 0) {
+    fprintf(stderr, "Child: failed to receive the frame\n");
+    return 1;
+  }
+  if (mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) !=
+      MAP_FAILED) {
+    fprintf(stderr, "Child: the frame is mapped writable\n");
+    return 1;
+  }
+  void* const mapping =
+      mmap(nullptr, layout.size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Child: failed to map the frame: %s\n", strerror(errno));
+    return 1;
+  }
+  const uint8_t* const data = static_cast<const uint8_t*>(mapping);
+  for (int plane = 0; plane < kNumPlanes; plane++) {
+    for (int y = 0; y < PlaneHeight(plane); y++) {
+      const uint8_t* const row =
+          data + layout.offsets[plane] + y * layout.strides[plane];
+      for (int x = 0; x < PlaneWidth(plane); x++) {
+        if (row[x] != ExpectedSample(plane, x, y)) {
+          fprintf(stderr, "Child: plane %d (%d, %d) is %d, expected %d\n",
+                  plane, x, y, row[x], ExpectedSample(plane, x, y));
+          return 1;
+        }
+      }
+    }
+  }
+  // The frame is not a copy: a sample written by the parent after the export
+  // is visible.
+  if (!WriteByte(socket) || !ReadByte(socket)) return 1;
+  if (data[layout.offsets[1]] != 0xAB) {
+    fprintf(stderr, "Child: a write after the export is not visible\n");
+    return 1;
+  }
+  munmap(mapping, layout.size);
+  return 0;
+}
+
+}  // namespace
+
+int main() {
+  FrameLayout layout;
+  layout.strides[0] = (kWidth + 15) & ~15;
+  layout.strides[1] = layout.strides[2] = (PlaneWidth(1) + 15) & ~15;
+  const int y_size = layout.strides[0] * kHeight;
+  const int uv_size = layout.strides[1] * PlaneHeight(1);
+  layout.offsets[0] = 0;
+  layout.offsets[1] = y_size;
+  layout.offsets[2] = y_size + uv_size;
+  layout.size = y_size + 2 * uv_size;
+
+  std::unique_ptr<gav1_jni::SharedMemoryRegion> region =
+      gav1_jni::SharedMemoryRegion::Create("gav1_frame_test", layout.size);
+  if (region == nullptr) {
+    fprintf(stderr, "Failed to create the shared memory region\n");
+    return 1;
+  }
+  for (int plane = 0; plane < kNumPlanes; plane++) {
+    for (int y = 0; y < PlaneHeight(plane); y++) {
+      uint8_t* const row =
+          region->data() + layout.offsets[plane] + y * layout.strides[plane];
+      for (int x = 0; x < PlaneWidth(plane); x++) {
+        row[x] = ExpectedSample(plane, x, y);
+      }
+    }
+  }
+
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+    perror("socketpair");
+    return 1;
+  }
+  const pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (pid == 0) {
+    close(sockets[0]);
+    _exit(CheckReceivedFrame(sockets[1]));
+  }
+  close(sockets[1]);
+
+  bool passed = true;
+  const int fd = region->DuplicateFd();
+  if (fd < 0 || !SendFd(sockets[0], fd, layout)) {
+    fprintf(stderr, "Failed to send the frame\n");
+    passed = false;
+  }
+  if (fd >= 0) close(fd);
+  if (passed && ReadByte(sockets[0])) {
+    region->data()[layout.offsets[1]] = 0xAB;
+    WriteByte(sockets[0]);
+  }
+  close(sockets[0]);
+
+  int status;
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    passed = false;
+  }
+  printf("SharedMemoryRegion export to a child process: %s\n",
+         passed ? "OK" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -23,7 +23,7 @@
 #include <cstdlib>
 #include <cstring>
 
-namespace gav1_jni {
+namespace exoplayer_jni {
 namespace {
 
 // Note: The code in this file needs to use the 'long' type because it is the
@@ -165,4 +165,4 @@ int GetNumberOfPerformanceCoresOnline() {
 
 #endif
 
-}  // namespace gav1_jni
+}  // namespace exoplayer_jni
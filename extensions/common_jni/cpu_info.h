@@ -13,16 +13,16 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#ifndef EXOPLAYER_V2_EXTENSIONS_AV1_SRC_MAIN_JNI_CPU_INFO_H_
-#define EXOPLAYER_V2_EXTENSIONS_AV1_SRC_MAIN_JNI_CPU_INFO_H_
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_CPU_INFO_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_CPU_INFO_H_
 
-namespace gav1_jni {
+namespace exoplayer_jni {
 
-// Returns the number of performance cores that are available for AV1 decoding.
+// Returns the number of performance cores that are available for decoding.
 // This is a heuristic that works on most common android devices. Returns 0 on
 // error or if the number of performance cores cannot be determined.
 int GetNumberOfPerformanceCoresOnline();
 
-}  // namespace gav1_jni
+}  // namespace exoplayer_jni
 
-#endif  // EXOPLAYER_V2_EXTENSIONS_AV1_SRC_MAIN_JNI_CPU_INFO_H_
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_CPU_INFO_H_
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "frame_arena.h"  // NOLINT
+
+#include <new>
+
+namespace exoplayer_jni {
+
+FrameArena& FrameArena::GetInstance() {
+  static FrameArena* const instance = new FrameArena();
+  return *instance;
+}
+
+uint8_t* FrameArena::Lease(size_t min_size, size_t* size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto best = idle_blocks_.end();
+    for (auto it = idle_blocks_.begin(); it != idle_blocks_.end(); ++it) {
+      if (it->size >= min_size && it->size / 2 <= min_size &&
+          (best == idle_blocks_.end() || it->size < best->size)) {
+        best = it;
+      }
+    }
+    if (best != idle_blocks_.end()) {
+      uint8_t* const data = best->data;
+      *size = best->size;
+      idle_bytes_ -= best->size;
+      idle_blocks_.erase(best);
+      return data;
+    }
+  }
+  uint8_t* const data = new (std::nothrow) uint8_t[min_size];
+  *size = (data != nullptr) ? min_size : 0;
+  return data;
+}
+
+void FrameArena::Return(uint8_t* block, size_t size) {
+  if (block == nullptr) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size > capacity_bytes_) {
+    delete[] block;
+    return;
+  }
+  idle_blocks_.push_back({block, size});
+  idle_bytes_ += size;
+  TrimLocked();
+}
+
+void FrameArena::Free(uint8_t* block) { delete[] block; }
+
+void FrameArena::SetCapacity(size_t capacity_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_bytes_ = capacity_bytes;
+  TrimLocked();
+}
+
+size_t FrameArena::idle_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_bytes_;
+}
+
+void FrameArena::TrimLocked() {
+  while (idle_bytes_ > capacity_bytes_) {
+    idle_bytes_ -= idle_blocks_.front().size;
+    delete[] idle_blocks_.front().data;
+    idle_blocks_.pop_front();
+  }
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_FRAME_ARENA_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_FRAME_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>  // NOLINT
+
+namespace exoplayer_jni {
+
+// Number of idle bytes the frame arena holds unless configured otherwise.
+constexpr size_t kDefaultFrameArenaCapacity = 64 * 1024 * 1024;
+
+// A store of the frame buffer memory released by the decoder contexts of a
+// native library, which later contexts lease instead of allocating new memory.
+// Each extension library links its own arena. When a decoder is re-created,
+// for example on a resolution change or a track switch, the new one reuses
+// memory that is already mapped and faulted in. Holds at most a configurable
+// number of idle bytes, freeing the least recently returned blocks beyond it.
+// Thread-safe.
+class FrameArena {
+ public:
+  // Returns the arena of the library. It is never destroyed.
+  static FrameArena& GetInstance();
+
+  // Returns a block of at least |min_size| bytes and stores its size in
+  // |size|, or returns null if it could not be allocated. Reuses the smallest
+  // idle block that is large enough, unless more than half of it would be
+  // wasted.
+  uint8_t* Lease(size_t min_size, size_t* size);
+
+  // Takes back a block of |size| bytes returned by Lease(). Does nothing if
+  // |block| is null.
+  void Return(uint8_t* block, size_t size);
+
+  // Frees a block returned by Lease() instead of keeping it idle, for callers
+  // that are shedding memory. Does nothing if |block| is null.
+  static void Free(uint8_t* block);
+
+  // Sets the maximum number of idle bytes held, freeing the blocks that no
+  // longer fit. 0 frees every idle block, and makes Return() free blocks
+  // immediately.
+  void SetCapacity(size_t capacity_bytes);
+
+  // Returns the number of idle bytes held.
+  size_t idle_bytes() const;
+
+ private:
+  struct Block {
+    uint8_t* data;
+    size_t size;
+  };
+
+  FrameArena() = default;
+
+  // Frees the least recently returned blocks until the idle ones fit the
+  // capacity. |mutex_| must be held.
+  void TrimLocked();
+
+  mutable std::mutex mutex_;
+  // Least recently returned first.
+  std::deque<Block> idle_blocks_;
+  size_t idle_bytes_ = 0;
+  size_t capacity_bytes_ = kDefaultFrameArenaCapacity;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_FRAME_ARENA_H_
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "frame_cache.h"  // NOLINT
+
+#include <algorithm>
+#include <cstring>
+
+namespace exoplayer_jni {
+namespace {
+
+int DownscaledSize(int size, int factor) {
+  return (size + factor - 1) / factor;
+}
+
+// Copies the |width| x |height| plane at |source| to |destination| without
+// padding, averaging each |factor| x |factor| block of pixels into one. Blocks
+// that cross the right or bottom edge repeat its last pixels.
+void CopyPlane(const uint8_t* source, int stride, int width, int height,
+               int factor, uint8_t* destination) {
+  if (factor == 1) {
+    for (int y = 0; y < height; ++y) {
+      std::memcpy(destination, source, width);
+      source += stride;
+      destination += width;
+    }
+    return;
+  }
+  const int output_width = DownscaledSize(width, factor);
+  const int output_height = DownscaledSize(height, factor);
+  const int area = factor * factor;
+  for (int y = 0; y < output_height; ++y) {
+    for (int x = 0; x < output_width; ++x) {
+      int sum = 0;
+      for (int dy = 0; dy < factor; ++dy) {
+        const uint8_t* const row =
+            source + std::min(y * factor + dy, height - 1) * stride;
+        for (int dx = 0; dx < factor; ++dx) {
+          sum += row[std::min(x * factor + dx, width - 1)];
+        }
+      }
+      *destination++ = static_cast<uint8_t>((sum + area / 2) / area);
+    }
+  }
+}
+
+}  // namespace
+
+size_t FrameCache::FrameSize(int width, int height) {
+  const size_t uv_size = static_cast<size_t>((width + 1) / 2) *
+                         static_cast<size_t>((height + 1) / 2);
+  return static_cast<size_t>(width) * height + 2 * uv_size;
+}
+
+void FrameCache::Configure(size_t budget_bytes, int downscale_factor) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (downscale_factor != downscale_factor_) {
+    downscale_factor_ = downscale_factor;
+    entries_.clear();
+    size_bytes_ = 0;
+    ++generation_;
+  }
+  budget_bytes_ = budget_bytes;
+  EvictLocked(/*extra_bytes=*/0);
+  if (budget_bytes == 0) {
+    spare_ = std::vector<uint8_t>();
+  }
+  enabled_.store(budget_bytes > 0, std::memory_order_relaxed);
+}
+
+void FrameCache::Put(int64_t time_us, int width, int height, int colorspace,
+                     const uint8_t* const planes[3], const int strides[3]) {
+  std::vector<uint8_t> data;
+  int downscale_factor;
+  int generation;
+  int output_width;
+  int output_height;
+  size_t frame_size;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    downscale_factor = downscale_factor_;
+    output_width = DownscaledSize(width, downscale_factor);
+    output_height = DownscaledSize(height, downscale_factor);
+    frame_size = FrameSize(output_width, output_height);
+    if (frame_size > budget_bytes_) return;
+    generation = generation_;
+    data.swap(spare_);
+  }
+
+  // Copy the frame without blocking readers.
+  data.resize(frame_size);
+  uint8_t* destination = data.data();
+  for (int plane = 0; plane < 3; ++plane) {
+    const int plane_width = (plane == 0) ? width : (width + 1) / 2;
+    const int plane_height = (plane == 0) ? height : (height + 1) / 2;
+    CopyPlane(planes[plane], strides[plane], plane_width, plane_height,
+              downscale_factor, destination);
+    destination += static_cast<size_t>(DownscaledSize(plane_width,
+                                                      downscale_factor)) *
+                   DownscaledSize(plane_height, downscale_factor);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (generation != generation_ || frame_size > budget_bytes_) return;
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->info.time_us == time_us) {
+      size_bytes_ -= it->data.size();
+      entries_.erase(it);
+      break;
+    }
+  }
+  EvictLocked(frame_size);
+  entries_.push_back(
+      {{time_us, output_width, output_height, colorspace}, std::move(data)});
+  size_bytes_ += frame_size;
+}
+
+bool FrameCache::Read(
+    int64_t time_us, int64_t tolerance_us,
+    const std::function<uint8_t*(const CachedFrameInfo&)>& allocate) {
+  CachedFrameInfo info;
+  std::vector<uint8_t> data;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto best = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      const int64_t frame_time_us = it->info.time_us;
+      if (frame_time_us <= time_us &&
+          time_us - frame_time_us <= tolerance_us &&
+          (best == entries_.end() || frame_time_us > best->info.time_us)) {
+        best = it;
+      }
+    }
+    if (best == entries_.end()) {
+      ++miss_count_;
+      return false;
+    }
+    ++hit_count_;
+    entries_.splice(entries_.end(), entries_, best);
+    // Copy the frame out, as it may be evicted once the lock is released.
+    info = best->info;
+    data = best->data;
+  }
+  uint8_t* const destination = allocate(info);
+  if (destination == nullptr) return false;
+  std::memcpy(destination, data.data(), data.size());
+  return true;
+}
+
+void FrameCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  size_bytes_ = 0;
+  ++generation_;
+}
+
+void FrameCache::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  enabled_.store(false, std::memory_order_relaxed);
+  budget_bytes_ = 0;
+  downscale_factor_ = 1;
+  entries_.clear();
+  spare_ = std::vector<uint8_t>();
+  size_bytes_ = 0;
+  ++generation_;
+  hit_count_ = 0;
+  miss_count_ = 0;
+}
+
+int64_t FrameCache::hit_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hit_count_;
+}
+
+int64_t FrameCache::miss_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return miss_count_;
+}
+
+void FrameCache::EvictLocked(size_t extra_bytes) {
+  while (!entries_.empty() && size_bytes_ + extra_bytes > budget_bytes_) {
+    size_bytes_ -= entries_.front().data.size();
+    spare_ = std::move(entries_.front().data);
+    entries_.pop_front();
+  }
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_FRAME_CACHE_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_FRAME_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>  // NOLINT
+#include <vector>
+
+namespace exoplayer_jni {
+
+// Describes a frame held by a FrameCache. Its Y, U and V planes are stored one
+// after the other without padding, the chroma planes being subsampled by 2 in
+// both directions.
+struct CachedFrameInfo {
+  int64_t time_us;
+  int width;
+  int height;
+  // One of the kColorSpace constants of the decoder.
+  int colorspace;
+};
+
+// Memory budgeted cache of recently output 8-bit 4:2:0 frames, keyed by
+// presentation time, that serves short backward seeks and seek previews
+// without decoding. Frames are optionally downscaled as they are stored. The
+// least recently stored or read frames are evicted first. Thread-safe.
+class FrameCache {
+ public:
+  // Returns the number of bytes held by a frame of |width| x |height|.
+  static size_t FrameSize(int width, int height);
+
+  // Sets the number of bytes of frames the cache may hold, 0 to disable it,
+  // and the factor by which frames are downscaled, 1, 2 or 4. Drops the frames
+  // that no longer fit, and all of them if |downscale_factor| changes.
+  void Configure(size_t budget_bytes, int downscale_factor);
+
+  // Returns whether Put() stores frames. May be called without locking.
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // Stores a copy of a frame of |width| x |height|, given by its Y, U and V
+  // |planes| and |strides|, replacing any frame with the same |time_us|. Does
+  // nothing if the cache is disabled or the frame does not fit its budget.
+  // The copy is one more pass over every output frame on the calling thread,
+  // of a quarter or a sixteenth of it when downscaling by 2 or 4, which is why
+  // callers only make it while enabled() is true.
+  void Put(int64_t time_us, int width, int height, int colorspace,
+           const uint8_t* const planes[3], const int strides[3]);
+
+  // Looks up the latest frame whose time is in
+  // [|time_us| - |tolerance_us|, |time_us|]. If there is one, calls |allocate|
+  // with its description, copies the frame to the FrameSize() bytes returned
+  // and returns true. Returns false if there is no such frame or |allocate|
+  // returns null. Counts a hit or a miss. |allocate| is called without the
+  // lock held, so it may call back into Java.
+  bool Read(int64_t time_us, int64_t tolerance_us,
+            const std::function<uint8_t*(const CachedFrameInfo&)>& allocate);
+
+  // Drops the frames, keeping the configuration and the counts.
+  void Clear();
+
+  // Disables the cache, drops the frames and zeroes the counts.
+  void Reset();
+
+  int64_t hit_count() const;
+  int64_t miss_count() const;
+
+ private:
+  struct Entry {
+    CachedFrameInfo info;
+    std::vector<uint8_t> data;
+  };
+
+  // Evicts the least recently used frames until |size_bytes_| + |extra_bytes|
+  // fits the budget. |mutex_| must be held.
+  void EvictLocked(size_t extra_bytes);
+
+  mutable std::mutex mutex_;
+  std::atomic<bool> enabled_{false};
+  size_t budget_bytes_ = 0;
+  int downscale_factor_ = 1;
+  // Incremented whenever stored frames are invalidated, so that a Put() that
+  // copied a frame without holding |mutex_| can detect it.
+  int generation_ = 0;
+  size_t size_bytes_ = 0;
+  // Most recently used last.
+  std::list<Entry> entries_;
+  // Storage of the last evicted frame, reused by the next Put().
+  std::vector<uint8_t> spare_;
+  int64_t hit_count_ = 0;
+  int64_t miss_count_ = 0;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_FRAME_CACHE_H_
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "jni_log.h"  // NOLINT
+
+#include <android/log.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace exoplayer_jni {
+namespace {
+
+// Each call site logs at most kLogRateLimit messages per kLogRateWindowMs.
+constexpr int64_t kLogRateWindowMs = 1000;
+constexpr int kLogRateLimit = 5;
+
+struct LogRingEntry {
+  // 0 while the entry is being written, otherwise the ticket of the message it
+  // holds plus one. Readers use it to skip entries that are torn by a
+  // concurrent write.
+  std::atomic<uint32_t> sequence;
+  int64_t time_ms;
+  int level;
+  const char* tag;
+  char message[kLogMessageSize];
+};
+
+LogRingEntry g_log_ring[kLogRingSize];
+std::atomic<uint32_t> g_log_ring_next(0);
+std::atomic<bool> g_log_ring_enabled(false);
+
+int64_t GetMonotonicTimeMs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+char GetLevelChar(int level) {
+  switch (level) {
+    case ANDROID_LOG_VERBOSE:
+      return 'V';
+    case ANDROID_LOG_DEBUG:
+      return 'D';
+    case ANDROID_LOG_INFO:
+      return 'I';
+    case ANDROID_LOG_WARN:
+      return 'W';
+    case ANDROID_LOG_ERROR:
+      return 'E';
+    default:
+      return 'F';
+  }
+}
+
+// Claims the next entry of the ring without locking. Writers that wrap around
+// onto an entry that is still being written leave it torn, and readers skip
+// it.
+void WriteToRing(int level, const char* tag, const char* message) {
+  const uint32_t ticket =
+      g_log_ring_next.fetch_add(1, std::memory_order_relaxed);
+  LogRingEntry& entry = g_log_ring[ticket % kLogRingSize];
+  entry.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  entry.time_ms = GetMonotonicTimeMs();
+  entry.level = level;
+  entry.tag = tag;
+  std::strncpy(entry.message, message, kLogMessageSize - 1);
+  entry.message[kLogMessageSize - 1] = '\0';
+  entry.sequence.store(ticket + 1, std::memory_order_release);
+}
+
+}  // namespace
+
+std::atomic<int> g_log_level(ANDROID_LOG_WARN);
+
+bool LogRateLimiter::Acquire(int* suppressed) {
+  *suppressed = 0;
+  const int64_t now_ms = GetMonotonicTimeMs();
+  int64_t window_start_ms = window_start_ms_.load(std::memory_order_relaxed);
+  if (now_ms - window_start_ms >= kLogRateWindowMs &&
+      window_start_ms_.compare_exchange_strong(window_start_ms, now_ms,
+                                               std::memory_order_relaxed)) {
+    count_.store(0, std::memory_order_relaxed);
+    *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+  }
+  if (count_.fetch_add(1, std::memory_order_relaxed) < kLogRateLimit) {
+    return true;
+  }
+  suppressed_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void SetLogLevel(int level) {
+  g_log_level.store(level, std::memory_order_relaxed);
+}
+
+void SetLogRingEnabled(bool enabled) {
+  g_log_ring_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int DumpLogRing(char* output, int capacity) {
+  if (capacity <= 0) {
+    return 0;
+  }
+  output[0] = '\0';
+  const uint32_t next = g_log_ring_next.load(std::memory_order_acquire);
+  const uint32_t count = next < static_cast<uint32_t>(kLogRingSize)
+                             ? next
+                             : static_cast<uint32_t>(kLogRingSize);
+  int length = 0;
+  for (uint32_t ticket = next - count; ticket != next; ticket++) {
+    const LogRingEntry& entry = g_log_ring[ticket % kLogRingSize];
+    if (entry.sequence.load(std::memory_order_acquire) != ticket + 1) {
+      continue;
+    }
+    const int64_t time_ms = entry.time_ms;
+    const int level = entry.level;
+    const char* const tag = entry.tag;
+    char message[kLogMessageSize];
+    std::memcpy(message, entry.message, kLogMessageSize);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.sequence.load(std::memory_order_relaxed) != ticket + 1) {
+      continue;
+    }
+    message[kLogMessageSize - 1] = '\0';
+    const int written =
+        snprintf(output + length, capacity - length, "%lld %c/%s: %s\n",
+                 static_cast<long long>(time_ms),  // NOLINT
+                 GetLevelChar(level), tag, message);
+    if (written < 0 || written >= capacity - length) {
+      // Drop the partially written line.
+      output[length] = '\0';
+      break;
+    }
+    length += written;
+  }
+  return length;
+}
+
+void LogWrite(int level, const char* tag, LogRateLimiter* limiter,
+              const char* format, ...) {
+  int suppressed = 0;
+  if (level < ANDROID_LOG_ERROR && !limiter->Acquire(&suppressed)) {
+    return;
+  }
+  char message[kLogMessageSize];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(message, kLogMessageSize, format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  if (suppressed > 0 && length < kLogMessageSize) {
+    snprintf(message + length, kLogMessageSize - length,
+             " (%d similar messages suppressed)", suppressed);
+  }
+  const bool write_to_ring =
+      g_log_ring_enabled.load(std::memory_order_relaxed);
+  if (write_to_ring) {
+    WriteToRing(level, tag, message);
+  }
+  if (!write_to_ring || level >= ANDROID_LOG_ERROR) {
+    __android_log_write(level, tag, message);
+  }
+}
+
+}  // namespace exoplayer_jni
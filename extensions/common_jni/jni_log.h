@@ -0,0 +1,108 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_JNI_LOG_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_JNI_LOG_H_
+
+#include <android/log.h>
+
+#include <atomic>
+#include <cstdint>
+
+// Messages below this android_LogPriority are compiled out. Release builds
+// drop debug and verbose messages unless the build overrides this.
+#ifndef JNI_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define JNI_LOG_MIN_LEVEL ANDROID_LOG_INFO
+#else
+#define JNI_LOG_MIN_LEVEL ANDROID_LOG_VERBOSE
+#endif
+#endif
+
+namespace exoplayer_jni {
+
+// Longer messages are truncated.
+constexpr int kLogMessageSize = 256;
+// Number of messages held in the ring. Older messages are overwritten.
+constexpr int kLogRingSize = 256;
+// Size of a buffer that is large enough for DumpLogRing() to write every
+// message held in the ring, including the time, level and tag of each.
+constexpr int kLogRingDumpSize = kLogRingSize * (kLogMessageSize + 48);
+
+// Limits how often a single call site logs. Each call site owns one instance,
+// so a message repeated for every frame cannot flood the log. Errors are not
+// limited, so that none is lost.
+class LogRateLimiter {
+ public:
+  constexpr LogRateLimiter() : window_start_ms_(0), count_(0), suppressed_(0) {}
+
+  // Returns whether a message may be logged now. When a new window starts,
+  // |*suppressed| is set to the number of messages dropped in the previous
+  // one, and to 0 otherwise.
+  bool Acquire(int* suppressed);
+
+ private:
+  std::atomic<int64_t> window_start_ms_;
+  std::atomic<int> count_;
+  std::atomic<int> suppressed_;
+};
+
+// The minimum android_LogPriority of messages that are logged. Messages below
+// it cost a single relaxed atomic load.
+extern std::atomic<int> g_log_level;
+
+inline bool IsLoggable(int level) {
+  return level >= g_log_level.load(std::memory_order_relaxed);
+}
+
+// Sets the minimum android_LogPriority of messages that are logged.
+void SetLogLevel(int level);
+
+// Sets whether messages are written to an in-memory ring of recent messages
+// instead of logcat. Errors are written to logcat in either case.
+void SetLogRingEnabled(bool enabled);
+
+// Writes the messages held in the ring, oldest first and one per line, to
+// |output| as a null terminated string of at most |capacity| bytes. Returns the
+// number of bytes written, excluding the terminator.
+int DumpLogRing(char* output, int capacity);
+
+// Formats a message and writes it to logcat or to the ring, unless |limiter|
+// drops it. Messages of level ANDROID_LOG_ERROR and above bypass |limiter|.
+// Use the JNI_LOG macros, which skip formatting when the message is not
+// logged.
+void LogWrite(int level, const char* tag, LogRateLimiter* limiter,
+              const char* format, ...) __attribute__((format(printf, 4, 5)));
+
+}  // namespace exoplayer_jni
+
+// Logs a printf style message with the given android_LogPriority and the
+// LOG_TAG of the including file.
+#define JNI_LOG(level, ...)                                                   \
+  do {                                                                        \
+    if ((level) >= JNI_LOG_MIN_LEVEL && ::exoplayer_jni::IsLoggable(level)) { \
+      static ::exoplayer_jni::LogRateLimiter jni_log_limiter;                 \
+      ::exoplayer_jni::LogWrite((level), LOG_TAG, &jni_log_limiter,           \
+                                __VA_ARGS__);                                 \
+    }                                                                         \
+  } while (0)
+
+#define LOGE(...) JNI_LOG(ANDROID_LOG_ERROR, __VA_ARGS__)
+#define LOGW(...) JNI_LOG(ANDROID_LOG_WARN, __VA_ARGS__)
+#define LOGI(...) JNI_LOG(ANDROID_LOG_INFO, __VA_ARGS__)
+#define LOGD(...) JNI_LOG(ANDROID_LOG_DEBUG, __VA_ARGS__)
+#define LOGV(...) JNI_LOG(ANDROID_LOG_VERBOSE, __VA_ARGS__)
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_JNI_LOG_H_
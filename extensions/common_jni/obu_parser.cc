@@ -0,0 +1,391 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "obu_parser.h"  // NOLINT
+
+#include <algorithm>
+
+namespace exoplayer_jni {
+namespace {
+
+// OBU types, from section 6.2.2 of the AV1 specification.
+const int kObuSequenceHeader = 1;
+const int kObuFrameHeader = 3;
+const int kObuFrame = 6;
+
+// Frame types, from section 6.8.2 of the AV1 specification.
+const int kFrameKey = 0;
+const int kFrameIntraOnly = 2;
+const int kFrameSwitch = 3;
+
+// Value of seq_force_screen_content_tools and seq_force_integer_mv when it is
+// signaled in each frame header.
+const int kSelect = 2;
+
+const int kAllFrames = 0xFF;
+
+// Layout of the packed representation, which must match TemporalUnitInfo.java.
+const int kFlagKeyFrame = 1;
+const int kFlagIntraOnly = 1 << 1;
+const int kFlagShowExistingFrame = 1 << 2;
+const int kFlagReference = 1 << 3;
+const int kShownFrameCountShift = 8;
+const int kHiddenFrameCountShift = 16;
+const int kSpatialLayerCountShift = 24;
+const int kCountMask = 0xFF;
+
+bool IsIntraFrame(int frame_type) {
+  return frame_type == kFrameKey || frame_type == kFrameIntraOnly;
+}
+
+// Reads a leb128 value, from section 4.10.5 of the AV1 specification. Returns
+// the number of bytes read, or 0 if the value is malformed or truncated.
+size_t ReadLeb128(const uint8_t* data, size_t size, uint64_t* value) {
+  *value = 0;
+  for (size_t i = 0; i < 8 && i < size; i++) {
+    *value |= static_cast<uint64_t>(data[i] & 0x7F) << (i * 7);
+    if ((data[i] & 0x80) == 0) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+// Reads the bits of an OBU payload, most significant first. Reads past the end
+// return zeros and mark the reader as overrun.
+class ObuParser::BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), bit_offset_(0), overrun_(false) {}
+
+  uint32_t ReadBits(int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++) {
+      value = (value << 1) | ReadBit();
+    }
+    return value;
+  }
+
+  uint32_t ReadBit() {
+    const size_t byte_offset = bit_offset_ >> 3;
+    if (byte_offset >= size_) {
+      overrun_ = true;
+      return 0;
+    }
+    const uint32_t bit = (data_[byte_offset] >> (7 - (bit_offset_ & 7))) & 1;
+    bit_offset_++;
+    return bit;
+  }
+
+  // Reads a uvlc() value, from section 4.10.3 of the AV1 specification.
+  uint32_t ReadUvlc() {
+    int leading_zeros = 0;
+    while (ReadBit() == 0) {
+      if (overrun_) {
+        return 0;
+      }
+      leading_zeros++;
+    }
+    if (leading_zeros >= 32) {
+      return UINT32_MAX;
+    }
+    return ReadBits(leading_zeros) + ((1u << leading_zeros) - 1);
+  }
+
+  bool overrun() const { return overrun_; }
+
+ private:
+  const uint8_t* const data_;
+  const size_t size_;
+  size_t bit_offset_;
+  bool overrun_;
+};
+
+int PackTemporalUnitInfo(const TemporalUnitInfo& info) {
+  int packed = 0;
+  if (info.key_frame) packed |= kFlagKeyFrame;
+  if (info.intra_only) packed |= kFlagIntraOnly;
+  if (info.show_existing_frame) packed |= kFlagShowExistingFrame;
+  if (info.reference) packed |= kFlagReference;
+  packed |= std::min(info.shown_frame_count, kCountMask)
+            << kShownFrameCountShift;
+  packed |= std::min(info.hidden_frame_count, kCountMask)
+            << kHiddenFrameCountShift;
+  packed |= std::min(info.spatial_layer_count, kCountMask / 2)
+            << kSpatialLayerCountShift;
+  return packed;
+}
+
+void ObuParser::Reset() {
+  has_sequence_header_ = false;
+  std::fill(ref_frame_type_, ref_frame_type_ + kNumRefFrames, kFrameKey);
+}
+
+bool ObuParser::ParseTemporalUnit(const uint8_t* data, size_t size,
+                                  TemporalUnitInfo* info) {
+  *info = TemporalUnitInfo();
+  info->intra_only = true;
+  size_t offset = 0;
+  while (offset < size) {
+    // obu_header(), from section 5.3.2 of the AV1 specification.
+    const uint8_t header = data[offset];
+    if ((header & 0x80) != 0) {
+      return false;
+    }
+    const int obu_type = (header >> 3) & 0xF;
+    const bool has_extension = (header & 0x04) != 0;
+    const bool has_size_field = (header & 0x02) != 0;
+    size_t header_size = 1;
+    int temporal_id = 0;
+    int spatial_id = 0;
+    if (has_extension) {
+      if (offset + 1 >= size) {
+        return false;
+      }
+      temporal_id = data[offset + 1] >> 5;
+      spatial_id = (data[offset + 1] >> 3) & 3;
+      header_size++;
+    }
+    uint64_t payload_size = size - offset - header_size;
+    if (has_size_field) {
+      const size_t leb128_size = ReadLeb128(
+          data + offset + header_size, size - offset - header_size,
+          &payload_size);
+      if (leb128_size == 0) {
+        return false;
+      }
+      header_size += leb128_size;
+    }
+    if (offset + header_size > size ||
+        payload_size > size - offset - header_size) {
+      return false;
+    }
+    BitReader reader(data + offset + header_size,
+                     static_cast<size_t>(payload_size));
+    if (obu_type == kObuSequenceHeader) {
+      if (!ParseSequenceHeader(&reader)) {
+        return false;
+      }
+    } else if (obu_type == kObuFrameHeader || obu_type == kObuFrame) {
+      if (!has_sequence_header_ ||
+          !ParseFrameHeader(&reader, temporal_id, spatial_id, info)) {
+        return false;
+      }
+      info->spatial_layer_count =
+          std::max(info->spatial_layer_count, spatial_id + 1);
+    }
+    offset += header_size + static_cast<size_t>(payload_size);
+  }
+  if (info->shown_frame_count + info->hidden_frame_count == 0) {
+    info->intra_only = false;
+  }
+  return true;
+}
+
+// sequence_header_obu(), from section 5.5.1 of the AV1 specification, up to
+// the fields that frame headers depend on.
+bool ObuParser::ParseSequenceHeader(BitReader* reader) {
+  SequenceHeader header = {};
+  reader->ReadBits(3);  // seq_profile
+  reader->ReadBit();    // still_picture
+  header.reduced_still_picture_header = reader->ReadBit();
+  if (header.reduced_still_picture_header) {
+    header.operating_point_count = 1;
+    reader->ReadBits(5);  // seq_level_idx[0]
+  } else {
+    const bool timing_info_present = reader->ReadBit();
+    if (timing_info_present) {
+      reader->ReadBits(32);  // num_units_in_display_tick
+      reader->ReadBits(32);  // time_scale
+      header.equal_picture_interval = reader->ReadBit();
+      if (header.equal_picture_interval) {
+        reader->ReadUvlc();  // num_ticks_per_picture_minus_1
+      }
+      header.decoder_model_info_present = reader->ReadBit();
+    }
+    int buffer_delay_length = 0;
+    if (header.decoder_model_info_present) {
+      buffer_delay_length = reader->ReadBits(5) + 1;
+      reader->ReadBits(32);  // num_units_in_decoding_tick
+      header.buffer_removal_time_length = reader->ReadBits(5) + 1;
+      header.frame_presentation_time_length = reader->ReadBits(5) + 1;
+    }
+    const bool initial_display_delay_present = reader->ReadBit();
+    header.operating_point_count = reader->ReadBits(5) + 1;
+    for (int i = 0; i < header.operating_point_count; i++) {
+      header.operating_point_idc[i] = reader->ReadBits(12);
+      const int seq_level_idx = reader->ReadBits(5);
+      if (seq_level_idx > 7) {
+        reader->ReadBit();  // seq_tier
+      }
+      if (header.decoder_model_info_present) {
+        header.decoder_model_present_for_op[i] = reader->ReadBit();
+        if (header.decoder_model_present_for_op[i]) {
+          reader->ReadBits(buffer_delay_length);  // decoder_buffer_delay
+          reader->ReadBits(buffer_delay_length);  // encoder_buffer_delay
+          reader->ReadBit();                      // low_delay_mode_flag
+        }
+      }
+      if (initial_display_delay_present && reader->ReadBit()) {
+        reader->ReadBits(4);  // initial_display_delay_minus_1
+      }
+    }
+  }
+  const int frame_width_bits = reader->ReadBits(4) + 1;
+  const int frame_height_bits = reader->ReadBits(4) + 1;
+  reader->ReadBits(frame_width_bits);   // max_frame_width_minus_1
+  reader->ReadBits(frame_height_bits);  // max_frame_height_minus_1
+  if (!header.reduced_still_picture_header) {
+    header.frame_id_numbers_present = reader->ReadBit();
+  }
+  if (header.frame_id_numbers_present) {
+    const int delta_frame_id_length = reader->ReadBits(4) + 2;
+    header.frame_id_length = delta_frame_id_length + reader->ReadBits(3) + 1;
+  }
+  reader->ReadBit();  // use_128x128_superblock
+  reader->ReadBit();  // enable_filter_intra
+  reader->ReadBit();  // enable_intra_edge_filter
+  header.force_screen_content_tools = kSelect;
+  header.force_integer_mv = kSelect;
+  if (!header.reduced_still_picture_header) {
+    reader->ReadBit();  // enable_interintra_compound
+    reader->ReadBit();  // enable_masked_compound
+    reader->ReadBit();  // enable_warped_motion
+    reader->ReadBit();  // enable_dual_filter
+    const bool enable_order_hint = reader->ReadBit();
+    if (enable_order_hint) {
+      reader->ReadBit();  // enable_jnt_comp
+      reader->ReadBit();  // enable_ref_frame_mvs
+    }
+    if (!reader->ReadBit()) {  // seq_choose_screen_content_tools
+      header.force_screen_content_tools = reader->ReadBit();
+    }
+    if (header.force_screen_content_tools > 0 &&
+        !reader->ReadBit()) {  // seq_choose_integer_mv
+      header.force_integer_mv = reader->ReadBit();
+    }
+    if (enable_order_hint) {
+      header.order_hint_bits = reader->ReadBits(3) + 1;
+    }
+  }
+  if (reader->overrun()) {
+    return false;
+  }
+  sequence_header_ = header;
+  has_sequence_header_ = true;
+  return true;
+}
+
+// uncompressed_header(), from section 5.9.2 of the AV1 specification, up to
+// refresh_frame_flags.
+bool ObuParser::ParseFrameHeader(BitReader* reader, int temporal_id,
+                                 int spatial_id, TemporalUnitInfo* info) {
+  const SequenceHeader& sequence = sequence_header_;
+  int frame_type = kFrameKey;
+  bool show_frame = true;
+  bool error_resilient_mode = true;
+  if (!sequence.reduced_still_picture_header) {
+    const bool show_existing_frame = reader->ReadBit();
+    if (show_existing_frame) {
+      const int frame_to_show = reader->ReadBits(3);
+      if (reader->overrun()) {
+        return false;
+      }
+      // Showing a key frame refreshes every reference frame slot with it.
+      frame_type = ref_frame_type_[frame_to_show];
+      info->show_existing_frame = true;
+      info->shown_frame_count++;
+      info->intra_only &= IsIntraFrame(frame_type);
+      if (frame_type == kFrameKey) {
+        info->key_frame = true;
+        info->reference = true;
+        std::fill(ref_frame_type_, ref_frame_type_ + kNumRefFrames, kFrameKey);
+      }
+      return true;
+    }
+    frame_type = reader->ReadBits(2);
+    show_frame = reader->ReadBit();
+    if (show_frame && sequence.decoder_model_info_present &&
+        !sequence.equal_picture_interval) {
+      // frame_presentation_time
+      reader->ReadBits(sequence.frame_presentation_time_length);
+    }
+    if (!show_frame) {
+      reader->ReadBit();  // showable_frame
+    }
+    if (frame_type != kFrameSwitch && !(frame_type == kFrameKey && show_frame)) {
+      error_resilient_mode = reader->ReadBit();
+    }
+  }
+  reader->ReadBit();  // disable_cdf_update
+  int allow_screen_content_tools = sequence.force_screen_content_tools;
+  if (allow_screen_content_tools == kSelect) {
+    allow_screen_content_tools = reader->ReadBit();
+  }
+  if (allow_screen_content_tools > 0 && sequence.force_integer_mv == kSelect) {
+    reader->ReadBit();  // force_integer_mv
+  }
+  if (sequence.frame_id_numbers_present) {
+    reader->ReadBits(sequence.frame_id_length);  // current_frame_id
+  }
+  if (frame_type != kFrameSwitch && !sequence.reduced_still_picture_header) {
+    reader->ReadBit();  // frame_size_override_flag
+  }
+  reader->ReadBits(sequence.order_hint_bits);  // order_hint
+  if (!IsIntraFrame(frame_type) && !error_resilient_mode) {
+    reader->ReadBits(3);  // primary_ref_frame
+  }
+  if (sequence.decoder_model_info_present &&
+      reader->ReadBit()) {  // buffer_removal_time_present_flag
+    for (int i = 0; i < sequence.operating_point_count; i++) {
+      if (!sequence.decoder_model_present_for_op[i]) {
+        continue;
+      }
+      const int idc = sequence.operating_point_idc[i];
+      const bool in_temporal_layer = (idc >> temporal_id) & 1;
+      const bool in_spatial_layer = (idc >> (spatial_id + 8)) & 1;
+      if (idc == 0 || (in_temporal_layer && in_spatial_layer)) {
+        // buffer_removal_time
+        reader->ReadBits(sequence.buffer_removal_time_length);
+      }
+    }
+  }
+  int refresh_frame_flags = kAllFrames;
+  if (frame_type != kFrameSwitch && !(frame_type == kFrameKey && show_frame)) {
+    refresh_frame_flags = reader->ReadBits(8);
+  }
+  if (reader->overrun()) {
+    return false;
+  }
+
+  for (int i = 0; i < kNumRefFrames; i++) {
+    if ((refresh_frame_flags >> i) & 1) {
+      ref_frame_type_[i] = frame_type;
+    }
+  }
+  info->key_frame |= frame_type == kFrameKey && show_frame;
+  info->intra_only &= IsIntraFrame(frame_type);
+  info->reference |= refresh_frame_flags != 0;
+  if (show_frame) {
+    info->shown_frame_count++;
+  } else {
+    info->hidden_frame_count++;
+  }
+  return true;
+}
+
+}  // namespace exoplayer_jni
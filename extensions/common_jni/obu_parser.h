@@ -0,0 +1,101 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_OBU_PARSER_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_OBU_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Packed value that stands for a temporal unit that could not be parsed.
+constexpr int kTemporalUnitUnknown = -1;
+
+// Describes the frames in an AV1 temporal unit.
+struct TemporalUnitInfo {
+  // Whether the temporal unit shows a key frame, either as it is decoded or
+  // with show_existing_frame. Key frames that are decoded without being shown
+  // do not count, as the frames that follow them until they are shown may
+  // still refer to earlier frames.
+  bool key_frame = false;
+  // Whether every frame is intra coded, or shows an intra coded frame that was
+  // decoded earlier. False if the temporal unit contains no frames.
+  bool intra_only = false;
+  // Whether the temporal unit shows a frame that was decoded earlier.
+  bool show_existing_frame = false;
+  // Whether any frame refreshes a reference frame slot.
+  bool reference = false;
+  int shown_frame_count = 0;
+  int hidden_frame_count = 0;
+  // One more than the highest spatial_id of a frame, or 0 without frames.
+  int spatial_layer_count = 0;
+};
+
+// Packs |info| into the int read by TemporalUnitInfo.fromPackedInfo() in Java.
+int PackTemporalUnitInfo(const TemporalUnitInfo& info);
+
+// Classifies AV1 temporal units in the low overhead bitstream format by
+// parsing their OBU headers, sequence headers and the start of their frame
+// headers, without decoding them. Keeps the state that frame headers depend
+// on, so temporal units must be parsed in decode order.
+class ObuParser {
+ public:
+  ObuParser() { Reset(); }
+
+  // Forgets the sequence header and the reference frame types.
+  void Reset();
+
+  // Parses the temporal unit of |size| bytes at |data| into |info|. Returns
+  // false if it is malformed, or if it has frames but no sequence header has
+  // been parsed yet.
+  bool ParseTemporalUnit(const uint8_t* data, size_t size,
+                         TemporalUnitInfo* info);
+
+ private:
+  class BitReader;
+
+  static constexpr int kMaxOperatingPoints = 32;
+  static constexpr int kNumRefFrames = 8;
+
+  struct SequenceHeader {
+    bool reduced_still_picture_header;
+    bool decoder_model_info_present;
+    bool equal_picture_interval;
+    int buffer_removal_time_length;
+    int frame_presentation_time_length;
+    int operating_point_count;
+    int operating_point_idc[kMaxOperatingPoints];
+    bool decoder_model_present_for_op[kMaxOperatingPoints];
+    bool frame_id_numbers_present;
+    int frame_id_length;
+    int force_screen_content_tools;
+    int force_integer_mv;
+    int order_hint_bits;
+  };
+
+  bool ParseSequenceHeader(BitReader* reader);
+  bool ParseFrameHeader(BitReader* reader, int temporal_id, int spatial_id,
+                        TemporalUnitInfo* info);
+
+  bool has_sequence_header_;
+  SequenceHeader sequence_header_;
+  // The frame_type of the frame held in each reference frame slot.
+  int ref_frame_type_[kNumRefFrames];
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_OBU_PARSER_H_
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "row_convert.h"  // NOLINT
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif  // defined(__i386__) || defined(__x86_64__)
+
+#include <algorithm>
+#include <vector>
+
+#include "worker_pool.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+// Number of rows in each band of a plane converted in parallel.
+constexpr int kBandRows = 128;
+
+// Converts rows [|first_row|, |last_row|) of |plane|, carrying |sample| into
+// the first of them.
+void ConvertPlaneRows(const PlaneTo8Bit& plane, int first_row, int last_row,
+                      int sample, RowTo8BitConverter convert_row) {
+  const uint8_t* source = plane.source + first_row * plane.source_stride;
+  uint8_t* destination =
+      plane.destination + first_row * plane.destination_stride;
+  for (int i = first_row; i < last_row; i++) {
+    convert_row(reinterpret_cast<const uint16_t*>(source), destination,
+                plane.width, &sample);
+    source += plane.source_stride;
+    destination += plane.destination_stride;
+  }
+}
+
+// Returns the sum of the samples of rows [|first_row|, |last_row|) of |plane|
+// modulo 4, which is the change in the remainder that converting them carries.
+// The unsigned sum may wrap, as 4 divides its modulus.
+int SumPlaneRowsModulo4(const PlaneTo8Bit& plane, int first_row,
+                        int last_row) {
+  uint32_t sum = 0;
+  const uint8_t* source = plane.source + first_row * plane.source_stride;
+  for (int i = first_row; i < last_row; i++) {
+    const uint16_t* const samples = reinterpret_cast<const uint16_t*>(source);
+    for (int j = 0; j < plane.width; j++) sum += samples[j];
+    source += plane.source_stride;
+  }
+  return static_cast<int>(sum & 3);
+}
+
+}  // namespace
+
+void ConvertRowTo8Bit(const uint16_t* source, uint8_t* destination, int width,
+                      int* sample) {
+  int remainder = *sample;
+  for (int j = 0; j < width; j++) {
+    remainder += source[j];
+    destination[j] = remainder >> 2;
+    remainder &= 3;
+  }
+  *sample = remainder;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+namespace {
+
+// Converts eight samples to 8 bits using the same lightweight dither as
+// ConvertRowTo8Bit(), so that the output is bit-exact with it. The remainder
+// carried into each sample is the running sum of the preceding samples modulo
+// 4, which is computed here with an in-register prefix sum.
+// |carry| holds the running sum in every lane on input and is updated to
+// include |values| on output. Only its lower two bits are significant, so the
+// 16-bit lanes are allowed to wrap.
+inline __m128i ConvertTo8BitSse2(__m128i values, __m128i* carry) {
+  __m128i sums = _mm_add_epi16(values, _mm_slli_si128(values, 2));
+  sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 4));
+  sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 8));
+  sums = _mm_add_epi16(sums, *carry);
+  *carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(sums, 0xFF), 0xFF);
+  const __m128i remainders =
+      _mm_and_si128(_mm_sub_epi16(sums, values), _mm_set1_epi16(3));
+  // The scalar code stores the result in a byte, so a full-scale sample plus a
+  // remainder wraps to 0 rather than saturating. Mask to match it.
+  return _mm_and_si128(_mm_srli_epi16(_mm_add_epi16(remainders, values), 2),
+                       _mm_set1_epi16(0xFF));
+}
+
+// AVX2 variant of ConvertTo8BitSse2() that converts sixteen samples. The
+// prefix sum is computed within each 128-bit lane and the total of the low
+// lane is then added to the high lane.
+__attribute__((target("avx2"))) inline __m256i ConvertTo8BitAvx2(
+    __m256i values, __m256i* carry) {
+  __m256i sums = _mm256_add_epi16(values, _mm256_slli_si256(values, 2));
+  sums = _mm256_add_epi16(sums, _mm256_slli_si256(sums, 4));
+  sums = _mm256_add_epi16(sums, _mm256_slli_si256(sums, 8));
+  __m256i lane_sums =
+      _mm256_shuffle_epi32(_mm256_shufflehi_epi16(sums, 0xFF), 0xFF);
+  sums = _mm256_add_epi16(
+      sums, _mm256_permute2x128_si256(lane_sums, lane_sums, 0x08));
+  sums = _mm256_add_epi16(sums, *carry);
+  lane_sums = _mm256_shuffle_epi32(_mm256_shufflehi_epi16(sums, 0xFF), 0xFF);
+  *carry = _mm256_permute2x128_si256(lane_sums, lane_sums, 0x11);
+  const __m256i remainders =
+      _mm256_and_si256(_mm256_sub_epi16(sums, values), _mm256_set1_epi16(3));
+  return _mm256_and_si256(
+      _mm256_srli_epi16(_mm256_add_epi16(remainders, values), 2),
+      _mm256_set1_epi16(0xFF));
+}
+
+}  // namespace
+
+void ConvertRowTo8BitSse2(const uint16_t* source, uint8_t* destination,
+                          int width, int* sample) {
+  __m128i carry = _mm_set1_epi16(static_cast<int16_t>(*sample));
+  int j = 0;
+  for (; j + 16 <= width; j += 16) {
+    const __m128i low = ConvertTo8BitSse2(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + j)), &carry);
+    const __m128i high = ConvertTo8BitSse2(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + j + 8)),
+        &carry);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + j),
+                     _mm_packus_epi16(low, high));
+  }
+  *sample = _mm_cvtsi128_si32(carry) & 3;
+  ConvertRowTo8Bit(source + j, destination + j, width - j, sample);
+}
+
+__attribute__((target("avx2"))) void ConvertRowTo8BitAvx2(
+    const uint16_t* source, uint8_t* destination, int width, int* sample) {
+  __m256i carry = _mm256_set1_epi16(static_cast<int16_t>(*sample));
+  int j = 0;
+  for (; j + 32 <= width; j += 32) {
+    const __m256i low = ConvertTo8BitAvx2(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + j)),
+        &carry);
+    const __m256i high = ConvertTo8BitAvx2(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + j + 16)),
+        &carry);
+    // _mm256_packus_epi16 packs within 128-bit lanes, so restore the order.
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(destination + j),
+        _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8));
+  }
+  *sample = _mm_cvtsi128_si32(_mm256_castsi256_si128(carry)) & 3;
+  ConvertRowTo8Bit(source + j, destination + j, width - j, sample);
+}
+#endif  // defined(__i386__) || defined(__x86_64__)
+
+void ConvertPlanesTo8Bit(const PlaneTo8Bit* planes, int plane_count,
+                         RowTo8BitConverter convert_row, bool parallel) {
+  if (!parallel) {
+    for (int i = 0; i < plane_count; i++) {
+      ConvertPlaneRows(planes[i], 0, planes[i].height, 0, convert_row);
+    }
+    return;
+  }
+  // The bands of all the planes, in plane order.
+  std::vector<int> band_planes;
+  for (int i = 0; i < plane_count; i++) {
+    band_planes.insert(band_planes.end(),
+                       (planes[i].height + kBandRows - 1) / kBandRows, i);
+  }
+  const int band_count = static_cast<int>(band_planes.size());
+  std::vector<int> first_band_rows(band_count);
+  for (int band = 0; band < band_count; band++) {
+    const bool first_band_of_plane =
+        band == 0 || band_planes[band] != band_planes[band - 1];
+    first_band_rows[band] =
+        first_band_of_plane ? 0 : first_band_rows[band - 1] + kBandRows;
+  }
+  // Sum each band, then turn the sums into the remainders carried into the
+  // bands.
+  std::vector<int> samples(band_count);
+  WorkerPool::GetInstance().ParallelFor(band_count, [&](int band) {
+    const PlaneTo8Bit& plane = planes[band_planes[band]];
+    const int first_row = first_band_rows[band];
+    samples[band] = SumPlaneRowsModulo4(
+        plane, first_row, std::min(first_row + kBandRows, plane.height));
+  });
+  int sample = 0;
+  for (int band = 0; band < band_count; band++) {
+    if (first_band_rows[band] == 0) sample = 0;
+    const int band_sum = samples[band];
+    samples[band] = sample;
+    sample = (sample + band_sum) & 3;
+  }
+  WorkerPool::GetInstance().ParallelFor(band_count, [&](int band) {
+    const PlaneTo8Bit& plane = planes[band_planes[band]];
+    const int first_row = first_band_rows[band];
+    ConvertPlaneRows(plane, first_row,
+                     std::min(first_row + kBandRows, plane.height),
+                     samples[band], convert_row);
+  });
+}
+
+}  // namespace exoplayer_jni
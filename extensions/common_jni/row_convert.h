@@ -0,0 +1,71 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_ROW_CONVERT_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_ROW_CONVERT_H_
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Converts |width| high bit depth samples of |source| to 8 bits in
+// |destination|, with a lightweight dither: the remainder of each conversion is
+// carried over to the next sample. |sample| holds the remainder carried into
+// the row, and is set to the one carried out of it. A full-scale 10-bit sample
+// plus a remainder wraps to 0.
+void ConvertRowTo8Bit(const uint16_t* source, uint8_t* destination, int width,
+                      int* sample);
+
+#if defined(__i386__) || defined(__x86_64__)
+// SSE2 and AVX2 variants of ConvertRowTo8Bit(), bit-exact with it for 10- and
+// 12-bit samples. The AVX2 variant must only be called if the CPU supports
+// AVX2.
+void ConvertRowTo8BitSse2(const uint16_t* source, uint8_t* destination,
+                          int width, int* sample);
+void ConvertRowTo8BitAvx2(const uint16_t* source, uint8_t* destination,
+                          int width, int* sample);
+#endif  // defined(__i386__) || defined(__x86_64__)
+
+// A row converter with the signature of ConvertRowTo8Bit().
+typedef void (*RowTo8BitConverter)(const uint16_t* source,
+                                   uint8_t* destination, int width,
+                                   int* sample);
+
+// A plane of high bit depth samples converted by ConvertPlanesTo8Bit(). Strides
+// are in bytes.
+struct PlaneTo8Bit {
+  const uint8_t* source;
+  int source_stride;
+  uint8_t* destination;
+  int destination_stride;
+  int width;
+  int height;
+};
+
+// Converts |plane_count| |planes| to 8 bits with |convert_row|, carrying the
+// dither remainder from row to row of each plane from 0 at its first row.
+//
+// If |parallel|, the planes are split into bands of rows that are converted in
+// parallel on the WorkerPool, or on the calling thread if the pool has no
+// threads. The remainder carried into a row is the sum of
+// the preceding samples of the plane modulo 4, so a first parallel pass sums
+// each band, and each band is then converted from the remainder the rows above
+// it carry into it. The output is the same as when converting row by row.
+void ConvertPlanesTo8Bit(const PlaneTo8Bit* planes, int plane_count,
+                         RowTo8BitConverter convert_row, bool parallel);
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_ROW_CONVERT_H_
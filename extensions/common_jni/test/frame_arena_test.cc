@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks which idle block FrameArena::Lease() reuses for each requested size,
+// and that idle blocks are trimmed to the capacity, least recently returned
+// first.
+
+#include <cstdint>
+#include <cstdio>
+
+#include "frame_arena.h"  // NOLINT
+
+namespace {
+
+using exoplayer_jni::FrameArena;
+
+bool Check(const char* name, bool condition) {
+  if (!condition) fprintf(stderr, "%s: failed\n", name);
+  return condition;
+}
+
+bool CheckReuse() {
+  FrameArena& arena = FrameArena::GetInstance();
+  arena.SetCapacity(exoplayer_jni::kDefaultFrameArenaCapacity);
+  size_t size_1000;
+  size_t size_2000;
+  size_t size_4000;
+  uint8_t* const block_1000 = arena.Lease(1000, &size_1000);
+  uint8_t* const block_2000 = arena.Lease(2000, &size_2000);
+  uint8_t* const block_4000 = arena.Lease(4000, &size_4000);
+  bool passed = Check("New blocks have the requested sizes",
+                      size_1000 == 1000 && size_2000 == 2000 &&
+                          size_4000 == 4000);
+  arena.Return(block_4000, size_4000);
+  arena.Return(block_2000, size_2000);
+  arena.Return(block_1000, size_1000);
+  passed &= Check("Idle bytes", arena.idle_bytes() == 7000);
+
+  // The smallest block that is large enough is reused.
+  size_t size;
+  uint8_t* block = arena.Lease(1500, &size);
+  passed &=
+      Check("Smallest fitting block", block == block_2000 && size == 2000);
+  uint8_t* const exact = arena.Lease(1000, &size);
+  passed &= Check("Exact fit", exact == block_1000 && size == 1000);
+
+  // A block more than twice the requested size is not, to bound the waste.
+  uint8_t* const small = arena.Lease(1500, &size);
+  passed &=
+      Check("Wasteful block skipped", small != block_4000 && size == 1500);
+  passed &= Check("Wasteful block kept idle", arena.idle_bytes() == 4000);
+  // Half of it used is acceptable.
+  uint8_t* const half = arena.Lease(2000, &size);
+  passed &= Check("Half used block", half == block_4000 && size == 4000);
+  passed &= Check("No idle bytes", arena.idle_bytes() == 0);
+
+  FrameArena::Free(small);
+  FrameArena::Free(block);
+  FrameArena::Free(exact);
+  FrameArena::Free(half);
+  if (passed) printf("Reuse: OK\n");
+  return passed;
+}
+
+bool CheckTrimming() {
+  FrameArena& arena = FrameArena::GetInstance();
+  arena.SetCapacity(5000);
+  size_t sizes[3];
+  uint8_t* blocks[3];
+  for (int i = 0; i < 3; i++) blocks[i] = arena.Lease(2000, &sizes[i]);
+  for (int i = 0; i < 3; i++) arena.Return(blocks[i], sizes[i]);
+  // The least recently returned block is freed.
+  bool passed = Check("Trimmed to the capacity", arena.idle_bytes() == 4000);
+  size_t size;
+  uint8_t* const first = arena.Lease(2000, &size);
+  uint8_t* const second = arena.Lease(2000, &size);
+  passed &= Check("Most recently returned blocks kept",
+                  (first == blocks[1] && second == blocks[2]) ||
+                      (first == blocks[2] && second == blocks[1]));
+  arena.Return(first, 2000);
+  arena.Return(second, 2000);
+
+  // A block larger than the capacity is freed as it is returned.
+  uint8_t* const large = arena.Lease(6000, &size);
+  arena.Return(large, size);
+  passed &= Check("Oversized block freed", arena.idle_bytes() == 4000);
+
+  // Lowering the capacity frees the blocks that no longer fit.
+  arena.SetCapacity(2000);
+  passed &= Check("Lowered capacity", arena.idle_bytes() == 2000);
+  arena.SetCapacity(0);
+  passed &= Check("Zero capacity", arena.idle_bytes() == 0);
+  uint8_t* const block = arena.Lease(100, &size);
+  arena.Return(block, size);
+  passed &= Check("Freed on return", arena.idle_bytes() == 0);
+
+  arena.Return(nullptr, 100);
+  FrameArena::Free(nullptr);
+  passed &= Check("Null block", arena.idle_bytes() == 0);
+  if (passed) printf("Trimming: OK\n");
+  return passed;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= CheckReuse();
+  passed &= CheckTrimming();
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks which frame FrameCache::Read() selects, the least recently used
+// eviction order, downscaling, and that the allocate callback runs without
+// the cache locked.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "frame_cache.h"  // NOLINT
+
+namespace {
+
+using exoplayer_jni::CachedFrameInfo;
+using exoplayer_jni::FrameCache;
+
+constexpr int kWidth = 4;
+constexpr int kHeight = 4;
+const size_t kFrameSize = FrameCache::FrameSize(kWidth, kHeight);
+
+// Stores a kWidth x kHeight frame whose samples are all |value|.
+void PutFrame(FrameCache* cache, int64_t time_us, uint8_t value) {
+  const std::vector<uint8_t> y(kWidth * kHeight, value);
+  const std::vector<uint8_t> uv((kWidth / 2) * (kHeight / 2), value);
+  const uint8_t* const planes[3] = {y.data(), uv.data(), uv.data()};
+  const int strides[3] = {kWidth, kWidth / 2, kWidth / 2};
+  cache->Put(time_us, kWidth, kHeight, /* colorspace= */ 0, planes, strides);
+}
+
+// Reads a frame and returns the time of the frame read, or -1 if there was
+// none. Stores its first sample in |value| if it is not null.
+int64_t ReadFrame(FrameCache* cache, int64_t time_us, int64_t tolerance_us,
+                  uint8_t* value = nullptr) {
+  std::vector<uint8_t> output;
+  int64_t read_time_us = -1;
+  const bool read = cache->Read(
+      time_us, tolerance_us,
+      [&output, &read_time_us](const CachedFrameInfo& info) -> uint8_t* {
+        read_time_us = info.time_us;
+        output.resize(FrameCache::FrameSize(info.width, info.height));
+        return output.data();
+      });
+  if (!read) return -1;
+  if (value != nullptr) *value = output[0];
+  return read_time_us;
+}
+
+bool Check(const char* name, bool condition) {
+  if (!condition) fprintf(stderr, "%s: failed\n", name);
+  return condition;
+}
+
+bool CheckBestMatch() {
+  FrameCache cache;
+  cache.Configure(10 * kFrameSize, /* downscale_factor= */ 1);
+  PutFrame(&cache, 0, 10);
+  PutFrame(&cache, 33, 20);
+  PutFrame(&cache, 66, 30);
+  PutFrame(&cache, 100, 40);
+  bool passed = true;
+  passed &= Check("Exact time", ReadFrame(&cache, 66, 0) == 66);
+  passed &= Check("Latest earlier frame", ReadFrame(&cache, 70, 10) == 66);
+  passed &= Check("Latest frame within a wide tolerance",
+                  ReadFrame(&cache, 99, 1000) == 66);
+  passed &= Check("Later frames are ignored", ReadFrame(&cache, 32, 100) == 0);
+  passed &= Check("Beyond the tolerance", ReadFrame(&cache, 65, 20) == -1);
+  passed &= Check("Before the first frame", ReadFrame(&cache, -1, 100) == -1);
+  passed &= Check("Counts",
+                  cache.hit_count() == 4 && cache.miss_count() == 2);
+
+  // A frame with the same time replaces the previous one.
+  PutFrame(&cache, 33, 25);
+  uint8_t value = 0;
+  passed &= Check("Replaced frame",
+                  ReadFrame(&cache, 33, 0, &value) == 33 && value == 25);
+  if (passed) printf("Best match: OK\n");
+  return passed;
+}
+
+bool CheckEviction() {
+  FrameCache cache;
+  cache.Configure(3 * kFrameSize, /* downscale_factor= */ 1);
+  PutFrame(&cache, 0, 1);
+  PutFrame(&cache, 1, 2);
+  PutFrame(&cache, 2, 3);
+  // Reading the oldest frame makes it the most recently used.
+  bool passed = Check("Read oldest", ReadFrame(&cache, 0, 0) == 0);
+  PutFrame(&cache, 3, 4);
+  passed &= Check("Least recently used evicted", ReadFrame(&cache, 1, 0) == -1);
+  passed &= Check("Read frame kept", ReadFrame(&cache, 0, 0) == 0);
+  passed &= Check("Newer frames kept", ReadFrame(&cache, 2, 0) == 2 &&
+                                           ReadFrame(&cache, 3, 0) == 3);
+
+  // Shrinking the budget evicts the least recently used frames.
+  cache.Configure(kFrameSize, /* downscale_factor= */ 1);
+  passed &= Check("Shrunk budget", ReadFrame(&cache, 0, 0) == -1 &&
+                                       ReadFrame(&cache, 2, 0) == -1 &&
+                                       ReadFrame(&cache, 3, 0) == 3);
+
+  // Frames larger than the whole budget are not stored.
+  cache.Configure(kFrameSize - 1, /* downscale_factor= */ 1);
+  PutFrame(&cache, 4, 5);
+  passed &= Check("Oversized frame", ReadFrame(&cache, 4, 0) == -1);
+
+  cache.Configure(0, /* downscale_factor= */ 1);
+  passed &= Check("Disabled", !cache.enabled());
+  PutFrame(&cache, 5, 6);
+  passed &= Check("Disabled Put", ReadFrame(&cache, 5, 0) == -1);
+  if (passed) printf("Eviction: OK\n");
+  return passed;
+}
+
+bool CheckDownscaling() {
+  FrameCache cache;
+  cache.Configure(10 * kFrameSize, /* downscale_factor= */ 1);
+  PutFrame(&cache, 0, 1);
+  // Changing the factor drops the frames stored with the previous one.
+  cache.Configure(10 * kFrameSize, /* downscale_factor= */ 2);
+  bool passed =
+      Check("Dropped on factor change", ReadFrame(&cache, 0, 0) == -1);
+
+  // A 4x4 luma plane whose 2x2 blocks average to 10, 20, 30 and 40.
+  const uint8_t y[kWidth * kHeight] = {9,  11, 19, 21,  //
+                                       9,  11, 19, 21,  //
+                                       29, 31, 39, 41,  //
+                                       29, 31, 39, 41};
+  const uint8_t uv[(kWidth / 2) * (kHeight / 2)] = {100, 100, 100, 100};
+  const uint8_t* const planes[3] = {y, uv, uv};
+  const int strides[3] = {kWidth, kWidth / 2, kWidth / 2};
+  cache.Put(1, kWidth, kHeight, /* colorspace= */ 0, planes, strides);
+  std::vector<uint8_t> output;
+  CachedFrameInfo read_info = {};
+  cache.Read(1, 0, [&](const CachedFrameInfo& info) -> uint8_t* {
+    read_info = info;
+    output.resize(FrameCache::FrameSize(info.width, info.height));
+    return output.data();
+  });
+  const std::vector<uint8_t> expected = {10, 20, 30, 40, 100, 100};
+  passed &= Check("Downscaled frame", read_info.width == 2 &&
+                                          read_info.height == 2 &&
+                                          output == expected);
+  if (passed) printf("Downscaling: OK\n");
+  return passed;
+}
+
+bool CheckAllocateUnlocked() {
+  FrameCache cache;
+  cache.Configure(kFrameSize, /* downscale_factor= */ 1);
+  PutFrame(&cache, 0, 7);
+  std::vector<uint8_t> output;
+  // The callback uses the cache, which would deadlock if it were locked, and
+  // evicts the frame being read.
+  const bool read = cache.Read(0, 0, [&](const CachedFrameInfo& info) {
+    PutFrame(&cache, 1, 8);
+    output.resize(FrameCache::FrameSize(info.width, info.height));
+    return output.data();
+  });
+  bool passed = Check("Read while evicted",
+                      read && output == std::vector<uint8_t>(kFrameSize, 7));
+  passed &= Check("Evicted", ReadFrame(&cache, 0, 0) == -1);
+
+  const bool allocation_failed = !cache.Read(
+      1, 0, [](const CachedFrameInfo& info) -> uint8_t* { return nullptr; });
+  passed &= Check("Failed allocation", allocation_failed);
+  if (passed) printf("Allocate unlocked: OK\n");
+  return passed;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= CheckBestMatch();
+  passed &= CheckEviction();
+  passed &= CheckDownscaling();
+  passed &= CheckAllocateUnlocked();
+  return passed ? 0 : 1;
+}
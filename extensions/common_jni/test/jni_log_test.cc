@@ -0,0 +1,196 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the per call site rate limiter, that errors bypass it, and the
+// contents, order and truncation of the in-memory ring. Logcat is replaced by
+// a definition of __android_log_write() that records the messages.
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "jni_log.h"  // NOLINT
+
+namespace {
+
+constexpr char kTag[] = "JniLogTest";
+// Messages logged by a call site per window before it is limited.
+constexpr int kRateLimit = 5;
+
+std::vector<std::string> g_logcat;
+
+// Waits for the current rate limiting window to end.
+void WaitForNextWindow() {
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+}
+
+// Logs |count| messages at |level| from a single call site, as a JNI_LOG macro
+// would, and returns the number that reached logcat.
+int LogFromOneCallSite(exoplayer_jni::LogRateLimiter* limiter, int level,
+                       int count) {
+  const size_t start = g_logcat.size();
+  for (int i = 0; i < count; i++) {
+    exoplayer_jni::LogWrite(level, kTag, limiter, "message %d", i);
+  }
+  return static_cast<int>(g_logcat.size() - start);
+}
+
+bool CheckRateLimiter() {
+  exoplayer_jni::LogRateLimiter limiter;
+  int suppressed;
+  for (int i = 0; i < kRateLimit + 3; i++) {
+    const bool acquired = limiter.Acquire(&suppressed);
+    if (acquired != (i < kRateLimit) || suppressed != 0) {
+      fprintf(stderr, "Acquire %d returned %d with %d suppressed\n", i,
+              acquired, suppressed);
+      return false;
+    }
+  }
+  WaitForNextWindow();
+  if (!limiter.Acquire(&suppressed) || suppressed != 3) {
+    fprintf(stderr, "Next window reported %d suppressed\n", suppressed);
+    return false;
+  }
+  printf("Rate limiter: OK\n");
+  return true;
+}
+
+bool CheckLimitedWarnings() {
+  exoplayer_jni::LogRateLimiter limiter;
+  const int logged = LogFromOneCallSite(&limiter, ANDROID_LOG_WARN, 12);
+  if (logged != kRateLimit) {
+    fprintf(stderr, "%d of 12 warnings logged\n", logged);
+    return false;
+  }
+  WaitForNextWindow();
+  LogFromOneCallSite(&limiter, ANDROID_LOG_WARN, 1);
+  const std::string expected = "message 0 (7 similar messages suppressed)";
+  if (g_logcat.back() != expected) {
+    fprintf(stderr, "Logged \"%s\"\n", g_logcat.back().c_str());
+    return false;
+  }
+  printf("Limited warnings: OK\n");
+  return true;
+}
+
+bool CheckUnlimitedErrors() {
+  exoplayer_jni::LogRateLimiter limiter;
+  const int logged = LogFromOneCallSite(&limiter, ANDROID_LOG_ERROR, 50);
+  if (logged != 50) {
+    fprintf(stderr, "%d of 50 errors logged\n", logged);
+    return false;
+  }
+  printf("Unlimited errors: OK\n");
+  return true;
+}
+
+// Returns the lines of the ring, without their time.
+std::vector<std::string> DumpRing(int capacity) {
+  std::vector<char> output(capacity);
+  const int length = exoplayer_jni::DumpLogRing(output.data(), capacity);
+  std::vector<std::string> lines;
+  if (static_cast<int>(strlen(output.data())) != length) return lines;
+  const char* line = output.data();
+  while (const char* const end = strchr(line, '\n')) {
+    const char* const message = strchr(line, ' ') + 1;
+    lines.push_back(std::string(message, end));
+    line = end + 1;
+  }
+  if (*line != '\0') lines.push_back("partial line");
+  return lines;
+}
+
+// Logs |count| messages, each from its own call site so that none is limited.
+void LogToRing(int level, int first, int count) {
+  for (int i = first; i < first + count; i++) {
+    exoplayer_jni::LogRateLimiter limiter;
+    exoplayer_jni::LogWrite(level, kTag, &limiter, "ring %d", i);
+  }
+}
+
+bool CheckRing() {
+  exoplayer_jni::SetLogRingEnabled(true);
+  const size_t logcat_size = g_logcat.size();
+  LogToRing(ANDROID_LOG_INFO, 0, 2);
+  LogToRing(ANDROID_LOG_ERROR, 2, 1);
+  std::vector<std::string> lines = DumpRing(exoplayer_jni::kLogRingDumpSize);
+  if (lines.size() != 3 || lines[0] != "I/JniLogTest: ring 0" ||
+      lines[2] != "E/JniLogTest: ring 2") {
+    fprintf(stderr, "Ring holds %zu lines\n", lines.size());
+    return false;
+  }
+  // Only the error also went to logcat.
+  if (g_logcat.size() != logcat_size + 1 || g_logcat.back() != "ring 2") {
+    fprintf(stderr, "Ring messages went to logcat\n");
+    return false;
+  }
+
+  // Overwrite the oldest messages.
+  LogToRing(ANDROID_LOG_WARN, 3, exoplayer_jni::kLogRingSize);
+  lines = DumpRing(exoplayer_jni::kLogRingDumpSize);
+  const int last = exoplayer_jni::kLogRingSize + 2;
+  if (static_cast<int>(lines.size()) != exoplayer_jni::kLogRingSize ||
+      lines.front() != "W/JniLogTest: ring 3" ||
+      lines.back() != "W/JniLogTest: ring " + std::to_string(last)) {
+    fprintf(stderr, "Wrapped ring holds %zu lines, from \"%s\"\n",
+            lines.size(), lines.empty() ? "" : lines.front().c_str());
+    return false;
+  }
+
+  // A small output only gets whole lines, oldest first.
+  lines = DumpRing(100);
+  if (lines.empty() || lines.size() > 4 || lines.back() == "partial line" ||
+      lines.front() != "W/JniLogTest: ring 3") {
+    fprintf(stderr, "Truncated dump holds %zu lines\n", lines.size());
+    return false;
+  }
+
+  // Long messages are truncated.
+  const std::string long_message(2 * exoplayer_jni::kLogMessageSize, 'x');
+  exoplayer_jni::LogRateLimiter limiter;
+  exoplayer_jni::LogWrite(ANDROID_LOG_WARN, kTag, &limiter, "%s",
+                          long_message.c_str());
+  lines = DumpRing(exoplayer_jni::kLogRingDumpSize);
+  const std::string expected =
+      "W/JniLogTest: " +
+      long_message.substr(0, exoplayer_jni::kLogMessageSize - 1);
+  if (lines.empty() || lines.back() != expected) {
+    fprintf(stderr, "Long message was not truncated\n");
+    return false;
+  }
+  exoplayer_jni::SetLogRingEnabled(false);
+  printf("Ring: OK\n");
+  return true;
+}
+
+}  // namespace
+
+int __android_log_write(int prio, const char* tag, const char* text) {
+  g_logcat.push_back(text);
+  return 1;
+}
+
+int main() {
+  bool passed = true;
+  passed &= CheckRateLimiter();
+  passed &= CheckLimitedWarnings();
+  passed &= CheckUnlimitedErrors();
+  passed &= CheckRing();
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks ObuParser on temporal units built bit by bit: temporal delimiters,
+// sequence headers, shown and hidden key frames, inter frames, frames shown
+// with show_existing_frame and malformed or truncated OBUs.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "obu_parser.h"  // NOLINT
+
+namespace {
+
+using exoplayer_jni::ObuParser;
+using exoplayer_jni::TemporalUnitInfo;
+
+// OBU types, from section 6.2.2 of the AV1 specification.
+constexpr int kObuSequenceHeader = 1;
+constexpr int kObuTemporalDelimiter = 2;
+constexpr int kObuFrameHeader = 3;
+
+// Frame types, from section 6.8.2 of the AV1 specification.
+constexpr int kFrameKey = 0;
+constexpr int kFrameInter = 1;
+
+constexpr int kOrderHintBits = 7;
+
+// Writes bits most significant first.
+class BitWriter {
+ public:
+  void WriteBits(uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+      if (bit_count_ % 8 == 0) bytes_.push_back(0);
+      if ((value >> i) & 1) bytes_.back() |= 0x80 >> (bit_count_ % 8);
+      bit_count_++;
+    }
+  }
+
+  const std::vector<uint8_t>& bytes() const { return bytes_; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+  int bit_count_ = 0;
+};
+
+// Appends an OBU with a size field and no extension to |temporal_unit|.
+void AppendObu(int type, const std::vector<uint8_t>& payload,
+               std::vector<uint8_t>* temporal_unit) {
+  temporal_unit->push_back(static_cast<uint8_t>((type << 3) | 0x02));
+  temporal_unit->push_back(static_cast<uint8_t>(payload.size()));
+  temporal_unit->insert(temporal_unit->end(), payload.begin(), payload.end());
+}
+
+void AppendTemporalDelimiter(std::vector<uint8_t>* temporal_unit) {
+  AppendObu(kObuTemporalDelimiter, {}, temporal_unit);
+}
+
+// A 1920x1080 sequence header with order hints and without timing info, so
+// that frame headers signal allow_screen_content_tools.
+void AppendSequenceHeader(std::vector<uint8_t>* temporal_unit) {
+  BitWriter writer;
+  writer.WriteBits(0, 3);      // seq_profile
+  writer.WriteBits(0, 1);      // still_picture
+  writer.WriteBits(0, 1);      // reduced_still_picture_header
+  writer.WriteBits(0, 1);      // timing_info_present_flag
+  writer.WriteBits(0, 1);      // initial_display_delay_present_flag
+  writer.WriteBits(0, 5);      // operating_points_cnt_minus_1
+  writer.WriteBits(0, 12);     // operating_point_idc[0]
+  writer.WriteBits(8, 5);      // seq_level_idx[0]
+  writer.WriteBits(0, 1);      // seq_tier[0]
+  writer.WriteBits(15, 4);     // frame_width_bits_minus_1
+  writer.WriteBits(15, 4);     // frame_height_bits_minus_1
+  writer.WriteBits(1919, 16);  // max_frame_width_minus_1
+  writer.WriteBits(1079, 16);  // max_frame_height_minus_1
+  writer.WriteBits(0, 1);      // frame_id_numbers_present_flag
+  writer.WriteBits(0, 3);      // use_128x128_superblock and intra tools
+  writer.WriteBits(0, 4);      // interintra, masked, warped and dual filter
+  writer.WriteBits(1, 1);      // enable_order_hint
+  writer.WriteBits(0, 2);      // enable_jnt_comp and enable_ref_frame_mvs
+  writer.WriteBits(1, 1);      // seq_choose_screen_content_tools
+  writer.WriteBits(1, 1);      // seq_choose_integer_mv
+  writer.WriteBits(kOrderHintBits - 1, 3);  // order_hint_bits_minus_1
+  writer.WriteBits(0, 3);                   // enable_superres and beyond
+  AppendObu(kObuSequenceHeader, writer.bytes(), temporal_unit);
+}
+
+// A frame header OBU, up to refresh_frame_flags.
+void AppendFrameHeader(int frame_type, bool show_frame,
+                       int refresh_frame_flags,
+                       std::vector<uint8_t>* temporal_unit) {
+  BitWriter writer;
+  writer.WriteBits(0, 1);  // show_existing_frame
+  writer.WriteBits(frame_type, 2);
+  writer.WriteBits(show_frame, 1);
+  if (!show_frame) {
+    writer.WriteBits(1, 1);  // showable_frame
+  }
+  const bool shown_key_frame = frame_type == kFrameKey && show_frame;
+  if (!shown_key_frame) {
+    writer.WriteBits(0, 1);  // error_resilient_mode
+  }
+  writer.WriteBits(0, 1);               // disable_cdf_update
+  writer.WriteBits(0, 1);               // allow_screen_content_tools
+  writer.WriteBits(0, 1);               // frame_size_override_flag
+  writer.WriteBits(5, kOrderHintBits);  // order_hint
+  if (frame_type == kFrameInter) {
+    writer.WriteBits(7, 3);  // primary_ref_frame
+  }
+  if (!shown_key_frame) {
+    writer.WriteBits(refresh_frame_flags, 8);
+  }
+  writer.WriteBits(0, 8);  // The rest of the header.
+  AppendObu(kObuFrameHeader, writer.bytes(), temporal_unit);
+}
+
+void AppendShowExistingFrame(int frame_to_show,
+                             std::vector<uint8_t>* temporal_unit) {
+  BitWriter writer;
+  writer.WriteBits(1, 1);  // show_existing_frame
+  writer.WriteBits(frame_to_show, 3);
+  AppendObu(kObuFrameHeader, writer.bytes(), temporal_unit);
+}
+
+bool Parse(ObuParser* parser, const std::vector<uint8_t>& temporal_unit,
+           TemporalUnitInfo* info) {
+  return parser->ParseTemporalUnit(temporal_unit.data(), temporal_unit.size(),
+                                   info);
+}
+
+bool Check(const char* name, bool condition) {
+  if (!condition) fprintf(stderr, "%s: failed\n", name);
+  return condition;
+}
+
+bool CheckTemporalDelimiter() {
+  ObuParser parser;
+  std::vector<uint8_t> temporal_unit;
+  AppendTemporalDelimiter(&temporal_unit);
+  TemporalUnitInfo info;
+  const bool passed =
+      Check("Temporal delimiter", Parse(&parser, temporal_unit, &info) &&
+                                      !info.key_frame && !info.intra_only &&
+                                      info.shown_frame_count == 0 &&
+                                      info.hidden_frame_count == 0 &&
+                                      info.spatial_layer_count == 0);
+  if (passed) printf("Temporal delimiter: OK\n");
+  return passed;
+}
+
+bool CheckSequenceHeader() {
+  ObuParser parser;
+  std::vector<uint8_t> key_frame;
+  AppendTemporalDelimiter(&key_frame);
+  AppendFrameHeader(kFrameKey, /* show_frame= */ true, 0xFF, &key_frame);
+  TemporalUnitInfo info;
+  bool passed = Check("Frame without a sequence header",
+                      !Parse(&parser, key_frame, &info));
+
+  std::vector<uint8_t> temporal_unit;
+  AppendTemporalDelimiter(&temporal_unit);
+  AppendSequenceHeader(&temporal_unit);
+  passed &= Check("Sequence header", Parse(&parser, temporal_unit, &info) &&
+                                         info.shown_frame_count == 0);
+  passed &= Check("Frame after a sequence header",
+                  Parse(&parser, key_frame, &info));
+  parser.Reset();
+  passed &= Check("Frame after Reset()", !Parse(&parser, key_frame, &info));
+  if (passed) printf("Sequence header: OK\n");
+  return passed;
+}
+
+bool CheckKeyAndInterFrames() {
+  ObuParser parser;
+  std::vector<uint8_t> key_frame;
+  AppendTemporalDelimiter(&key_frame);
+  AppendSequenceHeader(&key_frame);
+  AppendFrameHeader(kFrameKey, /* show_frame= */ true, 0xFF, &key_frame);
+  TemporalUnitInfo info;
+  bool passed = Check("Key frame", Parse(&parser, key_frame, &info) &&
+                                       info.key_frame && info.intra_only &&
+                                       info.reference &&
+                                       !info.show_existing_frame &&
+                                       info.shown_frame_count == 1 &&
+                                       info.hidden_frame_count == 0 &&
+                                       info.spatial_layer_count == 1);
+
+  std::vector<uint8_t> inter_frame;
+  AppendTemporalDelimiter(&inter_frame);
+  AppendFrameHeader(kFrameInter, /* show_frame= */ true, 0x01, &inter_frame);
+  passed &= Check("Inter frame", Parse(&parser, inter_frame, &info) &&
+                                     !info.key_frame && !info.intra_only &&
+                                     info.reference &&
+                                     info.shown_frame_count == 1);
+
+  std::vector<uint8_t> non_reference_frame;
+  AppendTemporalDelimiter(&non_reference_frame);
+  AppendFrameHeader(kFrameInter, /* show_frame= */ true, 0,
+                    &non_reference_frame);
+  passed &= Check("Non-reference frame",
+                  Parse(&parser, non_reference_frame, &info) &&
+                      !info.reference && !info.key_frame);
+  if (passed) printf("Key and inter frames: OK\n");
+  return passed;
+}
+
+bool CheckHiddenKeyFrame() {
+  ObuParser parser;
+  std::vector<uint8_t> temporal_unit;
+  AppendTemporalDelimiter(&temporal_unit);
+  AppendSequenceHeader(&temporal_unit);
+  AppendFrameHeader(kFrameKey, /* show_frame= */ true, 0xFF, &temporal_unit);
+  TemporalUnitInfo info;
+  Parse(&parser, temporal_unit, &info);
+
+  // A key frame decoded into slot 2 without being shown, followed by a shown
+  // inter frame that may still refer to the frames before it.
+  temporal_unit.clear();
+  AppendTemporalDelimiter(&temporal_unit);
+  AppendFrameHeader(kFrameKey, /* show_frame= */ false, 0x04, &temporal_unit);
+  AppendFrameHeader(kFrameInter, /* show_frame= */ true, 0x01, &temporal_unit);
+  bool passed = Check("Hidden key frame",
+                      Parse(&parser, temporal_unit, &info) &&
+                          !info.key_frame && !info.intra_only &&
+                          info.shown_frame_count == 1 &&
+                          info.hidden_frame_count == 1);
+
+  // Showing the key frame is where decoding can start.
+  temporal_unit.clear();
+  AppendTemporalDelimiter(&temporal_unit);
+  AppendShowExistingFrame(2, &temporal_unit);
+  passed &= Check("Shown hidden key frame",
+                  Parse(&parser, temporal_unit, &info) && info.key_frame &&
+                      info.intra_only && info.show_existing_frame &&
+                      info.reference && info.shown_frame_count == 1);
+
+  // Showing an inter frame is not.
+  temporal_unit.clear();
+  AppendTemporalDelimiter(&temporal_unit);
+  AppendFrameHeader(kFrameInter, /* show_frame= */ false, 0x08, &temporal_unit);
+  Parse(&parser, temporal_unit, &info);
+  temporal_unit.clear();
+  AppendShowExistingFrame(3, &temporal_unit);
+  passed &= Check("Shown inter frame",
+                  Parse(&parser, temporal_unit, &info) && !info.key_frame &&
+                      !info.intra_only && info.show_existing_frame);
+  if (passed) printf("Hidden key frame: OK\n");
+  return passed;
+}
+
+bool CheckMalformed() {
+  ObuParser parser;
+  std::vector<uint8_t> temporal_unit;
+  AppendTemporalDelimiter(&temporal_unit);
+  AppendSequenceHeader(&temporal_unit);
+  const size_t frame_header_offset = temporal_unit.size();
+  AppendFrameHeader(kFrameKey, /* show_frame= */ true, 0xFF, &temporal_unit);
+  TemporalUnitInfo info;
+  bool passed = Check("Whole", Parse(&parser, temporal_unit, &info));
+  // Cutting the frame header OBU anywhere leaves it shorter than its size.
+  for (size_t size = frame_header_offset + 1; size < temporal_unit.size();
+       size++) {
+    const std::vector<uint8_t> truncated(temporal_unit.begin(),
+                                         temporal_unit.begin() + size);
+    if (Parse(&parser, truncated, &info)) {
+      fprintf(stderr, "Truncated to %zu bytes: parsed\n", size);
+      passed = false;
+    }
+  }
+
+  // A frame header whose payload ends before refresh_frame_flags.
+  std::vector<uint8_t> short_frame_header;
+  AppendObu(kObuFrameHeader, {0x20}, &short_frame_header);
+  passed &= Check("Short frame header",
+                  !Parse(&parser, short_frame_header, &info));
+
+  const std::vector<uint8_t> forbidden_bit = {0x92, 0x00};
+  passed &= Check("Forbidden bit", !Parse(&parser, forbidden_bit, &info));
+  const std::vector<uint8_t> unterminated_size = {0x12, 0x80};
+  passed &= Check("Unterminated size",
+                  !Parse(&parser, unterminated_size, &info));
+  if (passed) printf("Malformed: OK\n");
+  return passed;
+}
+
+bool CheckPacking() {
+  TemporalUnitInfo info;
+  info.key_frame = true;
+  info.reference = true;
+  info.shown_frame_count = 2;
+  info.hidden_frame_count = 300;
+  info.spatial_layer_count = 3;
+  const int packed = exoplayer_jni::PackTemporalUnitInfo(info);
+  const bool passed = Check("Packing", packed == (1 | 8 | (2 << 8) |
+                                                  (0xFF << 16) | (3 << 24)));
+  if (passed) printf("Packing: OK\n");
+  return passed;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= CheckTemporalDelimiter();
+  passed &= CheckSequenceHeader();
+  passed &= CheckKeyAndInterFrames();
+  passed &= CheckHiddenKeyFrame();
+  passed &= CheckMalformed();
+  passed &= CheckPacking();
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that the SIMD row converters are bit-exact with the scalar loop,
+// including the dither remainder carried into and out of each row, and that
+// converting frames in parallel bands gives the same output as converting them
+// row by row.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "row_convert.h"  // NOLINT
+
+namespace {
+
+using exoplayer_jni::PlaneTo8Bit;
+using exoplayer_jni::RowTo8BitConverter;
+
+constexpr int kMaxWidth = 300;
+constexpr int kIterations = 2000;
+
+// Returns whether |converter| matches the scalar loop for rows of every width
+// up to kMaxWidth, so that each tail length of the 16 and 32 sample vector
+// loops is covered, and for random rows, widths and carries after that.
+bool MatchesScalar(const char* name, RowTo8BitConverter converter,
+                   int max_sample) {
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> sample_distribution(0, max_sample);
+  std::vector<uint16_t> source(kMaxWidth);
+  std::vector<uint8_t> expected(kMaxWidth);
+  std::vector<uint8_t> actual(kMaxWidth);
+  for (int iteration = 0; iteration < kIterations; iteration++) {
+    const int width = iteration <= kMaxWidth ? iteration : random() % kMaxWidth;
+    const int carry = random() % 4;
+    // Every eighth row is full-scale, which wraps to 0 when a remainder is
+    // carried into a sample.
+    const bool full_scale = iteration % 8 == 0;
+    for (int i = 0; i < width; i++) {
+      source[i] = full_scale ? max_sample : sample_distribution(random);
+    }
+    int expected_sample = carry;
+    int actual_sample = carry;
+    exoplayer_jni::ConvertRowTo8Bit(source.data(), expected.data(), width,
+                                    &expected_sample);
+    converter(source.data(), actual.data(), width, &actual_sample);
+    for (int i = 0; i < width; i++) {
+      if (actual[i] != expected[i]) {
+        fprintf(stderr,
+                "%s: width %d, carry %d: sample %d is %d, expected %d\n", name,
+                width, carry, i, actual[i], expected[i]);
+        return false;
+      }
+    }
+    if (actual_sample != expected_sample) {
+      fprintf(stderr, "%s: width %d, carry %d: carried out %d, expected %d\n",
+              name, width, carry, actual_sample, expected_sample);
+      return false;
+    }
+  }
+  printf("%s: OK\n", name);
+  return true;
+}
+
+// A 4:2:0 frame of random samples, with padded strides, and two outputs.
+struct Frame {
+  Frame(int width, int height, int max_sample, std::mt19937* random) {
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+    const int widths[] = {width, chroma_width, chroma_width};
+    const int heights[] = {height, chroma_height, chroma_height};
+    std::uniform_int_distribution<int> sample_distribution(0, max_sample);
+    for (int i = 0; i < 3; i++) {
+      const int source_stride = 2 * widths[i] + 32;
+      const int destination_stride = widths[i] + 16;
+      sources[i].resize(source_stride / 2 * heights[i]);
+      for (uint16_t& sample : sources[i]) {
+        // Full-scale runs make remainders wrap samples to 0.
+        sample = (*random)() % 16 == 0 ? max_sample
+                                       : sample_distribution(*random);
+      }
+      for (int j = 0; j < 2; j++) {
+        destinations[j][i].assign(destination_stride * heights[i], 0);
+        planes[j][i] = {reinterpret_cast<const uint8_t*>(sources[i].data()),
+                        source_stride,
+                        destinations[j][i].data(),
+                        destination_stride,
+                        widths[i],
+                        heights[i]};
+      }
+    }
+  }
+
+  std::vector<uint16_t> sources[3];
+  std::vector<uint8_t> destinations[2][3];
+  PlaneTo8Bit planes[2][3];
+};
+
+// Returns whether ConvertPlanesTo8Bit() gives the same output in parallel
+// bands as row by row, for frame heights that end bands at and off band
+// boundaries.
+bool BandsMatchRows(const char* name, RowTo8BitConverter converter,
+                    int max_sample) {
+  std::mt19937 random(5678);
+  const int sizes[][2] = {{1, 1},     {33, 127},  {64, 128},  {257, 129},
+                          {320, 256}, {100, 500}, {1920, 1080}};
+  for (const auto& size : sizes) {
+    Frame frame(size[0], size[1], max_sample, &random);
+    exoplayer_jni::ConvertPlanesTo8Bit(frame.planes[0], 3, converter,
+                                       /*parallel=*/false);
+    exoplayer_jni::ConvertPlanesTo8Bit(frame.planes[1], 3, converter,
+                                       /*parallel=*/true);
+    for (int i = 0; i < 3; i++) {
+      if (frame.destinations[0][i] != frame.destinations[1][i]) {
+        fprintf(stderr, "%s: %dx%d: plane %d differs in bands\n", name,
+                size[0], size[1], i);
+        return false;
+      }
+    }
+  }
+  printf("%s in bands: OK\n", name);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= BandsMatchRows("ConvertRowTo8Bit", exoplayer_jni::ConvertRowTo8Bit,
+                           1023);
+#if defined(__i386__) || defined(__x86_64__)
+  const bool has_avx2 = __builtin_cpu_supports("avx2");
+  // libvpx outputs 10-bit samples for profile 2 and 12-bit ones for profile 3.
+  for (const int max_sample : {1023, 4095}) {
+    printf("%d-bit samples\n", max_sample == 1023 ? 10 : 12);
+    passed &= MatchesScalar("ConvertRowTo8BitSse2",
+                            exoplayer_jni::ConvertRowTo8BitSse2, max_sample);
+    passed &= BandsMatchRows("ConvertRowTo8BitSse2",
+                             exoplayer_jni::ConvertRowTo8BitSse2, max_sample);
+    if (has_avx2) {
+      passed &= MatchesScalar("ConvertRowTo8BitAvx2",
+                              exoplayer_jni::ConvertRowTo8BitAvx2, max_sample);
+      passed &= BandsMatchRows("ConvertRowTo8BitAvx2",
+                               exoplayer_jni::ConvertRowTo8BitAvx2, max_sample);
+    } else {
+      printf("ConvertRowTo8BitAvx2: skipped, AVX2 is not supported\n");
+    }
+  }
+#else
+  printf("No SIMD row converters on this architecture\n");
+#endif  // defined(__i386__) || defined(__x86_64__)
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that WorkerPool::ParallelFor() runs each task exactly once, including
+// when several threads submit jobs concurrently.
+
+#include <atomic>
+#include <cstdio>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "worker_pool.h"  // NOLINT
+
+namespace {
+
+constexpr int kCallerCount = 4;
+constexpr int kJobsPerCaller = 200;
+
+// Returns whether a job of |task_count| tasks ran each of them once.
+bool RunJob(int task_count) {
+  std::vector<std::atomic<int>> runs(task_count);
+  for (std::atomic<int>& run : runs) run.store(0);
+  exoplayer_jni::WorkerPool::GetInstance().ParallelFor(
+      task_count, [&runs](int index) { runs[index]++; });
+  for (int i = 0; i < task_count; i++) {
+    if (runs[i].load() != 1) {
+      fprintf(stderr, "Task %d of %d ran %d times\n", i, task_count,
+              runs[i].load());
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CheckSingleCaller() {
+  for (int task_count = 0; task_count < 64; task_count++) {
+    if (!RunJob(task_count)) return false;
+  }
+  printf("Single caller: OK\n");
+  return true;
+}
+
+bool CheckConcurrentCallers() {
+  std::atomic<bool> passed(true);
+  std::vector<std::thread> callers;
+  for (int i = 0; i < kCallerCount; i++) {
+    callers.emplace_back([&passed, i] {
+      for (int job = 0; job < kJobsPerCaller; job++) {
+        if (!RunJob(1 + (job * (i + 1)) % 40)) passed = false;
+      }
+    });
+  }
+  for (std::thread& caller : callers) caller.join();
+  if (passed) printf("Concurrent callers: OK\n");
+  return passed;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= CheckSingleCaller();
+  passed &= CheckConcurrentCallers();
+  return passed ? 0 : 1;
+}
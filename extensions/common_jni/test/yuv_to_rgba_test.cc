@@ -0,0 +1,252 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the YUV to RGB coefficients against the published BT.601, BT.709 and
+// BT.2020 matrices in limited and full range, and that the row converters,
+// SIMD paths included, match a scalar reference for every row width.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "yuv_to_rgba.h"  // NOLINT
+
+namespace {
+
+using exoplayer_jni::YuvToRgbCoefficients;
+
+constexpr int kMaxWidth = 300;
+constexpr int kIterations = 2000;
+
+// Conversion factors of a YUV to RGB matrix, as published with 3 decimals.
+struct Matrix {
+  double y;
+  double v_to_r;
+  double u_to_g;
+  double v_to_g;
+  double u_to_b;
+};
+
+bool Near(const char* name, const char* field, int coefficient,
+          double expected) {
+  const double actual =
+      coefficient / static_cast<double>(1 << exoplayer_jni::kRgbCoefficientBits);
+  if (std::fabs(actual - expected) > 0.002) {
+    fprintf(stderr, "%s: %s is %.4f, expected %.3f\n", name, field, actual,
+            expected);
+    return false;
+  }
+  return true;
+}
+
+bool CheckCoefficients(const char* name, int color_space, bool full_range,
+                       int bitdepth, const Matrix& matrix) {
+  const YuvToRgbCoefficients c = exoplayer_jni::GetYuvToRgbCoefficients(
+      color_space, full_range, bitdepth);
+  const int shift = bitdepth - 8;
+  bool passed = true;
+  if (c.y_offset != (full_range ? 0 : 16 << shift) ||
+      c.chroma_offset != 128 << shift) {
+    fprintf(stderr, "%s: offsets are %d and %d\n", name, c.y_offset,
+            c.chroma_offset);
+    passed = false;
+  }
+  passed &= Near(name, "y", c.y, matrix.y);
+  passed &= Near(name, "v_to_r", c.v_to_r, matrix.v_to_r);
+  passed &= Near(name, "u_to_g", c.u_to_g, matrix.u_to_g);
+  passed &= Near(name, "v_to_g", c.v_to_g, matrix.v_to_g);
+  passed &= Near(name, "u_to_b", c.u_to_b, matrix.u_to_b);
+  if (passed) printf("%s: OK\n", name);
+  return passed;
+}
+
+bool CheckAllCoefficients() {
+  // Limited range 8-bit matrices, which scale luma by 255 / 219 and chroma by
+  // 255 / 224.
+  const Matrix bt601_limited = {1.164, 1.596, -0.392, -0.813, 2.018};
+  const Matrix bt709_limited = {1.164, 1.793, -0.213, -0.533, 2.112};
+  const Matrix bt2020_limited = {1.164, 1.679, -0.187, -0.650, 2.142};
+  const Matrix bt601_full = {1.0, 1.402, -0.344, -0.714, 1.772};
+  const Matrix bt709_full = {1.0, 1.575, -0.187, -0.468, 1.856};
+  const Matrix bt2020_full = {1.0, 1.475, -0.165, -0.571, 1.881};
+  // 10-bit limited range scales luma by 1023 / 876 and chroma by 1023 / 896.
+  const double y_10 = 1023.0 / 876;
+  const double chroma_10 = 1023.0 / 896;
+  const Matrix bt2020_limited_10 = {y_10, 1.4746 * chroma_10,
+                                    -0.16455 * chroma_10, -0.57135 * chroma_10,
+                                    1.8814 * chroma_10};
+  bool passed = true;
+  passed &= CheckCoefficients("BT.601 limited", exoplayer_jni::kColorSpaceBT601,
+                              false, 8, bt601_limited);
+  passed &= CheckCoefficients("BT.709 limited", exoplayer_jni::kColorSpaceBT709,
+                              false, 8, bt709_limited);
+  passed &= CheckCoefficients("BT.2020 limited",
+                              exoplayer_jni::kColorSpaceBT2020, false, 8,
+                              bt2020_limited);
+  passed &= CheckCoefficients("BT.601 full", exoplayer_jni::kColorSpaceBT601,
+                              true, 8, bt601_full);
+  passed &= CheckCoefficients("BT.709 full", exoplayer_jni::kColorSpaceBT709,
+                              true, 8, bt709_full);
+  passed &= CheckCoefficients("BT.2020 full", exoplayer_jni::kColorSpaceBT2020,
+                              true, 8, bt2020_full);
+  passed &= CheckCoefficients("Unknown as BT.709",
+                              exoplayer_jni::kColorSpaceUnknown, false, 8,
+                              bt709_limited);
+  passed &= CheckCoefficients("BT.2020 limited 10-bit",
+                              exoplayer_jni::kColorSpaceBT2020, false, 10,
+                              bt2020_limited_10);
+  return passed;
+}
+
+// Checks that black, white and grey map to the ends and middle of the output
+// range, in limited and full range.
+bool CheckGreys() {
+  struct Grey {
+    int bitdepth;
+    bool full_range;
+    int y;
+    int expected;
+  };
+  const Grey greys[] = {
+      {8, false, 16, 0},      {8, false, 235, 255},   {8, false, 0, 0},
+      {8, false, 255, 255},   {8, true, 0, 0},        {8, true, 255, 255},
+      {8, true, 128, 128},    {10, false, 64, 0},     {10, false, 940, 1023},
+      {10, true, 0, 0},       {10, true, 1023, 1023}, {10, true, 512, 512},
+  };
+  bool passed = true;
+  for (const Grey& grey : greys) {
+    const YuvToRgbCoefficients c = exoplayer_jni::GetYuvToRgbCoefficients(
+        exoplayer_jni::kColorSpaceBT709, grey.full_range, grey.bitdepth);
+    int components[3];
+    if (grey.bitdepth == 8) {
+      const uint8_t y = grey.y;
+      const uint8_t chroma = c.chroma_offset;
+      uint8_t rgba[4];
+      exoplayer_jni::ConvertRowToRgba8888(&y, &chroma, &chroma, 1, c, rgba);
+      for (int i = 0; i < 3; i++) components[i] = rgba[i];
+    } else {
+      const uint16_t y = grey.y;
+      const uint16_t chroma = c.chroma_offset;
+      uint32_t rgba;
+      exoplayer_jni::ConvertRowToRgba1010102(&y, &chroma, &chroma, 1, c,
+                                             &rgba);
+      for (int i = 0; i < 3; i++) components[i] = (rgba >> (10 * i)) & 1023;
+    }
+    for (int i = 0; i < 3; i++) {
+      if (components[i] != grey.expected) {
+        fprintf(stderr, "%d-bit %s range Y %d: component %d is %d, expected %d\n",
+                grey.bitdepth, grey.full_range ? "full" : "limited", grey.y, i,
+                components[i], grey.expected);
+        passed = false;
+      }
+    }
+  }
+  if (passed) printf("Greys: OK\n");
+  return passed;
+}
+
+// Scalar reference conversion of one sample, clamped to |max_value|.
+void ReferenceRgb(int y, int u, int v, const YuvToRgbCoefficients& c,
+                  int max_value, int rgb[3]) {
+  const int shift = exoplayer_jni::kRgbCoefficientBits;
+  const int y_term = (y - c.y_offset) * c.y + (1 << (shift - 1));
+  const int u_sample = u - c.chroma_offset;
+  const int v_sample = v - c.chroma_offset;
+  rgb[0] = (y_term + c.v_to_r * v_sample) >> shift;
+  rgb[1] = (y_term + c.u_to_g * u_sample + c.v_to_g * v_sample) >> shift;
+  rgb[2] = (y_term + c.u_to_b * u_sample) >> shift;
+  for (int i = 0; i < 3; i++) {
+    rgb[i] = rgb[i] < 0 ? 0 : rgb[i] > max_value ? max_value : rgb[i];
+  }
+}
+
+// Returns whether the row converter of |bitdepth| matches ReferenceRgb() for
+// rows of every width up to kMaxWidth, so that each tail length of the 8
+// sample vector loops is covered, and for random rows after that. Samples
+// cover the whole range, so that the components saturate.
+bool MatchesReference(int bitdepth) {
+  std::mt19937 random(1234);
+  const int max_value = (1 << bitdepth) - 1;
+  std::uniform_int_distribution<int> sample_distribution(0, max_value);
+  std::vector<uint16_t> y(kMaxWidth);
+  std::vector<uint16_t> u(kMaxWidth);
+  std::vector<uint16_t> v(kMaxWidth);
+  std::vector<uint8_t> y8(kMaxWidth);
+  std::vector<uint8_t> u8(kMaxWidth);
+  std::vector<uint8_t> v8(kMaxWidth);
+  std::vector<uint8_t> rgba8888(4 * kMaxWidth);
+  std::vector<uint32_t> rgba1010102(kMaxWidth);
+  const int color_spaces[] = {
+      exoplayer_jni::kColorSpaceBT601, exoplayer_jni::kColorSpaceBT709,
+      exoplayer_jni::kColorSpaceBT2020};
+  for (int iteration = 0; iteration < kIterations; iteration++) {
+    const int width = iteration <= kMaxWidth ? iteration : random() % kMaxWidth;
+    const bool full_range = iteration % 2 == 0;
+    const YuvToRgbCoefficients c = exoplayer_jni::GetYuvToRgbCoefficients(
+        color_spaces[iteration % 3], full_range, bitdepth);
+    for (int i = 0; i < width; i++) {
+      y[i] = y8[i] = sample_distribution(random);
+      u[i] = u8[i] = sample_distribution(random);
+      v[i] = v8[i] = sample_distribution(random);
+    }
+    if (bitdepth == 8) {
+      exoplayer_jni::ConvertRowToRgba8888(y8.data(), u8.data(), v8.data(),
+                                          width, c, rgba8888.data());
+    } else {
+      exoplayer_jni::ConvertRowToRgba1010102(y.data(), u.data(), v.data(),
+                                             width, c, rgba1010102.data());
+    }
+    for (int x = 0; x < width; x++) {
+      int expected[3];
+      ReferenceRgb(y[x], u[x / 2], v[x / 2], c, max_value, expected);
+      int actual[4];
+      int expected_alpha;
+      if (bitdepth == 8) {
+        for (int i = 0; i < 4; i++) actual[i] = rgba8888[4 * x + i];
+        expected_alpha = 255;
+      } else {
+        for (int i = 0; i < 4; i++) {
+          actual[i] = (rgba1010102[x] >> (10 * i)) & 1023;
+        }
+        expected_alpha = 3;
+      }
+      if (actual[0] != expected[0] || actual[1] != expected[1] ||
+          actual[2] != expected[2] || actual[3] != expected_alpha) {
+        fprintf(stderr,
+                "%d-bit: width %d: pixel %d is (%d, %d, %d, %d), expected "
+                "(%d, %d, %d, %d)\n",
+                bitdepth, width, x, actual[0], actual[1], actual[2], actual[3],
+                expected[0], expected[1], expected[2], expected_alpha);
+        return false;
+      }
+    }
+  }
+  printf("%d-bit rows: OK\n", bitdepth);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= CheckAllCoefficients();
+  passed &= CheckGreys();
+  passed &= MatchesReference(8);
+  passed &= MatchesReference(10);
+  return passed ? 0 : 1;
+}
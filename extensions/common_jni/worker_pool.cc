@@ -0,0 +1,86 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "worker_pool.h"  // NOLINT
+
+#include <algorithm>
+
+#include "cpu_info.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+WorkerPool& WorkerPool::GetInstance() {
+  static WorkerPool* const instance = new WorkerPool();
+  return *instance;
+}
+
+void WorkerPool::ParallelFor(int task_count,
+                             const std::function<void(int)>& task) {
+  if (threads_.empty() || task_count < 2) {
+    for (int i = 0; i < task_count; i++) task(i);
+    return;
+  }
+  Job job(task, task_count);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(&job);
+  }
+  job_condition_.notify_all();
+  RunTasks(&job);
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Stop pool threads from joining the job, then wait for those that did.
+  const auto it = std::find(jobs_.begin(), jobs_.end(), &job);
+  if (it != jobs_.end()) jobs_.erase(it);
+  done_condition_.wait(lock, [&job] { return job.active_thread_count == 0; });
+}
+
+WorkerPool::WorkerPool() {
+  int core_count = GetNumberOfPerformanceCoresOnline();
+  if (core_count <= 0) {
+    core_count = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  // The calling thread takes part in its jobs.
+  for (int i = 1; i < core_count; i++) {
+    threads_.emplace_back(&WorkerPool::Run, this);
+  }
+}
+
+void WorkerPool::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    job_condition_.wait(lock, [this] { return !jobs_.empty(); });
+    Job* const job = jobs_.front();
+    if (job->next_task.load() >= job->task_count) {
+      // All the tasks of the job have been taken.
+      jobs_.pop_front();
+      continue;
+    }
+    job->active_thread_count++;
+    lock.unlock();
+    RunTasks(job);
+    lock.lock();
+    if (--job->active_thread_count == 0) done_condition_.notify_all();
+  }
+}
+
+// static
+void WorkerPool::RunTasks(Job* job) {
+  int index;
+  while ((index = job->next_task.fetch_add(1)) < job->task_count) {
+    job->task(index);
+  }
+}
+
+}  // namespace exoplayer_jni
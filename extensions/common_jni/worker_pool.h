@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_WORKER_POOL_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace exoplayer_jni {
+
+// A pool of threads shared by all the decoder contexts of a native library for
+// the pixel work done after decoding. Each extension library links its own
+// pool. Its threads and the threads calling ParallelFor() together use at most
+// one thread per performance core.
+//
+// Jobs submitted concurrently are queued first in, first out: the pool threads
+// take tasks from the oldest job that has tasks left, while each calling
+// thread runs tasks of its own job, so no job waits for another to finish.
+// Tasks are taken from a counter shared by the threads running the job, not
+// stolen from per-thread queues.
+class WorkerPool {
+ public:
+  // Returns the pool of the library. It is never destroyed.
+  static WorkerPool& GetInstance();
+
+  // Returns whether the pool has threads to share work with.
+  bool HasThreads() const { return !threads_.empty(); }
+
+  // Runs |task| for each index in [0, |task_count|) on the pool threads and
+  // the calling thread, and returns once all of them have run.
+  void ParallelFor(int task_count, const std::function<void(int)>& task);
+
+ private:
+  struct Job {
+    Job(const std::function<void(int)>& task, int task_count)
+        : task(task), task_count(task_count) {}
+
+    const std::function<void(int)>& task;
+    const int task_count;
+    std::atomic<int> next_task{0};
+    // Number of pool threads running tasks of the job. Guarded by |mutex_|.
+    int active_thread_count = 0;
+  };
+
+  WorkerPool();
+
+  void Run();
+  static void RunTasks(Job* job);
+
+  std::mutex mutex_;
+  std::condition_variable job_condition_;
+  std::condition_variable done_condition_;
+  // Jobs that may have tasks left, oldest first. Guarded by |mutex_|.
+  std::deque<Job*> jobs_;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_WORKER_POOL_H_
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "yuv_to_rgba.h"  // NOLINT
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define EXOPLAYER_JNI_HAS_NEON
+#elif defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define EXOPLAYER_JNI_HAS_SSE2
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace exoplayer_jni {
+namespace {
+
+constexpr int kRgbRounding = 1 << (kRgbCoefficientBits - 1);
+
+#if defined(EXOPLAYER_JNI_HAS_NEON)
+// Converts eight pairs of |y| and |u|, |v| samples, offset to be signed, to
+// RGB components saturated to 16 bits.
+inline void ConvertToRgbNeon(int16x8_t y, int16x8_t u, int16x8_t v,
+                             const YuvToRgbCoefficients& coefficients,
+                             int16x8_t* r, int16x8_t* g, int16x8_t* b) {
+  int16x4_t halves[3][2];
+  for (int half = 0; half < 2; half++) {
+    const int16x4_t y_half = half ? vget_high_s16(y) : vget_low_s16(y);
+    const int16x4_t u_half = half ? vget_high_s16(u) : vget_low_s16(u);
+    const int16x4_t v_half = half ? vget_high_s16(v) : vget_low_s16(v);
+    const int32x4_t y_term = vmull_n_s16(y_half, coefficients.y);
+    // Rounding shifts, which add kRgbRounding as the scalar conversion does.
+    halves[0][half] = vqrshrn_n_s32(
+        vmlal_n_s16(y_term, v_half, coefficients.v_to_r), kRgbCoefficientBits);
+    halves[1][half] = vqrshrn_n_s32(
+        vmlal_n_s16(vmlal_n_s16(y_term, u_half, coefficients.u_to_g), v_half,
+                    coefficients.v_to_g),
+        kRgbCoefficientBits);
+    halves[2][half] = vqrshrn_n_s32(
+        vmlal_n_s16(y_term, u_half, coefficients.u_to_b), kRgbCoefficientBits);
+  }
+  *r = vcombine_s16(halves[0][0], halves[0][1]);
+  *g = vcombine_s16(halves[1][0], halves[1][1]);
+  *b = vcombine_s16(halves[2][0], halves[2][1]);
+}
+#elif defined(EXOPLAYER_JNI_HAS_SSE2)
+// Returns a vector of (|first|, |second|) 16-bit pairs, to be used with
+// _mm_madd_epi16().
+inline __m128i CoefficientPairs(int first, int second) {
+  return _mm_set1_epi32(static_cast<int>(
+      (static_cast<uint32_t>(second) << 16) | static_cast<uint16_t>(first)));
+}
+
+// Converts eight pairs of |y| and |u|, |v| samples, offset to be signed, to
+// RGB components saturated to 16 bits.
+inline void ConvertToRgbSse2(__m128i y, __m128i u, __m128i v,
+                             const YuvToRgbCoefficients& coefficients,
+                             __m128i components[3]) {
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i y_coefficients = CoefficientPairs(coefficients.y, kRgbRounding);
+  const __m128i uv_coefficients[3] = {
+      CoefficientPairs(0, coefficients.v_to_r),
+      CoefficientPairs(coefficients.u_to_g, coefficients.v_to_g),
+      CoefficientPairs(coefficients.u_to_b, 0)};
+  for (int component = 0; component < 3; component++) {
+    __m128i halves[2];
+    for (int half = 0; half < 2; half++) {
+      const __m128i y_pairs =
+          half ? _mm_unpackhi_epi16(y, ones) : _mm_unpacklo_epi16(y, ones);
+      const __m128i uv_pairs =
+          half ? _mm_unpackhi_epi16(u, v) : _mm_unpacklo_epi16(u, v);
+      halves[half] = _mm_srai_epi32(
+          _mm_add_epi32(_mm_madd_epi16(y_pairs, y_coefficients),
+                        _mm_madd_epi16(uv_pairs, uv_coefficients[component])),
+          kRgbCoefficientBits);
+    }
+    components[component] = _mm_packs_epi32(halves[0], halves[1]);
+  }
+}
+#endif
+
+// Converts one sample of each plane to unclamped RGB components.
+inline void ConvertToRgb(int y, int u, int v,
+                         const YuvToRgbCoefficients& coefficients, int* r,
+                         int* g, int* b) {
+  const int y_term =
+      (y - coefficients.y_offset) * coefficients.y + kRgbRounding;
+  const int u_sample = u - coefficients.chroma_offset;
+  const int v_sample = v - coefficients.chroma_offset;
+  *r = (y_term + coefficients.v_to_r * v_sample) >> kRgbCoefficientBits;
+  *g = (y_term + coefficients.u_to_g * u_sample +
+        coefficients.v_to_g * v_sample) >>
+       kRgbCoefficientBits;
+  *b = (y_term + coefficients.u_to_b * u_sample) >> kRgbCoefficientBits;
+}
+
+}  // namespace
+
+YuvToRgbCoefficients GetYuvToRgbCoefficients(int color_space, bool full_range,
+                                             int bitdepth) {
+  double kr = 0.2126;
+  double kb = 0.0722;
+  if (color_space == kColorSpaceBT601) {
+    kr = 0.299;
+    kb = 0.114;
+  } else if (color_space == kColorSpaceBT2020) {
+    kr = 0.2627;
+    kb = 0.0593;
+  }
+  const double kg = 1 - kr - kb;
+  const int shift = bitdepth - 8;
+  const double max_value = (1 << bitdepth) - 1;
+  const double y_scale = full_range ? 1 : max_value / (219 << shift);
+  const double chroma_scale = (full_range ? 1 : max_value / (224 << shift)) *
+                              (1 << kRgbCoefficientBits);
+  YuvToRgbCoefficients coefficients;
+  coefficients.y_offset = full_range ? 0 : 16 << shift;
+  coefficients.chroma_offset = 128 << shift;
+  coefficients.y = std::lround(y_scale * (1 << kRgbCoefficientBits));
+  coefficients.v_to_r = std::lround(2 * (1 - kr) * chroma_scale);
+  coefficients.u_to_g = -std::lround(2 * (1 - kb) * kb / kg * chroma_scale);
+  coefficients.v_to_g = -std::lround(2 * (1 - kr) * kr / kg * chroma_scale);
+  coefficients.u_to_b = std::lround(2 * (1 - kb) * chroma_scale);
+  return coefficients;
+}
+
+void ConvertRowToRgba8888(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                          int width, const YuvToRgbCoefficients& coefficients,
+                          uint8_t* rgba) {
+  int x = 0;
+#if defined(EXOPLAYER_JNI_HAS_NEON)
+  const int16x8_t y_offset = vdupq_n_s16(coefficients.y_offset);
+  const int16x8_t chroma_offset = vdupq_n_s16(coefficients.chroma_offset);
+  uint8x8x4_t pixels;
+  pixels.val[3] = vdup_n_u8(255);
+  for (; x + 8 <= width; x += 8) {
+    uint32_t u_samples;
+    uint32_t v_samples;
+    std::memcpy(&u_samples, u + x / 2, sizeof(u_samples));
+    std::memcpy(&v_samples, v + x / 2, sizeof(v_samples));
+    const uint8x8_t u_pairs =
+        vzip_u8(vcreate_u8(u_samples), vcreate_u8(u_samples)).val[0];
+    const uint8x8_t v_pairs =
+        vzip_u8(vcreate_u8(v_samples), vcreate_u8(v_samples)).val[0];
+    int16x8_t r;
+    int16x8_t g;
+    int16x8_t b;
+    ConvertToRgbNeon(
+        vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + x))), y_offset),
+        vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u_pairs)), chroma_offset),
+        vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v_pairs)), chroma_offset),
+        coefficients, &r, &g, &b);
+    pixels.val[0] = vqmovun_s16(r);
+    pixels.val[1] = vqmovun_s16(g);
+    pixels.val[2] = vqmovun_s16(b);
+    vst4_u8(rgba + 4 * x, pixels);
+  }
+#elif defined(EXOPLAYER_JNI_HAS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i y_offset = _mm_set1_epi16(coefficients.y_offset);
+  const __m128i chroma_offset = _mm_set1_epi16(coefficients.chroma_offset);
+  const __m128i alpha = _mm_set1_epi8(-1);
+  for (; x + 8 <= width; x += 8) {
+    int u_samples;
+    int v_samples;
+    std::memcpy(&u_samples, u + x / 2, sizeof(u_samples));
+    std::memcpy(&v_samples, v + x / 2, sizeof(v_samples));
+    const __m128i y16 = _mm_sub_epi16(
+        _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)), zero),
+        y_offset);
+    __m128i u16 = _mm_sub_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(u_samples), zero), chroma_offset);
+    __m128i v16 = _mm_sub_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(v_samples), zero), chroma_offset);
+    u16 = _mm_unpacklo_epi16(u16, u16);
+    v16 = _mm_unpacklo_epi16(v16, v16);
+    __m128i components[3];
+    ConvertToRgbSse2(y16, u16, v16, coefficients, components);
+    for (int component = 0; component < 3; component++) {
+      components[component] =
+          _mm_packus_epi16(components[component], components[component]);
+    }
+    const __m128i rg = _mm_unpacklo_epi8(components[0], components[1]);
+    const __m128i ba = _mm_unpacklo_epi8(components[2], alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * x),
+                     _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * x + 16),
+                     _mm_unpackhi_epi16(rg, ba));
+  }
+#endif
+  for (; x < width; x++) {
+    int r;
+    int g;
+    int b;
+    ConvertToRgb(y[x], u[x / 2], v[x / 2], coefficients, &r, &g, &b);
+    rgba[4 * x] = std::min(std::max(r, 0), 255);
+    rgba[4 * x + 1] = std::min(std::max(g, 0), 255);
+    rgba[4 * x + 2] = std::min(std::max(b, 0), 255);
+    rgba[4 * x + 3] = 255;
+  }
+}
+
+void ConvertRowToRgba1010102(const uint16_t* y, const uint16_t* u,
+                             const uint16_t* v, int width,
+                             const YuvToRgbCoefficients& coefficients,
+                             uint32_t* rgba) {
+  int x = 0;
+#if defined(EXOPLAYER_JNI_HAS_NEON)
+  const int16x8_t y_offset = vdupq_n_s16(coefficients.y_offset);
+  const int16x8_t chroma_offset = vdupq_n_s16(coefficients.chroma_offset);
+  const int16x8_t zero = vdupq_n_s16(0);
+  const int16x8_t max_value = vdupq_n_s16(1023);
+  const uint32x4_t alpha = vdupq_n_u32(3u << 30);
+  for (; x + 8 <= width; x += 8) {
+    const uint16x4_t u_samples = vld1_u16(u + x / 2);
+    const uint16x4_t v_samples = vld1_u16(v + x / 2);
+    const uint16x4x2_t u_pairs = vzip_u16(u_samples, u_samples);
+    const uint16x4x2_t v_pairs = vzip_u16(v_samples, v_samples);
+    int16x8_t components[3];
+    ConvertToRgbNeon(
+        vsubq_s16(vreinterpretq_s16_u16(vld1q_u16(y + x)), y_offset),
+        vsubq_s16(vreinterpretq_s16_u16(
+                      vcombine_u16(u_pairs.val[0], u_pairs.val[1])),
+                  chroma_offset),
+        vsubq_s16(vreinterpretq_s16_u16(
+                      vcombine_u16(v_pairs.val[0], v_pairs.val[1])),
+                  chroma_offset),
+        coefficients, &components[0], &components[1], &components[2]);
+    uint16x8_t clamped[3];
+    for (int component = 0; component < 3; component++) {
+      clamped[component] = vreinterpretq_u16_s16(
+          vminq_s16(vmaxq_s16(components[component], zero), max_value));
+    }
+    for (int half = 0; half < 2; half++) {
+      const uint32x4_t r = vmovl_u16(half ? vget_high_u16(clamped[0])
+                                          : vget_low_u16(clamped[0]));
+      const uint32x4_t g = vmovl_u16(half ? vget_high_u16(clamped[1])
+                                          : vget_low_u16(clamped[1]));
+      const uint32x4_t b = vmovl_u16(half ? vget_high_u16(clamped[2])
+                                          : vget_low_u16(clamped[2]));
+      vst1q_u32(rgba + x + 4 * half,
+                vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 10)),
+                          vorrq_u32(vshlq_n_u32(b, 20), alpha)));
+    }
+  }
+#elif defined(EXOPLAYER_JNI_HAS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max_value = _mm_set1_epi16(1023);
+  const __m128i y_offset = _mm_set1_epi16(coefficients.y_offset);
+  const __m128i chroma_offset = _mm_set1_epi16(coefficients.chroma_offset);
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(3u << 30));
+  for (; x + 8 <= width; x += 8) {
+    const __m128i y16 = _mm_sub_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)), y_offset);
+    __m128i u16 = _mm_sub_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2)),
+        chroma_offset);
+    __m128i v16 = _mm_sub_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2)),
+        chroma_offset);
+    u16 = _mm_unpacklo_epi16(u16, u16);
+    v16 = _mm_unpacklo_epi16(v16, v16);
+    __m128i components[3];
+    ConvertToRgbSse2(y16, u16, v16, coefficients, components);
+    for (int component = 0; component < 3; component++) {
+      components[component] = _mm_min_epi16(
+          _mm_max_epi16(components[component], zero), max_value);
+    }
+    for (int half = 0; half < 2; half++) {
+      const __m128i r = half ? _mm_unpackhi_epi16(components[0], zero)
+                             : _mm_unpacklo_epi16(components[0], zero);
+      const __m128i g = half ? _mm_unpackhi_epi16(components[1], zero)
+                             : _mm_unpacklo_epi16(components[1], zero);
+      const __m128i b = half ? _mm_unpackhi_epi16(components[2], zero)
+                             : _mm_unpacklo_epi16(components[2], zero);
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(rgba + x + 4 * half),
+          _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 10)),
+                       _mm_or_si128(_mm_slli_epi32(b, 20), alpha)));
+    }
+  }
+#endif
+  for (; x < width; x++) {
+    int r;
+    int g;
+    int b;
+    ConvertToRgb(y[x], u[x / 2], v[x / 2], coefficients, &r, &g, &b);
+    rgba[x] = static_cast<uint32_t>(std::min(std::max(r, 0), 1023)) |
+              (static_cast<uint32_t>(std::min(std::max(g, 0), 1023)) << 10) |
+              (static_cast<uint32_t>(std::min(std::max(b, 0), 1023)) << 20) |
+              (3u << 30);
+  }
+}
+
+}  // namespace exoplayer_jni
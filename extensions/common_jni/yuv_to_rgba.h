@@ -0,0 +1,70 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_YUV_TO_RGBA_H_
+#define EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_YUV_TO_RGBA_H_
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Color spaces. See VideoDecoderOutputBuffer.
+constexpr int kColorSpaceUnknown = 0;
+constexpr int kColorSpaceBT601 = 1;
+constexpr int kColorSpaceBT709 = 2;
+constexpr int kColorSpaceBT2020 = 3;
+
+// RGBA pixel formats. See VideoDecoderOutputBuffer.
+constexpr int kRgbaFormat8888 = 0;
+constexpr int kRgbaFormat1010102 = 1;
+
+constexpr int kRgbCoefficientBits = 13;
+
+// Fixed-point coefficients converting YUV samples to RGB samples of the same
+// bit depth, in units of 1 / (1 << kRgbCoefficientBits).
+struct YuvToRgbCoefficients {
+  int y_offset;
+  int chroma_offset;
+  int y;
+  int v_to_r;
+  int u_to_g;
+  int v_to_g;
+  int u_to_b;
+};
+
+// Returns the coefficients converting |bitdepth|-bit YUV samples in the given
+// color space and range. Unknown color spaces are converted as BT.709, as in
+// the video renderers.
+YuvToRgbCoefficients GetYuvToRgbCoefficients(int color_space, bool full_range,
+                                             int bitdepth);
+
+// Converts a row of |width| 8-bit samples, with horizontally subsampled
+// chroma, to RGBA_8888 pixels. Uses NEON or SSE2 where available, bit-exact
+// with the scalar conversion.
+void ConvertRowToRgba8888(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                          int width, const YuvToRgbCoefficients& coefficients,
+                          uint8_t* rgba);
+
+// Converts a row of |width| 10-bit samples, with horizontally subsampled
+// chroma, to RGBA_1010102 pixels. Uses NEON or SSE2 where available,
+// bit-exact with the scalar conversion.
+void ConvertRowToRgba1010102(const uint16_t* y, const uint16_t* u,
+                             const uint16_t* v, int width,
+                             const YuvToRgbCoefficients& coefficients,
+                             uint32_t* rgba);
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_COMMON_JNI_YUV_TO_RGBA_H_
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.dav1d;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import androidx.annotation.Nullable;
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.VideoDecoderOutputBuffer;
+import com.google.android.exoplayer2.extractor.mp4.Mp4Extractor;
+import com.google.android.exoplayer2.testutil.FakeExtractorOutput;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.util.Util;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Tests for {@link Gav1Decoder}. */
+@RunWith(AndroidJUnit4.class)
+public final class Gav1DecoderTest {
+
+  // 60 frames, more than the 32 native frame buffers of a decoder.
+  private static final String AV1_FILE = "media/mp4/sample_with_colr_mdcv_and_clli.mp4";
+  private static final int TIMEOUT_MS = 10_000;
+
+  private int outputFrameCount;
+
+  @Before
+  public void setUp() {
+    if (!Gav1Library.isAvailable()) {
+      fail("Dav1d library not available.");
+    }
+  }
+
+  @Test
+  public void decodeInRgbaMode_moreFramesThanNativeBuffers_outputsEveryFrame() throws Exception {
+    FakeExtractorOutput extractorOutput =
+        TestUtil.extractAllSamplesFromFile(
+            new Mp4Extractor(), ApplicationProvider.getApplicationContext(), AV1_FILE);
+    FakeTrackOutput trackOutput = extractorOutput.trackOutputs.get(0);
+    Gav1Decoder decoder =
+        new Gav1Decoder(
+            /* numInputBuffers= */ 4,
+            /* numOutputBuffers= */ 4,
+            /* initialInputBufferSize= */ 0,
+            /* threads= */ 1);
+    decoder.setOutputMode(C.VIDEO_OUTPUT_MODE_RGBA);
+    // Output each frame as soon as it is decoded, so that all of them are output.
+    decoder.setBlockingDequeueEnabled(true);
+
+    try {
+      for (int i = 0; i < trackOutput.getSampleCount(); i++) {
+        byte[] sample = trackOutput.getSampleData(i);
+        DecoderInputBuffer inputBuffer = dequeueInputBuffer(decoder);
+        inputBuffer.ensureSpaceForWrite(sample.length);
+        Util.castNonNull(inputBuffer.data).put(sample);
+        inputBuffer.flip();
+        inputBuffer.timeUs = trackOutput.getSampleTimeUs(i);
+        decoder.queueInputBuffer(inputBuffer);
+        drainOutputBuffers(decoder);
+      }
+      long deadlineMs = System.currentTimeMillis() + TIMEOUT_MS;
+      while (outputFrameCount < 33 && System.currentTimeMillis() < deadlineMs) {
+        drainOutputBuffers(decoder);
+        Thread.sleep(10);
+      }
+    } finally {
+      decoder.release();
+    }
+
+    // Each frame copied out in RGBA mode used to keep one of the native frame buffers, so
+    // decoding failed after 32 frames.
+    assertThat(outputFrameCount).isGreaterThan(32);
+  }
+
+  private DecoderInputBuffer dequeueInputBuffer(Gav1Decoder decoder) throws Exception {
+    long deadlineMs = System.currentTimeMillis() + TIMEOUT_MS;
+    while (System.currentTimeMillis() < deadlineMs) {
+      @Nullable DecoderInputBuffer inputBuffer = decoder.dequeueInputBuffer();
+      if (inputBuffer != null) {
+        return inputBuffer;
+      }
+      drainOutputBuffers(decoder);
+      Thread.sleep(10);
+    }
+    throw new AssertionError("Timed out waiting for an input buffer.");
+  }
+
+  /** Releases the output buffers that are ready, counting them in {@link #outputFrameCount}. */
+  private void drainOutputBuffers(Gav1Decoder decoder) throws Exception {
+    @Nullable VideoDecoderOutputBuffer outputBuffer;
+    while ((outputBuffer = decoder.dequeueOutputBuffer()) != null) {
+      assertThat(outputBuffer.mode).isEqualTo(C.VIDEO_OUTPUT_MODE_RGBA);
+      assertThat(outputBuffer.data).isNotNull();
+      outputFrameCount++;
+      outputBuffer.release();
+    }
+  }
+}
@@ -18,13 +18,18 @@ package com.google.android.exoplayer2.ext.dav1d;
 import static androidx.annotation.VisibleForTesting.PACKAGE_PRIVATE;
 import static java.lang.Runtime.getRuntime;
 
+import android.util.Log;
 import android.view.Surface;
 import androidx.annotation.Nullable;
 import androidx.annotation.VisibleForTesting;
 import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.decoder.DecodedFrameRateTracker;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.DecoderThreadBudget;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
+import com.google.android.exoplayer2.decoder.TemporalUnitInfo;
 import com.google.android.exoplayer2.decoder.VideoDecoderOutputBuffer;
+import com.google.android.exoplayer2.decoder.VideoDecoderPreroll;
 import com.google.android.exoplayer2.util.Util;
 import java.nio.ByteBuffer;
 
@@ -38,6 +43,18 @@ public final class Gav1Decoder
   private static final int GAV1_DECODE_ONLY = 2;
 
   private final long gav1DecoderContext;
+  private final DecoderThreadBudget.Registration threadBudgetRegistration;
+  private final VideoDecoderPreroll preroll;
+  private final DecodedFrameRateTracker trickPlayFrameRate;
+
+  private volatile boolean blockingDequeueEnabled;
+  private volatile StreamLimits streamLimits;
+  private volatile boolean trickPlayEnabled;
+  private int decoderThreads;
+  private boolean decoderBlockingDequeue;
+  private StreamLimits decoderStreamLimits;
+  private boolean hasDecoded;
+  private boolean decoderTrickPlay;
 
   private volatile @C.VideoOutputMode int outputMode;
 
@@ -49,13 +66,18 @@ public final class Gav1Decoder
    * @param initialInputBufferSize The initial size of each input buffer, in bytes.
    * @param threads Number of threads libgav1 will use to decode. If {@link
    *     Libdav1dVideoRenderer#THREAD_COUNT_AUTODETECT} is passed, then this class will auto detect
-   *     the number of threads to be used.
+   *     the number of threads to be used. The decoder may use fewer threads when other decoders
+   *     share the {@link DecoderThreadBudget}.
    * @throws Gav1DecoderException Thrown if an exception occurs when initializing the decoder.
    */
   public Gav1Decoder(
       int numInputBuffers, int numOutputBuffers, int initialInputBufferSize, int threads)
       throws Gav1DecoderException {
     super(new DecoderInputBuffer[numInputBuffers], new VideoDecoderOutputBuffer[numOutputBuffers]);
+    preroll = new VideoDecoderPreroll();
+    trickPlayFrameRate = new DecodedFrameRateTracker();
+    streamLimits = StreamLimits.NONE;
+    decoderStreamLimits = StreamLimits.NONE;
     if (!Gav1Library.isAvailable()) {
       throw new Gav1DecoderException("Failed to load decoder native library.");
     }
@@ -69,14 +91,134 @@ public final class Gav1Decoder
       }
     }
 
-    gav1DecoderContext = gav1Init(threads);
+    threadBudgetRegistration =
+        DecoderThreadBudget.getInstance()
+            .register(DecoderThreadBudget.PRIORITY_FOREGROUND, threads);
+    decoderThreads = threadBudgetRegistration.getThreadCount();
+    gav1DecoderContext = gav1Init(decoderThreads);
     if (gav1DecoderContext == GAV1_ERROR || gav1CheckError(gav1DecoderContext) == GAV1_ERROR) {
+      threadBudgetRegistration.unregister();
       throw new Gav1DecoderException(
           "Failed to initialize decoder. Error: " + gav1GetErrorMessage(gav1DecoderContext));
     }
     setInitialInputBufferSize(initialInputBufferSize);
   }
 
+  /**
+   * Initializes native decoders ahead of time and keeps them idle, so that decoders created later,
+   * for example when switching channels or tracks, start without waiting for dav1d to initialize.
+   * Closed decoders are also kept idle for reuse. At most two idle decoders are kept.
+   *
+   * <p>Idle decoders are kept with a single thread, so that they hold no threads outside the
+   * {@link DecoderThreadBudget}. A decoder that reuses one starts the threads it is given.
+   *
+   * @param count Number of decoders to initialize.
+   */
+  public static void prewarm(int count) {
+    if (Gav1Library.isAvailable()) {
+      gav1Prewarm(count);
+    }
+  }
+
+  /**
+   * Sets how many bytes of picture memory released by decoders with a {@link
+   * #setStreamLimits(int, int, boolean, long) picture budget} are kept for new decoders to reuse. A
+   * decoder created after another one is closed, for example when a track or resolution change
+   * re-creates the decoder, then reuses memory that is already mapped instead of allocating it
+   * again. The least recently released memory is freed first. The default is 64 MiB. Setting 0
+   * frees the kept memory, for example when the app is asked to trim its memory.
+   *
+   * @param capacityBytes The maximum number of bytes kept.
+   */
+  public static void setFrameArenaCapacity(long capacityBytes) {
+    if (Gav1Library.isAvailable()) {
+      gav1SetFrameArenaCapacity(capacityBytes);
+    }
+  }
+
+  /**
+   * Sets the minimum priority of the messages logged by the native decoder. Messages below it cost
+   * next to nothing. The default is {@link Log#WARN}. Debug and verbose messages are compiled out
+   * of release builds of the native library.
+   *
+   * @param priority One of the {@link Log} priorities, such as {@link Log#VERBOSE}.
+   */
+  public static void setNativeLogLevel(int priority) {
+    if (Gav1Library.isAvailable()) {
+      gav1SetLogLevel(priority);
+    }
+  }
+
+  /**
+   * Sets whether the native decoder writes its messages to an in-memory ring of recent messages
+   * instead of logcat, so that verbose logging does not distort benchmarks. Errors are written to
+   * logcat in either case. The ring is read with {@link #getNativeLogRing()}.
+   */
+  public static void setNativeLogRingEnabled(boolean enabled) {
+    if (Gav1Library.isAvailable()) {
+      gav1SetLogRingEnabled(enabled);
+    }
+  }
+
+  /**
+   * Returns the messages held in the in-memory ring of the native decoder, oldest first and one per
+   * line, or an empty string if the native library is not available.
+   */
+  public static String getNativeLogRing() {
+    if (!Gav1Library.isAvailable()) {
+      return "";
+    }
+    @Nullable String log = gav1DumpLogRing();
+    return log != null ? log : "";
+  }
+
+  /**
+   * Classifies the temporal unit held by an input buffer by parsing its headers, without decoding
+   * it. The player can use the result to decide whether to drop or skip the buffer before queueing
+   * it.
+   *
+   * <p>Must be called on the thread that queues input buffers, before the buffer is queued. The
+   * parser keeps the sequence header and reference frame types of the stream, so buffers must be
+   * classified in decode order, starting from a buffer that holds a sequence header.
+   *
+   * @param inputBuffer The input buffer, whose {@link DecoderInputBuffer#data} must be flipped.
+   * @return The {@link TemporalUnitInfo}, or null if the temporal unit could not be parsed.
+   */
+  @Nullable
+  public TemporalUnitInfo classifyTemporalUnit(DecoderInputBuffer inputBuffer) {
+    ByteBuffer inputData = Util.castNonNull(inputBuffer.data);
+    return TemporalUnitInfo.fromPackedInfo(
+        gav1ClassifyTemporalUnit(
+            gav1DecoderContext, inputData, inputData.position(), inputData.remaining()));
+  }
+
+  /**
+   * Sets whether only key frames and other intra coded frames are decoded, for fast forward and
+   * rewind at high speeds. Other input buffers are skipped without being decoded, and output as
+   * decode-only buffers. Takes effect from the next input buffer.
+   *
+   * <p>Frames that follow a skipped frame may reference it, so after trick play is disabled, input
+   * buffers keep being skipped until the next key frame.
+   *
+   * @param enabled Whether trick play is enabled.
+   */
+  public void setTrickPlayEnabled(boolean enabled) {
+    trickPlayEnabled = enabled;
+    if (enabled) {
+      trickPlayFrameRate.start();
+    } else {
+      trickPlayFrameRate.stop();
+    }
+  }
+
+  /**
+   * Returns the number of frames per second output since trick play was enabled, or 0 if it is not
+   * enabled.
+   */
+  public float getTrickPlayFrameRate() {
+    return trickPlayFrameRate.getFrameRate();
+  }
+
   @Override
   public String getName() {
     return "libgav1";
@@ -96,12 +238,51 @@ public final class Gav1Decoder
   @Nullable
   protected Gav1DecoderException decode(
       DecoderInputBuffer inputBuffer, VideoDecoderOutputBuffer outputBuffer, boolean reset) {
+    preroll.onDecodeStarting();
+    if (reset || !hasDecoded) {
+      // Apply the decoder's current share of the thread budget, which may have changed as other
+      // decoders came and went, the dequeue mode and the stream limits.
+      int threads = threadBudgetRegistration.getThreadCount();
+      boolean blockingDequeue = blockingDequeueEnabled;
+      StreamLimits streamLimits = this.streamLimits;
+      if (threads != decoderThreads
+          || blockingDequeue != decoderBlockingDequeue
+          || streamLimits != decoderStreamLimits) {
+        if (streamLimits != decoderStreamLimits) {
+          gav1SetStreamLimits(
+              gav1DecoderContext,
+              streamLimits.maxFramePixels,
+              streamLimits.operatingPoint,
+              streamLimits.outputAllLayers,
+              streamLimits.maxPictureBytes);
+        }
+        if (gav1Reconfigure(gav1DecoderContext, threads, blockingDequeue) == GAV1_ERROR) {
+          return new Gav1DecoderException(
+              "gav1Reconfigure error: " + gav1GetErrorMessage(gav1DecoderContext));
+        }
+        decoderThreads = threads;
+        decoderBlockingDequeue = blockingDequeue;
+        decoderStreamLimits = streamLimits;
+      }
+      hasDecoded = true;
+    }
+    boolean trickPlay = trickPlayEnabled;
+    if (trickPlay != decoderTrickPlay) {
+      gav1SetTrickPlayEnabled(gav1DecoderContext, trickPlay);
+      decoderTrickPlay = trickPlay;
+    }
     ByteBuffer inputData = Util.castNonNull(inputBuffer.data);
     int inputSize = inputData.limit();
-    if (gav1Decode(gav1DecoderContext, inputData, inputSize) == GAV1_ERROR) {
+    int decodeResult = gav1Decode(gav1DecoderContext, inputData, inputSize);
+    if (decodeResult == GAV1_ERROR) {
       return new Gav1DecoderException(
           "gav1Decode error: " + gav1GetErrorMessage(gav1DecoderContext));
     }
+    if (decodeResult == GAV1_DECODE_ONLY) {
+      // The input buffer was skipped for trick play, so there is no frame to dequeue.
+      outputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
+      return null;
+    }
 
     boolean decodeOnly = inputBuffer.isDecodeOnly();
     if (!decodeOnly) {
@@ -120,7 +301,11 @@ public final class Gav1Decoder
     if (!decodeOnly) {
       outputBuffer.format = inputBuffer.format;
     }
+    if (trickPlay && !outputBuffer.isDecodeOnly()) {
+      trickPlayFrameRate.onFrameDecoded();
+    }
 
+    preroll.onFrameDecoded(outputBuffer);
     return null;
   }
 
@@ -131,12 +316,15 @@ public final class Gav1Decoder
 
   @Override
   public void release() {
+    preroll.release();
     super.release();
     gav1Close(gav1DecoderContext);
+    threadBudgetRegistration.unregister();
   }
 
   @Override
   protected void releaseOutputBuffer(VideoDecoderOutputBuffer buffer) {
+    preroll.onFrameReleased(buffer);
     // Decode only frames do not acquire a reference on the internal decoder buffer and thus do not
     // require a call to gav1ReleaseFrame.
     if (buffer.mode == C.VIDEO_OUTPUT_MODE_SURFACE_YUV && !buffer.isDecodeOnly()) {
@@ -145,6 +333,103 @@ public final class Gav1Decoder
     super.releaseOutputBuffer(buffer);
   }
 
+  /**
+   * Starts prerolling an upcoming playlist item, decoding its first frames before it becomes
+   * current. Until {@link #endPreroll()} is called, the decode thread runs at background priority
+   * and waits once the frames it decoded and that are still queued or held hold {@code maxBytes}.
+   * The frames are handed out as soon as they are dequeued.
+   *
+   * @param maxBytes The maximum number of bytes of decoded frames to hold while prerolling.
+   */
+  public void startPreroll(long maxBytes) {
+    preroll.start(maxBytes);
+  }
+
+  /** Ends the preroll started by {@link #startPreroll(long)}, once the item becomes current. */
+  public void endPreroll() {
+    preroll.end();
+  }
+
+  /**
+   * Suspends the decoder while it is not needed, for example while the app is in the background
+   * with playback paused. The native decoder is closed, which stops its threads and frees the
+   * pictures that are not held by output buffers, and the frame cache is cleared, but the
+   * configuration of the decoder is kept. Call {@link #setFrameArenaCapacity(long)} too to release
+   * the picture memory kept for reuse. May be called on any thread.
+   *
+   * <p>The native decoder is reopened by {@link #resume()}, or when it is next given input. As the
+   * frames it referenced are gone, input is then output as decode-only until the next key frame.
+   */
+  public void suspend() {
+    gav1Suspend(gav1DecoderContext);
+  }
+
+  /**
+   * Reopens the native decoder after {@link #suspend()}, so that the next input is not delayed by
+   * its initialization. Pictures are allocated again as frames are decoded. Does nothing if the
+   * decoder is not suspended. May be called on any thread.
+   *
+   * @throws Gav1DecoderException Thrown if the native decoder could not be reopened.
+   */
+  public void resume() throws Gav1DecoderException {
+    if (gav1Resume(gav1DecoderContext) == GAV1_ERROR) {
+      throw new Gav1DecoderException(
+          "gav1Resume error: " + gav1GetErrorMessage(gav1DecoderContext));
+    }
+  }
+
+  /**
+   * Sets whether each decoded frame is dequeued as soon as it is decoded. Takes effect from the
+   * first input buffer, or from the first input buffer after the next flush if called later.
+   *
+   * <p>By default dav1d keeps several frames in flight on its frame threads, and asks for more
+   * input before it outputs a picture. When enabled, the decoder is opened without frame delay, so
+   * each dequeue blocks until the frame of the data just submitted is decoded and returns it,
+   * instead of returning nothing until enough frames are in flight. This lowers the latency from
+   * input to output at the cost of decoding fewer frames in parallel.
+   *
+   * @param enabled Whether blocking dequeue is enabled.
+   */
+  public void setBlockingDequeueEnabled(boolean enabled) {
+    blockingDequeueEnabled = enabled;
+  }
+
+  /**
+   * Sets limits that bound the memory the decoder uses on untrusted streams, so that a stream
+   * declaring frames or layers the device cannot afford fails or is decoded in part as soon as it
+   * starts, instead of once dav1d has allocated for it. Takes effect from the first input buffer,
+   * or from the first input buffer after the next flush if called later.
+   *
+   * @param maxFramePixels The maximum area of the decoded frames, in pixels. Streams with larger
+   *     frames fail to decode. 0 for no limit, the default.
+   * @param operatingPoint The AV1 operating point decoded, from 0 to 31, which selects the layers
+   *     decoded in scalable streams. The default is 0.
+   * @param outputAllLayers Whether every spatial layer of the operating point is output, rather
+   *     than only the highest one. The default is true.
+   * @param maxPictureBytes The maximum number of bytes of pictures dav1d holds at once, reference
+   *     frames included. Decoding fails if it needs more. 0 for no limit, the default.
+   * @throws IllegalArgumentException If a limit is out of range.
+   */
+  public void setStreamLimits(
+      int maxFramePixels, int operatingPoint, boolean outputAllLayers, long maxPictureBytes) {
+    if (maxFramePixels < 0 || operatingPoint < 0 || operatingPoint > 31 || maxPictureBytes < 0) {
+      throw new IllegalArgumentException("Invalid stream limits");
+    }
+    streamLimits =
+        new StreamLimits(maxFramePixels, operatingPoint, outputAllLayers, maxPictureBytes);
+  }
+
+  /**
+   * Sets the priority of this decoder when the {@link DecoderThreadBudget} is divided between the
+   * live decoders. Decoders start with {@link DecoderThreadBudget#PRIORITY_FOREGROUND}. A change in
+   * the number of threads the decoder uses takes effect when it is next flushed.
+   *
+   * @param priority The {@link DecoderThreadBudget.Priority}.
+   */
+  public void setThreadPriority(@DecoderThreadBudget.Priority int priority) {
+    threadBudgetRegistration.setPriority(priority);
+  }
+
   /**
    * Sets the output mode for frames rendered by the decoder.
    *
@@ -154,6 +439,97 @@ public final class Gav1Decoder
     this.outputMode = outputMode;
   }
 
+  /**
+   * Sets the factor by which 8-bit frames are downscaled while being copied out, in {@link
+   * C#VIDEO_OUTPUT_MODE_YUV} and {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} modes. Takes effect from
+   * the next output frame.
+   *
+   * <p>Each output sample is the average of a {@code factor} x {@code factor} block of decoded
+   * samples, and the output width and height are the decoded ones divided by {@code factor},
+   * rounded up. This reduces the memory traffic and the size of the output buffers when the frames
+   * are shown in a view much smaller than the video, for example a thumbnail.
+   *
+   * @param factor 1 (the default) to output frames at their decoded size, 2 or 4.
+   * @throws IllegalArgumentException If the factor is not supported.
+   */
+  public void setOutputDownscaleFactor(int factor) {
+    if (factor != 1 && factor != 2 && factor != 4) {
+      throw new IllegalArgumentException("Unsupported downscale factor: " + factor);
+    }
+    gav1SetDownscaleFactor(gav1DecoderContext, factor);
+  }
+
+  /**
+   * Sets whether the film grain signaled by the stream is applied to the output frames. Enabled by
+   * default. Takes effect from the next frame that is output.
+   *
+   * <p>Frames are decoded without film grain, and the grain is synthesized only for the frames that
+   * are output, not for decode-only ones. Disabling it saves that cost on low-end devices, at the
+   * expense of the texture the content was graded with.
+   *
+   * @param enabled Whether film grain is applied.
+   */
+  public void setFilmGrainEnabled(boolean enabled) {
+    gav1SetFilmGrainEnabled(gav1DecoderContext, enabled);
+  }
+
+  /**
+   * Sets the size of a native cache of copies of the recently output frames, keyed by presentation
+   * time. Frames read from it with {@link #readCachedFrame} serve short backward seeks and seek
+   * previews without decoding. Only 8-bit 4:2:0 frames are cached. When the cache is full, the
+   * least recently output or read frames are evicted.
+   *
+   * <p>Frames are cached as they are shown, with their film grain applied if it is enabled. In
+   * {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode a frame is cached when it is first rendered, so
+   * frames dropped before rendering are not cached.
+   *
+   * <p>While the cache is enabled, every output frame is copied into it, which costs about one more
+   * pass over each frame, or a quarter or a sixteenth of one when downscaling by 2 or 4.
+   *
+   * <p>Cached frames survive flushes, so the cache should be disabled, which drops its frames,
+   * before the decoder is fed a stream whose timestamps may collide with the cached ones.
+   *
+   * @param maxBytes The maximum number of bytes of frames held, or 0 (the default) to disable the
+   *     cache.
+   * @param downscaleFactor The factor by which frames are downscaled as they are cached, as for
+   *     {@link #setOutputDownscaleFactor(int)}. Changing it drops the cached frames.
+   * @throws IllegalArgumentException If the downscale factor is not supported.
+   */
+  public void setFrameCacheSize(long maxBytes, int downscaleFactor) {
+    if (downscaleFactor != 1 && downscaleFactor != 2 && downscaleFactor != 4) {
+      throw new IllegalArgumentException("Unsupported downscale factor: " + downscaleFactor);
+    }
+    gav1SetFrameCacheSize(gav1DecoderContext, maxBytes, downscaleFactor);
+  }
+
+  /**
+   * Reads the latest cached frame whose presentation time is at most {@code timeUs} and at least
+   * {@code timeUs - toleranceUs} into a {@link C#VIDEO_OUTPUT_MODE_YUV} output buffer. Can be
+   * called on any thread.
+   *
+   * @param timeUs The presentation time of the frame, in microseconds.
+   * @param toleranceUs How much earlier than {@code timeUs} the frame may be, in microseconds. 0
+   *     for a frame-accurate lookup, larger for a seek preview.
+   * @param outputBuffer A buffer that was not dequeued from this decoder, which receives the frame
+   *     and its presentation time.
+   * @return Whether a frame was read.
+   */
+  public boolean readCachedFrame(
+      long timeUs, long toleranceUs, VideoDecoderOutputBuffer outputBuffer) {
+    outputBuffer.init(timeUs, C.VIDEO_OUTPUT_MODE_YUV, /* supplementalData= */ null);
+    return gav1ReadCachedFrame(gav1DecoderContext, timeUs, toleranceUs, outputBuffer);
+  }
+
+  /** Returns the number of {@link #readCachedFrame} calls that found a frame. */
+  public long getFrameCacheHitCount() {
+    return gav1GetFrameCacheHitCount(gav1DecoderContext);
+  }
+
+  /** Returns the number of {@link #readCachedFrame} calls that found no frame. */
+  public long getFrameCacheMissCount() {
+    return gav1GetFrameCacheMissCount(gav1DecoderContext);
+  }
+
   /**
    * Renders output buffer to the given surface. Must only be called when in {@link
    * C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode.
@@ -175,7 +551,7 @@ public final class Gav1Decoder
   }
 
   /**
-   * Initializes a libgav1 decoder.
+   * Initializes a libgav1 decoder, reusing an idle decoder context if there is one.
    *
    * @param threads Number of threads to be used by a libgav1 decoder.
    * @return The address of the decoder context or {@link #GAV1_ERROR} if there was an error.
@@ -183,19 +559,99 @@ public final class Gav1Decoder
   private native long gav1Init(int threads);
 
   /**
-   * Deallocates the decoder context.
+   * Initializes idle decoder contexts for {@link #gav1Init} to reuse.
+   *
+   * @param threads Number of threads to be used by each decoder.
+   * @param count Number of contexts to initialize.
+   */
+  private static native void gav1Prewarm(int count);
+
+  /**
+   * Sets the maximum number of bytes of released frame buffer memory kept for reuse.
+   *
+   * @param capacityBytes The maximum number of bytes kept.
+   */
+  private static native void gav1SetFrameArenaCapacity(long capacityBytes);
+
+  /**
+   * Deallocates the decoder context, or flushes it and keeps it idle for reuse.
    *
    * @param context Decoder context.
    */
   private native void gav1Close(long context);
 
+  /**
+   * Sets the limits applied when the decoder is next opened by {@link #gav1Reconfigure}.
+   *
+   * @param context Decoder context.
+   * @param maxFramePixels The maximum area of the decoded frames, in pixels, or 0 for no limit.
+   * @param operatingPoint The operating point decoded.
+   * @param allLayers Whether every spatial layer of the operating point is output.
+   * @param maxPictureBytes The maximum number of bytes of pictures held at once, or 0 for no
+   *     limit.
+   */
+  private native void gav1SetStreamLimits(
+      long context,
+      int maxFramePixels,
+      int operatingPoint,
+      boolean allLayers,
+      long maxPictureBytes);
+
+  /**
+   * Recreates the decoder with a different configuration. Frames queued in the decoder are
+   * dropped, so this must only be called when the decoder is flushed.
+   *
+   * @param context Decoder context.
+   * @param threads Number of threads to be used by the decoder.
+   * @param blockingDequeue Whether to open the decoder without frame delay.
+   * @return {@link #GAV1_OK} if successful, {@link #GAV1_ERROR} if an error occurred.
+   */
+  private native int gav1Reconfigure(long context, int threads, boolean blockingDequeue);
+
+  /**
+   * Closes the decoder and clears the frame cache, keeping the configuration.
+   *
+   * @param context Decoder context.
+   */
+  private native void gav1Suspend(long context);
+
+  /**
+   * Reopens the decoder closed by {@link #gav1Suspend(long)}, if any.
+   *
+   * @param context Decoder context.
+   * @return {@link #GAV1_OK} if successful, {@link #GAV1_ERROR} if an error occurred.
+   */
+  private native int gav1Resume(long context);
+
+  /**
+   * Classifies the temporal unit in the encoded data without decoding it.
+   *
+   * @param context Decoder context.
+   * @param encodedData Encoded data.
+   * @param offset Offset of the temporal unit in the data buffer.
+   * @param length Length of the temporal unit.
+   * @return The info packed for {@link TemporalUnitInfo#fromPackedInfo(int)}, or a negative value
+   *     if the temporal unit could not be parsed.
+   */
+  private native int gav1ClassifyTemporalUnit(
+      long context, ByteBuffer encodedData, int offset, int length);
+
+  /**
+   * Sets whether only temporal units whose frames are all intra coded are decoded.
+   *
+   * @param context Decoder context.
+   * @param enabled Whether trick play is enabled.
+   */
+  private native void gav1SetTrickPlayEnabled(long context, boolean enabled);
+
   /**
    * Decodes the encoded data passed.
    *
    * @param context Decoder context.
    * @param encodedData Encoded data.
    * @param length Length of the data buffer.
-   * @return {@link #GAV1_OK} if successful, {@link #GAV1_ERROR} if an error occurred.
+   * @return {@link #GAV1_OK} if successful, {@link #GAV1_DECODE_ONLY} if the data was skipped for
+   *     trick play, {@link #GAV1_ERROR} if an error occurred.
    */
   private native int gav1Decode(long context, ByteBuffer encodedData, int length);
 
@@ -221,6 +677,59 @@ public final class Gav1Decoder
   private native int gav1RenderFrame(
       long context, Surface surface, VideoDecoderOutputBuffer outputBuffer);
 
+  /**
+   * Sets the factor by which 8-bit frames are downscaled while being copied out.
+   *
+   * @param context Decoder context.
+   * @param factor 1, 2 or 4.
+   */
+  private native void gav1SetDownscaleFactor(long context, int factor);
+
+  /**
+   * Sets whether film grain is applied to the frames that are output.
+   *
+   * @param context Decoder context.
+   * @param enabled Whether film grain is applied.
+   */
+  private native void gav1SetFilmGrainEnabled(long context, boolean enabled);
+
+  /**
+   * Configures the cache of output frames.
+   *
+   * @param context Decoder context.
+   * @param maxBytes The maximum number of bytes of frames held, or 0 to disable the cache.
+   * @param downscaleFactor The factor by which frames are downscaled as they are cached.
+   */
+  private native void gav1SetFrameCacheSize(long context, long maxBytes, int downscaleFactor);
+
+  /**
+   * Reads a cached frame into a {@link C#VIDEO_OUTPUT_MODE_YUV} output buffer.
+   *
+   * @param context Decoder context.
+   * @param timeUs The latest presentation time of the frame, in microseconds.
+   * @param toleranceUs How much earlier than {@code timeUs} the frame may be, in microseconds.
+   * @param outputBuffer Output buffer.
+   * @return Whether a frame was read.
+   */
+  private native boolean gav1ReadCachedFrame(
+      long context, long timeUs, long toleranceUs, VideoDecoderOutputBuffer outputBuffer);
+
+  /**
+   * Returns the number of cached frame reads that found a frame.
+   *
+   * @param context Decoder context.
+   * @return The number of hits.
+   */
+  private native long gav1GetFrameCacheHitCount(long context);
+
+  /**
+   * Returns the number of cached frame reads that found no frame.
+   *
+   * @param context Decoder context.
+   * @return The number of misses.
+   */
+  private native long gav1GetFrameCacheMissCount(long context);
+
   /**
    * Releases the frame. Used with {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} only.
    *
@@ -251,4 +760,38 @@ public final class Gav1Decoder
    * @return Optimal number of threads if there was no error, 0 if an error occurred.
    */
   private native int gav1GetThreads();
+
+  /** Sets the minimum {@link Log} priority of native messages. */
+  private static native void gav1SetLogLevel(int priority);
+
+  /** Sets whether native messages are written to the in-memory ring instead of logcat. */
+  private static native void gav1SetLogRingEnabled(boolean enabled);
+
+  /** Returns the messages held in the native in-memory ring, or null if there was an error. */
+  @Nullable
+  private static native String gav1DumpLogRing();
+
+  /** Limits set by {@link #setStreamLimits}. */
+  private static final class StreamLimits {
+
+    public static final StreamLimits NONE =
+        new StreamLimits(
+            /* maxFramePixels= */ 0,
+            /* operatingPoint= */ 0,
+            /* outputAllLayers= */ true,
+            /* maxPictureBytes= */ 0);
+
+    public final int maxFramePixels;
+    public final int operatingPoint;
+    public final boolean outputAllLayers;
+    public final long maxPictureBytes;
+
+    public StreamLimits(
+        int maxFramePixels, int operatingPoint, boolean outputAllLayers, long maxPictureBytes) {
+      this.maxFramePixels = maxFramePixels;
+      this.operatingPoint = operatingPoint;
+      this.outputAllLayers = outputAllLayers;
+      this.maxPictureBytes = maxPictureBytes;
+    }
+  }
 }
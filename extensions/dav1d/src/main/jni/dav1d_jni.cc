@@ -18,19 +18,35 @@
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
 
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable> // NOLINT
 #include <cstdint>
 #include <cstring>
+#include <deque>
+#include <functional>
 #include <mutex> // NOLINT
 #include <new>
+#include <thread> // NOLINT
+#include <vector>
 
+#include "frame_arena.h" // NOLINT
+#include "frame_cache.h" // NOLINT
 #include "include/dav1d.h"
+#include "jni_log.h" // NOLINT
+#include "obu_parser.h" // NOLINT
+#include "row_convert.h" // NOLINT
+#include "worker_pool.h" // NOLINT
+#include "yuv_to_rgba.h" // NOLINT
 
 #define LOG_TAG "dav1d_jni"
-#define LOGE(...) \
-    ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__))
-
-#define LOGI(...) \
-    ((void)__android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__))
 
 #define DECODER_FUNC(RETURN_TYPE, NAME, ...)                               \
     extern "C"                                                             \
@@ -66,11 +82,14 @@ const int kMaxPlanes = 3;
 // https://developer.android.com/reference/android/graphics/ImageFormat.html#YV12.
 const int kImageFormatYV12 = 0x32315659;
 
+// Value of the chroma samples output for monochrome frames, which have no
+// chroma planes.
+const uint8_t kNeutralChroma = 128;
+
 // Output modes.
 const int kOutputModeYuv = 0;
 const int kOutputModeSurfaceYuv = 1;
-
-const int kColorSpaceUnknown = 0;
+const int kOutputModeRgba = 2;
 
 // Return codes for jni methods.
 const int kStatusError = 0;
@@ -88,7 +107,9 @@ enum JniStatusCode
   kJniStatusHighBitDepthNotSupportedWithSurfaceYuv = -5,
   kJniStatusANativeWindowError = -6,
   kJniStatusBufferResizeError = -7,
-  kJniStatusNeonNotSupported = -8
+  kJniStatusNeonNotSupported = -8,
+  kJniStatusUnsupportedRgbaFrame = -9,
+  kJniStatusInvalidBufferId = -10
 };
 
 const char *GetJniErrorMessage(JniStatusCode error_code)
@@ -112,24 +133,43 @@ const char *GetJniErrorMessage(JniStatusCode error_code)
       return "Buffer resize failed.";
     case kJniStatusNeonNotSupported:
       return "Neon is not supported.";
+    case kJniStatusUnsupportedRgbaFrame:
+      return "RGBA output is only supported for 8-bit and 10-bit 4:2:0 and "
+             "monochrome frames.";
+    case kJniStatusInvalidBufferId:
+      return "Invalid frame buffer id.";
     default:
       return "Unrecognized error code.";
   }
 }
 
+// Holds a reference on a Dav1dPicture, which is released when it goes out of
+// scope unless the picture was handed over and zeroed.
+class ScopedPicture
+{
+ public:
+  ScopedPicture() = default;
+
+  ~ScopedPicture() { dav1d_picture_unref(&picture_); }
+
+  // Not copyable or movable.
+  ScopedPicture(const ScopedPicture &) = delete;
+
+  ScopedPicture &operator=(const ScopedPicture &) = delete;
+
+  DAV1D_API::Dav1dPicture *get() { return &picture_; }
+
+ private:
+  DAV1D_API::Dav1dPicture picture_ = {};
+};
+
 // Manages frame buffer and reference information.
 class JniFrameBuffer
 {
  public:
   explicit JniFrameBuffer(int id) : id_(id), reference_count_(0) {}
 
-  ~JniFrameBuffer()
-  {
-    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++)
-    {
-      delete[] raw_buffer_[plane_index];
-    }
-  }
+  ~JniFrameBuffer() { ReleasePicture(); }
 
   // Not copyable or movable.
   JniFrameBuffer(const JniFrameBuffer &) = delete;
@@ -140,9 +180,20 @@ class JniFrameBuffer
 
   JniFrameBuffer &operator=(JniFrameBuffer &&) = delete;
 
-  void SetFrameData(const DAV1D_API::Dav1dPicture &decoder_buffer)
+  // Points the planes at |picture| and takes over its reference, zeroing
+  // |picture|. The reference is held until the buffer is released.
+  // |render_pending| is whether the picture is still to be cached, which is
+  // done when it is first rendered.
+  void SetFrameData(DAV1D_API::Dav1dPicture *picture, bool render_pending)
   {
-    for (int plane_index = kPlaneY; plane_index < 3; plane_index++)
+    ReleasePicture();
+    picture_ = *picture;
+    *picture = {};
+    render_pending_ = render_pending;
+    const DAV1D_API::Dav1dPicture &decoder_buffer = picture_;
+    num_planes_ =
+        (decoder_buffer.p.layout == DAV1D_PIXEL_LAYOUT_I400) ? 1 : kMaxPlanes;
+    for (int plane_index = kPlaneY; plane_index < num_planes_; plane_index++)
     {
       if (plane_index == 0 || plane_index == 1)
       {
@@ -166,6 +217,24 @@ class JniFrameBuffer
     }
   }
 
+  // Returns the picture set by SetFrameData(), handing its reference over to
+  // the caller. The planes must not be read until SetFrameData() is called
+  // again.
+  DAV1D_API::Dav1dPicture TakePicture()
+  {
+    DAV1D_API::Dav1dPicture picture = picture_;
+    picture_ = {};
+    return picture;
+  }
+
+  // Releases the reference on the picture set by SetFrameData(), if any.
+  void ReleasePicture() { dav1d_picture_unref(&picture_); }
+
+  bool RenderPending() const { return render_pending_; }
+
+  // Returns the number of planes, which is 1 for monochrome frames.
+  int NumPlanes() const { return num_planes_; }
+
   int Stride(int plane_index) const { return stride_[plane_index]; }
 
   uint8_t *Plane(int plane_index) const { return plane_[plane_index]; }
@@ -188,45 +257,19 @@ class JniFrameBuffer
 
   bool InUse() const { return reference_count_ != 0; }
 
-  uint8_t *RawBuffer(int plane_index) const { return raw_buffer_[plane_index]; }
-
   int *BufferPrivateData() const { return const_cast<int *>(&id_); }
 
-  // Attempts to reallocate data planes if the existing ones don't have enough
-  // capacity. Returns true if the allocation was successful or wasn't needed,
-  // false if the allocation failed.
-  bool MaybeReallocateGav1DataPlanes(int y_plane_min_size,
-                                     int uv_plane_min_size)
-  {
-    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++)
-    {
-      const int min_size =
-          (plane_index == kPlaneY) ? y_plane_min_size : uv_plane_min_size;
-      if (raw_buffer_size_[plane_index] >= min_size)
-        continue;
-      delete[] raw_buffer_[plane_index];
-      raw_buffer_[plane_index] = new (std::nothrow) uint8_t[min_size];
-      if (!raw_buffer_[plane_index])
-      {
-        raw_buffer_size_[plane_index] = 0;
-        return false;
-      }
-      raw_buffer_size_[plane_index] = min_size;
-    }
-    return true;
-  }
-
  private:
+  int num_planes_ = kMaxPlanes;
   int stride_[kMaxPlanes];
   uint8_t *plane_[kMaxPlanes];
   int displayed_width_[kMaxPlanes];
   int displayed_height_[kMaxPlanes];
   const int id_;
   int reference_count_;
-  // Pointers to the raw buffers allocated for the data planes.
-  uint8_t *raw_buffer_[kMaxPlanes] = {};
-  // Sizes of the raw buffers in bytes.
-  size_t raw_buffer_size_[kMaxPlanes] = {};
+  // Picture the planes point into in surface mode.
+  DAV1D_API::Dav1dPicture picture_ = {};
+  bool render_pending_ = false;
 };
 
 // Manages frame buffers used by libgav1 decoder and ExoPlayer.
@@ -246,8 +289,7 @@ class JniBufferManager
     }
   }
 
-  JniStatusCode GetBuffer(size_t y_plane_min_size, size_t uv_plane_min_size,
-                          JniFrameBuffer **jni_buffer)
+  JniStatusCode GetBuffer(JniFrameBuffer **jni_buffer)
   {
     std::lock_guard<std::mutex> lock(mutex_);
     JniFrameBuffer *output_buffer;
@@ -267,11 +309,6 @@ class JniBufferManager
       // Maximum number of buffers is being used.
       return kJniStatusOutOfMemory;
     }
-    if (!output_buffer->MaybeReallocateGav1DataPlanes(y_plane_min_size,
-                                                      uv_plane_min_size))
-    {
-      return kJniStatusOutOfMemory;
-    }
 
     output_buffer->AddReference();
     *jni_buffer = output_buffer;
@@ -281,6 +318,26 @@ class JniBufferManager
 
   JniFrameBuffer *GetBuffer(int id) const { return all_buffers_[id]; }
 
+  // Returns the buffer with |id| if it is one of the at most kMaxFrames
+  // buffers allocated so far and is in use, or null otherwise. For ids that
+  // come from outside the decoder.
+  JniFrameBuffer *GetBufferInUse(int id)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id < 0 || id >= all_buffer_count_ || !all_buffers_[id]->InUse())
+    {
+      return nullptr;
+    }
+    return all_buffers_[id];
+  }
+
+  // Returns whether any buffer is referenced by an output buffer.
+  bool HasBuffersInUse()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_buffer_count_ != all_buffer_count_;
+  }
+
   void AddBufferReference(int id)
   {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -290,6 +347,10 @@ class JniBufferManager
   JniStatusCode ReleaseBuffer(int id)
   {
     std::lock_guard<std::mutex> lock(mutex_);
+    if (id < 0 || id >= all_buffer_count_)
+    {
+      return kJniStatusInvalidBufferId;
+    }
     JniFrameBuffer *buffer = all_buffers_[id];
     if (!buffer->InUse())
     {
@@ -298,6 +359,7 @@ class JniBufferManager
     buffer->RemoveReference();
     if (!buffer->InUse())
     {
+      buffer->ReleasePicture();
       free_buffers_[free_buffer_count_++] = buffer;
     }
     return kJniStatusOk;
@@ -315,10 +377,35 @@ class JniBufferManager
   std::mutex mutex_;
 };
 
+// Limits on what dav1d decodes, which bound its memory on untrusted streams.
+// Applied when the decoder is opened.
+struct StreamLimits
+{
+  bool IsDefault() const
+  {
+    return frame_size_limit == 0 && operating_point == 0 && all_layers &&
+           picture_budget_bytes == 0;
+  }
+
+  // Maximum area of the frames decoded, in pixels, or 0 for no limit.
+  unsigned frame_size_limit = 0;
+  // Operating point decoded, which selects the layers of scalable streams.
+  int operating_point = 0;
+  // Whether every spatial layer of the operating point is output, instead of
+  // only the highest one.
+  bool all_layers = true;
+  // Maximum number of bytes of pictures allocated at once, or 0 for no limit.
+  size_t picture_budget_bytes = 0;
+};
+
 struct JniContext
 {
   ~JniContext()
   {
+    if (c_out)
+    {
+      dav1d_close(&c_out);
+    }
     if (native_window)
     {
       ANativeWindow_release(native_window);
@@ -351,17 +438,71 @@ struct JniContext
   jfieldID decoder_private_field;
   jfieldID output_mode_field;
   jfieldID data_field;
+  jfieldID time_us_field;
   jmethodID init_for_private_frame_method;
   jmethodID init_for_yuv_frame_method;
+  jmethodID init_for_rgba_frame_method;
+
+  // Limits set by gav1SetStreamLimits.
+  StreamLimits stream_limits;
+  // Picture budget of |c_out|, copied from |stream_limits| by OpenDecoder()
+  // for the allocator callbacks, which dav1d calls on its threads.
+  size_t picture_budget_bytes = 0;
+  // Bytes of the pictures allocated against |picture_budget_bytes|. Declared
+  // before |buffer_manager|, as the pictures it holds are released when it is
+  // destroyed.
+  std::atomic<size_t> picture_bytes{0};
 
   JniBufferManager buffer_manager;
 
-  Dav1dContext *c_out;
+  // Recreated by OpenDecoder() when the number of threads changes, and null
+  // while the context is suspended.
+  Dav1dContext *c_out = nullptr;
+  // Number of threads |c_out| was opened with, or 0 if opening it failed. Kept
+  // while the context is suspended.
+  int threads = 0;
+  // Serializes the calls that use or replace |c_out|, as gav1Suspend and
+  // gav1Resume may be called on any thread.
+  std::mutex decoder_mutex;
+  // Whether |c_out| is opened without frame delay, so that dav1d_get_picture
+  // waits for the picture of the data just sent instead of returning EAGAIN
+  // until several frames are in flight.
+  bool blocking_dequeue = false;
 
   ANativeWindow *native_window = nullptr;
   jobject surface = nullptr;
   int native_window_width = 0;
   int native_window_height = 0;
+  // Factor by which 8-bit frames are downscaled while being copied out, in YUV
+  // and surface modes. 1, 2 or 4.
+  int downscale_factor = 1;
+  // Whether film grain is applied to the frames that are output. See
+  // MaybeApplyFilmGrain().
+  bool film_grain = true;
+
+  // Classifies the temporal units passed to gav1ClassifyTemporalUnit(), on the
+  // thread that queues input buffers.
+  exoplayer_jni::ObuParser input_parser;
+
+  // Whether only temporal units whose frames are all intra coded are decoded.
+  // Set by gav1SetTrickPlayEnabled on the playback thread and read on the
+  // decode thread.
+  std::atomic<bool> trick_play{false};
+  // Whether temporal units are skipped until the next key frame, because one
+  // was skipped since the last key frame and later frames may reference it.
+  bool awaiting_key_frame = false;
+  // Whether |c_out| was closed by gav1Suspend and has not been given a key
+  // frame since. The new decoder has neither a sequence header nor reference
+  // frames, so every temporal unit before the next key frame is skipped.
+  bool restarting = false;
+  // Classifies the temporal units decoded while |trick_play| or
+  // |awaiting_key_frame| is set, on the decode thread. Not reset on suspend,
+  // so that it keeps the sequence header needed to find the next key frame.
+  exoplayer_jni::ObuParser trick_play_parser;
+
+  // Copies of recently output frames, read by gav1ReadCachedFrame on any
+  // thread.
+  exoplayer_jni::FrameCache frame_cache;
 
   int avid_status_code = kJniStatusOk;
   JniStatusCode jni_status_code = kJniStatusOk;
@@ -389,43 +530,531 @@ void CopyPlane(const uint8_t *source, int source_stride, uint8_t *destination,
   }
 }
 
-void CopyFrameToDataBuffer(const DAV1D_API::Dav1dPicture *decoder_buffer,
-                           jbyte *data)
+// Frames with at least this many luma samples are copied, converted or
+// downscaled in parallel row bands on the worker pool, with non-temporal
+// stores for copies. Smaller frames are processed on the calling thread, where
+// handing work to other threads costs more than it saves.
+const int kMinParallelCopySamples = 2560 * 1440;
+// Number of rows in each band of parallel work.
+const int kCopyBandRows = 128;
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_nontemporal_store)
+#define DAV1D_JNI_HAS_NONTEMPORAL_STORE
+#endif
+#endif
+
+// Copies a row, using non-temporal stores where the compiler supports them so
+// that large frames written to the window do not evict the decoder's data from
+// the caches.
+void CopyRowNonTemporal(const uint8_t *source, uint8_t *destination,
+                        int width)
 {
-  for (int plane_index = kPlaneY; plane_index < 3;
-       plane_index++)
+#ifdef DAV1D_JNI_HAS_NONTEMPORAL_STORE
+  typedef uint8_t Block __attribute__((vector_size(16)));
+  // Non-temporal stores need aligned destinations.
+  const int head = std::min(
+      width,
+      static_cast<int>(-reinterpret_cast<uintptr_t>(destination) & 15));
+  std::memcpy(destination, source, head);
+  int x = head;
+  for (; x + 16 <= width; x += 16)
   {
-    const uint64_t length = sizeof decoder_buffer->data[plane_index];
-    LOGI("CopyFrameToDataBuffer %lu", length);
-    memcpy(data, decoder_buffer->data[plane_index], length);
-    data += length;
+    Block block;
+    std::memcpy(&block, source + x, sizeof(block));
+    __builtin_nontemporal_store(block,
+                                reinterpret_cast<Block *>(destination + x));
   }
+  std::memcpy(destination + x, source + x, width - x);
+#else
+  std::memcpy(destination, source, width);
+#endif // DAV1D_JNI_HAS_NONTEMPORAL_STORE
 }
 
-void Convert10BitFrameTo8BitDataBuffer(
-    const DAV1D_API::Dav1dPicture *decoder_buffer, jbyte *data)
+// Returns the size of a dimension of |size| samples downscaled by |factor|.
+constexpr int DownscaledSize(int size, int factor)
+{
+  return (size + factor - 1) / factor;
+}
+
+// Writes |destination_width| samples, each the rounded average of a |factor| x
+// |factor| block of samples from |rows|, which holds |factor| source rows of
+// |source_width| samples. |factor| is 2 or 4. Blocks that extend past the right
+// edge repeat the last column.
+void DownscaleRow(const uint8_t *const *rows, int factor, int source_width,
+                  uint8_t *destination, int destination_width)
+{
+  int x = 0;
+  if (factor == 2)
+  {
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+    for (; 2 * (x + 8) <= source_width; x += 8)
+    {
+      const uint16x8_t sums = vaddq_u16(vpaddlq_u8(vld1q_u8(rows[0] + 2 * x)),
+                                        vpaddlq_u8(vld1q_u8(rows[1] + 2 * x)));
+      vst1_u8(destination + x, vrshrn_n_u16(sums, 2));
+    }
+#elif defined(__i386__) || defined(__x86_64__)
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    const __m128i rounding = _mm_set1_epi16(2);
+    for (; 2 * (x + 8) <= source_width; x += 8)
+    {
+      __m128i sums = rounding;
+      for (int i = 0; i < 2; i++)
+      {
+        const __m128i samples =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[i] + 2 * x));
+        sums = _mm_add_epi16(sums, _mm_and_si128(samples, low_bytes));
+        sums = _mm_add_epi16(sums, _mm_srli_epi16(samples, 8));
+      }
+      _mm_storel_epi64(
+          reinterpret_cast<__m128i *>(destination + x),
+          _mm_packus_epi16(_mm_srli_epi16(sums, 2), _mm_setzero_si128()));
+    }
+#endif
+  }
+  else if (factor == 4)
+  {
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+    for (; 4 * (x + 8) <= source_width; x += 8)
+    {
+      uint16x8_t low_sums = vdupq_n_u16(0);
+      uint16x8_t high_sums = vdupq_n_u16(0);
+      for (int i = 0; i < 4; i++)
+      {
+        low_sums = vpadalq_u8(low_sums, vld1q_u8(rows[i] + 4 * x));
+        high_sums = vpadalq_u8(high_sums, vld1q_u8(rows[i] + 4 * x + 16));
+      }
+      const uint16x8_t averages =
+          vcombine_u16(vrshrn_n_u32(vpaddlq_u16(low_sums), 4),
+                       vrshrn_n_u32(vpaddlq_u16(high_sums), 4));
+      vst1_u8(destination + x, vmovn_u16(averages));
+    }
+#elif defined(__i386__) || defined(__x86_64__)
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i rounding = _mm_set1_epi32(8);
+    for (; 4 * (x + 8) <= source_width; x += 8)
+    {
+      __m128i low_sums = _mm_setzero_si128();
+      __m128i high_sums = _mm_setzero_si128();
+      for (int i = 0; i < 4; i++)
+      {
+        const __m128i low_samples =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[i] + 4 * x));
+        const __m128i high_samples = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(rows[i] + 4 * x + 16));
+        low_sums =
+            _mm_add_epi16(low_sums, _mm_and_si128(low_samples, low_bytes));
+        low_sums = _mm_add_epi16(low_sums, _mm_srli_epi16(low_samples, 8));
+        high_sums =
+            _mm_add_epi16(high_sums, _mm_and_si128(high_samples, low_bytes));
+        high_sums = _mm_add_epi16(high_sums, _mm_srli_epi16(high_samples, 8));
+      }
+      const __m128i low_averages = _mm_srli_epi32(
+          _mm_add_epi32(_mm_madd_epi16(low_sums, ones), rounding), 4);
+      const __m128i high_averages = _mm_srli_epi32(
+          _mm_add_epi32(_mm_madd_epi16(high_sums, ones), rounding), 4);
+      _mm_storel_epi64(
+          reinterpret_cast<__m128i *>(destination + x),
+          _mm_packus_epi16(_mm_packs_epi32(low_averages, high_averages),
+                           _mm_setzero_si128()));
+    }
+#endif
+  }
+  const int block_size = factor * factor;
+  for (; x < destination_width; x++)
+  {
+    int sum = block_size / 2;
+    for (int i = 0; i < factor; i++)
+    {
+      for (int j = 0; j < factor; j++)
+      {
+        sum += rows[i][std::min(x * factor + j, source_width - 1)];
+      }
+    }
+    destination[x] = sum / block_size;
+  }
+}
+
+// A plane copied by CopyPlanes(). |width| and |height| are the size of the
+// source region.
+struct PlaneCopy
+{
+  const uint8_t *source;
+  int source_stride;
+  uint8_t *destination;
+  int destination_stride;
+  int width;
+  int height;
+};
+
+// Downscales rows [|first_row|, |last_row|) of the destination of |plane| by
+// |factor|. Rows that extend past the bottom edge repeat the last row.
+void DownscalePlaneRows(const PlaneCopy &plane, int first_row, int last_row,
+                        int factor)
+{
+  const int destination_width = DownscaledSize(plane.width, factor);
+  const uint8_t *rows[4];
+  for (int row = first_row; row < last_row; row++)
+  {
+    for (int i = 0; i < factor; i++)
+    {
+      const int source_row = std::min(row * factor + i, plane.height - 1);
+      rows[i] = plane.source + source_row * plane.source_stride;
+    }
+    DownscaleRow(rows, factor, plane.width,
+                 plane.destination + row * plane.destination_stride,
+                 destination_width);
+  }
+}
+
+// Copies rows [|first_row|, |last_row|) of |plane|, downscaled by
+// |downscale_factor|. The rows are counted in the destination.
+void CopyPlaneRows(const PlaneCopy &plane, int first_row, int last_row,
+                   int downscale_factor, bool non_temporal)
+{
+  if (downscale_factor > 1)
+  {
+    DownscalePlaneRows(plane, first_row, last_row, downscale_factor);
+    return;
+  }
+  const uint8_t *source = plane.source + first_row * plane.source_stride;
+  uint8_t *destination =
+      plane.destination + first_row * plane.destination_stride;
+  if (non_temporal)
+  {
+    for (int row = first_row; row < last_row; row++)
+    {
+      CopyRowNonTemporal(source, destination, plane.width);
+      source += plane.source_stride;
+      destination += plane.destination_stride;
+    }
+  }
+  else
+  {
+    CopyPlane(source, plane.source_stride, destination,
+              plane.destination_stride, plane.width, last_row - first_row);
+  }
+}
+
+// Copies |plane_count| planes, downscaled by |downscale_factor|, which is 1, 2
+// or 4. Large frames, as determined by the size of the first plane, are split
+// into bands of rows that are copied in parallel.
+void CopyPlanes(const PlaneCopy *planes, int plane_count, int downscale_factor)
+{
+  if (planes[0].width * planes[0].height < kMinParallelCopySamples)
+  {
+    for (int i = 0; i < plane_count; i++)
+    {
+      CopyPlaneRows(planes[i], 0,
+                    DownscaledSize(planes[i].height, downscale_factor),
+                    downscale_factor, /*non_temporal=*/false);
+    }
+    return;
+  }
+
+  int band_count[kMaxPlanes];
+  int total_band_count = 0;
+  for (int i = 0; i < plane_count; i++)
+  {
+    band_count[i] = (DownscaledSize(planes[i].height, downscale_factor) +
+                     kCopyBandRows - 1) /
+                    kCopyBandRows;
+    total_band_count += band_count[i];
+  }
+  exoplayer_jni::WorkerPool::GetInstance().ParallelFor(
+      total_band_count, [planes, downscale_factor, &band_count](int band)
+      {
+        int plane_index = 0;
+        while (band >= band_count[plane_index])
+        {
+          band -= band_count[plane_index++];
+        }
+        const PlaneCopy &plane = planes[plane_index];
+        const int first_row = band * kCopyBandRows;
+        const int last_row =
+            std::min(first_row + kCopyBandRows,
+                     DownscaledSize(plane.height, downscale_factor));
+        CopyPlaneRows(plane, first_row, last_row, downscale_factor,
+                      /*non_temporal=*/true);
+#if defined(DAV1D_JNI_HAS_NONTEMPORAL_STORE) && \
+    (defined(__i386__) || defined(__x86_64__))
+        // Order the non-temporal stores before the window buffer is posted.
+        _mm_sfence();
+#endif
+      });
+}
+
+// A 4:2:0 frame converted by ConvertFrameToRgba(). Monochrome frames have null
+// chroma planes.
+struct RgbaConversion
+{
+  const uint8_t *planes[kMaxPlanes];
+  int strides[kMaxPlanes];
+  int width;
+  int height;
+  int bitdepth;
+  exoplayer_jni::YuvToRgbCoefficients coefficients;
+  uint8_t *destination;
+  int destination_stride;
+};
+
+// Converts an 8-bit or 10-bit frame to RGBA_8888 or RGBA_1010102 pixels
+// respectively. Large frames are split into bands of rows that are converted
+// in parallel.
+void ConvertFrameToRgba(const RgbaConversion &conversion)
 {
-  LOGI("Convert10BitFrameTo8BitDataBuffer");
-  for (int plane_index = kPlaneY; plane_index < 3;
-       plane_index++)
+  const int sample_size = (conversion.bitdepth == 8) ? 1 : 2;
+  // Monochrome frames are converted with neutral chroma samples.
+  std::vector<uint8_t> neutral_chroma;
+  const uint8_t *u_plane = conversion.planes[kPlaneU];
+  const uint8_t *v_plane = conversion.planes[kPlaneV];
+  int chroma_stride = conversion.strides[kPlaneU];
+  if (u_plane == nullptr)
   {
-    int sample = 0;
-    const auto *source = static_cast<const uint8_t *>(decoder_buffer->data[plane_index]);
-    for (int i = 0; i < decoder_buffer->p.h; i++)
+    const int chroma_width = (conversion.width + 1) / 2;
+    neutral_chroma.resize(chroma_width * sample_size);
+    for (int x = 0; x < chroma_width; x++)
     {
-      const auto *source_16 = reinterpret_cast<const uint16_t *>(source);
-      for (int j = 0; j < decoder_buffer->p.w; j++)
+      if (sample_size == 1)
       {
-        // Lightweight dither. Carryover the remainder of each 10->8 bit
-        // conversion to the next pixel.
-        sample += source_16[j];
-        data[j] = sample >> 2;
-        sample &= 3; // Remainder.
+        neutral_chroma[x] = kNeutralChroma;
+      }
+      else
+      {
+        const uint16_t sample = conversion.coefficients.chroma_offset;
+        memcpy(&neutral_chroma[2 * x], &sample, sizeof(sample));
       }
-      source += decoder_buffer->stride[plane_index];
-      data += decoder_buffer->stride[plane_index];
     }
+    u_plane = v_plane = neutral_chroma.data();
+    chroma_stride = 0;
+  }
+
+  const auto convert_rows = [&](int first_row, int last_row)
+  {
+    for (int row = first_row; row < last_row; row++)
+    {
+      const uint8_t *const y = conversion.planes[kPlaneY] +
+                               row * conversion.strides[kPlaneY];
+      const uint8_t *const u = u_plane + (row / 2) * chroma_stride;
+      const uint8_t *const v = v_plane + (row / 2) * chroma_stride;
+      uint8_t *const rgba =
+          conversion.destination + row * conversion.destination_stride;
+      if (sample_size == 1)
+      {
+        exoplayer_jni::ConvertRowToRgba8888(y, u, v, conversion.width,
+                                            conversion.coefficients, rgba);
+      }
+      else
+      {
+        exoplayer_jni::ConvertRowToRgba1010102(
+            reinterpret_cast<const uint16_t *>(y),
+            reinterpret_cast<const uint16_t *>(u),
+            reinterpret_cast<const uint16_t *>(v), conversion.width,
+            conversion.coefficients, reinterpret_cast<uint32_t *>(rgba));
+      }
+    }
+  };
+  if (conversion.width * conversion.height < kMinParallelCopySamples)
+  {
+    convert_rows(0, conversion.height);
+    return;
+  }
+  exoplayer_jni::WorkerPool::GetInstance().ParallelFor(
+      (conversion.height + kCopyBandRows - 1) / kCopyBandRows,
+      [&conversion, &convert_rows](int band)
+      {
+        const int first_row = band * kCopyBandRows;
+        convert_rows(first_row,
+                     std::min(first_row + kCopyBandRows, conversion.height));
+      });
+}
+
+
+
+// Downscales the planes of 8-bit |decoder_buffer| by |downscale_factor|, which
+// may be 1, into |data|, with |y_stride| for the Y plane and |uv_stride| for
+// the U and V planes. Monochrome frames only have a Y plane, and their U and V
+// planes are filled with a neutral value.
+void DownscaleFrameToDataBuffer(const DAV1D_API::Dav1dPicture *decoder_buffer,
+                                int downscale_factor, int y_stride,
+                                int uv_stride, jbyte *data)
+{
+  const int width = decoder_buffer->p.w;
+  const int height = decoder_buffer->p.h;
+  auto *const destination = reinterpret_cast<uint8_t *>(data);
+  const uint64_t y_length = static_cast<uint64_t>(y_stride) *
+                            DownscaledSize(height, downscale_factor);
+  const uint64_t uv_length =
+      static_cast<uint64_t>(uv_stride) *
+      DownscaledSize((height + 1) / 2, downscale_factor);
+  const auto *const y_source =
+      static_cast<const uint8_t *>(decoder_buffer->data[kPlaneY]);
+  const int y_source_stride = static_cast<int>(decoder_buffer->stride[0]);
+  if (decoder_buffer->p.layout == DAV1D_PIXEL_LAYOUT_I400)
+  {
+    const PlaneCopy y_plane = {y_source, y_source_stride, destination, y_stride,
+                               width, height};
+    CopyPlanes(&y_plane, 1, downscale_factor);
+    memset(destination + y_length, kNeutralChroma, 2 * uv_length);
+    return;
+  }
+  const int uv_source_stride = static_cast<int>(decoder_buffer->stride[1]);
+  const PlaneCopy planes[kMaxPlanes] = {
+      {y_source, y_source_stride, destination, y_stride, width, height},
+      {static_cast<const uint8_t *>(decoder_buffer->data[kPlaneU]),
+       uv_source_stride, destination + y_length, uv_stride, (width + 1) / 2,
+       (height + 1) / 2},
+      {static_cast<const uint8_t *>(decoder_buffer->data[kPlaneV]),
+       uv_source_stride, destination + y_length + uv_length, uv_stride,
+       (width + 1) / 2, (height + 1) / 2}};
+  CopyPlanes(planes, kMaxPlanes, downscale_factor);
+}
+
+// Copies the planes of |decoder_buffer| into |data|, with the decoder's Y
+// stride and |uv_stride| for the U and V planes. Monochrome frames only have a
+// Y plane, and their U and V planes are filled with a neutral value. Large
+// frames are copied in parallel bands.
+void CopyFrameToDataBuffer(const DAV1D_API::Dav1dPicture *decoder_buffer,
+                           int uv_stride, jbyte *data)
+{
+  if (decoder_buffer->p.w * decoder_buffer->p.h >= kMinParallelCopySamples)
+  {
+    DownscaleFrameToDataBuffer(decoder_buffer, /*downscale_factor=*/1,
+                               static_cast<int>(decoder_buffer->stride[kPlaneY]),
+                               uv_stride, data);
+    return;
+  }
+  const uint64_t y_length =
+      static_cast<uint64_t>(decoder_buffer->stride[kPlaneY]) * decoder_buffer->p.h;
+  const uint64_t uv_length =
+      static_cast<uint64_t>(uv_stride) * ((decoder_buffer->p.h + 1) / 2);
+  memcpy(data, decoder_buffer->data[kPlaneY], y_length);
+  data += y_length;
+  if (decoder_buffer->p.layout == DAV1D_PIXEL_LAYOUT_I400)
+  {
+    memset(data, kNeutralChroma, 2 * uv_length);
+    return;
+  }
+  memcpy(data, decoder_buffer->data[kPlaneU], uv_length);
+  memcpy(data + uv_length, decoder_buffer->data[kPlaneV], uv_length);
+}
+
+// Converts the planes of |decoder_buffer| to 8 bits into |data|, with the same
+// layout as CopyFrameToDataBuffer(). Large frames are converted in parallel
+// bands of rows.
+void Convert10BitFrameTo8BitDataBuffer(
+    const DAV1D_API::Dav1dPicture *decoder_buffer, int uv_stride, jbyte *data)
+{
+  LOGV("Convert10BitFrameTo8BitDataBuffer");
+  const bool monochrome = decoder_buffer->p.layout == DAV1D_PIXEL_LAYOUT_I400;
+  const int plane_count = monochrome ? 1 : kMaxPlanes;
+  auto *destination = reinterpret_cast<uint8_t *>(data);
+  exoplayer_jni::PlaneTo8Bit planes[kMaxPlanes];
+  for (int plane_index = kPlaneY; plane_index < plane_count; plane_index++)
+  {
+    const bool chroma = plane_index != kPlaneY;
+    const int width = chroma ? (decoder_buffer->p.w + 1) / 2 : decoder_buffer->p.w;
+    const int height = chroma ? (decoder_buffer->p.h + 1) / 2 : decoder_buffer->p.h;
+    const int source_stride =
+        static_cast<int>(decoder_buffer->stride[chroma ? 1 : 0]);
+    const int destination_stride = chroma ? uv_stride : source_stride;
+    planes[plane_index] = {
+        static_cast<const uint8_t *>(decoder_buffer->data[plane_index]),
+        source_stride, destination, destination_stride, width, height};
+    destination += static_cast<uint64_t>(destination_stride) * height;
+  }
+  if (monochrome)
+  {
+    memset(destination, kNeutralChroma,
+           2 * static_cast<uint64_t>(uv_stride) * ((decoder_buffer->p.h + 1) / 2));
+  }
+
+#if defined(__i386__) || defined(__x86_64__)
+  const exoplayer_jni::RowTo8BitConverter convert_row =
+      exoplayer_jni::ConvertRowTo8BitSse2;
+#else
+  const exoplayer_jni::RowTo8BitConverter convert_row =
+      exoplayer_jni::ConvertRowTo8Bit;
+#endif
+  exoplayer_jni::ConvertPlanesTo8Bit(
+      planes, plane_count, convert_row,
+      /*parallel=*/decoder_buffer->p.w * decoder_buffer->p.h >=
+              kMinParallelCopySamples &&
+          exoplayer_jni::WorkerPool::GetInstance().HasThreads());
+}
+
+// Returns the color space of |decoder_buffer|, as passed to
+// VideoDecoderOutputBuffer.
+int GetColorSpace(const DAV1D_API::Dav1dPicture *decoder_buffer)
+{
+  switch (decoder_buffer->seq_hdr->mtrx)
+  {
+    case DAV1D_MC_BT470BG:
+    case DAV1D_MC_BT601:
+      return exoplayer_jni::kColorSpaceBT601;
+    case DAV1D_MC_BT709:
+      return exoplayer_jni::kColorSpaceBT709;
+    case DAV1D_MC_BT2020_NCL:
+    case DAV1D_MC_BT2020_CL:
+      return exoplayer_jni::kColorSpaceBT2020;
+    default:
+      return exoplayer_jni::kColorSpaceUnknown;
+  }
+}
+
+// Stores a copy of |picture| in the frame cache of |context| if it is enabled,
+// under the presentation time of |jOutputBuffer|. Only 8-bit 4:2:0 frames are
+// cached.
+void MaybeCacheFrame(JNIEnv *env, JniContext *const context,
+                     const DAV1D_API::Dav1dPicture *picture,
+                     jobject jOutputBuffer)
+{
+  if (!context->frame_cache.enabled() || picture->p.bpc != 8 ||
+      picture->p.layout != DAV1D_PIXEL_LAYOUT_I420)
+  {
+    return;
   }
+  const uint8_t *const planes[kMaxPlanes] = {
+      static_cast<const uint8_t *>(picture->data[kPlaneY]),
+      static_cast<const uint8_t *>(picture->data[kPlaneU]),
+      static_cast<const uint8_t *>(picture->data[kPlaneV])};
+  const int strides[kMaxPlanes] = {static_cast<int>(picture->stride[0]),
+                                   static_cast<int>(picture->stride[1]),
+                                   static_cast<int>(picture->stride[1])};
+  context->frame_cache.Put(
+      env->GetLongField(jOutputBuffer, context->time_us_field), picture->p.w,
+      picture->p.h, GetColorSpace(picture), planes, strides);
+}
+
+// Converts |decoder_buffer| to RGBA pixels written to |data|, |stride| bytes
+// apart.
+void CopyFrameToRgbaDataBuffer(const DAV1D_API::Dav1dPicture *decoder_buffer,
+                               int stride, jbyte *data)
+{
+  const bool monochrome = decoder_buffer->p.layout == DAV1D_PIXEL_LAYOUT_I400;
+  RgbaConversion conversion;
+  for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++)
+  {
+    const bool present = plane_index == kPlaneY || !monochrome;
+    conversion.planes[plane_index] =
+        present ? static_cast<const uint8_t *>(decoder_buffer->data[plane_index])
+                : nullptr;
+    conversion.strides[plane_index] =
+        present ? static_cast<int>(
+                      decoder_buffer->stride[plane_index == kPlaneY ? 0 : 1])
+                : 0;
+  }
+  conversion.width = decoder_buffer->p.w;
+  conversion.height = decoder_buffer->p.h;
+  conversion.bitdepth = decoder_buffer->p.bpc;
+  conversion.coefficients = exoplayer_jni::GetYuvToRgbCoefficients(
+      GetColorSpace(decoder_buffer), decoder_buffer->seq_hdr->color_range != 0,
+      decoder_buffer->p.bpc);
+  conversion.destination = reinterpret_cast<uint8_t *>(data);
+  conversion.destination_stride = stride;
+  ConvertFrameToRgba(conversion);
 }
 
 void libdav1d_data_free(const uint8_t *data, void *opaque)
@@ -434,23 +1063,332 @@ void libdav1d_data_free(const uint8_t *data, void *opaque)
   //
   //        av_buffer_unref(&buf);
 }
-} // namespace
+// Header at the start of the FrameArena block of a picture allocated by
+// AllocateBudgetedPicture().
+struct PictureAllocation
+{
+  size_t block_size;
+  size_t budget_size;
+};
 
-DECODER_FUNC(jlong, gav1Init, jint threads)
+// Allocates |picture| with the layout of dav1d's default allocator, in memory
+// leased from the FrameArena, and accounts it against the picture budget of
+// the JniContext |cookie|. Fails with ENOMEM if the budget would be exceeded,
+// which fails the decode. Called on dav1d's threads.
+int AllocateBudgetedPicture(DAV1D_API::Dav1dPicture *picture, void *cookie)
 {
-  JniContext *context = new (std::nothrow) JniContext();
-  if (context == nullptr)
+  auto *const context = static_cast<JniContext *>(cookie);
+  const int high_bit_depth = (picture->p.bpc > 8) ? 1 : 0;
+  const int aligned_width = (picture->p.w + 127) & ~127;
+  const int aligned_height = (picture->p.h + 127) & ~127;
+  const bool has_chroma = picture->p.layout != DAV1D_PIXEL_LAYOUT_I400;
+  const int ss_ver = (picture->p.layout == DAV1D_PIXEL_LAYOUT_I420) ? 1 : 0;
+  const int ss_hor = (picture->p.layout != DAV1D_PIXEL_LAYOUT_I444) ? 1 : 0;
+  ptrdiff_t y_stride = static_cast<ptrdiff_t>(aligned_width) << high_bit_depth;
+  ptrdiff_t uv_stride = has_chroma ? y_stride >> ss_hor : 0;
+  // Like dav1d, avoid strides that are multiples of 1024 bytes, which map the
+  // rows of a superblock to the same cache sets.
+  if ((y_stride & 1023) == 0)
   {
-    return kStatusError;
+    y_stride += DAV1D_PICTURE_ALIGNMENT;
+  }
+  if (has_chroma && (uv_stride & 1023) == 0)
+  {
+    uv_stride += DAV1D_PICTURE_ALIGNMENT;
+  }
+  const size_t y_size = static_cast<size_t>(y_stride) * aligned_height;
+  const size_t uv_size =
+      static_cast<size_t>(uv_stride) * (aligned_height >> ss_ver);
+  // Leave room for the header, for aligning the planes and for the padding
+  // dav1d may read past the end.
+  const size_t size = sizeof(PictureAllocation) + y_size + 2 * uv_size +
+                      2 * DAV1D_PICTURE_ALIGNMENT;
+
+  const size_t budget = context->picture_budget_bytes;
+  if (context->picture_bytes.fetch_add(size) + size > budget)
+  {
+    context->picture_bytes.fetch_sub(size);
+    LOGE("Picture budget of %zu bytes exceeded", budget);
+    return DAV1D_ERR(ENOMEM);
+  }
+  size_t block_size;
+  uint8_t *const block =
+      exoplayer_jni::FrameArena::GetInstance().Lease(size, &block_size);
+  if (block == nullptr)
+  {
+    context->picture_bytes.fetch_sub(size);
+    return DAV1D_ERR(ENOMEM);
+  }
+  auto *const allocation = new (block) PictureAllocation{block_size, size};
+  const uintptr_t planes =
+      reinterpret_cast<uintptr_t>(block + sizeof(*allocation));
+  uint8_t *const data = reinterpret_cast<uint8_t *>(
+      (planes + DAV1D_PICTURE_ALIGNMENT - 1) &
+      ~static_cast<uintptr_t>(DAV1D_PICTURE_ALIGNMENT - 1));
+  picture->stride[0] = y_stride;
+  picture->stride[1] = uv_stride;
+  picture->data[0] = data;
+  picture->data[1] = has_chroma ? data + y_size : nullptr;
+  picture->data[2] = has_chroma ? data + y_size + uv_size : nullptr;
+  picture->allocator_data = allocation;
+  return 0;
+}
+
+// Releases a picture allocated by AllocateBudgetedPicture(). Called on any
+// thread.
+void ReleaseBudgetedPicture(DAV1D_API::Dav1dPicture *picture, void *cookie)
+{
+  auto *const context = static_cast<JniContext *>(cookie);
+  auto *const allocation =
+      static_cast<PictureAllocation *>(picture->allocator_data);
+  context->picture_bytes.fetch_sub(allocation->budget_size);
+  exoplayer_jni::FrameArena::GetInstance().Return(
+      reinterpret_cast<uint8_t *>(allocation), allocation->block_size);
+}
+
+// Opens the dav1d decoder of |context| with |threads| threads, closing any
+// previous one. Dav1d fixes its thread count when it is opened, so this is how
+// the count is changed. Data queued in the previous decoder is dropped, but
+// pictures held by output buffers keep their own references and stay valid.
+int OpenDecoder(JniContext *const context, int threads)
+{
+  if (context->c_out)
+  {
+    dav1d_close(&context->c_out);
   }
-  LOGI("init %p", &context->buffer_manager);
   DAV1D_API::Dav1dSettings settings;
   dav1d_default_settings(&settings);
-  context->avid_status_code = dav1d_open(&(context->c_out), &settings);
+  settings.n_threads = std::min(threads, DAV1D_MAX_THREADS);
+  // Film grain is applied to the output frames by MaybeApplyFilmGrain().
+  settings.apply_grain = 0;
+  const StreamLimits &limits = context->stream_limits;
+  settings.frame_size_limit = limits.frame_size_limit;
+  settings.operating_point = limits.operating_point;
+  settings.all_layers = limits.all_layers ? 1 : 0;
+  context->picture_budget_bytes = limits.picture_budget_bytes;
+  if (limits.picture_budget_bytes > 0)
+  {
+    settings.allocator.cookie = context;
+    settings.allocator.alloc_picture_callback = AllocateBudgetedPicture;
+    settings.allocator.release_picture_callback = ReleaseBudgetedPicture;
+  }
+  if (context->blocking_dequeue)
+  {
+    settings.max_frame_delay = 1;
+  }
+  const int status = dav1d_open(&context->c_out, &settings);
+  context->threads = (status == kJniStatusOk) ? threads : 0;
+  return status;
+}
+
+// Replaces |picture| by a copy with its film grain applied, if it has film
+// grain and film grain is enabled. Dav1d decodes without film grain, see
+// OpenDecoder(), so that dav1d's SIMD implementation only synthesizes it for
+// the frames that are output, and not for the decode-only ones. Keeps
+// |picture| as is if the grain cannot be applied. |context->decoder_mutex|
+// must be held, as the grain is applied with the dav1d context.
+void MaybeApplyFilmGrain(JniContext *const context,
+                         DAV1D_API::Dav1dPicture *picture)
+{
+  if (!context->film_grain || context->c_out == nullptr ||
+      picture->frame_hdr == nullptr || !picture->frame_hdr->film_grain.present)
+  {
+    return;
+  }
+  DAV1D_API::Dav1dPicture grain_picture = {};
+  const int status = dav1d_apply_grain(context->c_out, &grain_picture, picture);
+  if (status != 0)
+  {
+    LOGE("dav1d_apply_grain %d", status);
+    return;
+  }
+  dav1d_picture_unref(picture);
+  *picture = grain_picture;
+}
+
+// Closes the dav1d decoder of |context|, which stops its threads and frees its
+// picture pool, and clears the frame cache. The configuration of the context
+// is kept. The decoder is reopened by
+// ResumeContext(), after which decoding restarts at the next key frame.
+// |context->decoder_mutex| must be held.
+void SuspendContext(JniContext *const context)
+{
+  if (context->c_out == nullptr)
+  {
+    return;
+  }
+  dav1d_close(&context->c_out);
+  context->frame_cache.Clear();
+  context->awaiting_key_frame = true;
+  context->restarting = true;
+}
+
+// Reopens the decoder of a suspended context with the number of threads it
+// had. Does nothing if the context is not suspended. |context->decoder_mutex|
+// must be held.
+int ResumeContext(JniContext *const context)
+{
+  if (context->c_out != nullptr)
+  {
+    return kJniStatusOk;
+  }
+  return OpenDecoder(context, context->threads);
+}
+
+// Maximum number of contexts kept by IdleContextPool. Each one keeps its
+// decoder and frame buffers, so the pool is kept small.
+constexpr int kMaxIdleContexts = 2;
+
+// Keeps the contexts of closed decoders, flushed but with their dav1d decoder
+// and frame buffers still allocated, so that gav1Init can reuse one instead of
+// opening a new decoder. This shortens the time to the first frame when
+// switching between channels or tracks. Idle decoders are reopened with a
+// single thread, which runs on the caller, so that the pool holds no threads
+// outside the DecoderThreadBudget of the decoders in use. gav1Init reopens a
+// reused decoder that is given more.
+class IdleContextPool
+{
+ public:
+  // Returns the pool of the process. It is never destroyed.
+  static IdleContextPool &GetInstance()
+  {
+    static IdleContextPool *const instance = new IdleContextPool();
+    return *instance;
+  }
+
+  // Removes and returns an idle context, whose decoder uses a single thread
+  // and the default configuration, or returns nullptr if there is none.
+  JniContext *Lease()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (contexts_.empty())
+    {
+      return nullptr;
+    }
+    JniContext *const context = contexts_.back();
+    contexts_.pop_back();
+    return context;
+  }
+
+  // Takes ownership of |context| unless the pool is full or its decoder could
+  // not be reopened with a single thread. Returns whether it did.
+  bool Park(JniContext *context)
+  {
+    if (IsFull())
+    {
+      return false;
+    }
+    if (context->threads != 1 || context->blocking_dequeue ||
+        !context->stream_limits.IsDefault())
+    {
+      context->blocking_dequeue = false;
+      context->stream_limits = StreamLimits();
+      context->avid_status_code = OpenDecoder(context, 1);
+      if (context->avid_status_code != kJniStatusOk)
+      {
+        return false;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (static_cast<int>(contexts_.size()) >= kMaxIdleContexts)
+    {
+      return false;
+    }
+    contexts_.push_back(context);
+    return true;
+  }
+
+ private:
+  IdleContextPool() = default;
+
+  bool IsFull()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(contexts_.size()) >= kMaxIdleContexts;
+  }
+
+  std::mutex mutex_;
+  std::vector<JniContext *> contexts_;
+};
+
+// Returns |context| to the state of a newly opened one, keeping its decoder
+// and frame buffers.
+void ResetContextForReuse(JniContext *const context)
+{
+  // Drops the data and pictures still queued in the decoder.
+  dav1d_flush(context->c_out);
+  if (context->native_window)
+  {
+    ANativeWindow_release(context->native_window);
+    context->native_window = nullptr;
+  }
+  context->surface = nullptr;
+  context->native_window_width = 0;
+  context->native_window_height = 0;
+  context->downscale_factor = 1;
+  context->film_grain = true;
+  context->input_parser.Reset();
+  context->trick_play = false;
+  context->awaiting_key_frame = false;
+  context->restarting = false;
+  context->trick_play_parser.Reset();
+  context->frame_cache.Reset();
+  context->avid_status_code = kJniStatusOk;
+  context->jni_status_code = kJniStatusOk;
+}
+
+// Returns whether the temporal unit of |size| bytes at |data| is skipped
+// instead of decoded. In trick-play mode, only temporal units whose frames are
+// all intra coded are decoded. Once a temporal unit has been skipped, inter
+// frames are skipped until the next key frame refreshes every reference frame.
+// Temporal units that cannot be classified are decoded, unless the decoder was
+// reopened after a suspension and has not decoded a key frame yet.
+bool SkipTemporalUnit(JniContext *const context, const uint8_t *data,
+                      size_t size)
+{
+  if (!context->trick_play && !context->awaiting_key_frame)
+  {
+    return false;
+  }
+  exoplayer_jni::TemporalUnitInfo info;
+  if (!context->trick_play_parser.ParseTemporalUnit(data, size, &info))
+  {
+    return context->restarting;
+  }
+  if (context->restarting && info.show_existing_frame)
+  {
+    // The reopened decoder holds no frame to show.
+    return true;
+  }
+  if (info.key_frame)
+  {
+    context->awaiting_key_frame = false;
+    context->restarting = false;
+    return false;
+  }
+  if (context->trick_play && info.intra_only && !context->restarting)
+  {
+    return false;
+  }
+  context->awaiting_key_frame = true;
+  return true;
+}
+
+// Creates a context with a decoder using |threads| threads. On failure, the
+// status codes of the returned context describe the error. Returns nullptr if
+// the context could not be allocated.
+JniContext *NewContext(JNIEnv *env, int threads)
+{
+  JniContext *context = new (std::nothrow) JniContext();
+  if (context == nullptr)
+  {
+    return nullptr;
+  }
+  context->avid_status_code = OpenDecoder(context, threads);
   if (context->avid_status_code != kJniStatusOk)
   {
-    LOGI("dav1d_open %d", context->avid_status_code);
-    return reinterpret_cast<jlong>(context);
+    LOGE("dav1d_open %d", context->avid_status_code);
+    return context;
   }
 
   // Populate JNI References.
@@ -461,31 +1399,165 @@ DECODER_FUNC(jlong, gav1Init, jint threads)
   context->output_mode_field = env->GetFieldID(outputBufferClass, "mode", "I");
   context->data_field =
       env->GetFieldID(outputBufferClass, "data", "Ljava/nio/ByteBuffer;");
+  context->time_us_field = env->GetFieldID(outputBufferClass, "timeUs", "J");
   context->init_for_private_frame_method =
       env->GetMethodID(outputBufferClass, "initForPrivateFrame", "(II)V");
   context->init_for_yuv_frame_method =
       env->GetMethodID(outputBufferClass, "initForYuvFrame", "(IIIII)Z");
+  context->init_for_rgba_frame_method =
+      env->GetMethodID(outputBufferClass, "initForRgbaFrame", "(IIIII)Z");
+  return context;
+}
+} // namespace
+
+DECODER_FUNC(jlong, gav1Init, jint threads)
+{
+  // Reuse the context of a closed decoder if there is one.
+  JniContext *context = IdleContextPool::GetInstance().Lease();
+  if (context != nullptr)
+  {
+    if (context->threads != threads)
+    {
+      context->avid_status_code = OpenDecoder(context, threads);
+    }
+    return reinterpret_cast<jlong>(context);
+  }
+  context = NewContext(env, threads);
+  if (context == nullptr)
+  {
+    return kStatusError;
+  }
   return reinterpret_cast<jlong>(context);
 }
 
+DECODER_FUNC(void, gav1Prewarm, jint count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    // Idle decoders use a single thread, see IdleContextPool.
+    JniContext *const context = NewContext(env, 1);
+    if (context == nullptr)
+    {
+      return;
+    }
+    if (context->threads == 0 || !IdleContextPool::GetInstance().Park(context))
+    {
+      delete context;
+      return;
+    }
+  }
+}
+
 DECODER_FUNC(void, gav1Close, jlong jContext)
 {
   auto *const context = reinterpret_cast<JniContext *>(jContext);
+  // Keep the context for the next decoder if it is healthy, not suspended and
+  // there is room. A context whose buffers are still held by output buffers
+  // the renderer has not released is destroyed instead, as they would be
+  // released into the next decoder.
+  if (context->c_out != nullptr && context->threads > 0 &&
+      context->jni_status_code == kJniStatusOk &&
+      !context->buffer_manager.HasBuffersInUse())
+  {
+    ResetContextForReuse(context);
+    if (IdleContextPool::GetInstance().Park(context))
+    {
+      return;
+    }
+  }
   delete context;
 }
 
+DECODER_FUNC(jint, gav1Reconfigure, jlong jContext, jint threads,
+             jboolean blockingDequeue)
+{
+  auto *const context = reinterpret_cast<JniContext *>(jContext);
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  context->blocking_dequeue = blockingDequeue;
+  context->avid_status_code = OpenDecoder(context, threads);
+  if (context->avid_status_code != kJniStatusOk)
+  {
+    return kStatusError;
+  }
+  return kStatusOk;
+}
+
+DECODER_FUNC(void, gav1Suspend, jlong jContext)
+{
+  auto *const context = reinterpret_cast<JniContext *>(jContext);
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  SuspendContext(context);
+}
+
+DECODER_FUNC(jint, gav1Resume, jlong jContext)
+{
+  auto *const context = reinterpret_cast<JniContext *>(jContext);
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  context->avid_status_code = ResumeContext(context);
+  if (context->avid_status_code != kJniStatusOk)
+  {
+    return kStatusError;
+  }
+  return kStatusOk;
+}
+
+DECODER_FUNC(void, gav1SetStreamLimits, jlong jContext, jint maxFramePixels,
+             jint operatingPoint, jboolean allLayers, jlong maxPictureBytes)
+{
+  auto *const context = reinterpret_cast<JniContext *>(jContext);
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  context->stream_limits.frame_size_limit =
+      static_cast<unsigned>(maxFramePixels);
+  context->stream_limits.operating_point = operatingPoint;
+  context->stream_limits.all_layers = allLayers;
+  context->stream_limits.picture_budget_bytes =
+      static_cast<size_t>(maxPictureBytes);
+}
+
+DECODER_FUNC(jint, gav1ClassifyTemporalUnit, jlong jContext,
+             jobject encodedData, jint offset, jint length)
+{
+  auto *const context = reinterpret_cast<JniContext *>(jContext);
+  const auto *const buffer = reinterpret_cast<const uint8_t *>(
+      env->GetDirectBufferAddress(encodedData));
+  exoplayer_jni::TemporalUnitInfo info;
+  if (buffer == nullptr ||
+      !context->input_parser.ParseTemporalUnit(buffer + offset, length, &info))
+  {
+    return exoplayer_jni::kTemporalUnitUnknown;
+  }
+  return exoplayer_jni::PackTemporalUnitInfo(info);
+}
+
+DECODER_FUNC(void, gav1SetTrickPlayEnabled, jlong jContext, jboolean enabled)
+{
+  auto *const context = reinterpret_cast<JniContext *>(jContext);
+  context->trick_play = enabled;
+}
+
 DECODER_FUNC(jint, gav1Decode, jlong jContext, jobject encodedData,
              jint length)
 {
   auto *const context = reinterpret_cast<JniContext *>(jContext);
   const auto *const buffer = reinterpret_cast<const uint8_t *>(
       env->GetDirectBufferAddress(encodedData));
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  if (SkipTemporalUnit(context, buffer, length))
+  {
+    return kStatusDecodeOnly;
+  }
+  context->avid_status_code = ResumeContext(context);
+  if (context->avid_status_code != kJniStatusOk)
+  {
+    LOGE("dav1d_open %d", context->avid_status_code);
+    return kStatusError;
+  }
   Dav1dData data;
   context->avid_status_code = dav1d_data_wrap(&data, buffer, length, libdav1d_data_free, data.ref);
 
   if (context->avid_status_code != kJniStatusOk)
   {
-    LOGI("dav1d_data_wrap %d", context->avid_status_code);
+    LOGE("dav1d_data_wrap %d", context->avid_status_code);
     return kStatusError;
   }
 
@@ -494,7 +1566,7 @@ DECODER_FUNC(jint, gav1Decode, jlong jContext, jobject encodedData,
   if (context->avid_status_code != kJniStatusOk &&
       context->avid_status_code != DAV1D_ERR(EAGAIN))
   {
-    LOGI("dav1d_send_data %d", context->avid_status_code);
+    LOGE("dav1d_send_data %d", context->avid_status_code);
     return kStatusError;
   }
 
@@ -505,15 +1577,24 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
              jboolean decodeOnly)
 {
   auto *const context = reinterpret_cast<JniContext *>(jContext);
-  Dav1dPicture pic = {0}, *p = &pic;
+  ScopedPicture picture;
+  DAV1D_API::Dav1dPicture *const p = picture.get();
 
+  std::lock_guard<std::mutex> lock(context->decoder_mutex);
+  if (context->c_out == nullptr)
+  {
+    // This is not an error. The decoder was suspended after the data was
+    // sent, dropping its picture.
+    return kStatusDecodeOnly;
+  }
   context->avid_status_code = dav1d_get_picture(context->c_out, p);
   if (context->avid_status_code == DAV1D_ERR(EAGAIN)) {
-    LOGI("dav1d_get_picture EAGAIN");
-    return kStatusOk;
+    // This is not an error. Dav1d needs more data before it outputs a picture,
+    // which only happens with frame delay.
+    return kStatusDecodeOnly;
   }
   if (context->avid_status_code != kJniStatusOk) {
-    LOGI("dav1d_get_picture %d", context->avid_status_code);
+    LOGE("dav1d_get_picture %d", context->avid_status_code);
     return kStatusError;
   }
 
@@ -523,32 +1604,42 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
     return kStatusDecodeOnly;
   }
 
-  JniFrameBuffer *jni_buffer;
-  context->jni_status_code = context->buffer_manager.GetBuffer(p->stride[0],
-                                                               p->stride[1],
-                                                               &jni_buffer);
-  //    LOGI("宽 %d，高 %d，y %td，uv %td,bit %d", p->p.w, p->p.h,
-  //         p->stride[0], p->stride[1], p->p.bpc);
-  if (context->jni_status_code != kJniStatusOk)
-  {
-    LOGE("GetBuffer %s", GetJniErrorMessage(context->jni_status_code));
-    return kStatusError;
-  }
-
+  // The grain is applied here, where the dav1d context is already locked,
+  // rather than in gav1RenderFrame, where the render thread would wait for
+  // the decode thread. The cache holds frames as they are shown, so the grain
+  // is applied first.
+  MaybeApplyFilmGrain(context, p);
   const int output_mode =
       env->GetIntField(jOutputBuffer, context->output_mode_field);
+  if (output_mode != kOutputModeSurfaceYuv)
+  {
+    // Frames rendered to a surface are cached in gav1RenderFrame.
+    MaybeCacheFrame(env, context, p, jOutputBuffer);
+  }
   if (output_mode == kOutputModeYuv)
   {
-    // Resize the buffer if required. Default color conversion will be used as
-    // libgav1::DecoderBuffer doesn't expose color space info.
+    // Only 8-bit frames are downscaled, into planes with packed rows.
+    const int downscale_factor =
+        (p->p.bpc == 8) ? context->downscale_factor : 1;
+    const int output_width = DownscaledSize(p->p.w, downscale_factor);
+    const int output_height = DownscaledSize(p->p.h, downscale_factor);
+    const int y_stride = (downscale_factor > 1) ? AlignTo16(output_width)
+                                                : p->stride[kPlaneY];
+    // Monochrome frames have no chroma stride, and are output with 4:2:0
+    // chroma planes.
+    const int uv_stride = (p->p.layout == DAV1D_PIXEL_LAYOUT_I400 ||
+                           downscale_factor > 1)
+                              ? AlignTo16((output_width + 1) / 2)
+                              : p->stride[kPlaneU];
+    // Resize the buffer if required.
     const jboolean init_result = env->CallBooleanMethod(
         jOutputBuffer,
         context->init_for_yuv_frame_method,
-        p->p.w,
-        p->p.h,
-        p->stride[kPlaneY],
-        p->stride[kPlaneU],
-        kColorSpaceUnknown);
+        output_width,
+        output_height,
+        y_stride,
+        uv_stride,
+        GetColorSpace(p));
     if (env->ExceptionCheck())
     {
       // Exception is thrown in Java when returning from the native call.
@@ -567,16 +1658,62 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
     switch (p->p.bpc)
     {
       case 8:
-        CopyFrameToDataBuffer(p, data);
+        if (downscale_factor > 1)
+        {
+          DownscaleFrameToDataBuffer(p, downscale_factor, y_stride, uv_stride,
+                                     data);
+        }
+        else
+        {
+          CopyFrameToDataBuffer(p, uv_stride, data);
+        }
         break;
       case 10:
-        Convert10BitFrameTo8BitDataBuffer(p, data);
+        Convert10BitFrameTo8BitDataBuffer(p, uv_stride, data);
         break;
       default:
         context->jni_status_code = kJniStatusBitDepth12NotSupportedWithYuv;
         return kStatusError;
     }
   }
+  else if (output_mode == kOutputModeRgba)
+  {
+    if ((p->p.bpc != 8 && p->p.bpc != 10) ||
+        (p->p.layout != DAV1D_PIXEL_LAYOUT_I420 &&
+         p->p.layout != DAV1D_PIXEL_LAYOUT_I400))
+    {
+      context->jni_status_code = kJniStatusUnsupportedRgbaFrame;
+      return kStatusError;
+    }
+    // Frames are converted at their decoded size. Both RGBA formats use 4
+    // bytes per pixel.
+    const int stride = p->p.w * 4;
+    const jboolean init_result = env->CallBooleanMethod(
+        jOutputBuffer,
+        context->init_for_rgba_frame_method,
+        p->p.w,
+        p->p.h,
+        stride,
+        (p->p.bpc == 8) ? exoplayer_jni::kRgbaFormat8888
+                        : exoplayer_jni::kRgbaFormat1010102,
+        GetColorSpace(p));
+    if (env->ExceptionCheck())
+    {
+      // Exception is thrown in Java when returning from the native call.
+      return kStatusError;
+    }
+    if (!init_result)
+    {
+      context->jni_status_code = kJniStatusBufferResizeError;
+      return kStatusError;
+    }
+
+    const jobject data_object =
+        env->GetObjectField(jOutputBuffer, context->data_field);
+    auto *const data =
+        reinterpret_cast<jbyte *>(env->GetDirectBufferAddress(data_object));
+    CopyFrameToRgbaDataBuffer(p, stride, data);
+  }
   else if (output_mode == kOutputModeSurfaceYuv)
   {
     if (p->p.bpc != 8)
@@ -585,13 +1722,24 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
           kJniStatusHighBitDepthNotSupportedWithSurfaceYuv;
       return kStatusError;
     }
-    jni_buffer->SetFrameData(*p);
+    // Only frames rendered to a surface hold a buffer, which Java releases
+    // with gav1ReleaseFrame. Frames copied out in the other modes need none.
+    JniFrameBuffer *jni_buffer;
+    context->jni_status_code = context->buffer_manager.GetBuffer(&jni_buffer);
+    if (context->jni_status_code != kJniStatusOk)
+    {
+      LOGE("GetBuffer %s", GetJniErrorMessage(context->jni_status_code));
+      return kStatusError;
+    }
+    const int width = DownscaledSize(p->p.w, context->downscale_factor);
+    const int height = DownscaledSize(p->p.h, context->downscale_factor);
+    jni_buffer->SetFrameData(p, /*render_pending=*/true);
     env->CallVoidMethod(jOutputBuffer, context->init_for_private_frame_method,
-                        p->p.w,
-                        p->p.h);
+                        width, height);
     if (env->ExceptionCheck())
     {
-      // Exception is thrown in Java when returning from the native call.gav1GetFrame
+      // Exception is thrown in Java when returning from the native call.
+      context->buffer_manager.ReleaseBuffer(*(jni_buffer->BufferPrivateData()));
       return kStatusError;
     }
     env->SetIntField(jOutputBuffer, context->decoder_private_field,
@@ -608,24 +1756,39 @@ DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
   const int buffer_id =
       env->GetIntField(jOutputBuffer, context->decoder_private_field);
   JniFrameBuffer *const jni_buffer =
-      context->buffer_manager.GetBuffer(buffer_id);
+      context->buffer_manager.GetBufferInUse(buffer_id);
+  if (jni_buffer == nullptr)
+  {
+    context->jni_status_code = kJniStatusInvalidBufferId;
+    return kStatusError;
+  }
   if (!context->MaybeAcquireNativeWindow(env, jSurface))
   {
     return kStatusError;
   }
+  if (jni_buffer->RenderPending())
+  {
+    DAV1D_API::Dav1dPicture picture = jni_buffer->TakePicture();
+    MaybeCacheFrame(env, context, &picture, jOutputBuffer);
+    jni_buffer->SetFrameData(&picture, /*render_pending=*/false);
+  }
 
-  if (context->native_window_width != jni_buffer->DisplayedWidth(kPlaneY) ||
-      context->native_window_height != jni_buffer->DisplayedHeight(kPlaneY))
+  const int downscale_factor = context->downscale_factor;
+  const int width =
+      DownscaledSize(jni_buffer->DisplayedWidth(kPlaneY), downscale_factor);
+  const int height =
+      DownscaledSize(jni_buffer->DisplayedHeight(kPlaneY), downscale_factor);
+  if (context->native_window_width != width ||
+      context->native_window_height != height)
   {
-    if (ANativeWindow_setBuffersGeometry(
-        context->native_window, jni_buffer->DisplayedWidth(kPlaneY),
-        jni_buffer->DisplayedHeight(kPlaneY), kImageFormatYV12))
+    if (ANativeWindow_setBuffersGeometry(context->native_window, width, height,
+                                         kImageFormatYV12))
     {
       context->jni_status_code = kJniStatusANativeWindowError;
       return kStatusError;
     }
-    context->native_window_width = jni_buffer->DisplayedWidth(kPlaneY);
-    context->native_window_height = jni_buffer->DisplayedHeight(kPlaneY);
+    context->native_window_width = width;
+    context->native_window_height = height;
   }
 
   ANativeWindow_Buffer native_window_buffer;
@@ -635,14 +1798,8 @@ DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
     context->jni_status_code = kJniStatusANativeWindowError;
     return kStatusError;
   }
-  // Y plane
-  CopyPlane(jni_buffer->Plane(kPlaneY),
-            jni_buffer->Stride(kPlaneY),
-            reinterpret_cast<uint8_t *>(native_window_buffer.bits),
-            native_window_buffer.stride,
-            jni_buffer->DisplayedWidth(kPlaneY),
-            jni_buffer->DisplayedHeight(kPlaneY));
-
+  auto *const window_data =
+      reinterpret_cast<uint8_t *>(native_window_buffer.bits);
   const int y_plane_size =
       native_window_buffer.stride * native_window_buffer.height;
   const int32_t native_window_buffer_uv_height =
@@ -650,31 +1807,58 @@ DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
   const int native_window_buffer_uv_stride =
       AlignTo16(native_window_buffer.stride / 2);
 
-  // TODO(b/140606738): Handle monochrome videos.
+  if (jni_buffer->NumPlanes() == 1)
+  {
+    // Monochrome frames only have a Y plane. Fill the V and U planes, which
+    // follow it, with a neutral value.
+    const PlaneCopy y_plane = {jni_buffer->Plane(kPlaneY),
+                               jni_buffer->Stride(kPlaneY),
+                               window_data,
+                               native_window_buffer.stride,
+                               jni_buffer->DisplayedWidth(kPlaneY),
+                               jni_buffer->DisplayedHeight(kPlaneY)};
+    CopyPlanes(&y_plane, 1, downscale_factor);
+    memset(window_data + y_plane_size, kNeutralChroma,
+           2 * native_window_buffer_uv_stride * native_window_buffer_uv_height);
+    if (ANativeWindow_unlockAndPost(context->native_window)) {
+      context->jni_status_code = kJniStatusANativeWindowError;
+      return kStatusError;
+    }
+    return kStatusOk;
+  }
 
-  // V plane
   // Since the format for ANativeWindow is YV12, V plane is being processed
   // before U plane.
   const int v_plane_height =
-      std::min(native_window_buffer_uv_height, jni_buffer->DisplayedHeight(kPlaneV));
-
-  CopyPlane(
-      jni_buffer->Plane(kPlaneV),
-      jni_buffer->Stride(kPlaneV),
-      reinterpret_cast<uint8_t *>(native_window_buffer.bits) + y_plane_size,
-      native_window_buffer_uv_stride, jni_buffer->DisplayedWidth(kPlaneV),
-      v_plane_height);
-
-  const int v_plane_size = v_plane_height * native_window_buffer_uv_stride;
-
-
-  // U plane
-  CopyPlane(jni_buffer->Plane(kPlaneU),
-            jni_buffer->Stride(kPlaneU),
-            reinterpret_cast<uint8_t *>(native_window_buffer.bits) + y_plane_size + v_plane_size,
-            native_window_buffer_uv_stride,
-            jni_buffer->DisplayedWidth(kPlaneU),
-            std::min(native_window_buffer_uv_height, jni_buffer->DisplayedHeight(kPlaneU)));
+      std::min(native_window_buffer_uv_height * downscale_factor,
+               jni_buffer->DisplayedHeight(kPlaneV));
+  const int v_plane_size = DownscaledSize(v_plane_height, downscale_factor) *
+                           native_window_buffer_uv_stride;
+
+  const PlaneCopy planes[kMaxPlanes] = {
+      // Y plane
+      {jni_buffer->Plane(kPlaneY),
+       jni_buffer->Stride(kPlaneY),
+       window_data,
+       native_window_buffer.stride,
+       jni_buffer->DisplayedWidth(kPlaneY),
+       jni_buffer->DisplayedHeight(kPlaneY)},
+      // V plane
+      {jni_buffer->Plane(kPlaneV),
+       jni_buffer->Stride(kPlaneV),
+       window_data + y_plane_size,
+       native_window_buffer_uv_stride,
+       jni_buffer->DisplayedWidth(kPlaneV),
+       v_plane_height},
+      // U plane
+      {jni_buffer->Plane(kPlaneU),
+       jni_buffer->Stride(kPlaneU),
+       window_data + y_plane_size + v_plane_size,
+       native_window_buffer_uv_stride,
+       jni_buffer->DisplayedWidth(kPlaneU),
+       std::min(native_window_buffer_uv_height * downscale_factor,
+                jni_buffer->DisplayedHeight(kPlaneU))}};
+  CopyPlanes(planes, kMaxPlanes, downscale_factor);
 
   if (ANativeWindow_unlockAndPost(context->native_window)) {
     context->jni_status_code = kJniStatusANativeWindowError;
@@ -683,6 +1867,62 @@ DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
   return kStatusOk;
 }
 
+DECODER_FUNC(void, gav1SetDownscaleFactor, jlong jContext, jint factor)
+{
+  JniContext *const context = reinterpret_cast<JniContext *>(jContext);
+  context->downscale_factor = factor;
+}
+
+DECODER_FUNC(void, gav1SetFilmGrainEnabled, jlong jContext, jboolean enabled)
+{
+  JniContext *const context = reinterpret_cast<JniContext *>(jContext);
+  context->film_grain = enabled;
+}
+
+DECODER_FUNC(void, gav1SetFrameCacheSize, jlong jContext, jlong maxBytes,
+             jint downscaleFactor)
+{
+  JniContext *const context = reinterpret_cast<JniContext *>(jContext);
+  context->frame_cache.Configure(
+      static_cast<size_t>(std::max<jlong>(maxBytes, 0)), downscaleFactor);
+}
+
+DECODER_FUNC(jboolean, gav1ReadCachedFrame, jlong jContext, jlong timeUs,
+             jlong toleranceUs, jobject jOutputBuffer)
+{
+  JniContext *const context = reinterpret_cast<JniContext *>(jContext);
+  return context->frame_cache.Read(
+      timeUs, std::max<jlong>(toleranceUs, 0),
+      [=](const exoplayer_jni::CachedFrameInfo &info) -> uint8_t *
+      {
+        const jboolean init_result = env->CallBooleanMethod(
+            jOutputBuffer, context->init_for_yuv_frame_method, info.width,
+            info.height, info.width, (info.width + 1) / 2, info.colorspace);
+        if (env->ExceptionCheck() || !init_result)
+        {
+          // Any exception is thrown in Java when returning from the native
+          // call.
+          return nullptr;
+        }
+        env->SetLongField(jOutputBuffer, context->time_us_field, info.time_us);
+        const jobject data_object =
+            env->GetObjectField(jOutputBuffer, context->data_field);
+        return static_cast<uint8_t *>(env->GetDirectBufferAddress(data_object));
+      });
+}
+
+DECODER_FUNC(jlong, gav1GetFrameCacheHitCount, jlong jContext)
+{
+  JniContext *const context = reinterpret_cast<JniContext *>(jContext);
+  return context->frame_cache.hit_count();
+}
+
+DECODER_FUNC(jlong, gav1GetFrameCacheMissCount, jlong jContext)
+{
+  JniContext *const context = reinterpret_cast<JniContext *>(jContext);
+  return context->frame_cache.miss_count();
+}
+
 DECODER_FUNC(void, gav1ReleaseFrame, jlong jContext, jobject jOutputBuffer)
 {
   JniContext *const context = reinterpret_cast<JniContext *>(jContext);
@@ -733,4 +1973,33 @@ DECODER_FUNC(jint, gav1CheckError, jlong jContext)
 DECODER_FUNC(jint, gav1GetThreads)
 {
   return 0;
+}
+
+DECODER_FUNC(void, gav1SetFrameArenaCapacity, jlong capacityBytes)
+{
+  exoplayer_jni::FrameArena::GetInstance().SetCapacity(
+      static_cast<size_t>(std::max<jlong>(capacityBytes, 0)));
+}
+
+DECODER_FUNC(void, gav1SetLogLevel, jint level)
+{
+  exoplayer_jni::SetLogLevel(level);
+}
+
+DECODER_FUNC(void, gav1SetLogRingEnabled, jboolean enabled)
+{
+  exoplayer_jni::SetLogRingEnabled(enabled);
+}
+
+DECODER_FUNC(jstring, gav1DumpLogRing)
+{
+  char *log = new (std::nothrow) char[exoplayer_jni::kLogRingDumpSize];
+  if (log == nullptr)
+  {
+    return nullptr;
+  }
+  exoplayer_jni::DumpLogRing(log, exoplayer_jni::kLogRingDumpSize);
+  jstring result = env->NewStringUTF(log);
+  delete[] log;
+  return result;
 }
\ No newline at end of file
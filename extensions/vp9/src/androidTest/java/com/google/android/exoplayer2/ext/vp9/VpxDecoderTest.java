@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.vp9;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import androidx.annotation.Nullable;
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.VideoDecoderOutputBuffer;
+import com.google.android.exoplayer2.extractor.mkv.MatroskaExtractor;
+import com.google.android.exoplayer2.testutil.FakeExtractorOutput;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.util.Util;
+import java.nio.ByteBuffer;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Tests for {@link VpxDecoder}. */
+@RunWith(AndroidJUnit4.class)
+public final class VpxDecoderTest {
+
+  private static final String BEAR_FILE = "media/vp9/bear-vp9.webm";
+  private static final int TIMEOUT_MS = 10_000;
+
+  private FakeTrackOutput trackOutput;
+
+  @Before
+  public void setUp() throws Exception {
+    if (!VpxLibrary.isAvailable()) {
+      fail("Vpx library not available.");
+    }
+    FakeExtractorOutput extractorOutput =
+        TestUtil.extractAllSamplesFromFile(
+            new MatroskaExtractor(), ApplicationProvider.getApplicationContext(), BEAR_FILE);
+    trackOutput = extractorOutput.trackOutputs.valueAt(0);
+  }
+
+  @Test
+  public void release_whileZeroCopyYuvBufferHeld_keepsBufferValid() throws Exception {
+    VpxDecoder decoder = createDecoder();
+    decoder.setZeroCopyYuvOutputEnabled(true);
+    VideoDecoderOutputBuffer heldBuffer;
+    try {
+      heldBuffer = decodeUntilOutput(decoder);
+    } finally {
+      decoder.release();
+    }
+    // The buffer wraps the frame buffer of the released decoder.
+    assertThat(heldBuffer.data).isNull();
+    ByteBuffer yPlane = Util.castNonNull(Util.castNonNull(heldBuffer.yuvPlanes)[0]);
+    byte[] expectedY = new byte[yPlane.remaining()];
+    yPlane.duplicate().get(expectedY);
+
+    // Another decoder reuses the memory of released frame buffers, which would overwrite the held
+    // frame if the released decoder had freed it.
+    VpxDecoder otherDecoder = createDecoder();
+    try {
+      for (int i = 0; i < trackOutput.getSampleCount(); i++) {
+        queueSample(otherDecoder, i);
+        releaseOutputBuffers(otherDecoder);
+      }
+    } finally {
+      otherDecoder.release();
+    }
+
+    byte[] actualY = new byte[yPlane.remaining()];
+    yPlane.duplicate().get(actualY);
+    assertThat(actualY).isEqualTo(expectedY);
+    // Releases the frame into the buffer manager of the released decoder, which deletes it.
+    heldBuffer.release();
+  }
+
+  private static VpxDecoder createDecoder() throws VpxDecoderException {
+    VpxDecoder decoder =
+        new VpxDecoder(
+            /* numInputBuffers= */ 4,
+            /* numOutputBuffers= */ 4,
+            /* initialInputBufferSize= */ 0,
+            /* cryptoConfig= */ null,
+            /* threads= */ 1);
+    decoder.setOutputMode(C.VIDEO_OUTPUT_MODE_YUV);
+    return decoder;
+  }
+
+  /** Queues samples until an output buffer is available, and returns it without releasing it. */
+  private VideoDecoderOutputBuffer decodeUntilOutput(VpxDecoder decoder) throws Exception {
+    long deadlineMs = System.currentTimeMillis() + TIMEOUT_MS;
+    int sampleIndex = 0;
+    while (System.currentTimeMillis() < deadlineMs) {
+      @Nullable VideoDecoderOutputBuffer outputBuffer = decoder.dequeueOutputBuffer();
+      if (outputBuffer != null) {
+        if (!outputBuffer.isDecodeOnly()) {
+          return outputBuffer;
+        }
+        outputBuffer.release();
+      } else if (sampleIndex < trackOutput.getSampleCount()) {
+        queueSample(decoder, sampleIndex++);
+      } else {
+        Thread.sleep(10);
+      }
+    }
+    throw new AssertionError("Timed out waiting for an output buffer.");
+  }
+
+  private void queueSample(VpxDecoder decoder, int sampleIndex) throws Exception {
+    long deadlineMs = System.currentTimeMillis() + TIMEOUT_MS;
+    @Nullable DecoderInputBuffer inputBuffer;
+    while ((inputBuffer = decoder.dequeueInputBuffer()) == null) {
+      if (System.currentTimeMillis() >= deadlineMs) {
+        throw new AssertionError("Timed out waiting for an input buffer.");
+      }
+      releaseOutputBuffers(decoder);
+      Thread.sleep(10);
+    }
+    byte[] sample = trackOutput.getSampleData(sampleIndex);
+    inputBuffer.ensureSpaceForWrite(sample.length);
+    Util.castNonNull(inputBuffer.data).put(sample);
+    inputBuffer.flip();
+    inputBuffer.timeUs = trackOutput.getSampleTimeUs(sampleIndex);
+    decoder.queueInputBuffer(inputBuffer);
+  }
+
+  private static void releaseOutputBuffers(VpxDecoder decoder) throws Exception {
+    @Nullable VideoDecoderOutputBuffer outputBuffer;
+    while ((outputBuffer = decoder.dequeueOutputBuffer()) != null) {
+      outputBuffer.release();
+    }
+  }
+}
@@ -17,6 +17,7 @@ package com.google.android.exoplayer2.ext.vp9;
 
 import static androidx.annotation.VisibleForTesting.PACKAGE_PRIVATE;
 
+import android.util.Log;
 import android.view.Surface;
 import androidx.annotation.Nullable;
 import androidx.annotation.VisibleForTesting;
@@ -24,9 +25,12 @@ import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.decoder.CryptoConfig;
 import com.google.android.exoplayer2.decoder.CryptoException;
 import com.google.android.exoplayer2.decoder.CryptoInfo;
+import com.google.android.exoplayer2.decoder.DecodedFrameRateTracker;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.DecoderThreadBudget;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
 import com.google.android.exoplayer2.decoder.VideoDecoderOutputBuffer;
+import com.google.android.exoplayer2.decoder.VideoDecoderPreroll;
 import com.google.android.exoplayer2.util.Assertions;
 import com.google.android.exoplayer2.util.Util;
 import java.nio.ByteBuffer;
@@ -41,13 +45,26 @@ public final class VpxDecoder
   private static final int NO_ERROR = 0;
   private static final int DECODE_ERROR = -1;
   private static final int DRM_ERROR = -2;
+  private static final int DECODE_SKIPPED = 1;
+
+  /** Value of {@link VideoDecoderOutputBuffer#decoderPrivate} when it holds no native frame. */
+  private static final int NO_NATIVE_FRAME = -1;
 
   @Nullable private final CryptoConfig cryptoConfig;
   private final long vpxDecContext;
+  // Releases the native frames of output buffers, including after the decoder is released.
+  private final long vpxBufferManager;
+  private final DecoderThreadBudget.Registration threadBudgetRegistration;
+  private final VideoDecoderPreroll preroll;
+  private final DecodedFrameRateTracker trickPlayFrameRate;
 
   @Nullable private ByteBuffer lastSupplementalData;
+  private int decoderThreads;
+  private boolean decoderTrickPlay;
 
   private volatile @C.VideoOutputMode int outputMode;
+  private volatile boolean asyncRenderEnabled;
+  private volatile boolean trickPlayEnabled;
 
   /**
    * Creates a VP9 decoder.
@@ -57,7 +74,8 @@ public final class VpxDecoder
    * @param initialInputBufferSize The initial size of each input buffer.
    * @param cryptoConfig The {@link CryptoConfig} object required for decoding encrypted content.
    *     May be null and can be ignored if decoder does not handle encrypted content.
-   * @param threads Number of threads libvpx will use to decode.
+   * @param threads Maximum number of threads libvpx will use to decode. The decoder may use fewer
+   *     threads when other decoders share the {@link DecoderThreadBudget}.
    * @throws VpxDecoderException Thrown if an exception occurs when initializing the decoder.
    */
   public VpxDecoder(
@@ -68,6 +86,8 @@ public final class VpxDecoder
       int threads)
       throws VpxDecoderException {
     super(new DecoderInputBuffer[numInputBuffers], new VideoDecoderOutputBuffer[numOutputBuffers]);
+    preroll = new VideoDecoderPreroll();
+    trickPlayFrameRate = new DecodedFrameRateTracker();
     if (!VpxLibrary.isAvailable()) {
       throw new VpxDecoderException("Failed to load decoder native libraries.");
     }
@@ -75,14 +95,115 @@ public final class VpxDecoder
     if (cryptoConfig != null && !VpxLibrary.vpxIsSecureDecodeSupported()) {
       throw new VpxDecoderException("Vpx decoder does not support secure decode.");
     }
+    threadBudgetRegistration =
+        DecoderThreadBudget.getInstance()
+            .register(DecoderThreadBudget.PRIORITY_FOREGROUND, Math.max(1, threads));
+    decoderThreads = threadBudgetRegistration.getThreadCount();
     vpxDecContext =
-        vpxInit(/* disableLoopFilter= */ false, /* enableRowMultiThreadMode= */ false, threads);
+        vpxInit(
+            /* disableLoopFilter= */ false, /* enableRowMultiThreadMode= */ false, decoderThreads);
     if (vpxDecContext == 0) {
+      threadBudgetRegistration.unregister();
       throw new VpxDecoderException("Failed to initialize decoder");
     }
+    vpxBufferManager = vpxGetBufferManager(vpxDecContext);
     setInitialInputBufferSize(initialInputBufferSize);
   }
 
+  /**
+   * Initializes native decoders ahead of time and keeps them idle, so that decoders created later,
+   * for example when switching channels or tracks, start without waiting for libvpx to initialize.
+   * Closed decoders are also kept idle for reuse. At most two idle decoders are kept.
+   *
+   * <p>Idle decoders are kept with a single thread, so that they hold no threads outside the
+   * {@link DecoderThreadBudget}. A decoder that reuses one starts the threads it is given.
+   *
+   * @param count Number of decoders to initialize.
+   */
+  public static void prewarm(int count) {
+    if (VpxLibrary.isAvailable()) {
+      vpxPrewarm(count);
+    }
+  }
+
+  /**
+   * Sets how many bytes of frame buffer memory released by closed decoders are kept for new
+   * decoders to reuse. A decoder created after another one is closed, for example when a track or
+   * resolution change re-creates the decoder, then reuses memory that is already mapped instead of
+   * allocating it again. The least recently released memory is freed first. The default is 64 MiB.
+   * Setting 0 frees the kept memory, for example when the app is asked to trim its memory.
+   *
+   * @param capacityBytes The maximum number of bytes kept.
+   */
+  public static void setFrameArenaCapacity(long capacityBytes) {
+    if (VpxLibrary.isAvailable()) {
+      vpxSetFrameArenaCapacity(capacityBytes);
+    }
+  }
+
+  /**
+   * Sets the minimum priority of the messages logged by the native decoder. Messages below it cost
+   * next to nothing. The default is {@link Log#WARN}. Debug and verbose messages are compiled out
+   * of release builds of the native library.
+   *
+   * @param priority One of the {@link Log} priorities, such as {@link Log#VERBOSE}.
+   */
+  public static void setNativeLogLevel(int priority) {
+    if (VpxLibrary.isAvailable()) {
+      vpxSetLogLevel(priority);
+    }
+  }
+
+  /**
+   * Sets whether the native decoder writes its messages to an in-memory ring of recent messages
+   * instead of logcat, so that verbose logging does not distort benchmarks. Errors are written to
+   * logcat in either case. The ring is read with {@link #getNativeLogRing()}.
+   */
+  public static void setNativeLogRingEnabled(boolean enabled) {
+    if (VpxLibrary.isAvailable()) {
+      vpxSetLogRingEnabled(enabled);
+    }
+  }
+
+  /**
+   * Returns the messages held in the in-memory ring of the native decoder, oldest first and one per
+   * line, or an empty string if the native library is not available.
+   */
+  public static String getNativeLogRing() {
+    if (!VpxLibrary.isAvailable()) {
+      return "";
+    }
+    @Nullable String log = vpxDumpLogRing();
+    return log != null ? log : "";
+  }
+
+  /**
+   * Sets whether only key frames and other intra coded frames are decoded, for fast forward and
+   * rewind at high speeds. Other input buffers are skipped without being decoded, and output as
+   * decode-only buffers. Takes effect from the next input buffer.
+   *
+   * <p>Frames that follow a skipped frame may reference it, so after trick play is disabled, input
+   * buffers keep being skipped until the next key frame.
+   *
+   * @param enabled Whether trick play is enabled.
+   */
+  public void setTrickPlayEnabled(boolean enabled) {
+    trickPlayEnabled = enabled;
+    if (enabled) {
+      trickPlayFrameRate.start();
+    } else {
+      trickPlayFrameRate.stop();
+    }
+  }
+
+  /**
+   * Returns the number of frames per second output since trick play was enabled, or 0 if it is not
+   * enabled.
+   */
+  public float getTrickPlayFrameRate() {
+    return trickPlayFrameRate.getFrameRate();
+  }
+
   @Override
   public String getName() {
     return "libvpx" + VpxLibrary.getVersion();
@@ -100,10 +221,13 @@ public final class VpxDecoder
 
   @Override
   protected void releaseOutputBuffer(VideoDecoderOutputBuffer buffer) {
+    preroll.onFrameReleased(buffer);
     // Decode only frames do not acquire a reference on the internal decoder buffer and thus do not
-    // require a call to vpxReleaseFrame.
-    if (outputMode == C.VIDEO_OUTPUT_MODE_SURFACE_YUV && !buffer.isDecodeOnly()) {
-      vpxReleaseFrame(vpxDecContext, buffer);
+    // require a call to vpxReleaseFrame. Nor do frames copied out in YUV mode, but frames exposed
+    // without copying do. They may be released after the decoder, whose buffer manager outlives it
+    // until then.
+    if (!buffer.isDecodeOnly() && buffer.decoderPrivate != NO_NATIVE_FRAME) {
+      vpxReleaseFrame(vpxBufferManager, buffer);
     }
     super.releaseOutputBuffer(buffer);
   }
@@ -117,11 +241,27 @@ public final class VpxDecoder
   @Nullable
   protected VpxDecoderException decode(
       DecoderInputBuffer inputBuffer, VideoDecoderOutputBuffer outputBuffer, boolean reset) {
+    preroll.onDecodeStarting();
     if (reset && lastSupplementalData != null) {
       // Don't propagate supplemental data across calls to flush the decoder.
       lastSupplementalData.clear();
     }
+    if (reset) {
+      // Apply the decoder's current share of the thread budget, which may have changed as other
+      // decoders came and went.
+      int threads = threadBudgetRegistration.getThreadCount();
+      // If the decoder can't be reinitialized, it keeps decoding with its current thread count and
+      // the change is retried at the next reset.
+      if (threads != decoderThreads && vpxSetThreads(vpxDecContext, threads) == NO_ERROR) {
+        decoderThreads = threads;
+      }
+    }
 
+    boolean trickPlay = trickPlayEnabled;
+    if (trickPlay != decoderTrickPlay) {
+      vpxSetTrickPlayEnabled(vpxDecContext, trickPlay);
+      decoderTrickPlay = trickPlay;
+    }
     ByteBuffer inputData = Util.castNonNull(inputBuffer.data);
     int inputSize = inputData.limit();
     CryptoInfo cryptoInfo = inputBuffer.cryptoInfo;
@@ -139,6 +279,11 @@ public final class VpxDecoder
                 cryptoInfo.numBytesOfClearData,
                 cryptoInfo.numBytesOfEncryptedData)
             : vpxDecode(vpxDecContext, inputData, inputSize);
+    if (result == DECODE_SKIPPED) {
+      // The input buffer was skipped for trick play, so there is no frame to get.
+      outputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
+      return null;
+    }
     if (result != NO_ERROR) {
       if (result == DRM_ERROR) {
         String message = "Drm error: " + vpxGetErrorMessage(vpxDecContext);
@@ -165,6 +310,7 @@ public final class VpxDecoder
 
     if (!inputBuffer.isDecodeOnly()) {
       outputBuffer.init(inputBuffer.timeUs, outputMode, lastSupplementalData);
+      outputBuffer.decoderPrivate = NO_NATIVE_FRAME;
       int getFrameResult = vpxGetFrame(vpxDecContext, outputBuffer);
       if (getFrameResult == 1) {
         outputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
@@ -172,15 +318,49 @@ public final class VpxDecoder
         return new VpxDecoderException("Buffer initialization failed.");
       }
       outputBuffer.format = inputBuffer.format;
+      if (trickPlay && !outputBuffer.isDecodeOnly()) {
+        trickPlayFrameRate.onFrameDecoded();
+      }
     }
+    preroll.onFrameDecoded(outputBuffer);
     return null;
   }
 
   @Override
   public void release() {
+    preroll.release();
     super.release();
     lastSupplementalData = null;
     vpxClose(vpxDecContext);
+    threadBudgetRegistration.unregister();
+  }
+
+  /**
+   * Starts prerolling an upcoming playlist item, decoding its first frames before it becomes
+   * current. Until {@link #endPreroll()} is called, the decode thread runs at background priority
+   * and waits once the frames it decoded and that are still queued or held hold {@code maxBytes}.
+   * The frames are handed out as soon as they are dequeued.
+   *
+   * @param maxBytes The maximum number of bytes of decoded frames to hold while prerolling.
+   */
+  public void startPreroll(long maxBytes) {
+    preroll.start(maxBytes);
+  }
+
+  /** Ends the preroll started by {@link #startPreroll(long)}, once the item becomes current. */
+  public void endPreroll() {
+    preroll.end();
+  }
+
+  /**
+   * Sets the priority of this decoder when the {@link DecoderThreadBudget} is divided between the
+   * live decoders. Decoders start with {@link DecoderThreadBudget#PRIORITY_FOREGROUND}. A change in
+   * the number of threads the decoder uses takes effect when it is next flushed.
+   *
+   * @param priority The {@link DecoderThreadBudget.Priority}.
+   */
+  public void setThreadPriority(@DecoderThreadBudget.Priority int priority) {
+    threadBudgetRegistration.setPriority(priority);
   }
 
   /**
@@ -192,10 +372,172 @@ public final class VpxDecoder
     this.outputMode = outputMode;
   }
 
+  /**
+   * Sets the row alignment of the planes written in {@link C#VIDEO_OUTPUT_MODE_YUV} mode. Takes
+   * effect from the next output frame.
+   *
+   * <p>By default the planes are copied with libvpx's strides, which include its border and
+   * alignment padding, and high bit depth frames keep their 16-bit stride after conversion to 8
+   * bits. If {@code alignment} is positive, the stride of each plane is instead its displayed width
+   * rounded up to a multiple of {@code alignment}. The strides used are reported through {@link
+   * VideoDecoderOutputBuffer#yuvStrides}.
+   *
+   * @param alignment The row alignment in bytes, for example 1 for tightly packed rows or 16, or 0
+   *     to use the decoder's strides.
+   */
+  public void setYuvOutputStrideAlignment(int alignment) {
+    vpxSetYuvOutputStrideAlignment(vpxDecContext, alignment);
+  }
+
+  /**
+   * Sets whether frames output in {@link C#VIDEO_OUTPUT_MODE_YUV} mode expose the decoder's frame
+   * buffers instead of copying them into {@link VideoDecoderOutputBuffer#data}. Takes effect from
+   * the next output frame.
+   *
+   * <p>When enabled, 8-bit frames are output with {@link VideoDecoderOutputBuffer#data} set to null
+   * and {@link VideoDecoderOutputBuffer#yuvPlanes} viewing the decoder's memory, which avoids a
+   * full frame copy. The planes keep libvpx's strides regardless of {@link
+   * #setYuvOutputStrideAlignment(int)}, and are only valid until the output buffer is released.
+   * High bit depth frames are converted and copied as before.
+   *
+   * @param enabled Whether zero-copy YUV output is enabled.
+   */
+  public void setZeroCopyYuvOutputEnabled(boolean enabled) {
+    vpxSetZeroCopyYuvOutputEnabled(vpxDecContext, enabled);
+  }
+
+  /**
+   * Sets the factor by which 8-bit frames are downscaled while being copied out, in {@link
+   * C#VIDEO_OUTPUT_MODE_YUV} and {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} modes. Takes effect from
+   * the next output frame.
+   *
+   * <p>Each output sample is the average of a {@code factor} x {@code factor} block of decoded
+   * samples, and the output width and height are the decoded ones divided by {@code factor},
+   * rounded up. This reduces the memory traffic and the size of the output buffers when the frames
+   * are shown in a view much smaller than the video, for example a thumbnail. Downscaled frames are
+   * never output through {@link #setZeroCopyYuvOutputEnabled(boolean) zero-copy} buffers.
+   *
+   * @param factor 1 (the default) to output frames at their decoded size, 2 or 4.
+   * @throws IllegalArgumentException If the factor is not supported.
+   */
+  public void setOutputDownscaleFactor(int factor) {
+    if (factor != 1 && factor != 2 && factor != 4) {
+      throw new IllegalArgumentException("Unsupported downscale factor: " + factor);
+    }
+    vpxSetDownscaleFactor(vpxDecContext, factor);
+  }
+
+  /**
+   * Sets whether frames are presented on a native render thread in {@link
+   * C#VIDEO_OUTPUT_MODE_SURFACE_YUV} mode.
+   *
+   * <p>When enabled, {@link #renderToSurface} queues the frame and returns without waiting for a
+   * window buffer, so a busy compositor does not block the caller. The render thread waits until
+   * the release time of each queued frame before presenting it, as ANativeWindow has no public API
+   * to pass a presentation time to the compositor. A frame is dropped if a later frame is already
+   * due when the render thread gets to it, or if too many frames are queued. Disabling stops the
+   * render thread and drops the frames that have not been presented yet.
+   *
+   * @param enabled Whether asynchronous rendering is enabled.
+   */
+  public void setAsyncRenderEnabled(boolean enabled) {
+    asyncRenderEnabled = enabled;
+    vpxSetAsyncRenderEnabled(vpxDecContext, enabled);
+  }
+
+  /**
+   * Returns the number of frames presented by the render thread since asynchronous rendering was
+   * last enabled.
+   */
+  public long getAsyncRenderedFrameCount() {
+    return vpxGetRenderedFrameCount(vpxDecContext);
+  }
+
+  /**
+   * Returns the number of frames dropped by the render thread since asynchronous rendering was last
+   * enabled, including frames that failed to be presented.
+   */
+  public long getAsyncDroppedFrameCount() {
+    return vpxGetDroppedFrameCount(vpxDecContext);
+  }
+
+  /**
+   * Sets the size of a native cache of copies of the recently output frames, keyed by presentation
+   * time. Frames read from it with {@link #readCachedFrame} serve short backward seeks and seek
+   * previews without decoding. Only 8-bit 4:2:0 frames are cached. When the cache is full, the
+   * least recently output or read frames are evicted.
+   *
+   * <p>While the cache is enabled, every output frame is copied into it, which costs about one more
+   * pass over each frame, or a quarter or a sixteenth of one when downscaling by 2 or 4.
+   *
+   * <p>Cached frames survive flushes, so the cache should be disabled, which drops its frames,
+   * before the decoder is fed a stream whose timestamps may collide with the cached ones.
+   *
+   * @param maxBytes The maximum number of bytes of frames held, or 0 (the default) to disable the
+   *     cache.
+   * @param downscaleFactor The factor by which frames are downscaled as they are cached, as for
+   *     {@link #setOutputDownscaleFactor(int)}. Changing it drops the cached frames.
+   * @throws IllegalArgumentException If the downscale factor is not supported.
+   */
+  public void setFrameCacheSize(long maxBytes, int downscaleFactor) {
+    if (downscaleFactor != 1 && downscaleFactor != 2 && downscaleFactor != 4) {
+      throw new IllegalArgumentException("Unsupported downscale factor: " + downscaleFactor);
+    }
+    vpxSetFrameCacheSize(vpxDecContext, maxBytes, downscaleFactor);
+  }
+
+  /**
+   * Reads the latest cached frame whose presentation time is at most {@code timeUs} and at least
+   * {@code timeUs - toleranceUs} into a {@link C#VIDEO_OUTPUT_MODE_YUV} output buffer. Can be
+   * called on any thread.
+   *
+   * @param timeUs The presentation time of the frame, in microseconds.
+   * @param toleranceUs How much earlier than {@code timeUs} the frame may be, in microseconds. 0
+   *     for a frame-accurate lookup, larger for a seek preview.
+   * @param outputBuffer A buffer that was not dequeued from this decoder, which receives the frame
+   *     and its presentation time.
+   * @return Whether a frame was read.
+   */
+  public boolean readCachedFrame(
+      long timeUs, long toleranceUs, VideoDecoderOutputBuffer outputBuffer) {
+    outputBuffer.init(timeUs, C.VIDEO_OUTPUT_MODE_YUV, /* supplementalData= */ null);
+    return vpxReadCachedFrame(vpxDecContext, timeUs, toleranceUs, outputBuffer);
+  }
+
+  /** Returns the number of {@link #readCachedFrame} calls that found a frame. */
+  public long getFrameCacheHitCount() {
+    return vpxGetFrameCacheHitCount(vpxDecContext);
+  }
+
+  /** Returns the number of {@link #readCachedFrame} calls that found no frame. */
+  public long getFrameCacheMissCount() {
+    return vpxGetFrameCacheMissCount(vpxDecContext);
+  }
+
   /** Renders the outputBuffer to the surface. Used with OUTPUT_MODE_SURFACE_YUV only. */
   public void renderToSurface(VideoDecoderOutputBuffer outputBuffer, Surface surface)
       throws VpxDecoderException {
-    int getFrameResult = vpxRenderFrame(vpxDecContext, surface, outputBuffer);
+    renderToSurface(outputBuffer, surface, System.nanoTime());
+  }
+
+  /**
+   * Renders the outputBuffer to the surface. Used with OUTPUT_MODE_SURFACE_YUV only.
+   *
+   * @param outputBuffer Output buffer.
+   * @param surface Output surface.
+   * @param releaseTimeNs The time at which the frame should be displayed, in the {@link
+   *     System#nanoTime()} time base. When asynchronous rendering is enabled, the frame is
+   *     presented at this time. Otherwise it is presented immediately.
+   * @throws VpxDecoderException Thrown if frame rendering fails. When asynchronous rendering is
+   *     enabled, also thrown if an earlier frame failed to be presented.
+   */
+  public void renderToSurface(
+      VideoDecoderOutputBuffer outputBuffer, Surface surface, long releaseTimeNs)
+      throws VpxDecoderException {
+    int getFrameResult =
+        asyncRenderEnabled
+            ? vpxQueueFrame(vpxDecContext, surface, outputBuffer, releaseTimeNs)
+            : vpxRenderFrame(vpxDecContext, surface, outputBuffer);
     if (getFrameResult == -1) {
       throw new VpxDecoderException("Buffer render failed.");
     }
@@ -204,8 +546,16 @@ public final class VpxDecoder
   private native long vpxInit(
       boolean disableLoopFilter, boolean enableRowMultiThreadMode, int threads);
 
+  private static native void vpxPrewarm(int count);
+
+  private static native void vpxSetFrameArenaCapacity(long capacityBytes);
+
   private native long vpxClose(long context);
 
+  private native int vpxSetThreads(long context, int threads);
+
+  private native void vpxSetTrickPlayEnabled(long context, boolean enabled);
+
   private native long vpxDecode(long context, ByteBuffer encoded, int length);
 
   private native long vpxSecureDecode(
@@ -230,12 +580,54 @@ public final class VpxDecoder
       long context, Surface surface, VideoDecoderOutputBuffer outputBuffer);
 
   /**
-   * Releases the frame. Used with OUTPUT_MODE_SURFACE_YUV only. Must only be called if {@link
-   * #vpxInit} was called with {@code enableBufferManager = true}.
+   * Queues the frame for presentation on the surface by the render thread. Used with
+   * OUTPUT_MODE_SURFACE_YUV only, when asynchronous rendering is enabled.
+   */
+  private native int vpxQueueFrame(
+      long context, Surface surface, VideoDecoderOutputBuffer outputBuffer, long releaseTimeNs);
+
+  private native void vpxSetDownscaleFactor(long context, int factor);
+
+  private native void vpxSetAsyncRenderEnabled(long context, boolean enabled);
+
+  private native long vpxGetRenderedFrameCount(long context);
+
+  private native long vpxGetDroppedFrameCount(long context);
+
+  /**
+   * Returns the buffer manager of the decoder, which holds the frames of output buffers. It stays
+   * valid after {@link #vpxClose(long)} until all of them are released.
    */
-  private native int vpxReleaseFrame(long context, VideoDecoderOutputBuffer outputBuffer);
+  private native long vpxGetBufferManager(long context);
+
+  /**
+   * Releases the frame. Used with OUTPUT_MODE_SURFACE_YUV and zero-copy OUTPUT_MODE_YUV only. May
+   * be called after {@link #vpxClose(long)}, and deletes the buffer manager if it was closed and
+   * this was its last frame held by an output buffer.
+   */
+  private native int vpxReleaseFrame(long bufferManager, VideoDecoderOutputBuffer outputBuffer);
+
+  private native void vpxSetYuvOutputStrideAlignment(long context, int alignment);
+
+  private native void vpxSetZeroCopyYuvOutputEnabled(long context, boolean enabled);
+
+  private native void vpxSetFrameCacheSize(long context, long maxBytes, int downscaleFactor);
+
+  private native boolean vpxReadCachedFrame(
+      long context, long timeUs, long toleranceUs, VideoDecoderOutputBuffer outputBuffer);
+
+  private native long vpxGetFrameCacheHitCount(long context);
+
+  private native long vpxGetFrameCacheMissCount(long context);
 
   private native int vpxGetErrorCode(long context);
 
   private native String vpxGetErrorMessage(long context);
+
+  private static native void vpxSetLogLevel(int priority);
+
+  private static native void vpxSetLogRingEnabled(boolean enabled);
+
+  @Nullable
+  private static native String vpxDumpLogRing();
 }
@@ -28,7 +28,15 @@ LOCAL_PATH := $(WORKING_DIR)
 LOCAL_MODULE := libvpxV2JNI
 LOCAL_ARM_MODE := arm
 LOCAL_CPP_EXTENSION := .cc
-LOCAL_SRC_FILES := vpx_jni.cc
+LOCAL_SRC_FILES := vpx_jni.cc vp9_packet.cc \
+                   ../../../../common_jni/cpu_info.cc \
+                   ../../../../common_jni/frame_arena.cc \
+                   ../../../../common_jni/frame_cache.cc \
+                   ../../../../common_jni/jni_log.cc \
+                   ../../../../common_jni/row_convert.cc \
+                   ../../../../common_jni/worker_pool.cc \
+                   ../../../../common_jni/yuv_to_rgba.cc
+LOCAL_C_INCLUDES := $(WORKING_DIR)/../../../../common_jni
 LOCAL_LDLIBS := -llog -lz -lm -landroid
 LOCAL_SHARED_LIBRARIES := libvpx
 LOCAL_STATIC_LIBRARIES := cpufeatures
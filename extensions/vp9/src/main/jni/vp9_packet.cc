@@ -0,0 +1,100 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vp9_packet.h"  // NOLINT
+
+namespace vpx_jni {
+
+bool parse_vp9_frame_type(const uint8_t* data, const size_t size,
+                          bool* key_frame, bool* intra_only) {
+  if (size < 2) {
+    return false;
+  }
+  // The fields read below take at most 11 bits.
+  const uint32_t bits = (data[0] << 8) | data[1];
+  int position = 16;
+  const auto read_bit = [&]() { return (bits >> --position) & 1; };
+  if (read_bit() != 1 || read_bit() != 0) {  // frame_marker
+    return false;
+  }
+  const uint32_t profile_low_bit = read_bit();
+  const uint32_t profile = (read_bit() << 1) | profile_low_bit;
+  if (profile == 3) {
+    read_bit();  // reserved_zero
+  }
+  if (read_bit()) {  // show_existing_frame
+    *key_frame = false;
+    *intra_only = false;
+    return true;
+  }
+  const bool is_key_frame = read_bit() == 0;  // frame_type
+  const bool show_frame = read_bit();
+  read_bit();  // error_resilient_mode
+  *key_frame = is_key_frame;
+  *intra_only = is_key_frame || (!show_frame && read_bit());
+  return true;
+}
+
+bool classify_vp9_packet(const uint8_t* data, size_t size, bool* key_frame,
+                         bool* intra_only) {
+  size_t frame_sizes[8];
+  int frame_count = 0;
+  if (size > 0) {
+    const uint8_t marker = data[size - 1];
+    if ((marker & 0xE0) == 0xC0) {
+      const int frames = (marker & 0x7) + 1;
+      const int size_bytes = ((marker >> 3) & 0x3) + 1;
+      const size_t index_size = 2 + size_bytes * frames;
+      if (size >= index_size && data[size - index_size] == marker) {
+        const uint8_t* index = data + size - index_size + 1;
+        for (int i = 0; i < frames; i++) {
+          size_t frame_size = 0;
+          for (int j = 0; j < size_bytes; j++) {
+            frame_size |= static_cast<size_t>(*index++) << (j * 8);
+          }
+          frame_sizes[i] = frame_size;
+        }
+        frame_count = frames;
+        size -= index_size;
+      }
+    }
+  }
+  if (frame_count == 0) {
+    frame_sizes[0] = size;
+    frame_count = 1;
+  }
+  *key_frame = false;
+  *intra_only = true;
+  size_t offset = 0;
+  for (int i = 0; i < frame_count; i++) {
+    if (frame_sizes[i] > size - offset) {
+      return false;
+    }
+    bool frame_key_frame;
+    bool frame_intra_only;
+    if (frame_sizes[i] > 0) {
+      if (!parse_vp9_frame_type(data + offset, frame_sizes[i],
+                                &frame_key_frame, &frame_intra_only)) {
+        return false;
+      }
+      *key_frame |= frame_key_frame;
+      *intra_only &= frame_intra_only;
+    }
+    offset += frame_sizes[i];
+  }
+  return true;
+}
+
+}  // namespace vpx_jni
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EXOPLAYER_V2_EXTENSIONS_VP9_SRC_MAIN_JNI_VP9_PACKET_H_
+#define EXOPLAYER_V2_EXTENSIONS_VP9_SRC_MAIN_JNI_VP9_PACKET_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vpx_jni {
+
+// Reads the start of the uncompressed header of the VP9 frame of size bytes at
+// data, from section 6.2 of the VP9 specification. Returns false if it is
+// malformed.
+bool parse_vp9_frame_type(const uint8_t* data, size_t size, bool* key_frame,
+                          bool* intra_only);
+
+// Classifies the frames of the VP9 packet of size bytes at data, which may be
+// a superframe holding several frames (annex B of the VP9 specification).
+// key_frame is set if any frame is a key frame, and intra_only if every frame
+// is intra coded. Returns false if it is malformed.
+bool classify_vp9_packet(const uint8_t* data, size_t size, bool* key_frame,
+                         bool* intra_only);
+
+}  // namespace vpx_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_VP9_SRC_MAIN_JNI_VP9_PACKET_H_
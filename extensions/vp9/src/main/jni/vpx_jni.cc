@@ -18,6 +18,9 @@
 #ifdef __ARM_NEON__
 #include <arm_neon.h>
 #endif
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
 #include <android/log.h>
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
@@ -25,18 +28,27 @@
 #include <pthread.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
 #include <new>
 
 #define VPX_CODEC_DISABLE_COMPAT 1
+#include "frame_arena.h"  // NOLINT
+#include "frame_cache.h"  // NOLINT
+#include "jni_log.h"      // NOLINT
+#include "row_convert.h"  // NOLINT
+#include "vp9_packet.h"   // NOLINT
 #include "vpx/vp8dx.h"
 #include "vpx/vpx_decoder.h"
+#include "worker_pool.h"  // NOLINT
+#include "yuv_to_rgba.h"  // NOLINT
 
 #define LOG_TAG "vpx_jni"
-#define LOGE(...) \
-  ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__))
 
 #define DECODER_FUNC(RETURN_TYPE, NAME, ...)                        \
   extern "C" {                                                      \
@@ -60,8 +72,11 @@
 
 // JNI references for VideoDecoderOutputBuffer class.
 static jmethodID initForYuvFrame;
+static jmethodID initForExternalYuvFrame;
 static jmethodID initForPrivateFrame;
+static jmethodID initForRgbaFrame;
 static jfieldID dataField;
+static jfieldID timeUsField;
 static jfieldID outputModeField;
 static jfieldID decoderPrivateField;
 
@@ -80,9 +95,34 @@ jint JNI_OnLoad(JavaVM* vm, void* reserved) {
   return JNI_VERSION_1_6;
 }
 
+// Planes with at least this many samples are copied, converted or downscaled
+// in parallel row bands on the worker pool. Smaller planes are processed on the
+// calling thread, where handing work to other threads costs more than it saves.
+static const int kMinParallelSamples = 2560 * 1440;
+// Number of rows in each band of parallel work.
+static const int kBandRows = 128;
+
+// Calls process_rows(firstRow, lastRow) for bands of rows covering
+// [0, height), in parallel on the worker pool if width x height is at least
+// kMinParallelSamples.
+static void for_each_row_band(
+    const int width, const int height,
+    const std::function<void(int, int)>& process_rows) {
+  if (width * height < kMinParallelSamples) {
+    process_rows(0, height);
+    return;
+  }
+  exoplayer_jni::WorkerPool::GetInstance().ParallelFor(
+      (height + kBandRows - 1) / kBandRows, [&](int band) {
+        const int firstRow = band * kBandRows;
+        process_rows(firstRow, std::min(firstRow + kBandRows, height));
+      });
+}
+
 #ifdef __ARM_NEON__
 static int convert_16_to_8_neon(const vpx_image_t* const img, jbyte* const data,
-                                const int32_t uvHeight, const int32_t yLength,
+                                const int32_t uvHeight, const int32_t yStride,
+                                const int32_t uvStride, const int32_t yLength,
                                 const int32_t uvLength) {
   if (!(android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON)) return 0;
   uint32x2_t lcg_val = vdup_n_u32(random());
@@ -96,7 +136,7 @@ static int convert_16_to_8_neon(const vpx_image_t* const img, jbyte* const data,
   uint8_t* dstBase = reinterpret_cast<uint8_t*>(data);
   // In units of uint16_t, so /2 from raw stride
   const int srcStride = img->stride[VPX_PLANE_Y] / 2;
-  const int dstStride = img->stride[VPX_PLANE_Y];
+  const int dstStride = yStride;
 
   for (int y = 0; y < img->d_h; y++) {
     const uint16_t* src = srcBase;
@@ -184,7 +224,7 @@ static int convert_16_to_8_neon(const vpx_image_t* const img, jbyte* const data,
   uint8_t* dstUBase = reinterpret_cast<uint8_t*>(data + yLength);
   uint8_t* dstVBase = reinterpret_cast<uint8_t*>(data + yLength + uvLength);
   const int srcUVStride = img->stride[VPX_PLANE_V] / 2;
-  const int dstUVStride = img->stride[VPX_PLANE_V];
+  const int dstUVStride = uvStride;
 
   for (int y = 0; y < uvHeight; y++) {
     const uint16_t* srcU = srcUBase;
@@ -246,49 +286,225 @@ static int convert_16_to_8_neon(const vpx_image_t* const img, jbyte* const data,
 
 #endif  // __ARM_NEON__
 
-static void convert_16_to_8_standard(const vpx_image_t* const img,
-                                     jbyte* const data, const int32_t uvHeight,
-                                     const int32_t yLength,
-                                     const int32_t uvLength) {
-  // Y
-  int sampleY = 0;
-  for (int y = 0; y < img->d_h; y++) {
-    const uint16_t* srcBase = reinterpret_cast<uint16_t*>(
-        img->planes[VPX_PLANE_Y] + img->stride[VPX_PLANE_Y] * y);
-    int8_t* destBase = data + img->stride[VPX_PLANE_Y] * y;
-    for (int x = 0; x < img->d_w; x++) {
-      // Lightweight dither. Carryover the remainder of each 10->8 bit
-      // conversion to the next pixel.
-      sampleY += *srcBase++;
-      *destBase++ = sampleY >> 2;
-      sampleY = sampleY & 3;  // Remainder.
-    }
+// Converts the high bit depth img to 8 bits into data, with the layout given by
+// the strides and plane lengths. Large frames are converted in parallel bands
+// of rows. The NEON converter dithers with pseudo-random values, so its bands
+// are passed to it as images of their own whose chroma rows start at half
+// their first luma row. The other converters carry a dither remainder from
+// sample to sample, which ConvertPlanesTo8Bit() carries across the bands.
+static void convert_16_to_8(const vpx_image_t* const img, jbyte* const data,
+                            const int32_t yStride, const int32_t uvStride,
+                            const int32_t yLength, const int32_t uvLength) {
+#if defined(__ARM_NEON__)
+  if (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) {
+    for_each_row_band(img->d_w, img->d_h, [&](int firstRow, int lastRow) {
+      // firstRow is even, as kBandRows is.
+      vpx_image_t band = *img;
+      band.d_h = lastRow - firstRow;
+      band.planes[VPX_PLANE_Y] += firstRow * img->stride[VPX_PLANE_Y];
+      band.planes[VPX_PLANE_U] += firstRow / 2 * img->stride[VPX_PLANE_U];
+      band.planes[VPX_PLANE_V] += firstRow / 2 * img->stride[VPX_PLANE_V];
+      const int32_t bandUvHeight = (lastRow + 1) / 2 - firstRow / 2;
+      const int32_t bandYLength =
+          yLength - firstRow * yStride + firstRow / 2 * uvStride;
+      convert_16_to_8_neon(&band, data + firstRow * yStride, bandUvHeight,
+                           yStride, uvStride, bandYLength, uvLength);
+    });
+    return;
   }
-  // UV
-  int sampleU = 0;
-  int sampleV = 0;
+#endif  // defined(__ARM_NEON__)
+  exoplayer_jni::RowTo8BitConverter convertRow =
+      exoplayer_jni::ConvertRowTo8Bit;
+#if defined(__i386__) || defined(__x86_64__)
+  convertRow = (android_getCpuFeatures() & ANDROID_CPU_X86_FEATURE_AVX2)
+                   ? exoplayer_jni::ConvertRowTo8BitAvx2
+                   : exoplayer_jni::ConvertRowTo8BitSse2;
+#endif  // defined(__i386__) || defined(__x86_64__)
+  uint8_t* const dst = reinterpret_cast<uint8_t*>(data);
   const int32_t uvWidth = (img->d_w + 1) / 2;
-  for (int y = 0; y < uvHeight; y++) {
-    const uint16_t* srcUBase = reinterpret_cast<uint16_t*>(
-        img->planes[VPX_PLANE_U] + img->stride[VPX_PLANE_U] * y);
-    const uint16_t* srcVBase = reinterpret_cast<uint16_t*>(
-        img->planes[VPX_PLANE_V] + img->stride[VPX_PLANE_V] * y);
-    int8_t* destUBase = data + yLength + img->stride[VPX_PLANE_U] * y;
-    int8_t* destVBase =
-        data + yLength + uvLength + img->stride[VPX_PLANE_V] * y;
-    for (int x = 0; x < uvWidth; x++) {
-      // Lightweight dither. Carryover the remainder of each 10->8 bit
-      // conversion to the next pixel.
-      sampleU += *srcUBase++;
-      *destUBase++ = sampleU >> 2;
-      sampleU = sampleU & 3;  // Remainder.
-      sampleV += *srcVBase++;
-      *destVBase++ = sampleV >> 2;
-      sampleV = sampleV & 3;  // Remainder.
+  const int32_t uvHeight = (img->d_h + 1) / 2;
+  const exoplayer_jni::PlaneTo8Bit planes[] = {
+      {img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y], dst, yStride,
+       static_cast<int>(img->d_w), static_cast<int>(img->d_h)},
+      {img->planes[VPX_PLANE_U], img->stride[VPX_PLANE_U], dst + yLength,
+       uvStride, uvWidth, uvHeight},
+      {img->planes[VPX_PLANE_V], img->stride[VPX_PLANE_V],
+       dst + yLength + uvLength, uvStride, uvWidth, uvHeight}};
+  exoplayer_jni::ConvertPlanesTo8Bit(
+      planes, 3, convertRow,
+      /*parallel=*/img->d_w * img->d_h >= kMinParallelSamples &&
+          exoplayer_jni::WorkerPool::GetInstance().HasThreads());
+}
+
+static inline int align_to(const int value, const int alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static void copy_plane(const uint8_t* src, const int srcStride, uint8_t* dst,
+                       const int dstStride, const int width, const int height) {
+  for_each_row_band(width, height, [&](int firstRow, int lastRow) {
+    for (int y = firstRow; y < lastRow; y++) {
+      memcpy(dst + y * dstStride, src + y * srcStride, width);
     }
+  });
+}
+
+static inline int downscaled_size(const int size, const int factor) {
+  return (size + factor - 1) / factor;
+}
+
+// Writes dst_width samples, each the rounded average of a factor x factor block
+// of samples from rows, which holds factor source rows of src_width samples.
+// factor is 2 or 4. Blocks that extend past the right edge repeat the last
+// column.
+static void downscale_row(const uint8_t* const* rows, const int factor,
+                          const int src_width, uint8_t* dst,
+                          const int dst_width) {
+  int x = 0;
+  if (factor == 2) {
+#ifdef __ARM_NEON__
+    for (; 2 * (x + 8) <= src_width; x += 8) {
+      const uint16x8_t sums = vaddq_u16(vpaddlq_u8(vld1q_u8(rows[0] + 2 * x)),
+                                        vpaddlq_u8(vld1q_u8(rows[1] + 2 * x)));
+      vst1_u8(dst + x, vrshrn_n_u16(sums, 2));
+    }
+#elif defined(__i386__) || defined(__x86_64__)
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    const __m128i rounding = _mm_set1_epi16(2);
+    for (; 2 * (x + 8) <= src_width; x += 8) {
+      __m128i sums = rounding;
+      for (int i = 0; i < 2; i++) {
+        const __m128i samples =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + 2 * x));
+        sums = _mm_add_epi16(sums, _mm_and_si128(samples, low_bytes));
+        sums = _mm_add_epi16(sums, _mm_srli_epi16(samples, 8));
+      }
+      _mm_storel_epi64(
+          reinterpret_cast<__m128i*>(dst + x),
+          _mm_packus_epi16(_mm_srli_epi16(sums, 2), _mm_setzero_si128()));
+    }
+#endif
+  } else if (factor == 4) {
+#ifdef __ARM_NEON__
+    for (; 4 * (x + 8) <= src_width; x += 8) {
+      uint16x8_t low_sums = vdupq_n_u16(0);
+      uint16x8_t high_sums = vdupq_n_u16(0);
+      for (int i = 0; i < 4; i++) {
+        low_sums = vpadalq_u8(low_sums, vld1q_u8(rows[i] + 4 * x));
+        high_sums = vpadalq_u8(high_sums, vld1q_u8(rows[i] + 4 * x + 16));
+      }
+      const uint16x8_t averages =
+          vcombine_u16(vrshrn_n_u32(vpaddlq_u16(low_sums), 4),
+                       vrshrn_n_u32(vpaddlq_u16(high_sums), 4));
+      vst1_u8(dst + x, vmovn_u16(averages));
+    }
+#elif defined(__i386__) || defined(__x86_64__)
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i rounding = _mm_set1_epi32(8);
+    for (; 4 * (x + 8) <= src_width; x += 8) {
+      __m128i low_sums = _mm_setzero_si128();
+      __m128i high_sums = _mm_setzero_si128();
+      for (int i = 0; i < 4; i++) {
+        const __m128i low_samples =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + 4 * x));
+        const __m128i high_samples = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(rows[i] + 4 * x + 16));
+        low_sums =
+            _mm_add_epi16(low_sums, _mm_and_si128(low_samples, low_bytes));
+        low_sums = _mm_add_epi16(low_sums, _mm_srli_epi16(low_samples, 8));
+        high_sums =
+            _mm_add_epi16(high_sums, _mm_and_si128(high_samples, low_bytes));
+        high_sums = _mm_add_epi16(high_sums, _mm_srli_epi16(high_samples, 8));
+      }
+      const __m128i low_averages = _mm_srli_epi32(
+          _mm_add_epi32(_mm_madd_epi16(low_sums, ones), rounding), 4);
+      const __m128i high_averages = _mm_srli_epi32(
+          _mm_add_epi32(_mm_madd_epi16(high_sums, ones), rounding), 4);
+      _mm_storel_epi64(
+          reinterpret_cast<__m128i*>(dst + x),
+          _mm_packus_epi16(_mm_packs_epi32(low_averages, high_averages),
+                           _mm_setzero_si128()));
+    }
+#endif
+  }
+  const int block_size = factor * factor;
+  for (; x < dst_width; x++) {
+    int sum = block_size / 2;
+    for (int i = 0; i < factor; i++) {
+      for (int j = 0; j < factor; j++) {
+        sum += rows[i][std::min(x * factor + j, src_width - 1)];
+      }
+    }
+    dst[x] = sum / block_size;
   }
 }
 
+// Writes rows [firstRow, lastRow) of the downscaled plane. See
+// downscale_plane.
+static void downscale_plane_rows(const uint8_t* src, const int srcStride,
+                                 uint8_t* dst, const int dstStride,
+                                 const int width, const int height,
+                                 const int factor, const int firstRow,
+                                 const int lastRow) {
+  const int dstWidth = downscaled_size(width, factor);
+  const uint8_t* rows[4];
+  for (int y = firstRow; y < lastRow; y++) {
+    for (int i = 0; i < factor; i++) {
+      const int srcRow = std::min(y * factor + i, height - 1);
+      rows[i] = src + srcRow * srcStride;
+    }
+    downscale_row(rows, factor, width, dst + y * dstStride, dstWidth);
+  }
+}
+
+// Downscales the width x height plane src by factor into dst. Blocks that
+// extend past the bottom edge repeat the last row.
+static void downscale_plane(const uint8_t* src, const int srcStride,
+                            uint8_t* dst, const int dstStride, const int width,
+                            const int height, const int factor) {
+  const int dstHeight = downscaled_size(height, factor);
+  // The bands hold whole blocks of source rows, as kBandRows is a multiple of
+  // factor.
+  for_each_row_band(width, height, [&](int firstRow, int lastRow) {
+    downscale_plane_rows(src, srcStride, dst, dstStride, width, height, factor,
+                         firstRow / factor,
+                         std::min(dstHeight, downscaled_size(lastRow, factor)));
+  });
+}
+
+// Converts an I420 or I42016 (10-bit) image to RGBA_8888 or RGBA_1010102
+// pixels respectively, dstStride bytes apart.
+static void convert_frame_to_rgba(const vpx_image_t* const img,
+                                  const int colorspace, uint8_t* dst,
+                                  const int dstStride) {
+  const bool highBitDepth = img->fmt & VPX_IMG_FMT_HIGHBITDEPTH;
+  const exoplayer_jni::YuvToRgbCoefficients coefficients =
+      exoplayer_jni::GetYuvToRgbCoefficients(
+          colorspace, img->range == VPX_CR_FULL_RANGE, highBitDepth ? 10 : 8);
+  for_each_row_band(img->d_w, img->d_h, [&](int firstRow, int lastRow) {
+    for (int row = firstRow; row < lastRow; row++) {
+      const uint8_t* y =
+          img->planes[VPX_PLANE_Y] + row * img->stride[VPX_PLANE_Y];
+      const uint8_t* u =
+          img->planes[VPX_PLANE_U] + (row / 2) * img->stride[VPX_PLANE_U];
+      const uint8_t* v =
+          img->planes[VPX_PLANE_V] + (row / 2) * img->stride[VPX_PLANE_V];
+      uint8_t* const dstRow = dst + row * dstStride;
+      if (highBitDepth) {
+        exoplayer_jni::ConvertRowToRgba1010102(
+            reinterpret_cast<const uint16_t*>(y),
+            reinterpret_cast<const uint16_t*>(u),
+            reinterpret_cast<const uint16_t*>(v), img->d_w, coefficients,
+            reinterpret_cast<uint32_t*>(dstRow));
+      } else {
+        exoplayer_jni::ConvertRowToRgba8888(y, u, v, img->d_w, coefficients,
+                                            dstRow);
+      }
+    }
+  });
+}
+
 struct JniFrameBuffer {
   friend class JniBufferManager;
 
@@ -301,8 +517,16 @@ struct JniFrameBuffer {
   int id;
   int ref_count;
   vpx_codec_frame_buffer_t vpx_fb;
+  // Direct ByteBuffer wrapping vpx_fb.data for zero-copy YUV output, and the
+  // allocation it was created for.
+  jobject direct_buffer;
+  uint8_t* direct_buffer_data;
+  size_t direct_buffer_size;
 };
 
+// Owned by its JniCtx until the context is destroyed, and then by the output
+// buffers still holding references on its frame buffers, whose data they may
+// wrap without copying. See detach().
 class JniBufferManager {
   static const int MAX_FRAMES = 32;
 
@@ -312,14 +536,37 @@ class JniBufferManager {
   JniFrameBuffer* free_buffers[MAX_FRAMES];
   int free_buffer_count = 0;
 
+  // Number of references held by output buffers, taken by add_output_ref.
+  int output_ref_count = 0;
+
+  // Whether the context has given up its reference. See detach().
+  bool detached = false;
+
   pthread_mutex_t mutex;
 
+  // Only deleted by detach() or release_output_ref().
+  ~JniBufferManager() {
+    while (all_buffer_count--) {
+      exoplayer_jni::FrameArena::GetInstance().Return(
+          all_buffers[all_buffer_count]->vpx_fb.data,
+          all_buffers[all_buffer_count]->vpx_fb.size);
+    }
+  }
+
  public:
   JniBufferManager() { pthread_mutex_init(&mutex, NULL); }
 
-  ~JniBufferManager() {
-    while (all_buffer_count--) {
-      free(all_buffers[all_buffer_count]->vpx_fb.data);
+  // Gives up the reference of the context, whose decoder and render worker
+  // must have released their references. Deletes the manager unless output
+  // buffers still hold references, in which case the release_output_ref call
+  // that releases the last one does.
+  void detach() {
+    pthread_mutex_lock(&mutex);
+    detached = true;
+    const bool in_use = output_ref_count > 0;
+    pthread_mutex_unlock(&mutex);
+    if (!in_use) {
+      delete this;
     }
   }
 
@@ -329,16 +576,18 @@ class JniBufferManager {
     if (free_buffer_count) {
       out_buffer = free_buffers[--free_buffer_count];
       if (out_buffer->vpx_fb.size < min_size) {
-        free(out_buffer->vpx_fb.data);
-        out_buffer->vpx_fb.data = (uint8_t*)malloc(min_size);
-        out_buffer->vpx_fb.size = min_size;
+        exoplayer_jni::FrameArena& arena =
+            exoplayer_jni::FrameArena::GetInstance();
+        arena.Return(out_buffer->vpx_fb.data, out_buffer->vpx_fb.size);
+        out_buffer->vpx_fb.data =
+            arena.Lease(min_size, &out_buffer->vpx_fb.size);
       }
     } else {
       out_buffer = new JniFrameBuffer();
       out_buffer->id = all_buffer_count;
       all_buffers[all_buffer_count++] = out_buffer;
-      out_buffer->vpx_fb.data = (uint8_t*)malloc(min_size);
-      out_buffer->vpx_fb.size = min_size;
+      out_buffer->vpx_fb.data = exoplayer_jni::FrameArena::GetInstance().Lease(
+          min_size, &out_buffer->vpx_fb.size);
       out_buffer->vpx_fb.priv = &out_buffer->id;
     }
     *fb = out_buffer->vpx_fb;
@@ -347,7 +596,8 @@ class JniBufferManager {
       LOGE("JniBufferManager get_buffer OOM.");
       retVal = -1;
     } else {
-      memset(fb->data, 0, fb->size);
+      // Leased memory may hold an earlier frame, and be larger than needed.
+      memset(fb->data, 0, min_size);
     }
     out_buffer->ref_count = 1;
     pthread_mutex_unlock(&mutex);
@@ -362,6 +612,49 @@ class JniBufferManager {
     return all_buffers[id];
   }
 
+  // Returns a direct ByteBuffer wrapping the data of the frame buffer, and its
+  // start address in |data|. The ByteBuffer is cached as a global reference
+  // and recreated if the data has been reallocated since. Must be called on a
+  // Java thread while the frame buffer is referenced.
+  jobject get_direct_buffer(JNIEnv* env, int id, const uint8_t** data) {
+    if (id < 0 || id >= all_buffer_count) {
+      LOGE("JniBufferManager get_direct_buffer invalid id %d.", id);
+      return NULL;
+    }
+    JniFrameBuffer* buffer = all_buffers[id];
+    if (buffer->direct_buffer &&
+        (buffer->direct_buffer_data != buffer->vpx_fb.data ||
+         buffer->direct_buffer_size != buffer->vpx_fb.size)) {
+      env->DeleteGlobalRef(buffer->direct_buffer);
+      buffer->direct_buffer = NULL;
+    }
+    if (!buffer->direct_buffer) {
+      jobject local_buffer =
+          env->NewDirectByteBuffer(buffer->vpx_fb.data, buffer->vpx_fb.size);
+      if (!local_buffer) {
+        return NULL;
+      }
+      buffer->direct_buffer = env->NewGlobalRef(local_buffer);
+      buffer->direct_buffer_data = buffer->vpx_fb.data;
+      buffer->direct_buffer_size = buffer->vpx_fb.size;
+      env->DeleteLocalRef(local_buffer);
+    }
+    *data = buffer->direct_buffer_data;
+    return buffer->direct_buffer;
+  }
+
+  // Deletes the global references created by get_direct_buffer.
+  void release_direct_buffers(JNIEnv* env) {
+    pthread_mutex_lock(&mutex);
+    for (int i = 0; i < all_buffer_count; i++) {
+      if (all_buffers[i]->direct_buffer) {
+        env->DeleteGlobalRef(all_buffers[i]->direct_buffer);
+        all_buffers[i]->direct_buffer = NULL;
+      }
+    }
+    pthread_mutex_unlock(&mutex);
+  }
+
   void add_ref(int id) {
     if (id < 0 || id >= all_buffer_count) {
       LOGE("JniBufferManager add_ref invalid id %d.", id);
@@ -390,18 +683,340 @@ class JniBufferManager {
     pthread_mutex_unlock(&mutex);
     return 0;
   }
+
+  // Like add_ref and release, for the references held by output buffers until
+  // vpxReleaseFrame is called. These are counted apart from the references of
+  // the decoder, which keeps its reference frames after a flush.
+  void add_output_ref(int id) {
+    if (id < 0 || id >= all_buffer_count) {
+      LOGE("JniBufferManager add_output_ref invalid id %d.", id);
+      return;
+    }
+    pthread_mutex_lock(&mutex);
+    all_buffers[id]->ref_count++;
+    output_ref_count++;
+    pthread_mutex_unlock(&mutex);
+  }
+
+  // Deletes the manager if it is detached and this was the last reference
+  // held by an output buffer, so the manager must not be used after releasing
+  // a reference once its context is destroyed.
+  int release_output_ref(int id) {
+    const int result = release(id);
+    if (!result) {
+      pthread_mutex_lock(&mutex);
+      output_ref_count--;
+      const bool delete_manager = detached && output_ref_count == 0;
+      pthread_mutex_unlock(&mutex);
+      if (delete_manager) {
+        delete this;
+      }
+    }
+    return result;
+  }
+
+  // Returns whether output buffers hold references on frame buffers.
+  bool has_output_refs() {
+    pthread_mutex_lock(&mutex);
+    const bool result = output_ref_count > 0;
+    pthread_mutex_unlock(&mutex);
+    return result;
+  }
+};
+
+// Geometry last set on a window.
+struct WindowGeometry {
+  int width = 0;
+  int height = 0;
+};
+
+// Downscales srcBuffer by factor into buffer, which is a YV12 window buffer.
+static void downscale_frame_to_window_buffer(
+    const JniFrameBuffer* srcBuffer, const int factor,
+    const ANativeWindow_Buffer& buffer) {
+  uint8_t* const dest_y = (uint8_t*)buffer.bits;
+  uint8_t* const dest_uv = dest_y + buffer.stride * buffer.height;
+  const int32_t buffer_uv_height = (buffer.height + 1) / 2;
+  const int width = std::min(srcBuffer->d_w, buffer.stride * factor);
+  const int height = std::min(srcBuffer->d_h, buffer.height * factor);
+  const int uv_width = (width + 1) / 2;
+  const int uv_height = (height + 1) / 2;
+  downscale_plane(srcBuffer->planes[VPX_PLANE_Y],
+                  srcBuffer->stride[VPX_PLANE_Y], dest_y, buffer.stride, width,
+                  height, factor);
+  const int dest_uv_stride = (buffer.stride / 2 + 15) & (~15);
+  downscale_plane(srcBuffer->planes[VPX_PLANE_V],
+                  srcBuffer->stride[VPX_PLANE_V], dest_uv, dest_uv_stride,
+                  uv_width, uv_height, factor);
+  downscale_plane(srcBuffer->planes[VPX_PLANE_U],
+                  srcBuffer->stride[VPX_PLANE_U],
+                  dest_uv + buffer_uv_height * dest_uv_stride, dest_uv_stride,
+                  uv_width, uv_height, factor);
+}
+
+// Copies srcBuffer, downscaled by factor, into the next YV12 buffer of window
+// and posts it. geometry holds the geometry last set on window, and is updated
+// if the output size differs. Returns 0 on success.
+static int render_frame_to_window(ANativeWindow* window,
+                                  const JniFrameBuffer* srcBuffer,
+                                  const int factor, WindowGeometry* geometry) {
+  const int width = downscaled_size(srcBuffer->d_w, factor);
+  const int height = downscaled_size(srcBuffer->d_h, factor);
+  if (geometry->width != width || geometry->height != height) {
+    // The geometry is only cached once set, so that a failure is retried.
+    if (ANativeWindow_setBuffersGeometry(window, width, height,
+                                         kImageFormatYV12)) {
+      return -1;
+    }
+    geometry->width = width;
+    geometry->height = height;
+  }
+  ANativeWindow_Buffer buffer;
+  int result = ANativeWindow_lock(window, &buffer, NULL);
+  if (buffer.bits == NULL || result) {
+    return -1;
+  }
+  if (factor > 1) {
+    downscale_frame_to_window_buffer(srcBuffer, factor, buffer);
+    return ANativeWindow_unlockAndPost(window);
+  }
+  // Y
+  copy_plane(srcBuffer->planes[VPX_PLANE_Y], srcBuffer->stride[VPX_PLANE_Y],
+             (uint8_t*)buffer.bits, buffer.stride, srcBuffer->d_w,
+             srcBuffer->d_h);
+  // UV
+  const int src_uv_stride = srcBuffer->stride[VPX_PLANE_U];
+  const int32_t buffer_uv_height = (buffer.height + 1) / 2;
+  const int32_t height_uv =
+      std::min((int32_t)(srcBuffer->d_h + 1) / 2, buffer_uv_height);
+  int stride = (srcBuffer->d_w + 1) / 2;
+  const uint8_t* src_base =
+      reinterpret_cast<uint8_t*>(srcBuffer->planes[VPX_PLANE_U]);
+  const uint8_t* src_v_base =
+      reinterpret_cast<uint8_t*>(srcBuffer->planes[VPX_PLANE_V]);
+  uint8_t* dest_v_base =
+      ((uint8_t*)buffer.bits) + buffer.stride * buffer.height;
+  const int dest_uv_stride = (buffer.stride / 2 + 15) & (~15);
+  copy_plane(src_v_base, src_uv_stride, dest_v_base, dest_uv_stride, stride,
+             height_uv);
+  copy_plane(src_base, src_uv_stride,
+             dest_v_base + buffer_uv_height * dest_uv_stride, dest_uv_stride,
+             stride, height_uv);
+  return ANativeWindow_unlockAndPost(window);
+}
+
+// Presents frames on a dedicated thread, so that a slow ANativeWindow_lock does
+// not block the thread rendering the output buffers.
+class RenderWorker {
+  static const int MAX_PENDING_FRAMES = 3;
+
+  struct PendingFrame {
+    ANativeWindow* window;
+    int downscale_factor;
+    int id;
+    int64_t release_time_ns;
+  };
+
+  JniBufferManager* const buffer_manager;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  // Pending frames, sorted by release time.
+  PendingFrame pending_frames[MAX_PENDING_FRAMES];
+  int pending_frame_count = 0;
+  bool stopping = false;
+  bool failed = false;
+  int64_t rendered_frame_count = 0;
+  int64_t dropped_frame_count = 0;
+
+  // Only accessed on the render thread.
+  ANativeWindow* window = NULL;
+  WindowGeometry geometry;
+
+  static int64_t now_ns() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  }
+
+  static void* run(void* arg) {
+    reinterpret_cast<RenderWorker*>(arg)->render_loop();
+    return NULL;
+  }
+
+  // Releases the references held by frame. Must be called with mutex held or
+  // after the thread has stopped.
+  void drop_frame(const PendingFrame& frame) {
+    ANativeWindow_release(frame.window);
+    buffer_manager->release(frame.id);
+    dropped_frame_count++;
+  }
+
+  void render_loop() {
+    pthread_mutex_lock(&mutex);
+    while (true) {
+      while (!stopping && !pending_frame_count) {
+        pthread_cond_wait(&cond, &mutex);
+      }
+      if (stopping) {
+        break;
+      }
+
+      // Wait until the first frame is due. Queuing an earlier frame or
+      // stopping wakes the thread. cond uses CLOCK_MONOTONIC, as
+      // release_time_ns does.
+      const int64_t now = now_ns();
+      const int64_t due = pending_frames[0].release_time_ns;
+      if (due > now) {
+        timespec deadline;
+        deadline.tv_sec = (time_t)(due / 1000000000);
+        deadline.tv_nsec = (long)(due % 1000000000);
+        pthread_cond_timedwait(&cond, &mutex, &deadline);
+        continue;
+      }
+
+      // Skip frames that a later due frame supersedes.
+      int skipped = 0;
+      while (skipped < pending_frame_count - 1 &&
+             pending_frames[skipped + 1].release_time_ns <= now) {
+        drop_frame(pending_frames[skipped++]);
+      }
+      const PendingFrame frame = pending_frames[skipped];
+      pending_frame_count -= skipped + 1;
+      memmove(&pending_frames[0], &pending_frames[skipped + 1],
+              pending_frame_count * sizeof(PendingFrame));
+
+      pthread_mutex_unlock(&mutex);
+      if (frame.window != window) {
+        if (window) {
+          ANativeWindow_release(window);
+        }
+        // Keep the frame's reference on the window, so that the geometry
+        // cached for it stays valid.
+        window = frame.window;
+        geometry = WindowGeometry();
+      } else {
+        ANativeWindow_release(frame.window);
+      }
+      const int result =
+          render_frame_to_window(window, buffer_manager->get_buffer(frame.id),
+                                 frame.downscale_factor, &geometry);
+      buffer_manager->release(frame.id);
+      pthread_mutex_lock(&mutex);
+
+      if (!result) {
+        rendered_frame_count++;
+      } else {
+        LOGE("RenderWorker failed to render frame, error = %d.", result);
+        failed = true;
+        dropped_frame_count++;
+      }
+    }
+    pthread_mutex_unlock(&mutex);
+  }
+
+ public:
+  explicit RenderWorker(JniBufferManager* buffer_manager)
+      : buffer_manager(buffer_manager) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    pthread_create(&thread, NULL, run, this);
+  }
+
+  // Stops the thread. Frames that have not been presented yet are dropped.
+  ~RenderWorker() {
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+    while (pending_frame_count) {
+      drop_frame(pending_frames[--pending_frame_count]);
+    }
+    if (window) {
+      ANativeWindow_release(window);
+    }
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  // Queues the frame in buffer id for presentation on window, downscaled by
+  // downscale_factor as in render_frame_to_window(). The frame is posted once
+  // release_time_ns, which is in the CLOCK_MONOTONIC time base, is reached.
+  // ANativeWindow has no public API to set a presentation time, so the worker
+  // waits until then instead. A frame is dropped instead if a later frame is
+  // already due when the worker gets to it, or if the queue is full when a
+  // frame is queued. Takes references on the buffer and the window until the
+  // frame has been presented or dropped.
+  void queue_frame(ANativeWindow* window, int downscale_factor, int id,
+                   int64_t release_time_ns) {
+    buffer_manager->add_ref(id);
+    ANativeWindow_acquire(window);
+    PendingFrame frame = {window, downscale_factor, id, release_time_ns};
+    pthread_mutex_lock(&mutex);
+    if (pending_frame_count == MAX_PENDING_FRAMES) {
+      drop_frame(pending_frames[0]);
+      memmove(&pending_frames[0], &pending_frames[1],
+              --pending_frame_count * sizeof(PendingFrame));
+    }
+    int index = pending_frame_count++;
+    while (index > 0 &&
+           pending_frames[index - 1].release_time_ns > release_time_ns) {
+      pending_frames[index] = pending_frames[index - 1];
+      index--;
+    }
+    pending_frames[index] = frame;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+  }
+
+  // Returns whether a frame failed to be presented since the last call.
+  bool take_error() {
+    pthread_mutex_lock(&mutex);
+    const bool result = failed;
+    failed = false;
+    pthread_mutex_unlock(&mutex);
+    return result;
+  }
+
+  int64_t rendered_frames() {
+    pthread_mutex_lock(&mutex);
+    const int64_t result = rendered_frame_count;
+    pthread_mutex_unlock(&mutex);
+    return result;
+  }
+
+  int64_t dropped_frames() {
+    pthread_mutex_lock(&mutex);
+    const int64_t result = dropped_frame_count;
+    pthread_mutex_unlock(&mutex);
+    return result;
+  }
 };
 
 struct JniCtx {
   JniCtx() { buffer_manager = new JniBufferManager(); }
 
   ~JniCtx() {
+    // Stop the render worker first, as it holds references on frame buffers.
+    if (render_worker) {
+      delete render_worker;
+    }
     if (native_window) {
       ANativeWindow_release(native_window);
     }
-    if (buffer_manager) {
-      delete buffer_manager;
+    // Destroy the decoder before detaching the buffer manager, as it releases
+    // its frame buffers into it.
+    if (decoder) {
+      vpx_codec_destroy(decoder);
+      delete decoder;
     }
+    buffer_manager->detach();
   }
 
   void acquire_native_window(JNIEnv* env, jobject new_surface) {
@@ -411,18 +1026,75 @@ struct JniCtx {
       }
       native_window = ANativeWindow_fromSurface(env, new_surface);
       surface = new_surface;
-      width = 0;
+      geometry = WindowGeometry();
     }
   }
 
+  // Detached when the context is destroyed. Output buffers that still hold
+  // frame buffers keep it alive, and release them through the pointer returned
+  // by vpxGetBufferManager.
   JniBufferManager* buffer_manager = NULL;
+  // Presents the frames queued by vpxQueueFrame if asynchronous rendering is
+  // enabled.
+  RenderWorker* render_worker = NULL;
   vpx_codec_ctx_t* decoder = NULL;
   ANativeWindow* native_window = NULL;
   jobject surface = NULL;
-  int width = 0;
-  int height = 0;
+  WindowGeometry geometry;
+  // Factor by which 8-bit frames are downscaled while being copied out, in YUV
+  // and surface modes. 1, 2 or 4.
+  int downscale_factor = 1;
+  // Row alignment of the planes written in YUV output mode, or 0 to use the
+  // decoder's strides.
+  int yuv_stride_alignment = 0;
+  // Whether 8-bit frames are output in YUV mode by exposing the frame buffers
+  // instead of copying them.
+  bool zero_copy_yuv = false;
+  // Options the decoder was created with, reapplied when it is recreated with
+  // a different number of threads.
+  bool disable_loop_filter = false;
+  bool enable_row_mt = false;
+  // Number of threads the decoder was initialized with, or 0 if its
+  // initialization failed.
+  int threads = 0;
+  // Whether only packets whose frames are all intra coded are decoded. Set by
+  // vpxSetTrickPlayEnabled on the playback thread and read on the decode
+  // thread.
+  std::atomic<bool> trick_play{false};
+  // Whether packets are skipped until the next key frame, because one was
+  // skipped since the last key frame and later frames may reference it.
+  bool awaiting_key_frame = false;
+  // Copies of recently output frames, read by vpxReadCachedFrame on any
+  // thread.
+  exoplayer_jni::FrameCache frame_cache;
 };
 
+// Returns whether the packet of size bytes at data is skipped instead of
+// decoded. In trick-play mode, only packets whose frames are all intra coded
+// are decoded. Once a packet has been skipped, inter frames are skipped until
+// the next key frame resets every reference frame. Packets that cannot be
+// classified are decoded.
+static bool skip_packet(JniCtx* context, const uint8_t* data,
+                        const size_t size) {
+  if (!context->trick_play && !context->awaiting_key_frame) {
+    return false;
+  }
+  bool key_frame;
+  bool intra_only;
+  if (!vpx_jni::classify_vp9_packet(data, size, &key_frame, &intra_only)) {
+    return false;
+  }
+  if (key_frame) {
+    context->awaiting_key_frame = false;
+    return false;
+  }
+  if (context->trick_play && intra_only) {
+    return false;
+  }
+  context->awaiting_key_frame = true;
+  return true;
+}
+
 int vpx_get_frame_buffer(void* priv, size_t min_size,
                          vpx_codec_frame_buffer_t* fb) {
   JniBufferManager* const buffer_manager =
@@ -436,28 +1108,26 @@ int vpx_release_frame_buffer(void* priv, vpx_codec_frame_buffer_t* fb) {
   return buffer_manager->release(*(int*)fb->priv);
 }
 
-DECODER_FUNC(jlong, vpxInit, jboolean disableLoopFilter,
-             jboolean enableRowMultiThreadMode, jint threads) {
-  JniCtx* context = new JniCtx();
-  context->decoder = new vpx_codec_ctx_t();
+// Initializes the libvpx decoder of the context with the given number of
+// threads, applying the context's loop filter and row multithreading options.
+static vpx_codec_err_t init_decoder(JniCtx* context, int threads) {
   vpx_codec_dec_cfg_t cfg = {0, 0, 0};
   cfg.threads = threads;
-  errorCode = 0;
   vpx_codec_err_t err =
       vpx_codec_dec_init(context->decoder, &vpx_codec_vp9_dx_algo, &cfg, 0);
   if (err) {
     LOGE("Failed to initialize libvpx decoder, error = %d.", err);
-    errorCode = err;
-    return 0;
+    context->threads = 0;
+    return err;
   }
 #ifdef VPX_CTRL_VP9_DECODE_SET_ROW_MT
   err = vpx_codec_control(context->decoder, VP9D_SET_ROW_MT,
-                          enableRowMultiThreadMode);
+                          context->enable_row_mt);
   if (err) {
     LOGE("Failed to enable row multi thread mode, error = %d.", err);
   }
 #endif
-  if (disableLoopFilter) {
+  if (context->disable_loop_filter) {
     err = vpx_codec_control(context->decoder, VP9_SET_SKIP_LOOP_FILTER, true);
     if (err) {
       LOGE("Failed to shut off libvpx loop filter, error = %d.", err);
@@ -476,29 +1146,201 @@ DECODER_FUNC(jlong, vpxInit, jboolean disableLoopFilter,
   if (err) {
     LOGE("Failed to set libvpx frame buffer functions, error = %d.", err);
   }
+  context->threads = threads;
+  return VPX_CODEC_OK;
+}
+
+// Maximum number of contexts kept by IdleContextPool. Each one keeps its
+// frame buffers, so the pool is kept small.
+static const int kMaxIdleContexts = 2;
+
+// Keeps the contexts of closed decoders, flushed but with their libvpx decoder
+// and frame buffers still allocated, so that vpxInit can reuse one instead of
+// initializing a new decoder. This shortens the time to the first frame when
+// switching between channels or tracks. Idle decoders are initialized again
+// with a single thread, so that the pool holds no tile threads outside the
+// DecoderThreadBudget of the decoders in use. vpxInit initializes a reused
+// decoder that is given more threads again.
+class IdleContextPool {
+  pthread_mutex_t mutex;
+  // Guarded by mutex.
+  JniCtx* contexts[kMaxIdleContexts];
+  int context_count = 0;
+
+  IdleContextPool() { pthread_mutex_init(&mutex, NULL); }
+
+  bool is_full() {
+    pthread_mutex_lock(&mutex);
+    const bool full = context_count >= kMaxIdleContexts;
+    pthread_mutex_unlock(&mutex);
+    return full;
+  }
+
+ public:
+  // Returns the pool of the process. It is never destroyed.
+  static IdleContextPool& get_instance() {
+    static IdleContextPool* const instance = new IdleContextPool();
+    return *instance;
+  }
+
+  // Removes and returns an idle context, whose decoder uses a single thread,
+  // or returns NULL if there is none.
+  JniCtx* lease() {
+    pthread_mutex_lock(&mutex);
+    JniCtx* context = NULL;
+    if (context_count) {
+      context = contexts[--context_count];
+    }
+    pthread_mutex_unlock(&mutex);
+    return context;
+  }
+
+  // Takes ownership of context unless the pool is full or its decoder could
+  // not be initialized again with a single thread. Returns whether it did.
+  bool park(JniCtx* context) {
+    if (is_full()) {
+      return false;
+    }
+    if (context->threads != 1) {
+      vpx_codec_destroy(context->decoder);
+      if (init_decoder(context, 1)) {
+        return false;
+      }
+    }
+    pthread_mutex_lock(&mutex);
+    const bool parked = context_count < kMaxIdleContexts;
+    if (parked) {
+      contexts[context_count++] = context;
+    }
+    pthread_mutex_unlock(&mutex);
+    return parked;
+  }
+};
+
+// Returns the context to the state of a newly initialized one, keeping its
+// decoder and frame buffers. Returns false if the decoder could not be
+// flushed, in which case the context must not be reused.
+static bool reset_context_for_reuse(JNIEnv* env, JniCtx* context) {
+  // Stop the render worker first, as it holds references on frame buffers.
+  if (context->render_worker) {
+    delete context->render_worker;
+    context->render_worker = NULL;
+  }
+  // Drop the frames still held by the decoder, returning their buffers.
+  if (vpx_codec_decode(context->decoder, NULL, 0, NULL, 0) != VPX_CODEC_OK) {
+    return false;
+  }
+  vpx_codec_iter_t iter = NULL;
+  while (vpx_codec_get_frame(context->decoder, &iter)) {
+  }
+  context->buffer_manager->release_direct_buffers(env);
+  if (context->native_window) {
+    ANativeWindow_release(context->native_window);
+    context->native_window = NULL;
+  }
+  context->surface = NULL;
+  context->geometry = WindowGeometry();
+  context->downscale_factor = 1;
+  context->yuv_stride_alignment = 0;
+  context->zero_copy_yuv = false;
+  context->trick_play = false;
+  context->awaiting_key_frame = false;
+  context->frame_cache.Reset();
+  return true;
+}
+
+// Creates a context with a decoder, or returns NULL and sets errorCode if the
+// decoder could not be initialized.
+static JniCtx* new_context(JNIEnv* env, const bool disableLoopFilter,
+                           const bool enableRowMultiThreadMode,
+                           const int threads) {
+  JniCtx* context = new JniCtx();
+  context->decoder = new vpx_codec_ctx_t();
+  context->disable_loop_filter = disableLoopFilter;
+  context->enable_row_mt = enableRowMultiThreadMode;
+  errorCode = init_decoder(context, threads);
+  if (errorCode) {
+    delete context;
+    return NULL;
+  }
 
   // Populate JNI References.
   const jclass outputBufferClass = env->FindClass(
       "com/google/android/exoplayer2/decoder/VideoDecoderOutputBuffer");
   initForYuvFrame =
       env->GetMethodID(outputBufferClass, "initForYuvFrame", "(IIIII)Z");
+  initForExternalYuvFrame = env->GetMethodID(
+      outputBufferClass, "initForExternalYuvFrame",
+      "(IILjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;"
+      "IIIIII)Z");
   initForPrivateFrame =
       env->GetMethodID(outputBufferClass, "initForPrivateFrame", "(II)V");
+  initForRgbaFrame =
+      env->GetMethodID(outputBufferClass, "initForRgbaFrame", "(IIIII)Z");
   dataField =
       env->GetFieldID(outputBufferClass, "data", "Ljava/nio/ByteBuffer;");
+  timeUsField = env->GetFieldID(outputBufferClass, "timeUs", "J");
   outputModeField = env->GetFieldID(outputBufferClass, "mode", "I");
   decoderPrivateField =
       env->GetFieldID(outputBufferClass, "decoderPrivate", "I");
-  return reinterpret_cast<intptr_t>(context);
+  return context;
+}
+
+DECODER_FUNC(jlong, vpxInit, jboolean disableLoopFilter,
+             jboolean enableRowMultiThreadMode, jint threads) {
+  // Reuse the context of a closed decoder if there is one.
+  JniCtx* context = IdleContextPool::get_instance().lease();
+  if (context) {
+    errorCode = 0;
+    if (context->threads != threads ||
+        context->disable_loop_filter != disableLoopFilter ||
+        context->enable_row_mt != enableRowMultiThreadMode) {
+      vpx_codec_destroy(context->decoder);
+      context->disable_loop_filter = disableLoopFilter;
+      context->enable_row_mt = enableRowMultiThreadMode;
+      errorCode = init_decoder(context, threads);
+      if (errorCode) {
+        delete context;
+        return 0;
+      }
+    }
+    return reinterpret_cast<intptr_t>(context);
+  }
+  return reinterpret_cast<intptr_t>(
+      new_context(env, disableLoopFilter, enableRowMultiThreadMode, threads));
+}
+
+DECODER_FUNC(void, vpxPrewarm, jint count) {
+  for (int i = 0; i < count; i++) {
+    // Idle decoders use a single thread, see IdleContextPool.
+    JniCtx* const context = new_context(env, /* disableLoopFilter= */ false,
+                                        /* enableRowMultiThreadMode= */ false,
+                                        /* threads= */ 1);
+    if (!context) {
+      return;
+    }
+    if (!IdleContextPool::get_instance().park(context)) {
+      delete context;
+      return;
+    }
+  }
+}
+
+DECODER_FUNC(void, vpxSetTrickPlayEnabled, jlong jContext, jboolean enabled) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  context->trick_play = enabled;
 }
 
 DECODER_FUNC(jlong, vpxDecode, jlong jContext, jobject encoded, jint len) {
   JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
   const uint8_t* const buffer =
       reinterpret_cast<const uint8_t*>(env->GetDirectBufferAddress(encoded));
+  errorCode = 0;
+  if (skip_packet(context, buffer, len)) {
+    return 1;
+  }
   const vpx_codec_err_t status =
       vpx_codec_decode(context->decoder, buffer, len, NULL, 0);
-  errorCode = 0;
   if (status != VPX_CODEC_OK) {
     LOGE("vpx_codec_decode() failed, status= %d", status);
     errorCode = status;
@@ -520,11 +1362,60 @@ DECODER_FUNC(jlong, vpxSecureDecode, jlong jContext, jobject encoded, jint len,
 
 DECODER_FUNC(jlong, vpxClose, jlong jContext) {
   JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
-  vpx_codec_destroy(context->decoder);
+  // Keep the context for the next decoder if there is room. A context whose
+  // frame buffers are still held by output buffers the renderer has not
+  // released is destroyed instead, as they would be released into the next
+  // decoder. Its buffer manager is then deleted by the last of those releases.
+  if (context->threads && reset_context_for_reuse(env, context) &&
+      !context->buffer_manager->has_output_refs() &&
+      IdleContextPool::get_instance().park(context)) {
+    return 0;
+  }
+  context->buffer_manager->release_direct_buffers(env);
   delete context;
   return 0;
 }
 
+DECODER_FUNC(jint, vpxSetThreads, jlong jContext, jint threads) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  // libvpx fixes its thread count at initialization, so a new decoder is
+  // initialized. The current one is only replaced once that has succeeded, so
+  // that a failure leaves the context decoding with its old thread count.
+  // Frames still held by output buffers keep their references in the buffer
+  // manager and stay valid.
+  vpx_codec_ctx_t* const old_decoder = context->decoder;
+  const int old_threads = context->threads;
+  context->decoder = new vpx_codec_ctx_t();
+  errorCode = init_decoder(context, threads);
+  if (errorCode) {
+    vpx_codec_destroy(context->decoder);
+    delete context->decoder;
+    context->decoder = old_decoder;
+    context->threads = old_threads;
+    return -1;
+  }
+  vpx_codec_destroy(old_decoder);
+  delete old_decoder;
+  return 0;
+}
+
+// Stores a copy of img in the frame cache of context if it is enabled, under
+// the presentation time of jOutputBuffer. Only 8-bit 4:2:0 frames are cached.
+static void maybe_cache_frame(JNIEnv* env, JniCtx* context,
+                              const vpx_image_t* const img,
+                              const int colorspace, jobject jOutputBuffer) {
+  if (!context->frame_cache.enabled() || img->fmt != VPX_IMG_FMT_I420) {
+    return;
+  }
+  const uint8_t* const planes[3] = {img->planes[VPX_PLANE_Y],
+                                    img->planes[VPX_PLANE_U],
+                                    img->planes[VPX_PLANE_V]};
+  const int strides[3] = {img->stride[VPX_PLANE_Y], img->stride[VPX_PLANE_U],
+                          img->stride[VPX_PLANE_V]};
+  context->frame_cache.Put(env->GetLongField(jOutputBuffer, timeUsField),
+                           img->d_w, img->d_h, colorspace, planes, strides);
+}
+
 DECODER_FUNC(jint, vpxGetFrame, jlong jContext, jobject jOutputBuffer) {
   JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
   vpx_codec_iter_t iter = NULL;
@@ -536,33 +1427,76 @@ DECODER_FUNC(jint, vpxGetFrame, jlong jContext, jobject jOutputBuffer) {
 
   const int kOutputModeYuv = 0;
   const int kOutputModeSurfaceYuv = 1;
+  const int kOutputModeRgba = 2;
+
+  int colorspace = exoplayer_jni::kColorSpaceUnknown;
+  switch (img->cs) {
+    case VPX_CS_BT_601:
+      colorspace = exoplayer_jni::kColorSpaceBT601;
+      break;
+    case VPX_CS_BT_709:
+      colorspace = exoplayer_jni::kColorSpaceBT709;
+      break;
+    case VPX_CS_BT_2020:
+      colorspace = exoplayer_jni::kColorSpaceBT2020;
+      break;
+    default:
+      break;
+  }
+  maybe_cache_frame(env, context, img, colorspace, jOutputBuffer);
 
   int outputMode = env->GetIntField(jOutputBuffer, outputModeField);
   if (outputMode == kOutputModeYuv) {
-    const int kColorspaceUnknown = 0;
-    const int kColorspaceBT601 = 1;
-    const int kColorspaceBT709 = 2;
-    const int kColorspaceBT2020 = 3;
-
-    int colorspace = kColorspaceUnknown;
-    switch (img->cs) {
-      case VPX_CS_BT_601:
-        colorspace = kColorspaceBT601;
-        break;
-      case VPX_CS_BT_709:
-        colorspace = kColorspaceBT709;
-        break;
-      case VPX_CS_BT_2020:
-        colorspace = kColorspaceBT2020;
-        break;
-      default:
-        break;
+    // Only 8-bit frames are downscaled.
+    const int factor =
+        (img->fmt & VPX_IMG_FMT_HIGHBITDEPTH) ? 1 : context->downscale_factor;
+    if (context->zero_copy_yuv && factor == 1 &&
+        !(img->fmt & VPX_IMG_FMT_HIGHBITDEPTH)) {
+      // Expose the frame buffer directly. The output buffer holds a reference
+      // to it until vpxReleaseFrame is called.
+      const int id = *(int*)img->fb_priv;
+      const uint8_t* fbData;
+      jobject directBuffer =
+          context->buffer_manager->get_direct_buffer(env, id, &fbData);
+      if (!directBuffer) {
+        return -1;
+      }
+      jboolean initResult = env->CallBooleanMethod(
+          jOutputBuffer, initForExternalYuvFrame, img->d_w, img->d_h,
+          directBuffer, directBuffer, directBuffer,
+          (jint)(img->planes[VPX_PLANE_Y] - fbData),
+          (jint)(img->planes[VPX_PLANE_U] - fbData),
+          (jint)(img->planes[VPX_PLANE_V] - fbData), img->stride[VPX_PLANE_Y],
+          img->stride[VPX_PLANE_U], colorspace);
+      if (env->ExceptionCheck() || !initResult) {
+        return -1;
+      }
+      context->buffer_manager->add_output_ref(id);
+      env->SetIntField(jOutputBuffer, decoderPrivateField,
+                       id + kDecoderPrivateBase);
+      return 0;
+    }
+
+    // Use the decoder's strides unless a stride alignment was requested or the
+    // frame is downscaled, in which case the rows are packed to the output
+    // width.
+    const int outWidth = downscaled_size(img->d_w, factor);
+    const int outHeight = downscaled_size(img->d_h, factor);
+    const int32_t uvWidth = (outWidth + 1) / 2;
+    int32_t yStride = img->stride[VPX_PLANE_Y];
+    int32_t uvStride = img->stride[VPX_PLANE_U];
+    if (context->yuv_stride_alignment > 0 || factor > 1) {
+      const int alignment = context->yuv_stride_alignment > 0
+                                ? context->yuv_stride_alignment
+                                : 16;
+      yStride = align_to(outWidth, alignment);
+      uvStride = align_to(uvWidth, alignment);
     }
 
     // resize buffer if required.
-    jboolean initResult = env->CallBooleanMethod(
-        jOutputBuffer, initForYuvFrame, img->d_w, img->d_h,
-        img->stride[VPX_PLANE_Y], img->stride[VPX_PLANE_U], colorspace);
+    jboolean initResult =
+        env->CallBooleanMethod(jOutputBuffer, initForYuvFrame, outWidth,
+                               outHeight, yStride, uvStride, colorspace);
     if (env->ExceptionCheck() || !initResult) {
       return -1;
     }
@@ -572,28 +1506,70 @@ DECODER_FUNC(jint, vpxGetFrame, jlong jContext, jobject jOutputBuffer) {
     jbyte* const data =
         reinterpret_cast<jbyte*>(env->GetDirectBufferAddress(dataObject));
 
-    const int32_t uvHeight = (img->d_h + 1) / 2;
-    const uint64_t yLength = img->stride[VPX_PLANE_Y] * img->d_h;
-    const uint64_t uvLength = img->stride[VPX_PLANE_U] * uvHeight;
-    if (img->fmt == VPX_IMG_FMT_I42016) {  // HBD planar 420.
-      // Note: The stride for BT2020 is twice of what we use so this is wasting
-      // memory. The long term goal however is to upload half-float/short so
-      // it's not important to optimize the stride at this time.
-      int converted = 0;
-#ifdef __ARM_NEON__
-      converted = convert_16_to_8_neon(img, data, uvHeight, yLength, uvLength);
-#endif  // __ARM_NEON__
-      if (!converted) {
-        convert_16_to_8_standard(img, data, uvHeight, yLength, uvLength);
-      }
-    } else {
+    const int32_t uvHeight = (outHeight + 1) / 2;
+    const uint64_t yLength = yStride * outHeight;
+    const uint64_t uvLength = uvStride * uvHeight;
+    if (factor > 1) {
+      const int srcUvWidth = (img->d_w + 1) / 2;
+      const int srcUvHeight = (img->d_h + 1) / 2;
+      downscale_plane(img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y],
+                      reinterpret_cast<uint8_t*>(data), yStride, img->d_w,
+                      img->d_h, factor);
+      downscale_plane(img->planes[VPX_PLANE_U], img->stride[VPX_PLANE_U],
+                      reinterpret_cast<uint8_t*>(data + yLength), uvStride,
+                      srcUvWidth, srcUvHeight, factor);
+      downscale_plane(img->planes[VPX_PLANE_V], img->stride[VPX_PLANE_V],
+                      reinterpret_cast<uint8_t*>(data + yLength + uvLength),
+                      uvStride, srcUvWidth, srcUvHeight, factor);
+    } else if (img->fmt == VPX_IMG_FMT_I42016) {  // HBD planar 420.
+      // Note: Unless a stride alignment is set, the stride for BT2020 is twice
+      // of what we use so this is wasting memory. The long term goal however
+      // is to upload half-float/short so it's not important to optimize the
+      // default stride at this time.
+      convert_16_to_8(img, data, yStride, uvStride, yLength, uvLength);
+    } else if (yStride == img->stride[VPX_PLANE_Y] &&
+               uvStride == img->stride[VPX_PLANE_U]) {
       // TODO: This copy can be eliminated by using external frame
       // buffers. This is insignificant for smaller videos but takes ~1.5ms
       // for 1080p clips. So this should eventually be gotten rid of.
       memcpy(data, img->planes[VPX_PLANE_Y], yLength);
       memcpy(data + yLength, img->planes[VPX_PLANE_U], uvLength);
       memcpy(data + yLength + uvLength, img->planes[VPX_PLANE_V], uvLength);
+    } else {
+      copy_plane(img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y],
+                 reinterpret_cast<uint8_t*>(data), yStride, img->d_w,
+                 img->d_h);
+      copy_plane(img->planes[VPX_PLANE_U], img->stride[VPX_PLANE_U],
+                 reinterpret_cast<uint8_t*>(data + yLength), uvStride, uvWidth,
+                 uvHeight);
+      copy_plane(img->planes[VPX_PLANE_V], img->stride[VPX_PLANE_V],
+                 reinterpret_cast<uint8_t*>(data + yLength + uvLength),
+                 uvStride, uvWidth, uvHeight);
     }
+  } else if (outputMode == kOutputModeRgba) {
+    const bool highBitDepth = img->fmt & VPX_IMG_FMT_HIGHBITDEPTH;
+    if (img->fmt != VPX_IMG_FMT_I420 &&
+        (img->fmt != VPX_IMG_FMT_I42016 || img->bit_depth != 10)) {
+      LOGE("Output format %d with bit depth %d not supported in RGBA output "
+           "mode",
+           img->fmt, img->bit_depth);
+      return -1;
+    }
+    // Frames are converted at their decoded size. Both RGBA formats use 4
+    // bytes per pixel.
+    const int stride = img->d_w * 4;
+    jboolean initResult = env->CallBooleanMethod(
+        jOutputBuffer, initForRgbaFrame, img->d_w, img->d_h, stride,
+        highBitDepth ? exoplayer_jni::kRgbaFormat1010102
+                     : exoplayer_jni::kRgbaFormat8888,
+        colorspace);
+    if (env->ExceptionCheck() || !initResult) {
+      return -1;
+    }
+    const jobject dataObject = env->GetObjectField(jOutputBuffer, dataField);
+    uint8_t* const data =
+        reinterpret_cast<uint8_t*>(env->GetDirectBufferAddress(dataObject));
+    convert_frame_to_rgba(img, colorspace, data, stride);
   } else if (outputMode == kOutputModeSurfaceYuv) {
     if (img->fmt & VPX_IMG_FMT_HIGHBITDEPTH) {
       LOGE(
@@ -603,7 +1579,7 @@ DECODER_FUNC(jint, vpxGetFrame, jlong jContext, jobject jOutputBuffer) {
       return -1;
     }
     int id = *(int*)img->fb_priv;
-    context->buffer_manager->add_ref(id);
+    context->buffer_manager->add_output_ref(id);
     JniFrameBuffer* jfb = context->buffer_manager->get_buffer(id);
     for (int i = 2; i >= 0; i--) {
       jfb->stride[i] = img->stride[i];
@@ -611,7 +1587,9 @@ DECODER_FUNC(jint, vpxGetFrame, jlong jContext, jobject jOutputBuffer) {
     }
     jfb->d_w = img->d_w;
     jfb->d_h = img->d_h;
-    env->CallVoidMethod(jOutputBuffer, initForPrivateFrame, img->d_w, img->d_h);
+    env->CallVoidMethod(jOutputBuffer, initForPrivateFrame,
+                        downscaled_size(img->d_w, context->downscale_factor),
+                        downscaled_size(img->d_h, context->downscale_factor));
     if (env->ExceptionCheck()) {
       return -1;
     }
@@ -631,58 +1609,120 @@ DECODER_FUNC(jint, vpxRenderFrame, jlong jContext, jobject jSurface,
   if (context->native_window == NULL || !srcBuffer) {
     return 1;
   }
-  if (context->width != srcBuffer->d_w || context->height != srcBuffer->d_h) {
-    ANativeWindow_setBuffersGeometry(context->native_window, srcBuffer->d_w,
-                                     srcBuffer->d_h, kImageFormatYV12);
-    context->width = srcBuffer->d_w;
-    context->height = srcBuffer->d_h;
-  }
-  ANativeWindow_Buffer buffer;
-  int result = ANativeWindow_lock(context->native_window, &buffer, NULL);
-  if (buffer.bits == NULL || result) {
+  return render_frame_to_window(context->native_window, srcBuffer,
+                                context->downscale_factor, &context->geometry);
+}
+
+DECODER_FUNC(jint, vpxQueueFrame, jlong jContext, jobject jSurface,
+             jobject jOutputBuffer, jlong releaseTimeNs) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  if (!context->render_worker || context->render_worker->take_error()) {
     return -1;
   }
-  // Y
-  const size_t src_y_stride = srcBuffer->stride[VPX_PLANE_Y];
-  int stride = srcBuffer->d_w;
-  const uint8_t* src_base =
-      reinterpret_cast<uint8_t*>(srcBuffer->planes[VPX_PLANE_Y]);
-  uint8_t* dest_base = (uint8_t*)buffer.bits;
-  for (int y = 0; y < srcBuffer->d_h; y++) {
-    memcpy(dest_base, src_base, stride);
-    src_base += src_y_stride;
-    dest_base += buffer.stride;
-  }
-  // UV
-  const int src_uv_stride = srcBuffer->stride[VPX_PLANE_U];
-  const int dest_uv_stride = (buffer.stride / 2 + 15) & (~15);
-  const int32_t buffer_uv_height = (buffer.height + 1) / 2;
-  const int32_t height =
-      std::min((int32_t)(srcBuffer->d_h + 1) / 2, buffer_uv_height);
-  stride = (srcBuffer->d_w + 1) / 2;
-  src_base = reinterpret_cast<uint8_t*>(srcBuffer->planes[VPX_PLANE_U]);
-  const uint8_t* src_v_base =
-      reinterpret_cast<uint8_t*>(srcBuffer->planes[VPX_PLANE_V]);
-  uint8_t* dest_v_base =
-      ((uint8_t*)buffer.bits) + buffer.stride * buffer.height;
-  dest_base = dest_v_base + buffer_uv_height * dest_uv_stride;
-  for (int y = 0; y < height; y++) {
-    memcpy(dest_base, src_base, stride);
-    memcpy(dest_v_base, src_v_base, stride);
-    src_base += src_uv_stride;
-    src_v_base += src_uv_stride;
-    dest_base += dest_uv_stride;
-    dest_v_base += dest_uv_stride;
+  const int id = env->GetIntField(jOutputBuffer, decoderPrivateField) -
+                 kDecoderPrivateBase;
+  context->acquire_native_window(env, jSurface);
+  if (context->native_window == NULL ||
+      !context->buffer_manager->get_buffer(id)) {
+    return 1;
   }
-  return ANativeWindow_unlockAndPost(context->native_window);
+  context->render_worker->queue_frame(context->native_window,
+                                      context->downscale_factor, id,
+                                      releaseTimeNs);
+  return 0;
 }
 
-DECODER_FUNC(void, vpxReleaseFrame, jlong jContext, jobject jOutputBuffer) {
+DECODER_FUNC(jlong, vpxGetBufferManager, jlong jContext) {
   JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  return reinterpret_cast<jlong>(context->buffer_manager);
+}
+
+DECODER_FUNC(void, vpxReleaseFrame, jlong jBufferManager,
+             jobject jOutputBuffer) {
+  JniBufferManager* const buffer_manager =
+      reinterpret_cast<JniBufferManager*>(jBufferManager);
   const int id = env->GetIntField(jOutputBuffer, decoderPrivateField) -
                  kDecoderPrivateBase;
   env->SetIntField(jOutputBuffer, decoderPrivateField, -1);
-  context->buffer_manager->release(id);
+  buffer_manager->release_output_ref(id);
+}
+
+DECODER_FUNC(void, vpxSetDownscaleFactor, jlong jContext, jint factor) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  context->downscale_factor = factor;
+}
+
+DECODER_FUNC(void, vpxSetAsyncRenderEnabled, jlong jContext,
+             jboolean enabled) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  if (!enabled) {
+    delete context->render_worker;
+    context->render_worker = NULL;
+  } else if (!context->render_worker) {
+    context->render_worker =
+        new (std::nothrow) RenderWorker(context->buffer_manager);
+  }
+}
+
+DECODER_FUNC(jlong, vpxGetRenderedFrameCount, jlong jContext) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  return context->render_worker ? context->render_worker->rendered_frames()
+                                : 0;
+}
+
+DECODER_FUNC(jlong, vpxGetDroppedFrameCount, jlong jContext) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  return context->render_worker ? context->render_worker->dropped_frames() : 0;
+}
+
+DECODER_FUNC(void, vpxSetYuvOutputStrideAlignment, jlong jContext,
+             jint alignment) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  context->yuv_stride_alignment = alignment;
+}
+
+DECODER_FUNC(void, vpxSetZeroCopyYuvOutputEnabled, jlong jContext,
+             jboolean enabled) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  context->zero_copy_yuv = enabled;
+}
+
+DECODER_FUNC(void, vpxSetFrameCacheSize, jlong jContext, jlong maxBytes,
+             jint downscaleFactor) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  context->frame_cache.Configure(
+      static_cast<size_t>(std::max<jlong>(maxBytes, 0)), downscaleFactor);
+}
+
+DECODER_FUNC(jboolean, vpxReadCachedFrame, jlong jContext, jlong timeUs,
+             jlong toleranceUs, jobject jOutputBuffer) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  return context->frame_cache.Read(
+      timeUs, std::max<jlong>(toleranceUs, 0),
+      [=](const exoplayer_jni::CachedFrameInfo& info) -> uint8_t* {
+        const jboolean initResult = env->CallBooleanMethod(
+            jOutputBuffer, initForYuvFrame, info.width, info.height,
+            info.width, (info.width + 1) / 2, info.colorspace);
+        if (env->ExceptionCheck() || !initResult) {
+          // Any exception is thrown in Java when returning from the native
+          // call.
+          return NULL;
+        }
+        env->SetLongField(jOutputBuffer, timeUsField, info.time_us);
+        jobject dataObject = env->GetObjectField(jOutputBuffer, dataField);
+        return reinterpret_cast<uint8_t*>(
+            env->GetDirectBufferAddress(dataObject));
+      });
+}
+
+DECODER_FUNC(jlong, vpxGetFrameCacheHitCount, jlong jContext) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  return context->frame_cache.hit_count();
+}
+
+DECODER_FUNC(jlong, vpxGetFrameCacheMissCount, jlong jContext) {
+  JniCtx* const context = reinterpret_cast<JniCtx*>(jContext);
+  return context->frame_cache.miss_count();
 }
 
 DECODER_FUNC(jstring, vpxGetErrorMessage, jlong jContext) {
@@ -692,6 +1732,30 @@ DECODER_FUNC(jstring, vpxGetErrorMessage, jlong jContext) {
 
 DECODER_FUNC(jint, vpxGetErrorCode, jlong jContext) { return errorCode; }
 
+DECODER_FUNC(void, vpxSetFrameArenaCapacity, jlong capacityBytes) {
+  exoplayer_jni::FrameArena::GetInstance().SetCapacity(
+      static_cast<size_t>(std::max<jlong>(capacityBytes, 0)));
+}
+
+DECODER_FUNC(void, vpxSetLogLevel, jint level) {
+  exoplayer_jni::SetLogLevel(level);
+}
+
+DECODER_FUNC(void, vpxSetLogRingEnabled, jboolean enabled) {
+  exoplayer_jni::SetLogRingEnabled(enabled);
+}
+
+DECODER_FUNC(jstring, vpxDumpLogRing) {
+  char* const log = new (std::nothrow) char[exoplayer_jni::kLogRingDumpSize];
+  if (log == nullptr) {
+    return nullptr;
+  }
+  exoplayer_jni::DumpLogRing(log, exoplayer_jni::kLogRingDumpSize);
+  jstring result = env->NewStringUTF(log);
+  delete[] log;
+  return result;
+}
+
 LIBRARY_FUNC(jstring, vpxIsSecureDecodeSupported) {
   // Doesn't support
   return 0;
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks parse_vp9_frame_type() and classify_vp9_packet() on frames and
+// superframes built bit by bit, including the hidden and shown frame pairs
+// that encoders pack into superframes.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "vp9_packet.h"  // NOLINT
+
+namespace {
+
+// Size of the frames built by MakeFrame(), unless given.
+constexpr size_t kFrameSize = 20;
+
+struct FrameHeader {
+  int profile;
+  bool show_existing_frame;
+  bool key_frame;
+  bool show_frame;
+  // Only signaled by hidden inter frames.
+  bool intra_only;
+};
+
+// Returns a frame of |size| bytes whose uncompressed header starts with
+// |header|, from section 6.2 of the VP9 specification.
+std::vector<uint8_t> MakeFrame(const FrameHeader& header,
+                               size_t size = kFrameSize) {
+  std::vector<int> bits = {1, 0};  // frame_marker
+  bits.push_back(header.profile & 1);
+  bits.push_back(header.profile >> 1);
+  if (header.profile == 3) {
+    bits.push_back(0);  // reserved_zero
+  }
+  bits.push_back(header.show_existing_frame);
+  if (!header.show_existing_frame) {
+    bits.push_back(header.key_frame ? 0 : 1);  // frame_type
+    bits.push_back(header.show_frame);
+    bits.push_back(0);  // error_resilient_mode
+    if (!header.key_frame && !header.show_frame) {
+      bits.push_back(header.intra_only);
+    }
+  }
+  std::vector<uint8_t> frame(size);
+  for (size_t i = 0; i < bits.size(); i++) {
+    if (bits[i]) frame[i / 8] |= 0x80 >> (i % 8);
+  }
+  return frame;
+}
+
+// Returns a superframe holding |frames|, with an index whose sizes take
+// |size_bytes| bytes each, from annex B of the VP9 specification.
+std::vector<uint8_t> MakeSuperframe(
+    const std::vector<std::vector<uint8_t>>& frames, int size_bytes) {
+  std::vector<uint8_t> superframe;
+  for (const std::vector<uint8_t>& frame : frames) {
+    superframe.insert(superframe.end(), frame.begin(), frame.end());
+  }
+  const uint8_t marker = static_cast<uint8_t>(
+      0xC0 | ((size_bytes - 1) << 3) | (frames.size() - 1));
+  superframe.push_back(marker);
+  for (const std::vector<uint8_t>& frame : frames) {
+    for (int i = 0; i < size_bytes; i++) {
+      superframe.push_back(static_cast<uint8_t>(frame.size() >> (8 * i)));
+    }
+  }
+  superframe.push_back(marker);
+  return superframe;
+}
+
+const FrameHeader kKeyFrame = {0, false, true, true, false};
+const FrameHeader kInterFrame = {0, false, false, true, false};
+const FrameHeader kHiddenInterFrame = {0, false, false, false, false};
+const FrameHeader kHiddenIntraOnlyFrame = {0, false, false, false, true};
+const FrameHeader kShowExistingFrame = {0, true, false, false, false};
+
+// Returns whether classify_vp9_packet() accepts |packet| and classifies it as
+// expected.
+bool Classifies(const char* name, const std::vector<uint8_t>& packet,
+                bool expected_key_frame, bool expected_intra_only) {
+  bool key_frame;
+  bool intra_only;
+  if (!vpx_jni::classify_vp9_packet(packet.data(), packet.size(), &key_frame,
+                                    &intra_only)) {
+    fprintf(stderr, "%s: not parsed\n", name);
+    return false;
+  }
+  if (key_frame != expected_key_frame || intra_only != expected_intra_only) {
+    fprintf(stderr, "%s: key_frame %d, intra_only %d\n", name, key_frame,
+            intra_only);
+    return false;
+  }
+  return true;
+}
+
+bool Rejects(const char* name, const std::vector<uint8_t>& packet) {
+  bool key_frame;
+  bool intra_only;
+  if (vpx_jni::classify_vp9_packet(packet.data(), packet.size(), &key_frame,
+                                   &intra_only)) {
+    fprintf(stderr, "%s: parsed\n", name);
+    return false;
+  }
+  return true;
+}
+
+bool CheckFrameTypes() {
+  bool passed = true;
+  passed &= Classifies("Key frame", MakeFrame(kKeyFrame), true, true);
+  passed &= Classifies("Profile 3 key frame",
+                       MakeFrame({3, false, true, true, false}), true, true);
+  passed &= Classifies("Inter frame", MakeFrame(kInterFrame), false, false);
+  passed &= Classifies("Hidden inter frame", MakeFrame(kHiddenInterFrame),
+                       false, false);
+  passed &= Classifies("Hidden intra-only frame",
+                       MakeFrame(kHiddenIntraOnlyFrame), false, true);
+  passed &= Classifies("Profile 3 hidden intra-only frame",
+                       MakeFrame({3, false, false, false, true}), false, true);
+  passed &= Classifies("Show existing frame", MakeFrame(kShowExistingFrame),
+                       false, false);
+
+  bool key_frame;
+  bool intra_only;
+  const std::vector<uint8_t> frame = MakeFrame(kKeyFrame);
+  if (!vpx_jni::parse_vp9_frame_type(frame.data(), frame.size(), &key_frame,
+                                     &intra_only) ||
+      !key_frame || !intra_only) {
+    fprintf(stderr, "parse_vp9_frame_type: key frame not parsed\n");
+    passed = false;
+  }
+  std::vector<uint8_t> bad_marker = MakeFrame(kKeyFrame);
+  bad_marker[0] ^= 0x40;
+  passed &= Rejects("Bad frame marker", bad_marker);
+  passed &= Rejects("One byte frame", MakeFrame(kKeyFrame, 1));
+  if (passed) printf("Frame types: OK\n");
+  return passed;
+}
+
+bool CheckSuperframes() {
+  bool passed = true;
+  // An alternate reference frame decoded without being shown, then the frame
+  // that is shown.
+  passed &= Classifies("Hidden and shown inter frames",
+                       MakeSuperframe({MakeFrame(kHiddenInterFrame),
+                                       MakeFrame(kInterFrame)},
+                                      1),
+                       false, false);
+  passed &= Classifies("Key frame and hidden intra-only frame",
+                       MakeSuperframe({MakeFrame(kKeyFrame),
+                                       MakeFrame(kHiddenIntraOnlyFrame)},
+                                      1),
+                       true, true);
+  passed &= Classifies("Hidden intra-only and shown inter frames",
+                       MakeSuperframe({MakeFrame(kHiddenIntraOnlyFrame),
+                                       MakeFrame(kInterFrame)},
+                                      1),
+                       false, false);
+  passed &= Classifies("Inter frame and key frame",
+                       MakeSuperframe({MakeFrame(kInterFrame),
+                                       MakeFrame(kKeyFrame)},
+                                      1),
+                       true, false);
+  // Frames of 300 bytes need two bytes in the index.
+  passed &= Classifies("Two byte sizes",
+                       MakeSuperframe({MakeFrame(kHiddenInterFrame, 300),
+                                       MakeFrame(kKeyFrame, 300)},
+                                      2),
+                       true, false);
+  passed &= Classifies(
+      "Eight frames",
+      MakeSuperframe(std::vector<std::vector<uint8_t>>(
+                         8, MakeFrame(kHiddenIntraOnlyFrame)),
+                     4),
+      false, true);
+
+  std::vector<uint8_t> oversized = MakeSuperframe(
+      {MakeFrame(kHiddenInterFrame), MakeFrame(kInterFrame)}, 1);
+  // Grow the size of the second frame in the index beyond the data.
+  oversized[oversized.size() - 2] = 2 * kFrameSize;
+  passed &= Rejects("Frame beyond the data", oversized);
+
+  std::vector<uint8_t> truncated_frame = MakeSuperframe(
+      {MakeFrame(kKeyFrame), MakeFrame(kInterFrame, 1)}, 1);
+  passed &= Rejects("One byte frame in a superframe", truncated_frame);
+
+  // A packet that only ends with what looks like a marker is a single frame.
+  std::vector<uint8_t> false_marker = MakeFrame(kKeyFrame);
+  false_marker.back() = 0xC1;
+  passed &= Classifies("Unmatched marker", false_marker, true, true);
+  if (passed) printf("Superframes: OK\n");
+  return passed;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= CheckFrameTypes();
+  passed &= CheckSuperframes();
+  return passed ? 0 : 1;
+}
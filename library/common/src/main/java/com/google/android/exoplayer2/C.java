@@ -511,12 +511,19 @@ public final class C {
 
   /**
    * Video decoder output modes. Possible modes are {@link #VIDEO_OUTPUT_MODE_NONE}, {@link
-   * #VIDEO_OUTPUT_MODE_YUV} and {@link #VIDEO_OUTPUT_MODE_SURFACE_YUV}.
+   * #VIDEO_OUTPUT_MODE_YUV}, {@link #VIDEO_OUTPUT_MODE_SURFACE_YUV} and {@link
+   * #VIDEO_OUTPUT_MODE_RGBA}.
    */
   @Documented
   @Retention(RetentionPolicy.SOURCE)
   @Target(TYPE_USE)
-  @IntDef(value = {VIDEO_OUTPUT_MODE_NONE, VIDEO_OUTPUT_MODE_YUV, VIDEO_OUTPUT_MODE_SURFACE_YUV})
+  @IntDef(
+      value = {
+        VIDEO_OUTPUT_MODE_NONE,
+        VIDEO_OUTPUT_MODE_YUV,
+        VIDEO_OUTPUT_MODE_SURFACE_YUV,
+        VIDEO_OUTPUT_MODE_RGBA
+      })
   public @interface VideoOutputMode {}
   /** Video decoder output mode is not set. */
   public static final int VIDEO_OUTPUT_MODE_NONE = -1;
@@ -524,6 +531,11 @@ public final class C {
   public static final int VIDEO_OUTPUT_MODE_YUV = 0;
   /** Video decoder output mode that renders 4:2:0 YUV planes directly to a surface. */
   public static final int VIDEO_OUTPUT_MODE_SURFACE_YUV = 1;
+  /**
+   * Video decoder output mode that outputs RGBA pixels converted from YUV by the decoder, for
+   * consumers that need RGB frames rather than for rendering.
+   */
+  public static final int VIDEO_OUTPUT_MODE_RGBA = 2;
 
   /**
    * Video scaling modes for {@link MediaCodec}-based renderers. One of {@link
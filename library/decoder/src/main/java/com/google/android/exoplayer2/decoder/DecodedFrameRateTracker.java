@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import android.os.SystemClock;
+import androidx.annotation.GuardedBy;
+import com.google.android.exoplayer2.C;
+
+/**
+ * Measures the rate at which a decoder outputs frames, for example while it decodes only key frames
+ * in a trick-play mode.
+ *
+ * <p>The decoder calls {@link #onFrameDecoded()} on its decode thread. The rate can be read on any
+ * thread.
+ */
+public final class DecodedFrameRateTracker {
+
+  @GuardedBy("this")
+  private long startTimeMs;
+
+  @GuardedBy("this")
+  private int frameCount;
+
+  /** Creates an instance that is not measuring. */
+  public DecodedFrameRateTracker() {
+    startTimeMs = C.TIME_UNSET;
+  }
+
+  /** Starts measuring from now, discarding the frames counted so far. */
+  public synchronized void start() {
+    startTimeMs = SystemClock.elapsedRealtime();
+    frameCount = 0;
+  }
+
+  /** Stops measuring. {@link #getFrameRate()} returns 0 until {@link #start()} is called. */
+  public synchronized void stop() {
+    startTimeMs = C.TIME_UNSET;
+    frameCount = 0;
+  }
+
+  /** Returns whether the tracker is measuring. */
+  public synchronized boolean isStarted() {
+    return startTimeMs != C.TIME_UNSET;
+  }
+
+  /** Counts a frame output by the decoder, if the tracker is measuring. */
+  public synchronized void onFrameDecoded() {
+    if (startTimeMs != C.TIME_UNSET) {
+      frameCount++;
+    }
+  }
+
+  /**
+   * Returns the number of frames counted per second since {@link #start()} was called, or 0 if
+   * the tracker is not measuring or no time has elapsed.
+   */
+  public synchronized float getFrameRate() {
+    if (startTimeMs == C.TIME_UNSET) {
+      return 0;
+    }
+    long elapsedMs = SystemClock.elapsedRealtime() - startTimeMs;
+    return elapsedMs > 0 ? frameCount * 1000f / elapsedMs : 0;
+  }
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static java.lang.annotation.ElementType.TYPE_USE;
+
+import androidx.annotation.GuardedBy;
+import androidx.annotation.IntDef;
+import androidx.annotation.Nullable;
+import androidx.annotation.VisibleForTesting;
+import com.google.android.exoplayer2.util.Assertions;
+import java.lang.annotation.Documented;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.lang.annotation.Target;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Divides a process-wide budget of decoding threads between the live software decoder instances.
+ *
+ * <p>Each native decoder sizes its own thread pool, so several decoders running at once (for
+ * example a full screen player next to preview tiles) would otherwise each claim every core. A
+ * decoder {@link #register registers} the number of threads it would like, and is allocated a
+ * share of the budget weighted by its {@link Priority}. Shares are recomputed whenever a decoder
+ * registers, unregisters or changes priority. Decoders read their current share with {@link
+ * Registration#getThreadCount()} and apply it when they are next flushed.
+ */
+public final class DecoderThreadBudget {
+
+  /**
+   * The priority of a decoder when dividing the budget. One of {@link #PRIORITY_FOREGROUND} or
+   * {@link #PRIORITY_BACKGROUND}.
+   */
+  @Documented
+  @Retention(RetentionPolicy.SOURCE)
+  @Target(TYPE_USE)
+  @IntDef({PRIORITY_FOREGROUND, PRIORITY_BACKGROUND})
+  public @interface Priority {}
+  /** A decoder whose output is the main content on screen. */
+  public static final int PRIORITY_FOREGROUND = 0;
+  /** A decoder whose output is secondary, for example a preview or a thumbnail. */
+  public static final int PRIORITY_BACKGROUND = 1;
+
+  private static final int FOREGROUND_WEIGHT = 2;
+  private static final int BACKGROUND_WEIGHT = 1;
+
+  /** A decoder's entry in the budget. */
+  public final class Registration {
+
+    private final int maxThreads;
+
+    // Guarded by the enclosing budget.
+    private @Priority int priority;
+    private int threadCount;
+
+    private Registration(@Priority int priority, int maxThreads) {
+      this.priority = priority;
+      this.maxThreads = maxThreads;
+    }
+
+    /**
+     * Returns the number of threads the decoder should currently use. This is at least one and at
+     * most the number of threads passed to {@link #register}.
+     */
+    public int getThreadCount() {
+      synchronized (DecoderThreadBudget.this) {
+        return threadCount;
+      }
+    }
+
+    /** Changes the priority of the decoder, rebalancing the budget. */
+    public void setPriority(@Priority int priority) {
+      synchronized (DecoderThreadBudget.this) {
+        if (this.priority != priority) {
+          this.priority = priority;
+          rebalance();
+        }
+      }
+    }
+
+    /** Removes the decoder from the budget, returning its share to the other decoders. */
+    public void unregister() {
+      synchronized (DecoderThreadBudget.this) {
+        if (registrations.remove(this)) {
+          rebalance();
+        }
+      }
+    }
+  }
+
+  @Nullable private static DecoderThreadBudget instance;
+
+  private final int totalThreads;
+
+  @GuardedBy("this")
+  private final List<Registration> registrations;
+
+  /** Returns the process-wide budget, which has one thread per available processor. */
+  public static synchronized DecoderThreadBudget getInstance() {
+    if (instance == null) {
+      instance = new DecoderThreadBudget(Runtime.getRuntime().availableProcessors());
+    }
+    return instance;
+  }
+
+  /**
+   * Creates an instance.
+   *
+   * @param totalThreads The number of threads to divide between the registered decoders.
+   */
+  @VisibleForTesting
+  /* package */ DecoderThreadBudget(int totalThreads) {
+    Assertions.checkArgument(totalThreads > 0);
+    this.totalThreads = totalThreads;
+    registrations = new ArrayList<>();
+  }
+
+  /**
+   * Registers a decoder.
+   *
+   * @param priority The {@link Priority} of the decoder.
+   * @param maxThreads The number of threads the decoder would use on its own. Must be positive.
+   * @return The decoder's {@link Registration}, which must be {@link Registration#unregister()
+   *     unregistered} when the decoder is released.
+   */
+  public synchronized Registration register(@Priority int priority, int maxThreads) {
+    Assertions.checkArgument(maxThreads > 0);
+    Registration registration = new Registration(priority, maxThreads);
+    registrations.add(registration);
+    rebalance();
+    return registration;
+  }
+
+  @GuardedBy("this")
+  private void rebalance() {
+    // Hand out the budget in proportion to the weights, capping each decoder at the number of
+    // threads it asked for and sharing what a capped decoder leaves between the others.
+    List<Registration> uncapped = new ArrayList<>(registrations);
+    int remainingThreads = totalThreads;
+    boolean capped = true;
+    while (capped && !uncapped.isEmpty()) {
+      capped = false;
+      int totalWeight = getTotalWeight(uncapped);
+      for (int i = 0; i < uncapped.size(); i++) {
+        Registration registration = uncapped.get(i);
+        if ((long) remainingThreads * getWeight(registration.priority)
+            >= (long) registration.maxThreads * totalWeight) {
+          registration.threadCount = registration.maxThreads;
+          remainingThreads -= registration.maxThreads;
+          uncapped.remove(i);
+          capped = true;
+          break;
+        }
+      }
+    }
+    if (uncapped.isEmpty()) {
+      return;
+    }
+    int totalWeight = getTotalWeight(uncapped);
+    int allocatedThreads = 0;
+    for (Registration registration : uncapped) {
+      int share = Math.max(0, remainingThreads) * getWeight(registration.priority) / totalWeight;
+      registration.threadCount = Math.max(1, share);
+      allocatedThreads += registration.threadCount;
+    }
+    // Give the threads lost to rounding down to foreground decoders first.
+    int leftoverThreads = remainingThreads - allocatedThreads;
+    for (int pass = 0; pass < 2 && leftoverThreads > 0; pass++) {
+      int passPriority = pass == 0 ? PRIORITY_FOREGROUND : PRIORITY_BACKGROUND;
+      for (int i = 0; i < uncapped.size() && leftoverThreads > 0; i++) {
+        Registration registration = uncapped.get(i);
+        if (registration.priority == passPriority
+            && registration.threadCount < registration.maxThreads) {
+          registration.threadCount++;
+          leftoverThreads--;
+        }
+      }
+    }
+  }
+
+  private static int getTotalWeight(List<Registration> registrations) {
+    int totalWeight = 0;
+    for (int i = 0; i < registrations.size(); i++) {
+      totalWeight += getWeight(registrations.get(i).priority);
+    }
+    return totalWeight;
+  }
+
+  private static int getWeight(@Priority int priority) {
+    return priority == PRIORITY_FOREGROUND ? FOREGROUND_WEIGHT : BACKGROUND_WEIGHT;
+  }
+}
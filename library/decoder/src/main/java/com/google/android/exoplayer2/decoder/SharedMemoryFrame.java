@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import android.os.ParcelFileDescriptor;
+import java.io.Closeable;
+import java.io.IOException;
+
+/**
+ * A decoded 8-bit YUV frame held in shared memory, which another process can map instead of
+ * receiving a copy of the frame.
+ *
+ * <p>The {@link #fileDescriptor} can be sent to the other process, for example in a {@link
+ * android.os.Parcel}. The other process maps {@link #sizeBytes} bytes of it read-only and reads
+ * the planes at the given offsets and strides, with chroma planes subsampled by 2 in both
+ * directions. The decoder may reuse the memory for another frame once the output buffer the frame
+ * was exported from is released, so the buffer must be held until the other process is done with
+ * the frame.
+ */
+public final class SharedMemoryFrame implements Closeable {
+
+  /** The file descriptor of the shared memory, owned by this instance. */
+  public final ParcelFileDescriptor fileDescriptor;
+  /** The size of the shared memory, in bytes. */
+  public final int sizeBytes;
+  /** The width of the frame, in pixels. */
+  public final int width;
+  /** The height of the frame, in pixels. */
+  public final int height;
+  /** The offsets of the Y, U and V planes in the shared memory, in bytes. */
+  public final int[] offsets;
+  /**
+   * The strides of the Y, U and V planes, in bytes. The U and V strides of monochrome frames are 0.
+   */
+  public final int[] strides;
+
+  /**
+   * Creates an instance.
+   *
+   * @param fileDescriptor The file descriptor of the shared memory, which the instance takes
+   *     ownership of.
+   * @param sizeBytes The size of the shared memory, in bytes.
+   * @param width The width of the frame, in pixels.
+   * @param height The height of the frame, in pixels.
+   * @param offsets The offsets of the Y, U and V planes in the shared memory, in bytes.
+   * @param strides The strides of the Y, U and V planes, in bytes.
+   */
+  public SharedMemoryFrame(
+      ParcelFileDescriptor fileDescriptor,
+      int sizeBytes,
+      int width,
+      int height,
+      int[] offsets,
+      int[] strides) {
+    this.fileDescriptor = fileDescriptor;
+    this.sizeBytes = sizeBytes;
+    this.width = width;
+    this.height = height;
+    this.offsets = offsets;
+    this.strides = strides;
+  }
+
+  /** Closes the {@link #fileDescriptor}. Mappings of the memory made from it remain valid. */
+  @Override
+  public void close() throws IOException {
+    fileDescriptor.close();
+  }
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import androidx.annotation.Nullable;
+
+/**
+ * Describes the frames in a temporal unit of compressed video, that is the data of one input
+ * buffer, as classified by parsing its headers without decoding it.
+ *
+ * <p>Software decoders return instances so that the player can decide which input buffers to drop
+ * or skip, and how many output buffers to allocate, before the decoder does any work.
+ */
+public final class TemporalUnitInfo {
+
+  // Layout of the packed representation returned by the native parsers.
+  private static final int FLAG_KEY_FRAME = 1;
+  private static final int FLAG_INTRA_ONLY = 1 << 1;
+  private static final int FLAG_SHOW_EXISTING_FRAME = 1 << 2;
+  private static final int FLAG_REFERENCE = 1 << 3;
+  private static final int SHOWN_FRAME_COUNT_SHIFT = 8;
+  private static final int HIDDEN_FRAME_COUNT_SHIFT = 16;
+  private static final int SPATIAL_LAYER_COUNT_SHIFT = 24;
+  private static final int COUNT_MASK = 0xFF;
+
+  /**
+   * Whether the temporal unit shows a key frame, from which decoding can start. Key frames that are
+   * decoded without being shown do not count until they are shown.
+   */
+  public final boolean isKeyFrame;
+  /**
+   * Whether every frame in the temporal unit is intra coded, or shows an intra coded frame that
+   * was decoded earlier, so that it can be decoded without the preceding inter frames. False if
+   * the temporal unit contains no frames.
+   */
+  public final boolean isIntraOnly;
+  /** Whether the temporal unit shows a frame that was decoded earlier instead of a new one. */
+  public final boolean isShowExistingFrame;
+  /**
+   * Whether any frame in the temporal unit is used as a reference by later frames. If not, the
+   * temporal unit can be dropped without affecting the frames that follow it.
+   */
+  public final boolean isReference;
+  /** The number of frames that are output when the temporal unit is decoded. */
+  public final int shownFrameCount;
+  /** The number of frames that are decoded only to be referenced or shown later. */
+  public final int hiddenFrameCount;
+  /** The number of spatial layers in the temporal unit, or 0 if it contains no frames. */
+  public final int spatialLayerCount;
+
+  /** Creates an instance. */
+  public TemporalUnitInfo(
+      boolean isKeyFrame,
+      boolean isIntraOnly,
+      boolean isShowExistingFrame,
+      boolean isReference,
+      int shownFrameCount,
+      int hiddenFrameCount,
+      int spatialLayerCount) {
+    this.isKeyFrame = isKeyFrame;
+    this.isIntraOnly = isIntraOnly;
+    this.isShowExistingFrame = isShowExistingFrame;
+    this.isReference = isReference;
+    this.shownFrameCount = shownFrameCount;
+    this.hiddenFrameCount = hiddenFrameCount;
+    this.spatialLayerCount = spatialLayerCount;
+  }
+
+  /**
+   * Unpacks the representation returned by the native parsers of the software decoder extensions.
+   *
+   * @param packedInfo The packed representation, or a negative value if the temporal unit could
+   *     not be parsed.
+   * @return The unpacked instance, or null if {@code packedInfo} is negative.
+   */
+  @Nullable
+  public static TemporalUnitInfo fromPackedInfo(int packedInfo) {
+    if (packedInfo < 0) {
+      return null;
+    }
+    return new TemporalUnitInfo(
+        /* isKeyFrame= */ (packedInfo & FLAG_KEY_FRAME) != 0,
+        /* isIntraOnly= */ (packedInfo & FLAG_INTRA_ONLY) != 0,
+        /* isShowExistingFrame= */ (packedInfo & FLAG_SHOW_EXISTING_FRAME) != 0,
+        /* isReference= */ (packedInfo & FLAG_REFERENCE) != 0,
+        /* shownFrameCount= */ (packedInfo >> SHOWN_FRAME_COUNT_SHIFT) & COUNT_MASK,
+        /* hiddenFrameCount= */ (packedInfo >> HIDDEN_FRAME_COUNT_SHIFT) & COUNT_MASK,
+        /* spatialLayerCount= */ (packedInfo >> SPATIAL_LAYER_COUNT_SHIFT) & COUNT_MASK);
+  }
+}
@@ -28,6 +28,14 @@ public class VideoDecoderOutputBuffer extends DecoderOutputBuffer {
   public static final int COLORSPACE_BT709 = 2;
   public static final int COLORSPACE_BT2020 = 3;
 
+  /** RGBA pixels with 8 bits per component, in R, G, B, A byte order. */
+  public static final int RGBA_FORMAT_8888 = 0;
+  /**
+   * RGBA pixels packed into little-endian 32-bit words, with 10 bits per color component in bits
+   * 0-9 (R), 10-19 (G) and 20-29 (B), and 2 bits of alpha.
+   */
+  public static final int RGBA_FORMAT_1010102 = 1;
+
   /** Decoder private data. Used from native code. */
   public int decoderPrivate;
 
@@ -47,6 +55,11 @@ public class VideoDecoderOutputBuffer extends DecoderOutputBuffer {
   @Nullable public int[] yuvStrides;
   public int colorspace;
 
+  /** Format of the pixels in {@link #data} for RGBA mode. */
+  public int rgbaFormat;
+  /** Row stride of the pixels in {@link #data} for RGBA mode, in bytes. */
+  public int rgbaStride;
+
   /**
    * Supplemental data related to the output frame, if {@link #hasSupplementalData()} returns true.
    * If present, the buffer is populated with supplemental data from position 0 to its limit.
@@ -74,7 +87,8 @@ public class VideoDecoderOutputBuffer extends DecoderOutputBuffer {
    *
    * @param timeUs The presentation timestamp for the buffer, in microseconds.
    * @param mode The output mode. One of {@link C#VIDEO_OUTPUT_MODE_NONE}, {@link
-   *     C#VIDEO_OUTPUT_MODE_YUV} and {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV}.
+   *     C#VIDEO_OUTPUT_MODE_YUV}, {@link C#VIDEO_OUTPUT_MODE_SURFACE_YUV} and {@link
+   *     C#VIDEO_OUTPUT_MODE_RGBA}.
    * @param supplementalData Supplemental data associated with the frame, or {@code null} if not
    *     present. It is safe to reuse the provided buffer after this method returns.
    */
@@ -151,6 +165,91 @@ public class VideoDecoderOutputBuffer extends DecoderOutputBuffer {
     return true;
   }
 
+  /**
+   * Configures the buffer to expose YUV planes that are owned by the decoder rather than copied
+   * into {@link #data}. Called via JNI after decoding completes.
+   *
+   * <p>Each plane is exposed as a view of the corresponding decoder buffer, positioned at the given
+   * offset and limited to {@code stride * planeHeight} bytes. The planes remain valid until the
+   * buffer is released, after which the decoder may reuse the underlying memory.
+   *
+   * @return Whether the planes fit within the given decoder buffers.
+   */
+  public boolean initForExternalYuvFrame(
+      int width,
+      int height,
+      ByteBuffer yBuffer,
+      ByteBuffer uBuffer,
+      ByteBuffer vBuffer,
+      int yOffset,
+      int uOffset,
+      int vOffset,
+      int yStride,
+      int uvStride,
+      int colorspace) {
+    this.width = width;
+    this.height = height;
+    this.colorspace = colorspace;
+    int uvHeight = (int) (((long) height + 1) / 2);
+    if (!isSafeToMultiply(yStride, height) || !isSafeToMultiply(uvStride, uvHeight)) {
+      return false;
+    }
+    int yLength = yStride * height;
+    int uvLength = uvStride * uvHeight;
+    if (!fitsInBuffer(yBuffer, yOffset, yLength)
+        || !fitsInBuffer(uBuffer, uOffset, uvLength)
+        || !fitsInBuffer(vBuffer, vOffset, uvLength)) {
+      return false;
+    }
+
+    // The planes are not backed by data.
+    data = null;
+    if (yuvPlanes == null) {
+      yuvPlanes = new ByteBuffer[3];
+    }
+    yuvPlanes[0] = createPlaneView(yBuffer, yOffset, yLength);
+    yuvPlanes[1] = createPlaneView(uBuffer, uOffset, uvLength);
+    yuvPlanes[2] = createPlaneView(vBuffer, vOffset, uvLength);
+    if (yuvStrides == null) {
+      yuvStrides = new int[3];
+    }
+    yuvStrides[0] = yStride;
+    yuvStrides[1] = uvStride;
+    yuvStrides[2] = uvStride;
+    return true;
+  }
+
+  /**
+   * Resizes {@link #data} to hold RGBA pixels with the given stride. Called via JNI after decoding
+   * completes.
+   *
+   * @param width The frame width, in pixels.
+   * @param height The frame height, in pixels.
+   * @param stride The row stride, in bytes.
+   * @param rgbaFormat The pixel format, {@link #RGBA_FORMAT_8888} or {@link #RGBA_FORMAT_1010102}.
+   * @param colorspace The color space from which the pixels were converted.
+   * @return Whether the buffer was resized successfully.
+   */
+  public boolean initForRgbaFrame(
+      int width, int height, int stride, int rgbaFormat, int colorspace) {
+    this.width = width;
+    this.height = height;
+    this.colorspace = colorspace;
+    this.rgbaFormat = rgbaFormat;
+    this.rgbaStride = stride;
+    if (width < 0 || stride < width * 4L || !isSafeToMultiply(stride, height)) {
+      return false;
+    }
+    int size = stride * height;
+    if (data == null || data.capacity() < size) {
+      data = ByteBuffer.allocateDirect(size);
+    } else {
+      data.position(0);
+      data.limit(size);
+    }
+    return true;
+  }
+
   /**
    * Configures the buffer for the given frame dimensions when passing actual frame data via {@link
    * #decoderPrivate}. Called via JNI after decoding completes.
@@ -160,6 +259,19 @@ public class VideoDecoderOutputBuffer extends DecoderOutputBuffer {
     this.height = height;
   }
 
+  private static boolean fitsInBuffer(ByteBuffer buffer, int offset, int length) {
+    return offset >= 0 && length >= 0 && offset <= buffer.capacity() - length;
+  }
+
+  private static ByteBuffer createPlaneView(ByteBuffer buffer, int offset, int length) {
+    // Use a duplicate so that consumers of one frame cannot move the position of another frame that
+    // shares the same decoder buffer.
+    ByteBuffer plane = buffer.duplicate();
+    plane.limit(offset + length);
+    plane.position(offset);
+    return plane;
+  }
+
   /**
    * Ensures that the result of multiplying individual numbers can fit into the size limit of an
    * integer.
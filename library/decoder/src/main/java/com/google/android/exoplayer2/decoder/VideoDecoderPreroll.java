@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import android.os.Process;
+import androidx.annotation.GuardedBy;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.util.Assertions;
+import java.util.IdentityHashMap;
+import java.util.Map;
+
+/**
+ * Tracks a video decoder that decodes the first frames of an upcoming playlist item before the item
+ * becomes current, for example ahead of a gapless transition or an ad break.
+ *
+ * <p>While prerolling, the decode thread runs at background priority and the decoded frames stay
+ * queued in the decoder, ready to be dequeued as soon as the item starts. To bound the memory they
+ * use, the decode thread waits once the frames it decoded during the preroll and that have not been
+ * released yet reach a byte limit.
+ *
+ * <p>The decoder calls {@link #onDecodeStarting()} and {@link #onFrameDecoded} on its decode
+ * thread, and {@link #onFrameReleased} whenever an output buffer is released.
+ */
+public final class VideoDecoderPreroll {
+
+  @GuardedBy("this")
+  private final Map<VideoDecoderOutputBuffer, Long> prerolledFrameSizes;
+
+  @GuardedBy("this")
+  private boolean prerolling;
+
+  @GuardedBy("this")
+  private boolean released;
+
+  @GuardedBy("this")
+  private long maxBytes;
+
+  @GuardedBy("this")
+  private long prerolledBytes;
+
+  // Only accessed on the decode thread.
+  private boolean decodeThreadInBackground;
+
+  /** Creates an instance that is not prerolling. */
+  public VideoDecoderPreroll() {
+    prerolledFrameSizes = new IdentityHashMap<>();
+  }
+
+  /**
+   * Starts prerolling. Takes effect from the next decoded frame.
+   *
+   * @param maxBytes The maximum number of bytes of decoded frames to hold. Must be positive. The
+   *     last frame decoded before the limit is reached may exceed it.
+   */
+  public synchronized void start(long maxBytes) {
+    Assertions.checkArgument(maxBytes > 0);
+    this.maxBytes = maxBytes;
+    prerolling = true;
+    notifyAll();
+  }
+
+  /**
+   * Stops prerolling, letting the decode thread run at its normal priority and without limit.
+   * Frames decoded during the preroll stay queued in the decoder.
+   */
+  public synchronized void end() {
+    prerolling = false;
+    prerolledFrameSizes.clear();
+    prerolledBytes = 0;
+    notifyAll();
+  }
+
+  /** Returns whether the decoder is prerolling. */
+  public synchronized boolean isPrerolling() {
+    return prerolling;
+  }
+
+  /** Wakes up the decode thread if it is waiting, for the decoder to be released. */
+  public synchronized void release() {
+    released = true;
+    notifyAll();
+  }
+
+  /**
+   * Called on the decode thread before decoding an input buffer. Adjusts the priority of the
+   * thread, and waits while the frames held by the preroll exceed the limit.
+   */
+  public void onDecodeStarting() {
+    boolean interrupted = false;
+    boolean inBackground;
+    synchronized (this) {
+      while (prerolling && !released && prerolledBytes >= maxBytes) {
+        try {
+          wait();
+        } catch (InterruptedException e) {
+          interrupted = true;
+        }
+      }
+      inBackground = prerolling;
+    }
+    if (interrupted) {
+      Thread.currentThread().interrupt();
+    }
+    if (inBackground != decodeThreadInBackground) {
+      Process.setThreadPriority(
+          inBackground ? Process.THREAD_PRIORITY_BACKGROUND : Process.THREAD_PRIORITY_DEFAULT);
+      decodeThreadInBackground = inBackground;
+    }
+  }
+
+  /**
+   * Called on the decode thread once a frame has been decoded into {@code outputBuffer}. The frame
+   * counts against the limit until {@link #onFrameReleased} is called for its buffer.
+   */
+  public synchronized void onFrameDecoded(VideoDecoderOutputBuffer outputBuffer) {
+    if (!prerolling || outputBuffer.isDecodeOnly() || outputBuffer.isEndOfStream()) {
+      return;
+    }
+    long size = getFrameSize(outputBuffer);
+    prerolledFrameSizes.put(outputBuffer, size);
+    prerolledBytes += size;
+  }
+
+  /** Called when {@code outputBuffer} is released back to the decoder. */
+  public synchronized void onFrameReleased(VideoDecoderOutputBuffer outputBuffer) {
+    Long size = prerolledFrameSizes.remove(outputBuffer);
+    if (size != null) {
+      prerolledBytes -= size;
+      notifyAll();
+    }
+  }
+
+  private static long getFrameSize(VideoDecoderOutputBuffer outputBuffer) {
+    long samples = (long) outputBuffer.width * outputBuffer.height;
+    return outputBuffer.mode == C.VIDEO_OUTPUT_MODE_RGBA ? samples * 4 : samples * 3 / 2;
+  }
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import java.time.Duration;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+import org.robolectric.shadows.ShadowSystemClock;
+
+/** Unit tests for {@link DecodedFrameRateTracker}. */
+@RunWith(AndroidJUnit4.class)
+public class DecodedFrameRateTrackerTest {
+
+  @Test
+  public void getFrameRate_notStarted_returnsZero() {
+    DecodedFrameRateTracker tracker = new DecodedFrameRateTracker();
+    tracker.onFrameDecoded();
+    ShadowSystemClock.advanceBy(Duration.ofMillis(1000));
+
+    assertThat(tracker.isStarted()).isFalse();
+    assertThat(tracker.getFrameRate()).isEqualTo(0f);
+  }
+
+  @Test
+  public void getFrameRate_started_returnsFramesPerSecond() {
+    DecodedFrameRateTracker tracker = new DecodedFrameRateTracker();
+    tracker.start();
+    for (int i = 0; i < 15; i++) {
+      tracker.onFrameDecoded();
+    }
+    ShadowSystemClock.advanceBy(Duration.ofMillis(500));
+
+    assertThat(tracker.getFrameRate()).isEqualTo(30f);
+  }
+
+  @Test
+  public void start_discardsFramesCountedBefore() {
+    DecodedFrameRateTracker tracker = new DecodedFrameRateTracker();
+    tracker.start();
+    tracker.onFrameDecoded();
+    ShadowSystemClock.advanceBy(Duration.ofMillis(1000));
+
+    tracker.start();
+    tracker.onFrameDecoded();
+    tracker.onFrameDecoded();
+    ShadowSystemClock.advanceBy(Duration.ofMillis(1000));
+
+    assertThat(tracker.getFrameRate()).isEqualTo(2f);
+  }
+
+  @Test
+  public void stop_resetsFrameRate() {
+    DecodedFrameRateTracker tracker = new DecodedFrameRateTracker();
+    tracker.start();
+    tracker.onFrameDecoded();
+    ShadowSystemClock.advanceBy(Duration.ofMillis(100));
+
+    tracker.stop();
+
+    assertThat(tracker.isStarted()).isFalse();
+    assertThat(tracker.getFrameRate()).isEqualTo(0f);
+  }
+}
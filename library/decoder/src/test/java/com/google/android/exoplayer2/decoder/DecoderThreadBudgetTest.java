@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.android.exoplayer2.decoder.DecoderThreadBudget.PRIORITY_BACKGROUND;
+import static com.google.android.exoplayer2.decoder.DecoderThreadBudget.PRIORITY_FOREGROUND;
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.decoder.DecoderThreadBudget.Registration;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link DecoderThreadBudget}. */
+@RunWith(AndroidJUnit4.class)
+public class DecoderThreadBudgetTest {
+
+  @Test
+  public void register_singleDecoder_getsRequestedThreads() {
+    DecoderThreadBudget budget = new DecoderThreadBudget(/* totalThreads= */ 8);
+
+    Registration registration = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 4);
+
+    assertThat(registration.getThreadCount()).isEqualTo(4);
+  }
+
+  @Test
+  public void register_singleDecoderAskingForMoreThanBudget_isCappedAtBudget() {
+    DecoderThreadBudget budget = new DecoderThreadBudget(/* totalThreads= */ 8);
+
+    Registration registration = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 16);
+
+    assertThat(registration.getThreadCount()).isEqualTo(8);
+  }
+
+  @Test
+  public void register_foregroundAndBackground_splitsByWeight() {
+    DecoderThreadBudget budget = new DecoderThreadBudget(/* totalThreads= */ 8);
+
+    Registration foreground = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 8);
+    Registration background = budget.register(PRIORITY_BACKGROUND, /* maxThreads= */ 8);
+
+    assertThat(foreground.getThreadCount()).isEqualTo(6);
+    assertThat(background.getThreadCount()).isEqualTo(2);
+  }
+
+  @Test
+  public void register_cappedDecoder_leavesRemainderToOthers() {
+    DecoderThreadBudget budget = new DecoderThreadBudget(/* totalThreads= */ 8);
+
+    Registration foreground = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 2);
+    Registration background = budget.register(PRIORITY_BACKGROUND, /* maxThreads= */ 8);
+
+    assertThat(foreground.getThreadCount()).isEqualTo(2);
+    assertThat(background.getThreadCount()).isEqualTo(6);
+  }
+
+  @Test
+  public void register_moreDecodersThanThreads_givesEachDecoderOneThread() {
+    DecoderThreadBudget budget = new DecoderThreadBudget(/* totalThreads= */ 2);
+
+    Registration first = budget.register(PRIORITY_BACKGROUND, /* maxThreads= */ 4);
+    Registration second = budget.register(PRIORITY_BACKGROUND, /* maxThreads= */ 4);
+    Registration third = budget.register(PRIORITY_BACKGROUND, /* maxThreads= */ 4);
+
+    assertThat(first.getThreadCount()).isEqualTo(1);
+    assertThat(second.getThreadCount()).isEqualTo(1);
+    assertThat(third.getThreadCount()).isEqualTo(1);
+  }
+
+  @Test
+  public void unregister_returnsShareToRemainingDecoders() {
+    DecoderThreadBudget budget = new DecoderThreadBudget(/* totalThreads= */ 8);
+    Registration first = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 8);
+    Registration second = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 8);
+    assertThat(first.getThreadCount()).isEqualTo(4);
+
+    second.unregister();
+
+    assertThat(first.getThreadCount()).isEqualTo(8);
+  }
+
+  @Test
+  public void setPriority_rebalancesBudget() {
+    DecoderThreadBudget budget = new DecoderThreadBudget(/* totalThreads= */ 8);
+    Registration first = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 8);
+    Registration second = budget.register(PRIORITY_FOREGROUND, /* maxThreads= */ 8);
+
+    first.setPriority(PRIORITY_BACKGROUND);
+
+    assertThat(first.getThreadCount()).isEqualTo(2);
+    assertThat(second.getThreadCount()).isEqualTo(6);
+  }
+}
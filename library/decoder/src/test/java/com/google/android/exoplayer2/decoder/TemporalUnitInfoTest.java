@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link TemporalUnitInfo}. */
+@RunWith(AndroidJUnit4.class)
+public class TemporalUnitInfoTest {
+
+  @Test
+  public void fromPackedInfo_keyFrame() {
+    // Key frame, intra only, reference, one shown frame, one spatial layer.
+    TemporalUnitInfo info = TemporalUnitInfo.fromPackedInfo(0x01_00_01_0B);
+
+    assertThat(info.isKeyFrame).isTrue();
+    assertThat(info.isIntraOnly).isTrue();
+    assertThat(info.isShowExistingFrame).isFalse();
+    assertThat(info.isReference).isTrue();
+    assertThat(info.shownFrameCount).isEqualTo(1);
+    assertThat(info.hiddenFrameCount).isEqualTo(0);
+    assertThat(info.spatialLayerCount).isEqualTo(1);
+  }
+
+  @Test
+  public void fromPackedInfo_hiddenAndShownInterFrames() {
+    // Reference, one shown and two hidden frames, in two spatial layers.
+    TemporalUnitInfo info = TemporalUnitInfo.fromPackedInfo(0x02_02_01_08);
+
+    assertThat(info.isKeyFrame).isFalse();
+    assertThat(info.isIntraOnly).isFalse();
+    assertThat(info.isReference).isTrue();
+    assertThat(info.shownFrameCount).isEqualTo(1);
+    assertThat(info.hiddenFrameCount).isEqualTo(2);
+    assertThat(info.spatialLayerCount).isEqualTo(2);
+  }
+
+  @Test
+  public void fromPackedInfo_negative_returnsNull() {
+    assertThat(TemporalUnitInfo.fromPackedInfo(-1)).isNull();
+  }
+}
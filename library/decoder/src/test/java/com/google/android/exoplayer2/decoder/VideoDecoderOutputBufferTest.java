@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import java.nio.ByteBuffer;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link VideoDecoderOutputBuffer}. */
+@RunWith(AndroidJUnit4.class)
+public class VideoDecoderOutputBufferTest {
+
+  @Test
+  public void initForExternalYuvFrame_exposesPlanesAtOffsets() {
+    VideoDecoderOutputBuffer buffer = new VideoDecoderOutputBuffer(outputBuffer -> {});
+    ByteBuffer yBuffer = ByteBuffer.allocateDirect(100);
+    ByteBuffer uvBuffer = ByteBuffer.allocateDirect(100);
+
+    boolean result =
+        buffer.initForExternalYuvFrame(
+            /* width= */ 7,
+            /* height= */ 5,
+            yBuffer,
+            uvBuffer,
+            uvBuffer,
+            /* yOffset= */ 10,
+            /* uOffset= */ 4,
+            /* vOffset= */ 50,
+            /* yStride= */ 16,
+            /* uvStride= */ 8,
+            VideoDecoderOutputBuffer.COLORSPACE_BT709);
+
+    assertThat(result).isTrue();
+    assertThat(buffer.data).isNull();
+    assertThat(buffer.width).isEqualTo(7);
+    assertThat(buffer.height).isEqualTo(5);
+    assertThat(buffer.colorspace).isEqualTo(VideoDecoderOutputBuffer.COLORSPACE_BT709);
+    assertThat(buffer.yuvStrides).asList().containsExactly(16, 8, 8).inOrder();
+    ByteBuffer[] planes = buffer.yuvPlanes;
+    assertThat(planes[0].position()).isEqualTo(10);
+    assertThat(planes[0].remaining()).isEqualTo(16 * 5);
+    assertThat(planes[1].position()).isEqualTo(4);
+    assertThat(planes[1].remaining()).isEqualTo(8 * 3);
+    assertThat(planes[2].position()).isEqualTo(50);
+    assertThat(planes[2].remaining()).isEqualTo(8 * 3);
+    // The planes are views that do not affect the decoder buffers.
+    assertThat(uvBuffer.position()).isEqualTo(0);
+    assertThat(uvBuffer.limit()).isEqualTo(100);
+  }
+
+  @Test
+  public void initForExternalYuvFrame_planeOutsideBuffer_returnsFalse() {
+    VideoDecoderOutputBuffer buffer = new VideoDecoderOutputBuffer(outputBuffer -> {});
+    ByteBuffer planeBuffer = ByteBuffer.allocateDirect(64);
+
+    boolean result =
+        buffer.initForExternalYuvFrame(
+            /* width= */ 8,
+            /* height= */ 8,
+            planeBuffer,
+            planeBuffer,
+            planeBuffer,
+            /* yOffset= */ 1,
+            /* uOffset= */ 0,
+            /* vOffset= */ 0,
+            /* yStride= */ 8,
+            /* uvStride= */ 4,
+            VideoDecoderOutputBuffer.COLORSPACE_UNKNOWN);
+
+    assertThat(result).isFalse();
+  }
+
+  @Test
+  public void initForRgbaFrame_sizesDataForStride() {
+    VideoDecoderOutputBuffer buffer = new VideoDecoderOutputBuffer(outputBuffer -> {});
+
+    boolean result =
+        buffer.initForRgbaFrame(
+            /* width= */ 7,
+            /* height= */ 5,
+            /* stride= */ 32,
+            VideoDecoderOutputBuffer.RGBA_FORMAT_1010102,
+            VideoDecoderOutputBuffer.COLORSPACE_BT2020);
+
+    assertThat(result).isTrue();
+    assertThat(buffer.width).isEqualTo(7);
+    assertThat(buffer.height).isEqualTo(5);
+    assertThat(buffer.rgbaStride).isEqualTo(32);
+    assertThat(buffer.rgbaFormat).isEqualTo(VideoDecoderOutputBuffer.RGBA_FORMAT_1010102);
+    assertThat(buffer.colorspace).isEqualTo(VideoDecoderOutputBuffer.COLORSPACE_BT2020);
+    assertThat(buffer.data.isDirect()).isTrue();
+    assertThat(buffer.data.position()).isEqualTo(0);
+    assertThat(buffer.data.limit()).isEqualTo(32 * 5);
+  }
+
+  @Test
+  public void initForRgbaFrame_strideShorterThanRow_returnsFalse() {
+    VideoDecoderOutputBuffer buffer = new VideoDecoderOutputBuffer(outputBuffer -> {});
+
+    boolean result =
+        buffer.initForRgbaFrame(
+            /* width= */ 8,
+            /* height= */ 2,
+            /* stride= */ 31,
+            VideoDecoderOutputBuffer.RGBA_FORMAT_8888,
+            VideoDecoderOutputBuffer.COLORSPACE_UNKNOWN);
+
+    assertThat(result).isFalse();
+  }
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.TimeUnit;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link VideoDecoderPreroll}. */
+@RunWith(AndroidJUnit4.class)
+public class VideoDecoderPrerollTest {
+
+  private static final int WIDTH = 64;
+  private static final int HEIGHT = 32;
+  private static final long FRAME_SIZE = WIDTH * HEIGHT * 3 / 2;
+
+  @Test
+  public void startAndEnd_updatePrerolling() {
+    VideoDecoderPreroll preroll = new VideoDecoderPreroll();
+    assertThat(preroll.isPrerolling()).isFalse();
+
+    preroll.start(/* maxBytes= */ FRAME_SIZE);
+    assertThat(preroll.isPrerolling()).isTrue();
+
+    preroll.end();
+    assertThat(preroll.isPrerolling()).isFalse();
+  }
+
+  @Test
+  public void onDecodeStarting_belowLimit_doesNotWait() {
+    VideoDecoderPreroll preroll = new VideoDecoderPreroll();
+    preroll.start(/* maxBytes= */ 2 * FRAME_SIZE);
+    preroll.onFrameDecoded(createFrame());
+
+    preroll.onDecodeStarting();
+  }
+
+  @Test
+  public void onDecodeStarting_atLimit_waitsUntilFrameReleased() throws Exception {
+    VideoDecoderPreroll preroll = new VideoDecoderPreroll();
+    preroll.start(/* maxBytes= */ FRAME_SIZE);
+    VideoDecoderOutputBuffer frame = createFrame();
+    preroll.onFrameDecoded(frame);
+
+    CountDownLatch decodeStarted = new CountDownLatch(1);
+    Thread decodeThread =
+        new Thread(
+            () -> {
+              preroll.onDecodeStarting();
+              decodeStarted.countDown();
+            });
+    decodeThread.start();
+    assertThat(decodeStarted.await(100, TimeUnit.MILLISECONDS)).isFalse();
+
+    preroll.onFrameReleased(frame);
+    assertThat(decodeStarted.await(5, TimeUnit.SECONDS)).isTrue();
+    decodeThread.join();
+  }
+
+  @Test
+  public void onDecodeStarting_atLimit_stopsWaitingWhenPrerollEnds() throws Exception {
+    VideoDecoderPreroll preroll = new VideoDecoderPreroll();
+    preroll.start(/* maxBytes= */ FRAME_SIZE);
+    preroll.onFrameDecoded(createFrame());
+
+    CountDownLatch decodeStarted = new CountDownLatch(1);
+    Thread decodeThread =
+        new Thread(
+            () -> {
+              preroll.onDecodeStarting();
+              decodeStarted.countDown();
+            });
+    decodeThread.start();
+
+    preroll.end();
+    assertThat(decodeStarted.await(5, TimeUnit.SECONDS)).isTrue();
+    decodeThread.join();
+  }
+
+  @Test
+  public void onFrameDecoded_decodeOnlyFrame_isNotCounted() {
+    VideoDecoderPreroll preroll = new VideoDecoderPreroll();
+    preroll.start(/* maxBytes= */ FRAME_SIZE);
+    VideoDecoderOutputBuffer frame = createFrame();
+    frame.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
+    preroll.onFrameDecoded(frame);
+
+    preroll.onDecodeStarting();
+  }
+
+  private static VideoDecoderOutputBuffer createFrame() {
+    VideoDecoderOutputBuffer frame = new VideoDecoderOutputBuffer(buffer -> {});
+    frame.mode = C.VIDEO_OUTPUT_MODE_YUV;
+    frame.width = WIDTH;
+    frame.height = HEIGHT;
+    return frame;
+  }
+}